@@ -0,0 +1,1239 @@
+/* aead.c - ChaCha20-Poly1305, X25519 und BLAKE2s, siehe aead.h */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/random.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "aead.h"
+
+typedef unsigned __int128 u128;
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t le64(const uint8_t *p)
+{
+    return (uint64_t)le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+/* ------------------------------------------------------------
+ * ChaCha20 (RFC 8439, 96-Bit-Nonce)
+ * ------------------------------------------------------------ */
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QR(a, b, c, d)                                   \
+    a += b; d ^= a; d = ROTL32(d, 16);                   \
+    c += d; b ^= c; b = ROTL32(b, 12);                   \
+    a += b; d ^= a; d = ROTL32(d, 8);                    \
+    c += d; b ^= c; b = ROTL32(b, 7)
+
+static void chacha_init(uint32_t st[16], const uint8_t key[32], uint64_t ctr)
+{
+    st[0] = 0x61707865; st[1] = 0x3320646e; st[2] = 0x79622d32; st[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) st[4 + i] = le32(key + 4 * i);
+    st[12] = 0;                          /* Blockzähler */
+    st[13] = 0;                          /* Nonce: 0 || ctr (LE) */
+    st[14] = (uint32_t)ctr;
+    st[15] = (uint32_t)(ctr >> 32);
+}
+
+static void chacha_block(const uint32_t st[16], uint8_t out[64])
+{
+    uint32_t x[16];
+
+    memcpy(x, st, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QR(x[0], x[4], x[8],  x[12]);
+        QR(x[1], x[5], x[9],  x[13]);
+        QR(x[2], x[6], x[10], x[14]);
+        QR(x[3], x[7], x[11], x[15]);
+        QR(x[0], x[5], x[10], x[15]);
+        QR(x[1], x[6], x[11], x[12]);
+        QR(x[2], x[7], x[8],  x[13]);
+        QR(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < 16; i++) put_le32(out + 4 * i, x[i] + st[i]);
+}
+
+/* Vier Blöcke parallel in den Spuren eines 4 x 32-Bit-Vektors (GCC-
+ * Vektorerweiterung, ohne Intrinsics; der Compiler wählt SSE/NEON oder
+ * skalaren Code). Spur j rechnet Block st[12] + j. */
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+
+#define VROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define VQR(a, b, c, d)                                  \
+    a += b; d ^= a; d = VROTL(d, 16);                    \
+    c += d; b ^= c; b = VROTL(b, 12);                    \
+    a += b; d ^= a; d = VROTL(d, 8);                     \
+    c += d; b ^= c; b = VROTL(b, 7)
+
+static void chacha_block4(const uint32_t st[16], uint8_t out[256])
+{
+    v4u32 x[16], in[16];
+
+    for (int i = 0; i < 16; i++) {
+        v4u32 v = { st[i], st[i], st[i], st[i] };
+        in[i] = v;
+    }
+    in[12] += (v4u32){ 0, 1, 2, 3 };
+    memcpy(x, in, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        VQR(x[0], x[4], x[8],  x[12]);
+        VQR(x[1], x[5], x[9],  x[13]);
+        VQR(x[2], x[6], x[10], x[14]);
+        VQR(x[3], x[7], x[11], x[15]);
+        VQR(x[0], x[5], x[10], x[15]);
+        VQR(x[1], x[6], x[11], x[12]);
+        VQR(x[2], x[7], x[8],  x[13]);
+        VQR(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < 16; i++) {
+        v4u32 v = x[i] + in[i];
+        for (int j = 0; j < 4; j++) put_le32(out + 64 * j + 4 * i, v[j]);
+    }
+}
+
+/* Acht Blöcke je Aufruf mit AVX2 (x86-64, zur Laufzeit erkannt); die
+ * Rotationen um 16 und 8 Bit sind Byte-Permutationen (vpshufb). */
+#if defined(__x86_64__) && defined(__GNUC__)
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+typedef uint8_t  v32u8 __attribute__((vector_size(32)));
+
+#define VROT16(v) ((v8u32)__builtin_shuffle((v32u8)(v), (v32u8){              \
+    2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,                      \
+    18, 19, 16, 17, 22, 23, 20, 21, 26, 27, 24, 25, 30, 31, 28, 29 }))
+#define VROT8(v)  ((v8u32)__builtin_shuffle((v32u8)(v), (v32u8){              \
+    3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,                      \
+    19, 16, 17, 18, 23, 20, 21, 22, 27, 24, 25, 26, 31, 28, 29, 30 }))
+#define VQR8(a, b, c, d)                                 \
+    a += b; d ^= a; d = VROT16(d);                       \
+    c += d; b ^= c; b = VROTL(b, 12);                    \
+    a += b; d ^= a; d = VROT8(d);                        \
+    c += d; b ^= c; b = VROTL(b, 7)
+
+__attribute__((target("avx2")))
+static void chacha_block8(const uint32_t st[16], uint8_t out[512])
+{
+    v8u32 x[16], in[16];
+
+    for (int i = 0; i < 16; i++) {
+        v8u32 v = { st[i], st[i], st[i], st[i], st[i], st[i], st[i], st[i] };
+        in[i] = v;
+    }
+    in[12] += (v8u32){ 0, 1, 2, 3, 4, 5, 6, 7 };
+    memcpy(x, in, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        VQR8(x[0], x[4], x[8],  x[12]);
+        VQR8(x[1], x[5], x[9],  x[13]);
+        VQR8(x[2], x[6], x[10], x[14]);
+        VQR8(x[3], x[7], x[11], x[15]);
+        VQR8(x[0], x[5], x[10], x[15]);
+        VQR8(x[1], x[6], x[11], x[12]);
+        VQR8(x[2], x[7], x[8],  x[13]);
+        VQR8(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < 16; i++) x[i] += in[i];
+
+    /* transponieren: je vier Zeilen ergeben Viertelblöcke, die 128-Bit-
+     * Hälften gehören zu Block j bzw. j + 4 (x86 ist little-endian) */
+    for (int q = 0; q < 4; q++) {
+        v8u32 *r = x + 4 * q;
+        v8u32 t0 = __builtin_shuffle(r[0], r[1], (v8u32){ 0, 8, 1, 9, 4, 12, 5, 13 });
+        v8u32 t1 = __builtin_shuffle(r[0], r[1], (v8u32){ 2, 10, 3, 11, 6, 14, 7, 15 });
+        v8u32 t2 = __builtin_shuffle(r[2], r[3], (v8u32){ 0, 8, 1, 9, 4, 12, 5, 13 });
+        v8u32 t3 = __builtin_shuffle(r[2], r[3], (v8u32){ 2, 10, 3, 11, 6, 14, 7, 15 });
+        r[0] = __builtin_shuffle(t0, t2, (v8u32){ 0, 1, 8, 9, 4, 5, 12, 13 });
+        r[1] = __builtin_shuffle(t0, t2, (v8u32){ 2, 3, 10, 11, 6, 7, 14, 15 });
+        r[2] = __builtin_shuffle(t1, t3, (v8u32){ 0, 1, 8, 9, 4, 5, 12, 13 });
+        r[3] = __builtin_shuffle(t1, t3, (v8u32){ 2, 3, 10, 11, 6, 7, 14, 15 });
+    }
+    for (int j = 0; j < 4; j++) {
+        for (int q = 0; q < 4; q += 2) {
+            v8u32 lo = __builtin_shuffle(x[4 * q + j], x[4 * q + 4 + j],
+                                         (v8u32){ 0, 1, 2, 3, 8, 9, 10, 11 });
+            v8u32 hi = __builtin_shuffle(x[4 * q + j], x[4 * q + 4 + j],
+                                         (v8u32){ 4, 5, 6, 7, 12, 13, 14, 15 });
+            memcpy(out + 64 * j + 16 * q, &lo, sizeof(lo));
+            memcpy(out + 64 * (j + 4) + 16 * q, &hi, sizeof(hi));
+        }
+    }
+}
+
+/* Vier Blöcke zeilenweise für kurze Pakete: je zwei Blöcke in einem
+ * Vektor (Block n unten, n + 1 oben), die Diagonalen per Permutation.
+ * Eine Zeilenfolge ist latenzgebunden, die zweite läuft verschränkt
+ * fast umsonst mit; so kosten vier Blöcke etwa so viel wie einer
+ * skalar. */
+#define VDIAG(b, c, d, mb, mc, md)                       \
+    b = __builtin_shuffle(b, mb);                        \
+    c = __builtin_shuffle(c, mc);                        \
+    d = __builtin_shuffle(d, md)
+
+__attribute__((target("avx2")))
+static void chacha_block4r(const uint32_t st[16], uint8_t out[256])
+{
+    v8u32 in[4], a0, b0, c0, d0, a1, b1, c1, d1;
+    v8u32 r1 = { 1, 2, 3, 0, 5, 6, 7, 4 }, r2 = { 2, 3, 0, 1, 6, 7, 4, 5 }, r3 = { 3, 0, 1, 2, 7, 4, 5, 6 };
+    v8u32 lo = { 0, 1, 2, 3, 8, 9, 10, 11 }, hi = { 4, 5, 6, 7, 12, 13, 14, 15 };
+    v8u32 two = { 2, 0, 0, 0, 2, 0, 0, 0 };
+
+    for (int i = 0; i < 4; i++) {
+        v8u32 v = { st[4 * i], st[4 * i + 1], st[4 * i + 2], st[4 * i + 3],
+                    st[4 * i], st[4 * i + 1], st[4 * i + 2], st[4 * i + 3] };
+        in[i] = v;
+    }
+    in[3] += (v8u32){ 0, 0, 0, 0, 1, 0, 0, 0 };
+    a0 = a1 = in[0]; b0 = b1 = in[1]; c0 = c1 = in[2]; d0 = in[3]; d1 = in[3] + two;
+    for (int i = 0; i < 10; i++) {
+        VQR8(a0, b0, c0, d0);
+        VQR8(a1, b1, c1, d1);
+        VDIAG(b0, c0, d0, r1, r2, r3);
+        VDIAG(b1, c1, d1, r1, r2, r3);
+        VQR8(a0, b0, c0, d0);
+        VQR8(a1, b1, c1, d1);
+        VDIAG(b0, c0, d0, r3, r2, r1);
+        VDIAG(b1, c1, d1, r3, r2, r1);
+    }
+    a0 += in[0]; b0 += in[1]; c0 += in[2]; d0 += in[3];
+    a1 += in[0]; b1 += in[1]; c1 += in[2]; d1 += in[3] + two;
+
+    v8u32 w[8] = {
+        __builtin_shuffle(a0, b0, lo), __builtin_shuffle(c0, d0, lo),
+        __builtin_shuffle(a0, b0, hi), __builtin_shuffle(c0, d0, hi),
+        __builtin_shuffle(a1, b1, lo), __builtin_shuffle(c1, d1, lo),
+        __builtin_shuffle(a1, b1, hi), __builtin_shuffle(c1, d1, hi)
+    };
+    memcpy(out, w, sizeof(w));
+}
+
+static int chacha_have8(void)
+{
+    static int have = -1;
+
+    if (have < 0) have = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return have;
+}
+#else
+static void chacha_block8(const uint32_t st[16], uint8_t out[512]) { (void)st; (void)out; }
+static void chacha_block4r(const uint32_t st[16], uint8_t out[256]) { (void)st; (void)out; }
+static int chacha_have8(void) { return 0; }
+#endif
+
+static void xor_bytes(uint8_t *out, const uint8_t *in, const uint8_t *ks, size_t n)
+{
+    size_t i = 0;
+
+    /* wortweise, memcpy vermeidet Ausrichtungsprobleme */
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, in + i, 8);
+        memcpy(&b, ks + i, 8);
+        a ^= b;
+        memcpy(out + i, &a, 8);
+    }
+    for (; i < n; i++) out[i] = in[i] ^ ks[i];
+}
+
+/* Schlüsselstrom ab Block 0 (bei len <= 64 ohne AVX2 nur 0..1, mit
+ * AVX2 ab len > 192 Blöcke 0..7, sonst 0..3): Block 0 ist der
+ * Poly1305-Schlüssel, die übrigen verschlüsseln die ersten Bytes.
+ * Rückgabewert: so viele Bytes deckt ks ab Offset 64 ab; st[12] steht
+ * auf dem nächsten Block. */
+static size_t chacha_start(uint32_t st[16], uint8_t ks[512], size_t len)
+{
+    int have8 = chacha_have8();
+
+    st[12] = 0;
+    if (have8 && len > 192) {
+        chacha_block8(st, ks);
+        st[12] = 8;
+        return 448;
+    }
+    if (have8 || len > 64) {
+        if (have8) chacha_block4r(st, ks);
+        else       chacha_block4(st, ks);
+        st[12] = 4;
+        return 192;
+    }
+    /* kurze Pakete (z.B. ACKs): zwei skalare Blöcke sind billiger */
+    chacha_block(st, ks);
+    st[12] = 1;
+    chacha_block(st, ks + 64);
+    st[12] = 2;
+    return 64;
+}
+
+/* in mit dem Schlüsselstrom ab Block 1 verknüpfen; ks und first aus
+ * chacha_start */
+static void chacha_xor(uint32_t st[16], const uint8_t ks[512], size_t first,
+                       const uint8_t *in, uint8_t *out, size_t len)
+{
+    uint8_t more[512];
+    size_t n = (len < first) ? len : first;
+    int have8 = chacha_have8();
+
+    xor_bytes(out, in, ks + 64, n);
+    in += n;
+    out += n;
+    len -= n;
+    while (len > 0) {
+        if (have8 && len > 256) {
+            n = (len < 512) ? len : 512;
+            chacha_block8(st, more);
+            st[12] += 8;
+        } else {
+            n = (len < 256) ? len : 256;
+            if (have8)       chacha_block4r(st, more);
+            else if (n > 64) chacha_block4(st, more);
+            else             chacha_block(st, more);
+            st[12] += (have8 || n > 64) ? 4 : 1;
+        }
+        xor_bytes(out, in, more, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+/* ------------------------------------------------------------
+ * Poly1305 (2 x 64 Bit + 2 Bit, 64x64->128-Bit-Multiplikation)
+ * ------------------------------------------------------------ */
+
+struct poly1305 {
+    uint64_t r0, r1, h0, h1, h2, pad0, pad1;
+};
+
+static void poly_init(struct poly1305 *p, const uint8_t key[32])
+{
+    p->r0 = le64(key)     & 0x0ffffffc0fffffffULL;
+    p->r1 = le64(key + 8) & 0x0ffffffc0ffffffcULL;
+    p->h0 = p->h1 = p->h2 = 0;
+    p->pad0 = le64(key + 16);
+    p->pad1 = le64(key + 24);
+}
+
+/* len Bytes in 16-Byte-Blöcken; ein unvollständiger letzter Block wird
+ * mit Nullen aufgefüllt (RFC 8439 polstert AD und Chiffrat ohnehin).
+ * h bleibt nur teilweise reduziert (h2 klein), erst poly_finish
+ * reduziert vollständig. */
+static void poly_blocks(struct poly1305 *p, const uint8_t *m, size_t len)
+{
+    uint64_t r0 = p->r0, r1 = p->r1;
+    uint64_t s1 = r1 + (r1 >> 2);        /* r1 * 5/4, die Klammerung macht es exakt */
+    uint64_t h0 = p->h0, h1 = p->h1, h2 = p->h2, c;
+    uint8_t last[16];
+
+    while (len > 0) {
+        u128 d0, d1;
+
+        if (len < 16) {
+            memset(last, 0, sizeof(last));
+            memcpy(last, m, len);
+            m = last;
+            len = 16;
+        }
+        d0 = (u128)h0 + le64(m);
+        h0 = (uint64_t)d0;
+        d1 = (u128)h1 + le64(m + 8) + (uint64_t)(d0 >> 64);
+        h1 = (uint64_t)d1;
+        h2 += (uint64_t)(d1 >> 64) + 1;
+
+        /* h *= r mod 2^130 - 5 (2^128 * r1 = 5/4 * r1 wegen 2^130 = 5) */
+        d0 = (u128)h0 * r0 + (u128)h1 * s1;
+        d1 = (u128)h0 * r1 + (u128)h1 * r0 + h2 * s1;
+        h2 = h2 * r0;
+        h0 = (uint64_t)d0;
+        d1 += (uint64_t)(d0 >> 64);
+        h1 = (uint64_t)d1;
+        h2 += (uint64_t)(d1 >> 64);
+
+        /* Bits ab 130 mal 5 nach unten falten */
+        c = (h2 >> 2) + (h2 & ~3ULL);
+        h2 &= 3;
+        h0 += c; c = (h0 < c);
+        h1 += c; c = (h1 < c);
+        h2 += c;
+
+        m += 16;
+        len -= 16;
+    }
+    p->h0 = h0; p->h1 = h1; p->h2 = h2;
+}
+
+static void poly_finish(struct poly1305 *p, uint8_t mac[16])
+{
+    uint64_t h0 = p->h0, h1 = p->h1, h2 = p->h2;
+    uint64_t g0, g1, g2, mask;
+    u128 t;
+
+    /* h + 5 - 2^130 berechnen und ohne Verzweigung auswählen */
+    t = (u128)h0 + 5;
+    g0 = (uint64_t)t;
+    t = (u128)h1 + (uint64_t)(t >> 64);
+    g1 = (uint64_t)t;
+    g2 = h2 + (uint64_t)(t >> 64);
+    mask = 0 - (g2 >> 2);
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+
+    t = (u128)h0 + p->pad0;
+    h0 = (uint64_t)t;
+    h1 = h1 + p->pad1 + (uint64_t)(t >> 64);
+
+    put_le64(mac, h0);
+    put_le64(mac + 8, h1);
+}
+
+/* Tag über ad und Chiffrat nach RFC 8439 2.8 */
+static void aead_tag(const uint8_t polyKey[32], const void *ad, size_t adLen,
+                     const uint8_t *ct, size_t len, uint8_t tag[16])
+{
+    struct poly1305 p;
+    uint8_t lens[16];
+
+    poly_init(&p, polyKey);
+    poly_blocks(&p, ad, adLen);
+    poly_blocks(&p, ct, len);
+    put_le64(lens, adLen);
+    put_le64(lens + 8, len);
+    poly_blocks(&p, lens, 16);
+    poly_finish(&p, tag);
+}
+
+/* Versiegeln mit vorbereitetem Zustand (chacha_init, der Selbsttest
+ * setzt auch das erste Nonce-Wort) */
+static void seal_st(uint32_t st[16], const void *ad, size_t adLen,
+                    const void *in, size_t len, void *out)
+{
+    uint8_t ks[512];
+    uint8_t *o = out;
+    size_t first;
+
+    first = chacha_start(st, ks, len);
+    chacha_xor(st, ks, first, in, o, len);
+    aead_tag(ks, ad, adLen, o, len, o + len);
+    memset(ks, 0, sizeof(ks));
+}
+
+void aeadSeal(const uint8_t key[AEAD_KEY_LEN], uint64_t ctr,
+              const void *ad, size_t adLen,
+              const void *in, size_t len, void *out)
+{
+    uint32_t st[16];
+
+    chacha_init(st, key, ctr);
+    seal_st(st, ad, adLen, in, len, out);
+}
+
+int aeadOpen(const uint8_t key[AEAD_KEY_LEN], uint64_t ctr,
+             const void *ad, size_t adLen,
+             const void *in, size_t len, void *out)
+{
+    uint32_t st[16];
+    uint8_t ks[512], tag[16];
+    size_t first;
+    const uint8_t *i = in;
+    unsigned diff = 0;
+
+    if (len < AEAD_TAG_LEN) return -1;
+    len -= AEAD_TAG_LEN;
+
+    chacha_init(st, key, ctr);
+    first = chacha_start(st, ks, len);
+    aead_tag(ks, ad, adLen, i, len, tag);
+    for (int k = 0; k < AEAD_TAG_LEN; k++) diff |= tag[k] ^ i[len + k];
+    if (diff == 0) chacha_xor(st, ks, first, i, out, len);
+    memset(ks, 0, sizeof(ks));
+    return diff ? -1 : 0;
+}
+
+/* ------------------------------------------------------------
+ * AES-256-GCM (NIST SP 800-38D) mit AES-NI und PCLMULQDQ
+ * ------------------------------------------------------------ */
+
+/* Nur mit den Befehlssätzen: AES in Software wäre langsamer als
+ * ChaCha20 und nicht frei von Cache-Timing. Nonce wie bei ChaCha20:
+ * 4 Nullbytes || ctr (LE), 96 Bit; J0 = Nonce || 1. GHASH rechnet wie
+ * Intels CLMUL-Whitepaper auf bytegespiegelten Blöcken (Schieben um ein
+ * Bit, Reduktion modulo x^128 + x^7 + x^2 + x + 1) mit einer Reduktion
+ * je acht Blöcke, verzahnt mit AES-CTR. Mit 128-Bit-Registern: VAES auf
+ * 256 Bit war zwischen den Systemaufrufen des Protokolls langsamer
+ * (Aufwachen der oberen Registerhälften). */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+GCM_TARGET
+static __m128i bswap128(__m128i v)
+{
+    return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+GCM_TARGET
+static __m128i aes_key_step(__m128i a, __m128i t)
+{
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    a = _mm_xor_si128(a, _mm_slli_si128(a, 4));
+    return _mm_xor_si128(a, t);
+}
+
+#define AES_EXPAND2(rk, i, rcon)                                                 \
+    rk[i]     = aes_key_step(rk[(i) - 2],                                        \
+                    _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[(i) - 1], rcon), 0xff)); \
+    rk[(i) + 1] = aes_key_step(rk[(i) - 1],                                      \
+                    _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i], 0), 0xaa))
+
+GCM_TARGET
+static void aes_expand(__m128i rk[15], const uint8_t key[32])
+{
+    rk[0] = _mm_loadu_si128((const __m128i *)key);
+    rk[1] = _mm_loadu_si128((const __m128i *)(key + 16));
+    AES_EXPAND2(rk, 2, 0x01);
+    AES_EXPAND2(rk, 4, 0x02);
+    AES_EXPAND2(rk, 6, 0x04);
+    AES_EXPAND2(rk, 8, 0x08);
+    AES_EXPAND2(rk, 10, 0x10);
+    AES_EXPAND2(rk, 12, 0x20);
+    rk[14] = aes_key_step(rk[12], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[13], 0x40), 0xff));
+}
+
+/* n Zählerblöcke ab *c (bytegespiegelt, Zähler in Spur 0) verschlüsseln;
+ * n ist nach dem Inlining konstant */
+GCM_TARGET __attribute__((always_inline))
+static inline void aes_ctr_blocks(const __m128i rk[15], __m128i *c, __m128i *b, const int n)
+{
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+
+#pragma GCC unroll 8
+    for (int i = 0; i < n; i++) {
+        b[i] = _mm_xor_si128(bswap128(*c), rk[0]);
+        *c = _mm_add_epi32(*c, one);
+    }
+    for (int r = 1; r < 14; r++) {
+#pragma GCC unroll 8
+        for (int i = 0; i < n; i++) b[i] = _mm_aesenc_si128(b[i], rk[r]);
+    }
+#pragma GCC unroll 8
+    for (int i = 0; i < n; i++) b[i] = _mm_aesenclast_si128(b[i], rk[14]);
+}
+
+/* Produkt a * b ohne Reduktion, zu lo/mid/hi addiert (4 x PCLMULQDQ) */
+GCM_TARGET
+static void gf_mul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo  = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi  = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x01),
+                                             _mm_clmulepi64_si128(a, b, 0x10)));
+}
+
+/* 256-Bit-Summe der Produkte um ein Bit schieben und reduzieren */
+GCM_TARGET
+static __m128i gf_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t7, t8, t9;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(_mm_or_si128(hi, t8), t9);
+
+    t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+                       _mm_slli_epi32(lo, 25));
+    t8 = _mm_srli_si128(t7, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t7, 12));
+    t9 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+                       _mm_srli_epi32(lo, 7));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(t9, t8));
+    return _mm_xor_si128(hi, lo);
+}
+
+/* Rundenschlüssel und hpow[i] = H^(8-i) */
+GCM_TARGET
+static void gcm_key(struct aead_key *k)
+{
+    __m128i rk[15], h, p;
+
+    aes_expand(rk, k->key);
+    h = rk[0];
+    for (int r = 1; r < 14; r++) h = _mm_aesenc_si128(h, rk[r]);
+    h = bswap128(_mm_aesenclast_si128(h, rk[14]));
+    p = h;
+    for (int i = 7; i >= 0; i--) {
+        __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+        _mm_storeu_si128((__m128i *)k->hpow[i], p);
+        gf_mul_acc(p, h, &lo, &mid, &hi);
+        p = gf_reduce(lo, mid, hi);
+    }
+    memcpy(k->rk, rk, sizeof(k->rk));
+}
+
+/* Block ab p (n Bytes übrig, ggf. mit Nullen aufgefüllt), bytegespiegelt */
+GCM_TARGET
+static __m128i gcm_block(const uint8_t *p, size_t n)
+{
+    uint8_t b[16];
+
+    if (n >= 16) return bswap128(_mm_loadu_si128((const __m128i *)p));
+    memset(b, 0, sizeof(b));
+    memcpy(b, p, n);
+    return bswap128(_mm_loadu_si128((const __m128i *)b));
+}
+
+/* GHASH ab x über len Bytes und, falls lens != NULL, den Längenblock;
+ * die erste Gruppe ist kürzer, damit alle weiteren acht Blöcke umfassen */
+GCM_TARGET
+static __m128i gcm_ghash(const struct aead_key *k, __m128i x, const uint8_t *p, size_t len,
+                         const __m128i *lens)
+{
+    size_t nData = (len + 15) / 16, n = nData + (lens != NULL);
+    size_t g = (n + 7) % 8 + 1, j = 0;
+
+    while (j < n) {
+        __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+
+        for (size_t i = 0; i < g; i++, j++) {
+            __m128i b = (j < nData) ? gcm_block(p + 16 * j, len - 16 * j) : *lens;
+
+            if (i == 0) b = _mm_xor_si128(b, x);
+            gf_mul_acc(b, _mm_loadu_si128((const __m128i *)k->hpow[8 - g + i]), &lo, &mid, &hi);
+        }
+        x = gf_reduce(lo, mid, hi);
+        g = 8;
+    }
+    return x;
+}
+
+/* GHASH ab x über acht volle Blöcke */
+GCM_TARGET
+static __m128i gcm_ghash8(const __m128i h[8], __m128i x, const uint8_t *p)
+{
+    __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+
+    x = _mm_xor_si128(x, bswap128(_mm_loadu_si128((const __m128i *)p)));
+    gf_mul_acc(x, h[0], &lo, &mid, &hi);
+    for (int i = 1; i < 8; i++)
+        gf_mul_acc(bswap128(_mm_loadu_si128((const __m128i *)(p + 16 * i))), h[i], &lo, &mid, &hi);
+    return gf_reduce(lo, mid, hi);
+}
+
+/* in mit dem Schlüsselstrom ab J0 + 1 verknüpfen und zugleich GHASH ab x
+ * über das Chiffrat samt Längenblock (enc: out, sonst in). Je Gruppe von
+ * acht Blöcken laufen AES und GHASH der Nachbargruppe verzahnt: AESENC
+ * und PCLMULQDQ belegen verschiedene Ports. */
+GCM_TARGET
+static __m128i gcm_crypt(const struct aead_key *k, const __m128i rk[15], __m128i c, __m128i x,
+                         const uint8_t *in, uint8_t *out, size_t len, __m128i lens, int enc)
+{
+    __m128i b[8], h[8];
+    const uint8_t *prev = NULL;     /* enc: Chiffrat der vorigen Gruppe */
+    uint8_t last[16];
+    size_t i;
+
+    for (i = 0; i < 8; i++) h[i] = _mm_loadu_si128((const __m128i *)k->hpow[i]);
+    c = _mm_add_epi32(c, _mm_set_epi32(0, 0, 0, 1));
+    for (; len >= 128; len -= 128, in += 128, out += 128) {
+        aes_ctr_blocks(rk, &c, b, 8);
+        if (!enc)             x = gcm_ghash8(h, x, in);
+        else if (prev != NULL) x = gcm_ghash8(h, x, prev);
+        for (i = 0; i < 8; i++)
+            _mm_storeu_si128((__m128i *)(out + 16 * i),
+                _mm_xor_si128(b[i], _mm_loadu_si128((const __m128i *)(in + 16 * i))));
+        prev = out;
+    }
+    if (len > 64)     aes_ctr_blocks(rk, &c, b, 8);
+    else if (len > 0) aes_ctr_blocks(rk, &c, b, 4);
+    if (prev != NULL && enc) x = gcm_ghash8(h, x, prev);
+    if (!enc) x = gcm_ghash(k, x, in, len, &lens);
+    for (i = 0; len - 16 * i >= 16; i++)
+        _mm_storeu_si128((__m128i *)(out + 16 * i),
+            _mm_xor_si128(b[i], _mm_loadu_si128((const __m128i *)(in + 16 * i))));
+    if (len > 16 * i) {
+        _mm_storeu_si128((__m128i *)last, b[i]);
+        xor_bytes(out + 16 * i, in + 16 * i, last, len - 16 * i);
+    }
+    if (enc) x = gcm_ghash(k, x, out, len, &lens);
+    return bswap128(x);
+}
+
+/* J0 = Nonce || 1, bytegespiegelt (Nullen, ctr Big Endian, 1), und die
+ * Maske E(J0) des Tags */
+GCM_TARGET
+static __m128i gcm_j0(const __m128i rk[15], uint64_t ctr, __m128i *mask)
+{
+    uint64_t be = __builtin_bswap64(ctr);
+    __m128i c = _mm_set_epi64x((long long)(be >> 32), (long long)(be << 32 | 1)), t = c;
+
+    aes_ctr_blocks(rk, &t, mask, 1);
+    return c;
+}
+
+/* Längen in Bit, Big Endian, bytegespiegelt: ad oben, Chiffrat unten */
+GCM_TARGET
+static __m128i gcm_lens(size_t adLen, size_t len)
+{
+    return _mm_set_epi64x((long long)((uint64_t)adLen * 8), (long long)((uint64_t)len * 8));
+}
+
+GCM_TARGET
+static void gcm_seal(const struct aead_key *k, uint64_t ctr, const void *ad, size_t adLen,
+                     const void *in, size_t len, void *out)
+{
+    __m128i rk[15], mask, j0, x;
+
+    memcpy(rk, k->rk, sizeof(rk));
+    j0 = gcm_j0(rk, ctr, &mask);
+    x = gcm_ghash(k, _mm_setzero_si128(), ad, adLen, NULL);
+    x = gcm_crypt(k, rk, j0, x, in, out, len, gcm_lens(adLen, len), 1);
+    _mm_storeu_si128((__m128i *)((uint8_t *)out + len), _mm_xor_si128(x, mask));
+}
+
+/* Entschlüsseln und Tag prüfen in einem Durchgang; bei falschem Tag
+ * wird out genullt (Vergleich in konstanter Zeit) */
+GCM_TARGET
+static int gcm_open(const struct aead_key *k, uint64_t ctr, const void *ad, size_t adLen,
+                    const uint8_t *in, size_t len, void *out)
+{
+    __m128i rk[15], mask, j0, x;
+
+    memcpy(rk, k->rk, sizeof(rk));
+    j0 = gcm_j0(rk, ctr, &mask);
+    x = gcm_ghash(k, _mm_setzero_si128(), ad, adLen, NULL);
+    x = gcm_crypt(k, rk, j0, x, in, out, len, gcm_lens(adLen, len), 0);
+    x = _mm_xor_si128(_mm_xor_si128(x, mask), _mm_loadu_si128((const __m128i *)(in + len)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) != 0xffff) {
+        memset(out, 0, len);
+        return -1;
+    }
+    return 0;
+}
+
+static int gcm_have(void)
+{
+    static int have = -1;
+
+    if (have < 0)
+        have = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+               __builtin_cpu_supports("ssse3");
+    return have;
+}
+#else
+static void gcm_key(struct aead_key *k) { (void)k; }
+static void gcm_seal(const struct aead_key *k, uint64_t ctr, const void *ad, size_t adLen,
+                     const void *in, size_t len, void *out)
+{ (void)k; (void)ctr; (void)ad; (void)adLen; (void)in; (void)len; (void)out; }
+static int gcm_open(const struct aead_key *k, uint64_t ctr, const void *ad, size_t adLen,
+                    const uint8_t *in, size_t len, void *out)
+{ (void)k; (void)ctr; (void)ad; (void)adLen; (void)in; (void)len; (void)out; return -1; }
+static int gcm_have(void) { return 0; }
+#endif
+
+unsigned aeadAlgs(void)
+{
+    return (1u << AEAD_CHACHA) | (gcm_have() ? 1u << AEAD_AESGCM : 0);
+}
+
+void aeadKeySet(struct aead_key *k, int alg, const uint8_t key[AEAD_KEY_LEN])
+{
+    memset(k, 0, sizeof(*k));
+    k->alg = (alg == AEAD_AESGCM && gcm_have()) ? AEAD_AESGCM : AEAD_CHACHA;
+    memcpy(k->key, key, AEAD_KEY_LEN);
+    if (k->alg == AEAD_AESGCM) gcm_key(k);
+}
+
+void aeadSealKey(const struct aead_key *k, uint64_t ctr,
+                 const void *ad, size_t adLen,
+                 const void *in, size_t len, void *out)
+{
+    if (k->alg == AEAD_AESGCM) gcm_seal(k, ctr, ad, adLen, in, len, out);
+    else                       aeadSeal(k->key, ctr, ad, adLen, in, len, out);
+}
+
+int aeadOpenKey(const struct aead_key *k, uint64_t ctr,
+                const void *ad, size_t adLen,
+                const void *in, size_t len, void *out)
+{
+    if (len < AEAD_TAG_LEN) return -1;
+    if (k->alg == AEAD_AESGCM) return gcm_open(k, ctr, ad, adLen, in, len - AEAD_TAG_LEN, out);
+    return aeadOpen(k->key, ctr, ad, adLen, in, len, out);
+}
+
+/* ------------------------------------------------------------
+ * BLAKE2s-256 (RFC 7693)
+ * ------------------------------------------------------------ */
+
+static const uint32_t b2s_iv[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint8_t b2s_sigma[10][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+#define ROTR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+#define B2S_G(a, b, c, d, x, y)                          \
+    a = a + b + (x); d = ROTR32(d ^ a, 16);              \
+    c = c + d;       b = ROTR32(b ^ c, 12);              \
+    a = a + b + (y); d = ROTR32(d ^ a, 8);               \
+    c = c + d;       b = ROTR32(b ^ c, 7)
+
+static void b2s_compress(uint32_t h[8], const uint8_t block[64], uint64_t t, int last)
+{
+    uint32_t v[16], m[16];
+
+    for (int i = 0; i < 16; i++) m[i] = le32(block + 4 * i);
+    for (int i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = b2s_iv[i];
+    }
+    v[12] ^= (uint32_t)t;
+    v[13] ^= (uint32_t)(t >> 32);
+    if (last) v[14] = ~v[14];
+
+    for (int r = 0; r < 10; r++) {
+        const uint8_t *s = b2s_sigma[r];
+        B2S_G(v[0], v[4], v[8],  v[12], m[s[0]],  m[s[1]]);
+        B2S_G(v[1], v[5], v[9],  v[13], m[s[2]],  m[s[3]]);
+        B2S_G(v[2], v[6], v[10], v[14], m[s[4]],  m[s[5]]);
+        B2S_G(v[3], v[7], v[11], v[15], m[s[6]],  m[s[7]]);
+        B2S_G(v[0], v[5], v[10], v[15], m[s[8]],  m[s[9]]);
+        B2S_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        B2S_G(v[2], v[7], v[8],  v[13], m[s[12]], m[s[13]]);
+        B2S_G(v[3], v[4], v[9],  v[14], m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) h[i] ^= v[i] ^ v[i + 8];
+}
+
+void aeadHash(uint8_t out[32], const void *key, size_t keyLen,
+              const void *data, size_t len)
+{
+    uint32_t h[8];
+    uint8_t block[64];
+    const uint8_t *d = data;
+    uint64_t t = 0;
+
+    if (keyLen > 32) keyLen = 32;
+    memcpy(h, b2s_iv, sizeof(h));
+    h[0] ^= 0x01010000u ^ ((uint32_t)keyLen << 8) ^ 32u;
+
+    if (keyLen > 0) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, key, keyLen);
+        t = 64;
+        b2s_compress(h, block, t, len == 0);
+    }
+    /* alle vollen Blöcke bis auf den letzten, dann den (aufgefüllten) letzten */
+    while (len > 64) {
+        t += 64;
+        b2s_compress(h, d, t, 0);
+        d += 64;
+        len -= 64;
+    }
+    if (len > 0 || keyLen == 0) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, d, len);
+        t += len;
+        b2s_compress(h, block, t, 1);
+    }
+    for (int i = 0; i < 8; i++) put_le32(out + 4 * i, h[i]);
+    memset(block, 0, sizeof(block));
+}
+
+/* ------------------------------------------------------------
+ * X25519 (RFC 7748), Feldelemente in 5 x 51 Bit
+ * ------------------------------------------------------------ */
+
+typedef uint64_t fe[5];
+
+#define M51 0x7ffffffffffffULL
+
+static void fe_add(fe o, const fe a, const fe b)
+{
+    for (int i = 0; i < 5; i++) o[i] = a[i] + b[i];
+}
+
+/* a - b + 4p: bleibt für Eingaben < 2^53 positiv */
+static void fe_sub(fe o, const fe a, const fe b)
+{
+    o[0] = a[0] + 0x1fffffffffffb4ULL - b[0];
+    for (int i = 1; i < 5; i++) o[i] = a[i] + 0x1ffffffffffffcULL - b[i];
+}
+
+static void fe_carry(fe o, u128 r[5])
+{
+    u128 c;
+
+    r[1] += r[0] >> 51; o[0] = (uint64_t)r[0] & M51;
+    r[2] += r[1] >> 51; o[1] = (uint64_t)r[1] & M51;
+    r[3] += r[2] >> 51; o[2] = (uint64_t)r[2] & M51;
+    r[4] += r[3] >> 51; o[3] = (uint64_t)r[3] & M51;
+    o[4] = (uint64_t)r[4] & M51;
+    c = (r[4] >> 51) * 19 + o[0];       /* Übertrag kann 2^64 überschreiten */
+    o[0] = (uint64_t)c & M51;
+    o[1] += (uint64_t)(c >> 51);
+}
+
+static void fe_mul(fe o, const fe a, const fe b)
+{
+    uint64_t b1 = b[1] * 19, b2 = b[2] * 19, b3 = b[3] * 19, b4 = b[4] * 19;
+    u128 r[5];
+
+    r[0] = (u128)a[0] * b[0] + (u128)a[1] * b4 + (u128)a[2] * b3 + (u128)a[3] * b2 + (u128)a[4] * b1;
+    r[1] = (u128)a[0] * b[1] + (u128)a[1] * b[0] + (u128)a[2] * b4 + (u128)a[3] * b3 + (u128)a[4] * b2;
+    r[2] = (u128)a[0] * b[2] + (u128)a[1] * b[1] + (u128)a[2] * b[0] + (u128)a[3] * b4 + (u128)a[4] * b3;
+    r[3] = (u128)a[0] * b[3] + (u128)a[1] * b[2] + (u128)a[2] * b[1] + (u128)a[3] * b[0] + (u128)a[4] * b4;
+    r[4] = (u128)a[0] * b[4] + (u128)a[1] * b[3] + (u128)a[2] * b[2] + (u128)a[3] * b[1] + (u128)a[4] * b[0];
+    fe_carry(o, r);
+}
+
+static void fe_mul_small(fe o, const fe a, uint64_t k)
+{
+    u128 r[5];
+
+    for (int i = 0; i < 5; i++) r[i] = (u128)a[i] * k;
+    fe_carry(o, r);
+}
+
+/* a^(p-2) = 1/a, p - 2 = 2^255 - 21 */
+static void fe_invert(fe o, const fe a)
+{
+    fe r;
+
+    memcpy(r, a, sizeof(fe));
+    for (int i = 253; i >= 0; i--) {
+        fe_mul(r, r, r);
+        if (i != 2 && i != 4) fe_mul(r, r, a);
+    }
+    memcpy(o, r, sizeof(fe));
+}
+
+static void fe_cswap(fe a, fe b, uint64_t swap)
+{
+    uint64_t mask = 0 - swap;
+
+    for (int i = 0; i < 5; i++) {
+        uint64_t t = mask & (a[i] ^ b[i]);
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+static void fe_from_bytes(fe o, const uint8_t s[32])
+{
+    o[0] =  le64(s)           & M51;
+    o[1] = (le64(s + 6) >> 3) & M51;
+    o[2] = (le64(s + 12) >> 6) & M51;
+    o[3] = (le64(s + 19) >> 1) & M51;
+    o[4] = (le64(s + 24) >> 12) & M51;   /* oberstes Bit ignorieren */
+}
+
+static void fe_to_bytes(uint8_t s[32], const fe a)
+{
+    uint64_t t[5], u[5], mask;
+
+    memcpy(t, a, sizeof(t));
+    for (int k = 0; k < 2; k++) {
+        t[1] += t[0] >> 51; t[0] &= M51;
+        t[2] += t[1] >> 51; t[1] &= M51;
+        t[3] += t[2] >> 51; t[2] &= M51;
+        t[4] += t[3] >> 51; t[3] &= M51;
+        t[0] += 19 * (t[4] >> 51); t[4] &= M51;
+    }
+    /* t < 2^255; t >= p genau dann, wenn t + 19 >= 2^255 */
+    u[0] = t[0] + 19;
+    u[1] = t[1] + (u[0] >> 51); u[0] &= M51;
+    u[2] = t[2] + (u[1] >> 51); u[1] &= M51;
+    u[3] = t[3] + (u[2] >> 51); u[2] &= M51;
+    u[4] = t[4] + (u[3] >> 51); u[3] &= M51;
+    mask = 0 - (u[4] >> 51);
+    u[4] &= M51;
+    for (int i = 0; i < 5; i++) t[i] = (t[i] & ~mask) | (u[i] & mask);
+
+    put_le64(s,      t[0]        | (t[1] << 51));
+    put_le64(s + 8,  (t[1] >> 13) | (t[2] << 38));
+    put_le64(s + 16, (t[2] >> 26) | (t[3] << 25));
+    put_le64(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static void x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t point[32])
+{
+    uint8_t k[32];
+    fe x1, x2, z2, x3, z3, a, aa, b, bb, e, c, d, da, cb;
+    uint64_t swap = 0;
+
+    memcpy(k, scalar, 32);
+    k[0] &= 248;
+    k[31] &= 127;
+    k[31] |= 64;
+
+    fe_from_bytes(x1, point);
+    memset(x2, 0, sizeof(fe)); x2[0] = 1;
+    memset(z2, 0, sizeof(fe));
+    memcpy(x3, x1, sizeof(fe));
+    memset(z3, 0, sizeof(fe)); z3[0] = 1;
+
+    for (int t = 254; t >= 0; t--) {
+        uint64_t bit = (k[t >> 3] >> (t & 7)) & 1;
+
+        swap ^= bit;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = bit;
+
+        fe_add(a, x2, z2);
+        fe_mul(aa, a, a);
+        fe_sub(b, x2, z2);
+        fe_mul(bb, b, b);
+        fe_sub(e, aa, bb);
+        fe_add(c, x3, z3);
+        fe_sub(d, x3, z3);
+        fe_mul(da, d, a);
+        fe_mul(cb, c, b);
+        fe_add(x3, da, cb);
+        fe_mul(x3, x3, x3);
+        fe_sub(z3, da, cb);
+        fe_mul(z3, z3, z3);
+        fe_mul(z3, z3, x1);
+        fe_mul(x2, aa, bb);
+        fe_mul_small(z2, e, 121665);
+        fe_add(z2, z2, aa);
+        fe_mul(z2, z2, e);
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_to_bytes(out, x2);
+    memset(k, 0, sizeof(k));
+}
+
+int aeadKeypair(uint8_t priv[AEAD_KEY_LEN], uint8_t pub[AEAD_PUB_LEN])
+{
+    static const uint8_t base[32] = { 9 };
+    size_t got = 0;
+
+    while (got < AEAD_KEY_LEN) {
+        ssize_t n = getrandom(priv + got, AEAD_KEY_LEN - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    x25519(pub, priv, base);
+    return 0;
+}
+
+int aeadShared(uint8_t out[AEAD_KEY_LEN], const uint8_t priv[AEAD_KEY_LEN],
+               const uint8_t peerPub[AEAD_PUB_LEN])
+{
+    uint8_t zero = 0;
+
+    x25519(out, priv, peerPub);
+    for (int i = 0; i < AEAD_KEY_LEN; i++) zero |= out[i];
+    return zero ? 0 : -1;
+}
+
+/* ------------------------------------------------------------
+ * Schlüsselableitung
+ * ------------------------------------------------------------ */
+
+#define KDF_LABEL      "ARQ-Stud AEAD v1"
+#define KDF_LABEL_LEN  (sizeof(KDF_LABEL) - 1)
+
+void aeadHelloKey(uint8_t k0[AEAD_KEY_LEN], const uint8_t psk[AEAD_KEY_LEN],
+                  const uint8_t cpub[AEAD_PUB_LEN])
+{
+    uint8_t in[KDF_LABEL_LEN + 1 + AEAD_PUB_LEN];
+
+    memcpy(in, KDF_LABEL, KDF_LABEL_LEN);
+    in[KDF_LABEL_LEN] = 'H';
+    memcpy(in + KDF_LABEL_LEN + 1, cpub, AEAD_PUB_LEN);
+    aeadHash(k0, psk, AEAD_KEY_LEN, in, sizeof(in));
+}
+
+void aeadSessionKeys(uint8_t c2s[AEAD_KEY_LEN], uint8_t s2c[AEAD_KEY_LEN],
+                     const uint8_t psk[AEAD_KEY_LEN], const uint8_t shared[AEAD_KEY_LEN],
+                     const uint8_t cpub[AEAD_PUB_LEN], const uint8_t spub[AEAD_PUB_LEN])
+{
+    uint8_t in[KDF_LABEL_LEN + 1 + AEAD_KEY_LEN + 2 * AEAD_PUB_LEN];
+    uint8_t master[AEAD_KEY_LEN];
+    size_t n = 0;
+
+    memcpy(in, KDF_LABEL, KDF_LABEL_LEN);  n += KDF_LABEL_LEN;
+    in[n++] = 'S';
+    memcpy(in + n, shared, AEAD_KEY_LEN);  n += AEAD_KEY_LEN;
+    memcpy(in + n, cpub, AEAD_PUB_LEN);    n += AEAD_PUB_LEN;
+    memcpy(in + n, spub, AEAD_PUB_LEN);    n += AEAD_PUB_LEN;
+    aeadHash(master, psk, AEAD_KEY_LEN, in, n);
+
+    aeadHash(c2s, master, sizeof(master), "c2s", 3);
+    aeadHash(s2c, master, sizeof(master), "s2c", 3);
+    memset(master, 0, sizeof(master));
+    memset(in, 0, sizeof(in));
+}
+
+int aeadKeyFile(uint8_t psk[AEAD_KEY_LEN], const char *path)
+{
+    unsigned char buf[4096];
+    FILE *fp = fopen(path, "rb");
+    size_t n;
+
+    if (fp == NULL) return -1;
+    n = fread(buf, 1, sizeof(buf), fp);
+    if (ferror(fp) || n == 0 || n == sizeof(buf)) {
+        /* mehr als 4 KiB ist keine Schlüsseldatei */
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    aeadHash(psk, NULL, 0, buf, n);
+    memset(buf, 0, sizeof(buf));
+    return 0;
+}
+
+/* ------------------------------------------------------------
+ * Selbsttest
+ * ------------------------------------------------------------ */
+
+static void unhex(uint8_t *out, const char *hex)
+{
+    for (size_t i = 0; hex[2 * i] != '\0'; i++) {
+        unsigned v;
+        sscanf(hex + 2 * i, "%2x", &v);
+        out[i] = (uint8_t)v;
+    }
+}
+
+static int check_hex(const uint8_t *got, const char *hex)
+{
+    uint8_t want[256];
+    size_t n = strlen(hex) / 2;
+
+    unhex(want, hex);
+    return memcmp(got, want, n) == 0 ? 0 : -1;
+}
+
+/* RFC 8439 2.8.2; AES-256-GCM; RFC 7748 5.2, 6.1; RFC 7693 Anhang B */
+static int self_test(void)
+{
+    static const char sunscreen[] =
+        "Ladies and Gentlemen of the class of '99: If I could offer you only "
+        "one tip for the future, sunscreen would be it.";
+    uint8_t key[32], nonce[12], ad[12], out[1024 + AEAD_TAG_LEN], in[1024];
+    uint8_t pk[32], pt[32];
+    uint32_t st[16];
+    int rc = 0;
+
+    /* AEAD mit vollständiger Nonce (erstes Wort 7) */
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x80 + i);
+    unhex(nonce, "070000004041424344454647");
+    unhex(ad, "50515253c0c1c2c3c4c5c6c7");
+    chacha_init(st, key, le64(nonce + 4));
+    st[13] = le32(nonce);
+    seal_st(st, ad, sizeof(ad), sunscreen, sizeof(sunscreen) - 1, out);
+    rc |= check_hex(out,
+        "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+        "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+        "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+        "3ff4def08e4b7a9de576d26586cec64b6116"
+        "1ae10b594f09e26a7e902ecbd0600691");
+
+    /* langes Paket (chacha_block8 bzw. chacha_block4): BLAKE2s über das
+     * Chiffrat, Referenzwert mit OpenSSL berechnet */
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+    for (int i = 0; i < 1000; i++) in[i] = (uint8_t)(i * 7);
+    aeadSeal(key, 0x0123456789abcdefULL, NULL, 0, in, 1000, out);
+    aeadHash(pk, NULL, 0, out, 1000 + AEAD_TAG_LEN);
+    rc |= check_hex(pk, "3dd6b8fc0b930e0ebfbe86392de8afafd4628857806c68d12c61604a18a69e3e");
+    memset(in, 0, sizeof(in));
+    rc |= aeadOpen(key, 0x0123456789abcdefULL, NULL, 0, out, 1000 + AEAD_TAG_LEN, in);
+    for (int i = 0; i < 1000; i++) rc |= (in[i] != (uint8_t)(i * 7));
+    out[500] ^= 1;
+    rc |= (aeadOpen(key, 0x0123456789abcdefULL, NULL, 0, out, 1000 + AEAD_TAG_LEN, in) == 0);
+
+    /* AES-256-GCM, falls vorhanden: langes und kurzes Paket, Referenzwerte
+     * mit OpenSSL berechnet */
+    if (aeadAlgs() & (1u << AEAD_AESGCM)) {
+        struct aead_key gk;
+
+        for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+        for (int i = 0; i < 1000; i++) in[i] = (uint8_t)(i * 7);
+        aeadKeySet(&gk, AEAD_AESGCM, key);
+        aeadSealKey(&gk, 0x0123456789abcdefULL, ad, sizeof(ad), in, 1000, out);
+        aeadHash(pk, NULL, 0, out, 1000 + AEAD_TAG_LEN);
+        rc |= check_hex(pk, "baba1a34bb41eee5d84701a501506fe76060451aa0d5d935692f04cd566c3b81");
+        aeadSealKey(&gk, 0x0123456789abcdefULL, ad, sizeof(ad), in, 24, out);
+        aeadHash(pk, NULL, 0, out, 24 + AEAD_TAG_LEN);
+        rc |= check_hex(pk, "1a9495e8fd2afcad813eefb90ad353f119b7bf29b9809b8681917af15bc2c9fc");
+        memset(in, 0, 24);
+        rc |= aeadOpenKey(&gk, 0x0123456789abcdefULL, ad, sizeof(ad), out, 24 + AEAD_TAG_LEN, in);
+        for (int i = 0; i < 24; i++) rc |= (in[i] != (uint8_t)(i * 7));
+        out[3] ^= 1;
+        rc |= (aeadOpenKey(&gk, 0x0123456789abcdefULL, ad, sizeof(ad), out, 24 + AEAD_TAG_LEN, in) == 0);
+    }
+
+    /* X25519 */
+    unhex(key, "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4");
+    unhex(pt,  "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c");
+    x25519(pk, key, pt);
+    rc |= check_hex(pk, "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552");
+    unhex(key, "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+    memset(pt, 0, sizeof(pt));
+    pt[0] = 9;
+    x25519(pk, key, pt);
+    rc |= check_hex(pk, "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+
+    /* BLAKE2s */
+    aeadHash(pk, NULL, 0, "abc", 3);
+    rc |= check_hex(pk, "508c5e8c327c14e2e1a72ba34eeb452f37458b209ed63a294d999b4c86675982");
+    for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+    aeadHash(pk, key, 32, "", 0);
+    rc |= check_hex(pk, "48a8997da407876b3d79c0d92325ad3b89cbb754d86ab71aee047ad345fd2c49");
+
+    return rc ? -1 : 0;
+}
+
+int aeadSelfTest(void)
+{
+    static int result = 1;      /* 1: noch nicht gelaufen */
+
+    if (result == 1) result = self_test();
+    return result;
+}
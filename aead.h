@@ -0,0 +1,101 @@
+#ifndef AEAD_H_INCLUDED
+#define AEAD_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Kryptographie für den verschlüsselten Betrieb (siehe struct sec_hdr
+ * in data.h), ohne externe Bibliotheken:
+ *   - ChaCha20-Poly1305 (RFC 8439) je Paket
+ *   - AES-256-GCM (SP 800-38D) je Paket, nur mit AES-NI und PCLMULQDQ
+ *   - X25519 (RFC 7748) für den Schlüsselaustausch im Hello
+ *   - BLAKE2s (RFC 7693, mit Schlüssel) für die Schlüsselableitung
+ *
+ * Der Zähler ctr bildet mit dem Schlüssel die Nonce und darf je
+ * Schlüssel nur einmal benutzt werden; Bit 63 kennzeichnet die
+ * Richtung Server -> Client (AEAD_CTR_S2C).
+ */
+
+#define AEAD_KEY_LEN   32
+#define AEAD_TAG_LEN   16
+#define AEAD_PUB_LEN   32
+#define AEAD_CTR_S2C   (1ULL << 63)
+
+/* in (len Bytes) verschlüsseln, out erhält len + AEAD_TAG_LEN Bytes;
+ * ad wird nur authentifiziert. in und out dürfen übereinstimmen. */
+void aeadSeal(const uint8_t key[AEAD_KEY_LEN], uint64_t ctr,
+              const void *ad, size_t adLen,
+              const void *in, size_t len, void *out);
+
+/* Prüfen und entschlüsseln; len inkl. Tag, out erhält len - AEAD_TAG_LEN
+ * Bytes. Rückgabewert: 0, <0 wenn das Paket verfälscht ist (out
+ * unverändert). */
+int  aeadOpen(const uint8_t key[AEAD_KEY_LEN], uint64_t ctr,
+              const void *ad, size_t adLen,
+              const void *in, size_t len, void *out);
+
+/* Verfahren für die Sitzungsschlüssel: ChaCha20-Poly1305 überall,
+ * AES-256-GCM (gleiche Nonce, gleiches Tag-Format) nur mit AES-NI und
+ * PCLMULQDQ; dort kostet es einen Bruchteil. */
+#define AEAD_CHACHA    0
+#define AEAD_AESGCM    1
+
+/* Vorbereiteter Schlüssel (aeadKeySet): Rundenschlüssel und GHASH-
+ * Potenzen werden einmal je Sitzung berechnet, nicht je Paket. */
+struct aead_key {
+    int      alg;                /* AEAD_*                         */
+    uint8_t  key[AEAD_KEY_LEN];
+    uint8_t  rk[15][16];         /* AES-256-Rundenschlüssel        */
+    uint8_t  hpow[8][16];        /* H^8..H^1 (GHASH, bytegespiegelt) */
+};
+
+/* Von dieser CPU unterstützte Verfahren, Bitmaske (1 << AEAD_*) */
+unsigned aeadAlgs(void);
+
+/* Schlüssel für alg vorbereiten (ohne Unterstützung: AEAD_CHACHA) */
+void aeadKeySet(struct aead_key *k, int alg, const uint8_t key[AEAD_KEY_LEN]);
+
+/* wie aeadSeal()/aeadOpen(), mit dem Verfahren des Schlüssels; mit
+ * AES-256-GCM ist out nach einem verfälschten Paket genullt statt
+ * unverändert (Prüfen und Entschlüsseln in einem Durchgang) */
+void aeadSealKey(const struct aead_key *k, uint64_t ctr,
+                 const void *ad, size_t adLen,
+                 const void *in, size_t len, void *out);
+int  aeadOpenKey(const struct aead_key *k, uint64_t ctr,
+                 const void *ad, size_t adLen,
+                 const void *in, size_t len, void *out);
+
+/* BLAKE2s-256 über data, mit Schlüssel key (keyLen <= 32, 0 = ohne) */
+void aeadHash(uint8_t out[32], const void *key, size_t keyLen,
+              const void *data, size_t len);
+
+/* Zufälliges Schlüsselpaar (getrandom). Rückgabewert: 0, <0 bei Fehler. */
+int  aeadKeypair(uint8_t priv[AEAD_KEY_LEN], uint8_t pub[AEAD_PUB_LEN]);
+
+/* X25519: gemeinsames Geheimnis. Rückgabewert: 0, <0 bei einem
+ * ungültigen (schwachen) öffentlichen Schlüssel. */
+int  aeadShared(uint8_t out[AEAD_KEY_LEN], const uint8_t priv[AEAD_KEY_LEN],
+                const uint8_t peerPub[AEAD_PUB_LEN]);
+
+/* Schlüsselableitung des Protokolls (Client und Server identisch):
+ *   Hello-Schlüssel   : aus PSK und Client-Schlüssel (0-RTT-Daten)
+ *   Sitzungsschlüssel : aus PSK, X25519-Geheimnis und beiden
+ *                       öffentlichen Schlüsseln, je Richtung einer */
+void aeadHelloKey(uint8_t k0[AEAD_KEY_LEN], const uint8_t psk[AEAD_KEY_LEN],
+                  const uint8_t cpub[AEAD_PUB_LEN]);
+void aeadSessionKeys(uint8_t c2s[AEAD_KEY_LEN], uint8_t s2c[AEAD_KEY_LEN],
+                     const uint8_t psk[AEAD_KEY_LEN], const uint8_t shared[AEAD_KEY_LEN],
+                     const uint8_t cpub[AEAD_PUB_LEN], const uint8_t spub[AEAD_PUB_LEN]);
+
+/* Gemeinsames Geheimnis aus einer Schlüsseldatei: BLAKE2s über den
+ * gesamten Inhalt (beliebiges Format, z.B. 32 Zufallsbytes).
+ * Rückgabewert: 0, <0 bei Lesefehler oder leerer Datei. */
+int  aeadKeyFile(uint8_t psk[AEAD_KEY_LEN], const char *path);
+
+/* Testvektoren aus RFC 8439, 7748 und 7693 prüfen (einmal je Prozess,
+ * auf dem Pfad, den diese CPU nimmt). Rückgabewert: 0, <0 bei einer
+ * Abweichung (dann nicht verschlüsseln). */
+int  aeadSelfTest(void);
+
+#endif /* AEAD_H_INCLUDED */
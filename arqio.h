@@ -0,0 +1,40 @@
+#ifndef ARQIO_H_INCLUDED
+#define ARQIO_H_INCLUDED
+
+#include <sys/socket.h>
+
+/*
+ * Transport- und Zeit-Hooks der ARQ-Engines.
+ *
+ * clientSy.c und serverSy.c greifen auf Uhr und Datagramm-Transport
+ * nur über diese Funktionen zu. Standard sind UDP-Socket und
+ * CLOCK_MONOTONIC; sim.c setzt stattdessen eine simulierte Strecke mit
+ * virtueller Uhr ein, sodass dieselbe Protokolllogik deterministisch
+ * und ohne Wartezeiten läuft.
+ *
+ * Alle Zeiten in Nanosekunden. user wird unverändert übergeben.
+ */
+struct arq_io {
+    void *user;
+
+    /* Monotone Uhr */
+    unsigned long long (*now)(void *user);
+
+    /* Datagramm senden (to == NULL: Gegenstelle des Clients).
+     * Rückgabewert: 0 bei Erfolg, <0 bei Fehler. */
+    int  (*send)(void *user, const void *buf, unsigned long len,
+                 const struct sockaddr_storage *to, socklen_t toLen);
+
+    /* Nicht blockierend empfangen (nur Client).
+     * Rückgabewert: Länge, <0 wenn nichts anliegt. */
+    long (*recv)(void *user, void *buf, unsigned long len);
+
+    /* Blockieren, bis etwas empfangen werden kann oder deadlineNs
+     * erreicht ist (nur Client). Rückgabewert: 1 = lesbar, 0 = Deadline. */
+    int  (*wait)(void *user, unsigned long long deadlineNs);
+
+    /* Bis deadlineNs schlafen, ohne zu empfangen (nur Client). */
+    void (*sleepUntil)(void *user, unsigned long long deadlineNs);
+};
+
+#endif /* ARQIO_H_INCLUDED */
@@ -0,0 +1,397 @@
+/* cas.c - Chunk-Store und inhaltsabhängige Zerlegung, siehe cas.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "aead.h"
+#include "cas.h"
+
+/* FastCDC: bis CAS_AVG_CHUNK die strengere Maske (seltener Schnitt),
+ * danach die leichtere; die Größen sammeln sich so um den Mittelwert */
+#define CAS_MASK_S   (((1ULL << 15) - 1) << 49)
+#define CAS_MASK_L   (((1ULL << 11) - 1) << 53)
+
+#define CAS_PACK     "chunks.pack"
+#define CAS_INDEX    "chunks.idx"
+
+/* Eintrag im Index (Datei und Speicher) */
+struct cas_idx {
+    unsigned char  Hash[CAS_HASH_LEN];
+    unsigned long  Off;         /* Position in der Pack-Datei */
+    unsigned int   Len;
+    unsigned int   pad;
+};
+
+struct cas_store {
+    int             packFd, idxFd;
+    unsigned long   packSize;
+    struct cas_idx *ent;
+    unsigned long   n, cap;
+    unsigned long   flushed;    /* Einträge bereits in der Indexdatei */
+    uint32_t       *slots;      /* Hash-Tabelle, Eintrag + 1, 0 = frei */
+    unsigned long   nSlots;
+};
+
+static uint64_t gGear[256];
+static pthread_once_t gGearOnce = PTHREAD_ONCE_INIT;
+
+/* Gear-Tabelle, für alle Clients gleich (feste Saat, splitmix64):
+ * nur dann fallen die Grenzen gleicher Inhalte gleich aus. Einmal je
+ * Prozess über pthread_once (Zerlegung in mehreren Threads). */
+static void gear_fill(void)
+{
+    uint64_t x = 0x41525143415331ULL;
+
+    for (int i = 255; i >= 0; i--) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        gGear[i] = z ^ (z >> 31);
+    }
+}
+
+void casHash(const void *data, unsigned long len, unsigned char out[CAS_HASH_LEN])
+{
+    uint8_t full[32];
+
+    aeadHash(full, NULL, 0, data, len);
+    memcpy(out, full, CAS_HASH_LEN);
+}
+
+/* Länge des nächsten Chunks ab p (n Bytes übrig) */
+static unsigned long cut_point(const unsigned char *p, unsigned long n)
+{
+    unsigned long i, normal;
+    uint64_t fp = 0;
+
+    if (n <= CAS_MIN_CHUNK) return n;
+    if (n > CAS_MAX_CHUNK) n = CAS_MAX_CHUNK;
+    normal = (n < CAS_AVG_CHUNK) ? n : CAS_AVG_CHUNK;
+    for (i = CAS_MIN_CHUNK; i < normal; i++) {
+        fp = (fp << 1) + gGear[p[i]];
+        if (!(fp & CAS_MASK_S)) return i + 1;
+    }
+    for (; i < n; i++) {
+        fp = (fp << 1) + gGear[p[i]];
+        if (!(fp & CAS_MASK_L)) return i + 1;
+    }
+    return n;
+}
+
+long casChunk(const unsigned char *data, unsigned long size, struct cas_chunk **out)
+{
+    unsigned long cap = size / CAS_AVG_CHUNK + 16, n = 0, pos = 0;
+    struct cas_chunk *c = malloc(cap * sizeof(*c));
+
+    *out = NULL;
+    if (c == NULL) return -1;
+    (void)pthread_once(&gGearOnce, gear_fill);
+    while (pos < size) {
+        if (n == cap) {
+            struct cas_chunk *g = realloc(c, 2 * cap * sizeof(*c));
+            if (g == NULL) {
+                free(c);
+                return -1;
+            }
+            c = g;
+            cap *= 2;
+        }
+        c[n].off = pos;
+        c[n].len = cut_point(data + pos, size - pos);
+        casHash(data + pos, c[n].len, c[n].hash);
+        pos += c[n].len;
+        n++;
+    }
+    *out = c;
+    return (long)n;
+}
+
+/* Tabellenplatz aus den ersten Bytes des Hashs (gleichverteilt) */
+static unsigned long hash_slot(const unsigned char *hash, unsigned long mask)
+{
+    uint64_t h;
+
+    memcpy(&h, hash, sizeof(h));
+    return (unsigned long)h & mask;
+}
+
+/* --- Kodierer --- */
+
+static int enc_rec(casEmitFn emit, void *user, unsigned char type, unsigned long len,
+                   unsigned long size, const unsigned char *hash)
+{
+    struct cas_rec rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.Type = type;
+    rec.Len  = (unsigned int)len;
+    rec.Size = size;
+    if (hash) memcpy(rec.Hash, hash, CAS_HASH_LEN);
+    return emit(user, &rec, sizeof(rec));
+}
+
+int casEncode(const unsigned char *data, unsigned long size,
+              const struct cas_chunk *chunks, unsigned long n,
+              const unsigned char *missing, casEmitFn emit, void *user,
+              struct cas_stats *st)
+{
+    struct cas_stats s;
+    unsigned long tbl = 1, mask;
+    long *seen;                 /* schon als Daten gesendet, Chunk + 1 */
+    int rc = -1;
+
+    while (tbl < 2 * n) tbl <<= 1;
+    mask = tbl - 1;
+    seen = calloc(tbl, sizeof(*seen));
+    if (seen == NULL) return -1;
+
+    memset(&s, 0, sizeof(s));
+    if (emit(user, CAS_MAGIC, CAS_MAGIC_LEN) < 0) goto out;
+    for (unsigned long i = 0; i < n; i++) {
+        const struct cas_chunk *c = &chunks[i];
+        int send = (missing[i / 8] >> (i % 8)) & 1;
+
+        if (send) {
+            unsigned long h = hash_slot(c->hash, mask);
+            for (; seen[h] != 0; h = (h + 1) & mask) {
+                if (memcmp(chunks[seen[h] - 1].hash, c->hash, CAS_HASH_LEN) == 0) {
+                    send = 0;
+                    break;
+                }
+            }
+            if (send) seen[h] = (long)i + 1;
+        }
+        if (send) {
+            if (enc_rec(emit, user, CAS_DATA, c->len, 0, c->hash) < 0 ||
+                emit(user, data + c->off, c->len) < 0)
+                goto out;
+            s.sent += c->len;
+        } else {
+            if (enc_rec(emit, user, CAS_REF, c->len, 0, c->hash) < 0) goto out;
+            s.reused += c->len;
+        }
+    }
+    if (enc_rec(emit, user, CAS_END, 0, size, NULL) < 0) goto out;
+    if (st) *st = s;
+    rc = 0;
+
+out:
+    free(seen);
+    return rc;
+}
+
+/* --- Store --- */
+
+static long find_entry(const struct cas_store *s, const unsigned char *hash)
+{
+    if (s->nSlots == 0) return -1;
+    for (unsigned long h = hash_slot(hash, s->nSlots - 1); s->slots[h] != 0;
+         h = (h + 1) & (s->nSlots - 1)) {
+        if (memcmp(s->ent[s->slots[h] - 1].Hash, hash, CAS_HASH_LEN) == 0)
+            return (long)s->slots[h] - 1;
+    }
+    return -1;
+}
+
+/* Hash-Tabelle auf doppelte Größe bringen */
+static int slots_grow(struct cas_store *s)
+{
+    unsigned long n = s->nSlots ? 2 * s->nSlots : 1024;
+    uint32_t *t = calloc(n, sizeof(*t));
+
+    if (t == NULL) return -1;
+    for (unsigned long i = 0; i < s->n; i++) {
+        unsigned long h = hash_slot(s->ent[i].Hash, n - 1);
+        while (t[h] != 0) h = (h + 1) & (n - 1);
+        t[h] = (uint32_t)(i + 1);
+    }
+    free(s->slots);
+    s->slots = t;
+    s->nSlots = n;
+    return 0;
+}
+
+static int add_entry(struct cas_store *s, const struct cas_idx *e)
+{
+    unsigned long h;
+
+    if (s->n >= UINT32_MAX - 1) return -1;
+    if (s->n == s->cap) {
+        unsigned long cap = s->cap ? 2 * s->cap : 1024;
+        struct cas_idx *g = realloc(s->ent, cap * sizeof(*g));
+        if (g == NULL) return -1;
+        s->ent = g;
+        s->cap = cap;
+    }
+    if (2 * (s->n + 1) > s->nSlots && slots_grow(s) < 0) return -1;
+    s->ent[s->n] = *e;
+    for (h = hash_slot(e->Hash, s->nSlots - 1); s->slots[h] != 0; h = (h + 1) & (s->nSlots - 1))
+        ;
+    s->slots[h] = (uint32_t)(++s->n);
+    return 0;
+}
+
+static int open_in(const char *dir, const char *name, int flags)
+{
+    char path[4096];
+
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return open(path, flags | O_CREAT | O_CLOEXEC, 0644);
+}
+
+/* Index laden: nur Einträge, deren Daten vollständig in der Pack-Datei
+ * liegen (ein Absturz kann Index bzw. Pack-Datei abschneiden); beide
+ * Dateien werden auf den gültigen Teil gekürzt */
+static int load_index(struct cas_store *s)
+{
+    struct stat st;
+    struct cas_idx e;
+    unsigned long packEnd = 0, valid = 0;
+    FILE *fp;
+    int fd = dup(s->idxFd);
+
+    if (fd < 0 || fstat(s->packFd, &st) != 0 || (fp = fdopen(fd, "rb")) == NULL) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    s->packSize = (unsigned long)st.st_size;
+    while (fread(&e, sizeof(e), 1, fp) == 1) {
+        if (e.Len == 0 || e.Len > CAS_MAX_CHUNK || e.Off > s->packSize ||
+            e.Len > s->packSize - e.Off)
+            break;
+        if (find_entry(s, e.Hash) < 0 && add_entry(s, &e) < 0) {
+            fclose(fp);
+            return -1;
+        }
+        if (e.Off + e.Len > packEnd) packEnd = e.Off + e.Len;
+        valid++;
+    }
+    fclose(fp);
+    if (ftruncate(s->idxFd, (off_t)(valid * sizeof(e))) != 0 ||
+        ftruncate(s->packFd, (off_t)packEnd) != 0)
+        return -1;
+    s->packSize = packEnd;
+    s->flushed = s->n;
+    return 0;
+}
+
+struct cas_store *casOpen(const char *dir)
+{
+    struct cas_store *s = calloc(1, sizeof(*s));
+
+    if (s == NULL) return NULL;
+    s->packFd = s->idxFd = -1;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) goto fail;
+    s->packFd = open_in(dir, CAS_PACK, O_RDWR);
+    if (s->packFd < 0) goto fail;
+    if (flock(s->packFd, LOCK_EX | LOCK_NB) != 0) goto fail;   /* zweiter Server */
+    s->idxFd = open_in(dir, CAS_INDEX, O_RDWR | O_APPEND);
+    if (s->idxFd < 0 || load_index(s) < 0) goto fail;
+    return s;
+
+fail:
+    if (s->packFd >= 0) close(s->packFd);
+    if (s->idxFd >= 0) close(s->idxFd);
+    free(s->ent);
+    free(s->slots);
+    free(s);
+    return NULL;
+}
+
+void casClose(struct cas_store *s)
+{
+    if (s == NULL) return;
+    (void)casFlush(s, 0);
+    close(s->packFd);
+    close(s->idxFd);
+    free(s->ent);
+    free(s->slots);
+    free(s);
+}
+
+int casHas(const struct cas_store *s, const unsigned char hash[CAS_HASH_LEN])
+{
+    return find_entry(s, hash) >= 0;
+}
+
+int casPut(struct cas_store *s, const unsigned char hash[CAS_HASH_LEN],
+           const void *data, unsigned long len)
+{
+    unsigned char check[CAS_HASH_LEN];
+    const char *p = data;
+    struct cas_idx e;
+    unsigned long off = 0;
+
+    if (len == 0 || len > CAS_MAX_CHUNK) return -1;
+    casHash(data, len, check);
+    if (memcmp(check, hash, CAS_HASH_LEN) != 0) return -1;
+    if (find_entry(s, hash) >= 0) return 1;
+
+    while (off < len) {
+        ssize_t n = pwrite(s->packFd, p + off, len - off, (off_t)(s->packSize + off));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        off += (unsigned long)n;
+    }
+    memset(&e, 0, sizeof(e));
+    memcpy(e.Hash, hash, CAS_HASH_LEN);
+    e.Off = s->packSize;
+    e.Len = (unsigned int)len;
+    if (add_entry(s, &e) < 0) return -1;
+    s->packSize += len;
+    return 0;
+}
+
+long casGet(const struct cas_store *s, const unsigned char hash[CAS_HASH_LEN],
+            void *buf, unsigned long len)
+{
+    long i = find_entry(s, hash);
+    unsigned long off = 0, want;
+
+    if (i < 0 || s->ent[i].Len > len) return -1;
+    want = s->ent[i].Len;
+    while (off < want) {
+        ssize_t n = pread(s->packFd, (char *)buf + off, want - off,
+                          (off_t)(s->ent[i].Off + off));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        off += (unsigned long)n;
+    }
+    return (long)want;
+}
+
+int casFlush(struct cas_store *s, int sync)
+{
+    const char *p = (const char *)(s->ent + s->flushed);
+    unsigned long len = (s->n - s->flushed) * sizeof(*s->ent);
+
+    /* Daten vor dem Index: ein Eintrag zeigt nie auf Ungeschriebenes */
+    if (sync && len > 0 && fdatasync(s->packFd) != 0) return -1;
+    while (len > 0) {
+        ssize_t n = write(s->idxFd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (unsigned long)n;
+    }
+    s->flushed = s->n;
+    if (sync && fdatasync(s->idxFd) != 0) return -1;
+    return 0;
+}
+
+void casStats(const struct cas_store *s, unsigned long *chunks, unsigned long *bytes)
+{
+    *chunks = s->n;
+    *bytes  = s->packSize;
+}
@@ -0,0 +1,86 @@
+#ifndef CAS_H_INCLUDED
+#define CAS_H_INCLUDED
+
+#include "data.h"
+
+/*
+ * Deduplizierung über Transfers hinweg (Formate siehe struct cas_rec
+ * in data.h):
+ *   - der Client zerlegt seine Eingabe inhaltsabhängig in Chunks
+ *     (Gear-Hash nach FastCDC): eine Grenze hängt nur von den Bytes
+ *     davor ab, eine Einfügung verschiebt nur die Chunks in ihrer Nähe
+ *   - er fragt nach den Hashes (BLAKE2s, gekürzt) und sendet nur die
+ *     Chunks, die dem Server fehlen, für alle übrigen einen Verweis
+ *   - der Server hält jeden Chunk einmal in einem Store (Pack-Datei
+ *     und Index in einem Verzeichnis) für alle folgenden Transfers
+ * Netz und Store wachsen so mit dem neuen Inhalt, nicht mit der Anzahl
+ * der Kopien.
+ */
+
+#define CAS_MIN_CHUNK    (2UL << 10)
+#define CAS_AVG_CHUNK    (8UL << 10)
+#define CAS_MAX_CHUNK    (64UL << 10)
+
+struct cas_chunk {
+    unsigned long off, len;
+    unsigned char hash[CAS_HASH_LEN];
+};
+
+/* Hash eines Chunks */
+void casHash(const void *data, unsigned long len, unsigned char out[CAS_HASH_LEN]);
+
+/* data (size Bytes) in Chunks zerlegen, Array in einem malloc-Puffer.
+ * Rückgabewert: Anzahl Chunks, <0 bei Speichermangel. */
+long casChunk(const unsigned char *data, unsigned long size, struct cas_chunk **out);
+
+/* Ausgabe des Kodierers, siehe deltaEmitFn in delta.h */
+typedef int (*casEmitFn)(void *user, const void *buf, unsigned long len);
+
+struct cas_stats {
+    unsigned long sent;      /* als Daten gesendete Bytes              */
+    unsigned long reused;    /* per Verweis übernommene Bytes          */
+};
+
+/* Strom von CAS_MAGIC bis CAS_END kodieren: Chunk i als Daten, wenn
+ * Bit i in missing gesetzt ist und derselbe Inhalt nicht schon früher
+ * im Strom reist, sonst als Verweis. st darf NULL sein.
+ * Rückgabewert: 0, <0 bei Speichermangel oder Abbruch durch emit. */
+int casEncode(const unsigned char *data, unsigned long size,
+              const struct cas_chunk *chunks, unsigned long n,
+              const unsigned char *missing, casEmitFn emit, void *user,
+              struct cas_stats *st);
+
+/* --- Store des Servers --- */
+
+struct cas_store;
+
+/* Store im Verzeichnis dir öffnen bzw. anlegen und den Index laden
+ * (exklusiv für diesen Prozess). Rückgabewert: Store oder NULL. */
+struct cas_store *casOpen(const char *dir);
+
+/* Neue Indexeinträge schreiben und schließen. */
+void casClose(struct cas_store *s);
+
+/* Ist der Chunk mit diesem Hash vorhanden? */
+int  casHas(const struct cas_store *s, const unsigned char hash[CAS_HASH_LEN]);
+
+/* Chunk ablegen, nachdem sein Hash geprüft ist.
+ * Rückgabewert: 0 neu, 1 schon vorhanden, <0 bei falschem Hash oder
+ * Schreibfehler. */
+int  casPut(struct cas_store *s, const unsigned char hash[CAS_HASH_LEN],
+            const void *data, unsigned long len);
+
+/* Chunk nach buf (len Bytes Platz) lesen.
+ * Rückgabewert: Länge, <0 wenn unbekannt, zu lang oder bei Lesefehler. */
+long casGet(const struct cas_store *s, const unsigned char hash[CAS_HASH_LEN],
+            void *buf, unsigned long len);
+
+/* Neue Indexeinträge schreiben; sync != 0: vorher die Pack-Datei,
+ * danach den Index auf stabilen Speicher bringen.
+ * Rückgabewert: 0, <0 bei Schreibfehler. */
+int  casFlush(struct cas_store *s, int sync);
+
+/* Anzahl Chunks und Bytes im Store */
+void casStats(const struct cas_store *s, unsigned long *chunks, unsigned long *bytes);
+
+#endif /* CAS_H_INCLUDED */
@@ -1,27 +1,880 @@
+#define _GNU_SOURCE  /* sched_setaffinity, CPU_SET */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "data.h"
 #include "config.h"
 #include "clientSy.h"
+#include "aead.h"
+#include "delta.h"
+#include "cas.h"
+#include "readahead.h"
 
 /* ==========================================
  * Schritt 1: Usage-Funktion zur Kommandozeilen-Argumentbehandlung
  * ========================================== */
 
-static void usage(const char *progName)
+static __attribute__((noreturn)) void usage(const char *progName)
 {
-    fprintf(stderr, "Usage: %s -a <server> -p <port> -f <file> -w <window>\n", progName);
+    fprintf(stderr, "Usage: %s -a <server> -p <port> -f <file> -w <window> [-r <rate>] [-s <stripes>] [-u]\n"
+                    "       [-b <us>] [-c <cpu>] [-t] [-e] [-k <keyfile>] [-d] [-z] [-m <receivers>]\n"
+                    "       [-n <ms>] [-l <ms>[,<retx>]] [-g] [-x <trace>]\n", progName);
     fprintf(stderr, "       -a <server> : Server-Adresse (Default: %s)\n",
             (DEFAULT_SERVER == NULL) ? "loopback" : DEFAULT_SERVER);
     fprintf(stderr, "       -p <port>   : Server-Port (Default: %s)\n", DEFAULT_PORT);
-    fprintf(stderr, "       -f <file>   : Eingabedatei\n");
+    fprintf(stderr, "       -f <file>   : Eingabedatei, '-' = stdin (Pipe-Modus),\n");
+    fprintf(stderr, "                     Verzeichnis = ganzer Baum in einer Sitzung (Batch)\n");
     fprintf(stderr, "       -w <window> : Fenstergröße (1..10)\n");
+    fprintf(stderr, "       -r <rate>   : Pacing in Bytes/s je Flow oder 'auto' (Default: aus)\n");
+    fprintf(stderr, "       -s <stripes>: Datei in Byte-Bereiche auf parallele Flows verteilen (1..%d)\n",
+            GBN_MAX_STRIPES);
+    fprintf(stderr, "       -u          : io_uring statt sendto/recvfrom (falls verfügbar)\n");
+    fprintf(stderr, "       -b <us>     : Busy-Poll: bis zu <us> Mikrosekunden auf ACKs pollen\n");
+    fprintf(stderr, "       -c <cpu>    : Protokoll-Thread auf Kern <cpu> festlegen (Stripes: ab <cpu>)\n");
+    fprintf(stderr, "       -t          : Latenz-Histogramme (RTT, Servicezeit, Wartezeit) am Ende ausgeben\n");
+    fprintf(stderr, "       -e          : verschlüsselt übertragen (AES-256-GCM bzw. ChaCha20-Poly1305, Server mit -e)\n");
+    fprintf(stderr, "       -k <keyfile>: gemeinsames Geheimnis mit dem Server (impliziert -e)\n");
+    fprintf(stderr, "       -d          : Delta: nur Änderungen gegenüber der Ausgabedatei des Servers senden\n");
+    fprintf(stderr, "       -g          : Dedup: nur Chunks senden, die dem Chunk-Store des Servers fehlen\n");
+    fprintf(stderr, "       -z          : Sparse: Nullblöcke und Löcher der Datei als Löcher übertragen (binär)\n");
+    fprintf(stderr, "       -m <n>      : Multicast an <n> Server, -a ist die Gruppe (z.B. ff01::4242%%eth0)\n");
+    fprintf(stderr, "       -n <ms>     : kleine app_units zu einem Paket sammeln, höchstens <ms> verzögern\n");
+    fprintf(stderr, "       -l <ms>[,<n>]: Nachrichtenmodus: Zeilen <ms> nach dem Lesen (0 = ohne Frist) bzw.\n");
+    fprintf(stderr, "                     nach <n> Wiederholungen aufgeben statt weiter zu warten\n");
+    fprintf(stderr, "       -x <trace>  : alle Datagramme mit Zeitstempel mitschneiden (Stripes: <trace>.<i>)\n");
     exit(EXIT_FAILURE);
 }
 
+/* Aufrufenden Thread auf einen Kern festlegen (Busy-Poll belegt ihn). */
+static int pinCpu(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Client: cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* ==========================================
+ * Sparse-Modus: Nullbereiche als Löcher (REQ_F_HOLE)
+ * ========================================== */
+
+#define SPARSE_BLOCK  4096UL            /* kleinstes ausgelassenes Loch */
+#define SPARSE_CHUNK  (64UL << 10)      /* Lesepuffer                   */
+
+/* Ziel der Abtastung: Datenpakete und Löcher */
+struct sparse_out {
+    int  (*data)(void *user, const struct app_unit *app);
+    int  (*hole)(void *user, unsigned long len);
+    void  *user;
+    unsigned long holeLen;              /* noch nicht gesendetes Loch */
+    unsigned long dataBytes, holeBytes;
+};
+
+/* Nur Nullbytes? (memcmp ist in der libc vektorisiert) */
+static int isZero(const char *p, unsigned long n)
+{
+    return n == 0 || (p[0] == 0 && memcmp(p, p + 1, n - 1) == 0);
+}
+
+static int sparseFlushHole(struct sparse_out *so)
+{
+    if (so->holeLen == 0) return 0;
+    if (so->hole(so->user, so->holeLen) != 0) return -1;
+    so->holeBytes += so->holeLen;
+    so->holeLen = 0;
+    return 0;
+}
+
+/* Daten in vollen app_units senden, ein offenes Loch vorher */
+static int sparseData(struct sparse_out *so, const char *buf, unsigned long len)
+{
+    struct app_unit app;
+
+    if (len > 0 && sparseFlushHole(so) != 0) return -1;
+    while (len > 0) {
+        app.len = (len < BufferSize) ? len : BufferSize;
+        memcpy(app.data, buf, app.len);
+        if (so->data(so->user, &app) != 0) return -1;
+        so->dataBytes += app.len;
+        buf += app.len;
+        len -= app.len;
+    }
+    return 0;
+}
+
+/* Bereich [off, off + len) der Datei fd senden: Löcher des Dateisystems
+ * (SEEK_DATA/SEEK_HOLE) ohne Lesen, in den Daten jeder ausgerichtete
+ * Block aus Nullen (SPARSE_BLOCK) als Loch. Benachbarte Löcher werden
+ * zu einem Paket zusammengefasst.
+ * Rückgabewert: 0 bei Erfolg, <0 bei Lese- oder Sendefehler.
+ */
+static int sparseScan(int fd, unsigned long off, unsigned long len, struct sparse_out *so)
+{
+    unsigned long pos = off, end = off + len;
+    char *buf = malloc(SPARSE_CHUNK);
+    int rc = -1;
+
+    if (buf == NULL) return -1;
+    while (pos < end) {
+        off_t d = lseek(fd, (off_t)pos, SEEK_DATA);
+        off_t h;
+        unsigned long stop, n, i, run;
+
+        if (d < 0) d = (errno == ENXIO) ? (off_t)end : (off_t)pos;  /* ENXIO: nur noch Loch */
+        if ((unsigned long)d > pos) {
+            unsigned long skip = (((unsigned long)d < end) ? (unsigned long)d : end) - pos;
+            so->holeLen += skip;
+            pos += skip;
+            continue;
+        }
+        h = lseek(fd, (off_t)pos, SEEK_HOLE);
+        stop = (h > (off_t)pos && (unsigned long)h < end) ? (unsigned long)h : end;
+        n = (stop - pos < SPARSE_CHUNK) ? stop - pos : SPARSE_CHUNK;
+
+        for (i = 0; i < n; ) {
+            ssize_t got = pread(fd, buf + i, n - i, (off_t)(pos + i));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                fprintf(stderr, "Client: sparse: read failed at %lu\n", pos + i);
+                goto out;
+            }
+            i += (unsigned long)got;
+        }
+
+        /* Datenlauf [run, i) sammeln, Nullblöcke unterbrechen ihn */
+        for (i = run = 0; i < n; ) {
+            unsigned long blen = SPARSE_BLOCK - (pos + i) % SPARSE_BLOCK;
+            if (blen > n - i) blen = n - i;
+            if (blen == SPARSE_BLOCK && isZero(buf + i, blen)) {
+                if (sparseData(so, buf + run, i - run) != 0) goto out;
+                so->holeLen += blen;
+                run = i + blen;
+            }
+            i += blen;
+        }
+        if (sparseData(so, buf + run, n - run) != 0) goto out;
+        pos += n;
+    }
+    rc = sparseFlushHole(so);
+
+out:
+    free(buf);
+    return rc;
+}
+
+/* ==========================================
+ * Striping: ein Thread (= ein Socket/Flow) je Byte-Bereich
+ * ========================================== */
+
+struct stripe_job {
+    const char       *server;
+    const char       *port;
+    const char       *filename;
+    int               winSize;
+    unsigned long     paceRate;
+    int               useUring;
+    unsigned long     busyPollUs;
+    int               cpu;      /* <0 = nicht festlegen */
+    int               timestamps;
+    int               secure;
+    const unsigned char *psk;   /* NULL = ohne gemeinsames Geheimnis */
+    int               sparse;   /* Nullbereiche als Löcher senden */
+    const char       *trace;    /* Mitschnitt nach <trace>.<Stripe>, NULL = aus */
+    struct arq_cookies *cookies; /* gemeinsam für alle Stripes */
+    struct arq_client *cli;     /* Flow des Stripes (im Thread) */
+    struct hello_info info;
+    unsigned long     length;   /* Länge des Byte-Bereichs */
+    int               result;
+};
+
+static int stripeData(void *user, const struct app_unit *app)
+{
+    struct stripe_job *job = user;
+    return arqClientSendData(job->cli, app, job->winSize);
+}
+
+static int stripeHole(void *user, unsigned long len)
+{
+    struct stripe_job *job = user;
+    return arqClientSendHole(job->cli, len, job->winSize);
+}
+
+static void *stripeWorker(void *arg)
+{
+    struct stripe_job *job = arg;
+    struct arq_client *cli;
+    struct app_unit app;
+    unsigned long left = job->length;
+    FILE *fp;
+
+    job->result = -1;
+
+    fp = fopen(job->filename, "rb");
+    if (!fp) {
+        perror("Stripe: file opening failed");
+        return NULL;
+    }
+    if (fseek(fp, (long)job->info.Offset, SEEK_SET) != 0) {
+        perror("Stripe: fseek");
+        fclose(fp);
+        return NULL;
+    }
+
+    /* eigener Client-Kontext (Socket, Fenster) je Stripe */
+    cli = arqClientCreate(job->server, job->port);
+    if (!cli) {
+        fclose(fp);
+        return NULL;
+    }
+    arqClientSetPacing(cli, job->paceRate);
+    arqClientSetCookies(cli, job->cookies);
+    if (job->useUring) (void)arqClientSetUring(cli, 1);
+    arqClientSetBusyPoll(cli, job->busyPollUs);
+    if (job->cpu >= 0) (void)pinCpu(job->cpu);
+    if (job->timestamps) (void)arqClientSetTimestamps(cli, 1);
+    if (job->trace) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.%u", job->trace, job->info.Stripe);
+        if (arqClientSetTrace(cli, path) != 0) {
+            fprintf(stderr, "Client: stripe %u: cannot write trace '%s'\n", job->info.Stripe, path);
+            goto out;
+        }
+    }
+    if (job->secure && arqClientSetSecure(cli, 1, job->psk) != 0) goto out;
+
+    if (arqClientHello(cli, job->winSize, &job->info) != 0) {
+        fprintf(stderr, "Client: stripe %u: Hello failed\n", job->info.Stripe);
+        goto out;
+    }
+
+    if (job->sparse) {
+        struct sparse_out so;
+        memset(&so, 0, sizeof(so));
+        so.data = stripeData;
+        so.hole = stripeHole;
+        so.user = job;
+        job->cli = cli;
+        if (sparseScan(fileno(fp), job->info.Offset, job->length, &so) != 0) {
+            fprintf(stderr, "Client: stripe %u: data send failed\n", job->info.Stripe);
+            goto out;
+        }
+        left = 0;
+    }
+
+    while (left > 0) {
+        size_t want = (left < BufferSize) ? (size_t)left : BufferSize;
+        size_t got = fread(app.data, 1, want, fp);
+        if (got == 0) {
+            fprintf(stderr, "Client: stripe %u: short read\n", job->info.Stripe);
+            goto out;
+        }
+        app.len = got;
+        if (arqClientSendData(cli, &app, job->winSize) != 0) {
+            fprintf(stderr, "Client: stripe %u: data send failed\n", job->info.Stripe);
+            goto out;
+        }
+        left -= got;
+    }
+
+    if (arqClientSendClose(cli, job->winSize) != 0) {
+        fprintf(stderr, "Client: stripe %u: error while sending close\n", job->info.Stripe);
+        goto out;
+    }
+    job->result = 0;
+    if (job->timestamps) {
+        char label[32];
+        snprintf(label, sizeof(label), "Stripe %u:", job->info.Stripe);
+        arqClientReport(cli, stdout, label);
+    }
+
+out:
+    arqClientDestroy(cli);
+    fclose(fp);
+    return NULL;
+}
+
+/* Datei in nStripes Bereiche (Vielfache von BufferSize) zerlegen und
+ * parallel übertragen. proto liefert die gemeinsamen Einstellungen
+ * (Server, Datei, Fenster, Pacing, ...), Stripe s läuft auf Kern
+ * proto->cpu + s. Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+static int sendStriped(const struct stripe_job *proto, int nStripes, unsigned long fileSize)
+{
+    struct stripe_job jobs[GBN_MAX_STRIPES];
+    pthread_t threads[GBN_MAX_STRIPES];
+    struct arq_cookies *cookies;
+    unsigned long chunk, offset = 0;
+    unsigned long xferId;
+    int started = 0, rc = 0;
+
+    /* Bereichsgröße auf ganze Pakete aufrunden */
+    chunk = (fileSize + (unsigned long)nStripes - 1) / (unsigned long)nStripes;
+    chunk = (chunk + BufferSize - 1) / BufferSize * BufferSize;
+    if (chunk == 0) chunk = BufferSize;
+
+    /* Letzte Stripes können durch das Aufrunden leer ausfallen */
+    nStripes = (int)((fileSize + chunk - 1) / chunk);
+    if (nStripes < 1) nStripes = 1;
+
+    cookies = arqCookiesCreate();   /* ohne: jeder Stripe für sich */
+
+    xferId = ((unsigned long)getpid() << 20) ^ (unsigned long)time(NULL) ^ (unsigned long)rand();
+    if (xferId == 0) xferId = 1;
+
+    for (int s = 0; s < nStripes; s++) {
+        struct stripe_job *job = &jobs[s];
+        *job = *proto;
+        job->cookies = cookies;
+        if (proto->cpu >= 0) job->cpu = proto->cpu + s;
+        job->info.XferId  = xferId;
+        job->info.Offset  = offset;
+        job->info.Stripe  = (unsigned short)s;
+        job->info.Stripes = (unsigned short)nStripes;
+        job->length = (fileSize - offset < chunk) ? fileSize - offset : chunk;
+        offset += job->length;
+
+        if (pthread_create(&threads[s], NULL, stripeWorker, job) != 0) {
+            fprintf(stderr, "Client: pthread_create failed\n");
+            rc = -1;
+            break;
+        }
+        started++;
+    }
+
+    for (int s = 0; s < started; s++) {
+        pthread_join(threads[s], NULL);
+        if (jobs[s].result != 0) rc = -1;
+    }
+    arqCookiesDestroy(cookies);
+    return rc;
+}
+
+/* ==========================================
+ * Versand mit einer app_unit Verzögerung (0-RTT, FIN)
+ * ========================================== */
+
+/* Die erste app_unit reist im Hello, die letzte trägt das FIN. Dazu
+ * wird jeweils eine app_unit zurückgehalten, bis die nächste vorliegt
+ * oder die Quelle zu Ende ist; eine Datei aus einem Paket braucht so
+ * nur einen Round Trip. */
+struct unit_sender {
+    struct app_unit pending;
+    int             havePending;
+    int             helloDone;
+    int             winSize;
+    int             idleMs;      /* so lange auf die Quelle warten, dann unitIdle() */
+
+    /* Nachrichtenmodus (-l): die Frist läuft ab dem Lesen, die
+     * Zurückhaltung (bis idleMs) zählt also mit */
+    unsigned long      lifetimeMs;
+    unsigned int       maxRetx;
+    unsigned long long pendingNs;   /* Lesezeitpunkt von pending */
+    unsigned long      expired;     /* vor dem Senden abgelaufen */
+};
+
+static unsigned long long monoNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* Restfrist der zurückgehaltenen app_unit (ab dem Lesen) nach *leftMs,
+ * 0 = ohne Frist; sie reist mit dieser app_unit (arqSendMsg()).
+ * Rückgabewert: 0, wenn sie schon abgelaufen ist (dann nicht senden). */
+static int unitLimits(struct unit_sender *us, unsigned long *leftMs)
+{
+    unsigned long long ageMs;
+
+    *leftMs = 0;
+    if (!us->lifetimeMs) return 1;
+    ageMs = (monoNs() - us->pendingNs) / 1000000ULL;
+    if (ageMs >= us->lifetimeMs) {
+        us->expired++;
+        return 0;
+    }
+    *leftMs = us->lifetimeMs - (unsigned long)ageMs;
+    return 1;
+}
+
+static int unitSendPending(struct unit_sender *us)
+{
+    unsigned long leftMs;
+    int rc;
+
+    if (!us->havePending) return 0;
+    if (!us->helloDone)
+        rc = arqSendHelloData(us->winSize, &us->pending, 0);
+    else if (unitLimits(us, &leftMs))
+        rc = arqSendMsg(&us->pending, us->winSize, leftMs, us->maxRetx);
+    else
+        rc = 0;
+    if (rc != 0) return -1;
+
+    us->helloDone = 1;
+    us->havePending = 0;
+    return 0;
+}
+
+static int unitPut(struct unit_sender *us, const struct app_unit *app)
+{
+    if (unitSendPending(us) != 0) return -1;
+    us->pending = *app;
+    us->havePending = 1;
+    if (us->lifetimeMs) us->pendingNs = monoNs();
+    return 0;
+}
+
+/* Quelle liefert gerade nichts: zurückgehaltene app_unit nicht länger
+ * verzögern, Protokoll weiterführen */
+static int unitIdle(struct unit_sender *us)
+{
+    if (unitSendPending(us) != 0) return -1;
+    return us->helloDone ? arqPoll(us->winSize) : 0;
+}
+
+/* Loch senden: zurückgehaltene app_unit zuerst, ein Loch am Anfang
+ * braucht das Hello vorab (REQ_F_HOLE reist nicht im Hello) */
+static int unitHole(struct unit_sender *us, unsigned long len)
+{
+    if (unitSendPending(us) != 0) return -1;
+    if (!us->helloDone) {
+        if (arqSendHelloData(us->winSize, NULL, 0) != 0) return -1;
+        us->helloDone = 1;
+    }
+    return arqSendHole(len, us->winSize);
+}
+
+/* Übertragung abschließen: FIN auf der letzten app_unit, bei einer
+ * leeren oder einteiligen Quelle schon im Hello */
+static int unitFinish(struct unit_sender *us)
+{
+    unsigned long leftMs;
+
+    if (!us->helloDone)
+        return arqSendHelloData(us->winSize, us->havePending ? &us->pending : NULL, 1);
+    if (us->havePending && unitLimits(us, &leftMs))
+        return arqSendLastMsg(&us->pending, us->winSize, leftMs, us->maxRetx);
+    return arqSendClose(us->winSize);
+}
+
+/* ==========================================
+ * Pipe-Modus: stdin / FIFO ohne Seek
+ * ========================================== */
+
+/* Eingabe blockweise und binär weiterreichen, sobald Daten anliegen.
+ * Speicherbedarf konstant (eine app_unit + Sendefenster). Liefert die
+ * Quelle nichts, hält unitIdle() das Protokoll am Laufen.
+ * lines (Nachrichtenmodus): wie sendLines() eine Zeile je app_unit
+ * (höchstens BufferSize - 1 Bytes), eine angefangene Zeile wartet auf
+ * ihr Ende; sonst zerfielen Nachrichten an den Grenzen von read().
+ * Rückgabewert: 0 bei Erfolg (EOF erreicht), !=0 bei Fehler.
+ */
+static int sendStream(int fd, struct unit_sender *us, int lines)
+{
+    struct app_unit app;
+    char buf[BufferSize];
+    struct pollfd pfd;
+    ssize_t n;
+
+    app.len = 0;
+
+    for (;;) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int rc = poll(&pfd, 1, us->idleMs);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            perror("Client: poll");
+            return -1;
+        }
+        if (rc == 0) {
+            if (unitIdle(us) != 0) return -1;
+            continue;
+        }
+
+        n = read(fd, lines ? buf : app.data, BufferSize);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            perror("Client: read");
+            return -1;
+        }
+        if (n == 0) /* EOF, ggf. letzte Zeile ohne Zeilenende */
+            return (app.len > 0) ? unitPut(us, &app) : 0;
+
+        if (!lines) {
+            app.len = (unsigned long)n;
+            if (unitPut(us, &app) != 0) return -1;
+            app.len = 0;
+            continue;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            app.data[app.len++] = buf[i];
+            if (buf[i] == '\n' || app.len == BufferSize - 1) {
+                if (unitPut(us, &app) != 0) return -1;
+                app.len = 0;
+            }
+        }
+    }
+}
+
+/* ==========================================
+ * Batch-Modus: Verzeichnisbaum in einer Sitzung
+ * ========================================== */
+
+/* Records und Inhalte werden lückenlos in volle app_units gepackt
+ * (siehe struct batch_rec in data.h); ebenso der Delta-Strom. */
+struct batch_packer {
+    struct app_unit     app;
+    struct unit_sender *us;
+    unsigned long   files;
+    unsigned long   bytes;
+};
+
+static int batchPut(struct batch_packer *bp, const void *data, unsigned long len)
+{
+    const char *p = data;
+
+    while (len > 0) {
+        unsigned long n = BufferSize - bp->app.len;
+        if (n > len) n = len;
+        memcpy(bp->app.data + bp->app.len, p, n);
+        bp->app.len += n;
+        p += n;
+        len -= n;
+
+        if (bp->app.len == BufferSize) {
+            if (unitPut(bp->us, &bp->app) != 0) return -1;
+            bp->app.len = 0;
+        }
+    }
+    return 0;
+}
+
+static int batchRecord(struct batch_packer *bp, unsigned char type, const char *rel,
+                       unsigned int mode, unsigned long size)
+{
+    struct batch_rec rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.Type    = type;
+    rec.NameLen = (unsigned short)strlen(rel);
+    rec.Mode    = mode & 0777;
+    rec.Size    = size;
+    if (batchPut(bp, &rec, sizeof(rec)) != 0) return -1;
+    return batchPut(bp, rel, rec.NameLen);
+}
+
+/* Dateiinhalt anhängen; genau st_size Bytes (Datei kann sich ändern) */
+static int batchFile(struct batch_packer *bp, const char *path, const char *rel,
+                     const struct stat *st)
+{
+    char buf[BufferSize];
+    unsigned long left = (unsigned long)st->st_size;
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        fprintf(stderr, "Client: skipping '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+    if (batchRecord(bp, BATCH_FILE, rel, st->st_mode, left) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    while (left > 0) {
+        size_t want = (left < sizeof(buf)) ? (size_t)left : sizeof(buf);
+        size_t got = fread(buf, 1, want, fp);
+        if (got == 0) {
+            /* Datei wurde kürzer: mit Nullen auffüllen */
+            fprintf(stderr, "Client: '%s' shrank while reading\n", path);
+            memset(buf, 0, want);
+            got = want;
+        }
+        if (batchPut(bp, buf, got) != 0) {
+            fclose(fp);
+            return -1;
+        }
+        left -= got;
+    }
+    fclose(fp);
+    bp->files++;
+    bp->bytes += (unsigned long)st->st_size;
+    return 0;
+}
+
+/* Verzeichnis rekursiv (pre-order) packen; nur Dateien und Verzeichnisse */
+static int batchDir(struct batch_packer *bp, const char *path, const char *rel)
+{
+    char childPath[PATH_MAX];
+    char childRel[PATH_MAX];
+    struct dirent *de;
+    struct stat st;
+    int rc = 0;
+    DIR *dir = opendir(path);
+
+    if (!dir) {
+        fprintf(stderr, "Client: skipping '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+    while (rc == 0 && (de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+
+        if (snprintf(childPath, sizeof(childPath), "%s/%s", path, de->d_name) >= (int)sizeof(childPath) ||
+            snprintf(childRel, sizeof(childRel), "%s%s%s", rel, rel[0] ? "/" : "", de->d_name) >= (int)sizeof(childRel)) {
+            fprintf(stderr, "Client: path too long, skipping '%s'\n", de->d_name);
+            continue;
+        }
+        if (lstat(childPath, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            rc = batchRecord(bp, BATCH_DIR, childRel, st.st_mode, 0);
+            if (rc == 0) rc = batchDir(bp, childPath, childRel);
+        } else if (S_ISREG(st.st_mode)) {
+            rc = batchFile(bp, childPath, childRel, &st);
+        } else {
+            fprintf(stderr, "Client: skipping special file '%s'\n", childPath);
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+/* Rückgabewert: 0 bei Erfolg, !=0 bei Fehler. */
+static int sendBatch(const char *root, struct unit_sender *us)
+{
+    struct batch_packer bp;
+
+    memset(&bp, 0, sizeof(bp));
+    bp.us = us;
+
+    if (batchPut(&bp, BATCH_MAGIC, BATCH_MAGIC_LEN) != 0 ||
+        batchDir(&bp, root, "") != 0 ||
+        batchRecord(&bp, BATCH_END, "", 0, 0) != 0) {
+        return -1;
+    }
+    /* angebrochenes letztes Paket */
+    if (bp.app.len > 0 && unitPut(us, &bp.app) != 0) return -1;
+
+    printf("Client: batch: %lu files, %lu bytes\n", bp.files, bp.bytes);
+    return 0;
+}
+
+/* ==========================================
+ * Delta-Modus: nur Änderungen gegenüber der Datei des Servers
+ * ========================================== */
+
+static int deltaEmit(void *user, const void *buf, unsigned long len)
+{
+    return batchPut(user, buf, len);
+}
+
+/* Signatur der Ausgabedatei des Servers abrufen (vor dem Hello) und die
+ * Datei als Delta-Strom senden (siehe delta.h).
+ * Rückgabewert: 0 bei Erfolg, 1 = Server ohne Signatur (Datei
+ * vollständig senden), <0 bei Fehler.
+ */
+static int sendDelta(FILE *fp, unsigned long size, struct unit_sender *us)
+{
+    struct batch_packer bp;
+    struct delta_stats ds;
+    char *sig = NULL;
+    void *map = NULL;
+    long sigLen;
+    int rc;
+
+    sigLen = arqFetchSig(&sig);
+    if (sigLen < 0) {
+        fprintf(stderr, "Client: server offers no delta signature, sending the whole file\n");
+        return 1;
+    }
+    if (size > 0) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (map == MAP_FAILED) {
+            perror("Client: mmap");
+            free(sig);
+            return -1;
+        }
+    }
+
+    memset(&bp, 0, sizeof(bp));
+    bp.us = us;
+    rc = deltaEncode(sig, (unsigned long)sigLen, map, size, deltaEmit, &bp, &ds);
+    /* angebrochenes letztes Paket */
+    if (rc == 0 && bp.app.len > 0) rc = unitPut(us, &bp.app);
+    if (rc == 0)
+        printf("Client: delta: %lu bytes literal, %lu bytes copied on the server\n",
+               ds.literal, ds.copied);
+
+    if (map) munmap(map, size);
+    free(sig);
+    return rc < 0 ? -1 : 0;
+}
+
+/* ==========================================
+ * Dedup-Modus: nur Chunks, die dem Chunk-Store des Servers fehlen
+ * ========================================== */
+
+static int casEmitUnit(void *user, const void *buf, unsigned long len)
+{
+    return batchPut(user, buf, len);
+}
+
+/* Datei in Chunks zerlegen, den Server vor dem Hello nach ihren Hashes
+ * fragen und als Dedup-Strom senden (siehe cas.h).
+ * Rückgabewert: 0 bei Erfolg, 1 = Server ohne Chunk-Store (Datei
+ * vollständig senden), <0 bei Fehler.
+ */
+static int sendDedup(FILE *fp, unsigned long size, struct unit_sender *us)
+{
+    struct batch_packer bp;
+    struct cas_chunk *chunks = NULL;
+    struct cas_stats cs;
+    struct app_unit *q = NULL, *ans = NULL;
+    unsigned char *missing = NULL;
+    unsigned long nq, i;
+    void *map;
+    long n;
+    int rc = -1;
+
+    if (size == 0) return 1;
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (map == MAP_FAILED) {
+        perror("Client: mmap");
+        return -1;
+    }
+    n = casChunk(map, size, &chunks);
+    if (n <= 0) goto out;
+
+    /* Hashes lückenlos zu je CAS_QUERY_MAX in eine Anfrage */
+    nq = ((unsigned long)n + CAS_QUERY_MAX - 1) / CAS_QUERY_MAX;
+    q = malloc(nq * sizeof(*q));
+    ans = malloc(nq * sizeof(*ans));
+    missing = calloc(((unsigned long)n + 7) / 8, 1);
+    if (q == NULL || ans == NULL || missing == NULL) goto out;
+    for (i = 0; i < (unsigned long)n; i++) {
+        struct app_unit *u = &q[i / CAS_QUERY_MAX];
+        unsigned long j = i % CAS_QUERY_MAX;
+        memcpy(u->data + j * CAS_HASH_LEN, chunks[i].hash, CAS_HASH_LEN);
+        u->len = (j + 1) * CAS_HASH_LEN;
+    }
+    if (arqQuery(q, ans, nq) != 0) {
+        fprintf(stderr, "Client: server keeps no chunk store, sending the whole file\n");
+        rc = 1;
+        goto out;
+    }
+    for (i = 0; i < (unsigned long)n; i++) {
+        const struct app_unit *a = &ans[i / CAS_QUERY_MAX];
+        unsigned long j = i % CAS_QUERY_MAX;
+        if (a->len < (q[i / CAS_QUERY_MAX].len / CAS_HASH_LEN + 7) / 8) {
+            fprintf(stderr, "Client: dedup: short answer from the server\n");
+            goto out;
+        }
+        if ((a->data[j / 8] >> (j % 8)) & 1) missing[i / 8] |= (unsigned char)(1 << (i % 8));
+    }
+
+    memset(&bp, 0, sizeof(bp));
+    bp.us = us;
+    rc = casEncode(map, size, chunks, (unsigned long)n, missing, casEmitUnit, &bp, &cs);
+    /* angebrochenes letztes Paket */
+    if (rc == 0 && bp.app.len > 0) rc = unitPut(us, &bp.app);
+    if (rc == 0)
+        printf("Client: dedup: %ld chunks, %lu bytes sent, %lu bytes already on the server\n",
+               n, cs.sent, cs.reused);
+
+out:
+    munmap(map, size);
+    free(chunks);
+    free(q);
+    free(ans);
+    free(missing);
+    return rc < 0 ? -1 : rc;
+}
+
+/* ==========================================
+ * Datei zeilenweise senden, gelesen wird vorab in einem eigenen Thread
+ * ========================================== */
+
+/* Der Lese-Thread (readahead.h) hält den Ring gefüllt, der Sender
+ * wartet nur bei leerem Ring und führt dabei das Protokoll weiter.
+ * Ohne Thread wird wie bisher direkt mit fgets gelesen.
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+static int sendLines(FILE *fp, struct unit_sender *us)
+{
+    struct read_ahead *ra = raStart(fileno(fp));
+    const struct app_unit *unit;
+    struct app_unit app;
+    int rc = 0;
+
+    if (ra == NULL) {
+        while (rc == 0 && fgets(app.data, BufferSize, fp)) {
+            app.len = strlen(app.data);
+            rc = unitPut(us, &app);
+        }
+        return rc;
+    }
+    while (rc == 0) {
+        int r = raNext(ra, &unit, us->idleMs);
+        if (r == RA_EOF) break;
+        if (r == RA_IDLE) {
+            rc = unitIdle(us);
+        } else if (r == RA_UNIT) {
+            rc = unitPut(us, unit);
+        } else {
+            fprintf(stderr, "Client: read error\n");
+            rc = -1;
+        }
+    }
+    raStop(ra);
+    return rc;
+}
+
+/* ==========================================
+ * Sparse-Modus für eine Datei in einer Sitzung
+ * ========================================== */
+
+static int unitData(void *user, const struct app_unit *app)
+{
+    return unitPut(user, app);
+}
+
+static int unitHoleOut(void *user, unsigned long len)
+{
+    return unitHole(user, len);
+}
+
+static int sendSparse(int fd, unsigned long size, struct unit_sender *us)
+{
+    struct sparse_out so;
+
+    memset(&so, 0, sizeof(so));
+    so.data = unitData;
+    so.hole = unitHoleOut;
+    so.user = us;
+    if (sparseScan(fd, 0, size, &so) != 0) return -1;
+    printf("Client: sparse: %lu bytes data, %lu bytes as holes\n", so.dataBytes, so.holeBytes);
+    return 0;
+}
+
 /* ==========================================
  * Schritt 2: Kommandozeilen-Argumente verarbeiten
  * ========================================== */
@@ -32,6 +885,26 @@ int main(int argc, char *argv[])
     const char *filename = NULL;
     const char *port = DEFAULT_PORT;
     const char *windowSize = "1";
+    int stripes = 1;
+    int streamMode = 0;
+    int batchMode = 0;
+    int deltaMode = 0;
+    int dedupMode = 0;
+    int sparseMode = 0;
+    unsigned int mcastRx = 0;
+    unsigned long paceRate = 0;
+    int useUring = 0;
+    unsigned long busyPollUs = 0;
+    unsigned long coalesceMs = 0;
+    unsigned long lifetimeMs = 0;
+    unsigned int maxRetx = 0;
+    const char *traceFile = NULL;
+    int cpu = -1;
+    int timestamps = 0;
+    int secure = 0;
+    const char *keyFile = NULL;
+    unsigned char psk[AEAD_KEY_LEN];
+    struct stat st;
 
     FILE *fp = NULL;
     long i;
@@ -54,7 +927,7 @@ int main(int argc, char *argv[])
                         }
                         usage(argv[0]);
                     case 'f': /* Eingabedatei */
-                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        if (argv[i + 1] && (argv[i + 1][0] != '-' || argv[i + 1][1] == 0)) {
                             filename = argv[++i];
                             break;
                         }
@@ -65,6 +938,84 @@ int main(int argc, char *argv[])
                             break;
                         }
                         usage(argv[0]);
+                    case 'r': /* Pacing-Rate */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            i++;
+                            paceRate = (strcmp(argv[i], "auto") == 0)
+                                           ? ARQ_PACE_AUTO
+                                           : strtoul(argv[i], NULL, 10);
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 's': /* Anzahl Stripes */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            stripes = atoi(argv[++i]);
+                            if (stripes >= 1 && stripes <= GBN_MAX_STRIPES) break;
+                        }
+                        usage(argv[0]);
+                    case 'u': /* io_uring */
+                        useUring = 1;
+                        break;
+                    case 'b': /* Busy-Poll */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            busyPollUs = strtoul(argv[++i], NULL, 10);
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 'c': /* CPU-Pinning */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            cpu = atoi(argv[++i]);
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 't': /* Latenz-Histogramme */
+                        timestamps = 1;
+                        break;
+                    case 'e': /* Verschlüsselung */
+                        secure = 1;
+                        break;
+                    case 'k': /* Schlüsseldatei */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            keyFile = argv[++i];
+                            secure = 1;
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 'd': /* Delta */
+                        deltaMode = 1;
+                        break;
+                    case 'g': /* Dedup */
+                        dedupMode = 1;
+                        break;
+                    case 'z': /* Sparse */
+                        sparseMode = 1;
+                        break;
+                    case 'n': /* Coalescing */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            coalesceMs = strtoul(argv[++i], NULL, 10);
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 'l': /* Nachrichtenmodus */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            char *end;
+                            lifetimeMs = strtoul(argv[++i], &end, 10);
+                            if (*end == ',') maxRetx = (unsigned int)strtoul(end + 1, &end, 10);
+                            if (*end == '\0' && (lifetimeMs > 0 || maxRetx > 0)) break;
+                        }
+                        usage(argv[0]);
+                    case 'x': /* Mitschnitt */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            traceFile = argv[++i];
+                            break;
+                        }
+                        usage(argv[0]);
+                    case 'm': /* Multicast */
+                        if (argv[i + 1] && argv[i + 1][0] != '-') {
+                            mcastRx = (unsigned int)strtoul(argv[++i], NULL, 10);
+                            if (mcastRx >= 1 && mcastRx <= GBN_MC_MAX_RX) break;
+                        }
+                        usage(argv[0]);
                     default:
                         usage(argv[0]);
                 }
@@ -77,61 +1028,186 @@ int main(int argc, char *argv[])
     if (!filename) {
         usage(argv[0]);
     }
+    if (keyFile && aeadKeyFile(psk, keyFile) < 0) {
+        fprintf(stderr, "Client: cannot read key file '%s'\n", keyFile);
+        return EXIT_FAILURE;
+    }
 
 /* ==========================================
  * Schritt 3: Datei öffnen und Fehlerbehandlung
  * ========================================== */
 
-    fp = fopen(filename, "r");
+    if (strcmp(filename, "-") == 0) {
+        fp = stdin;
+    } else {
+        fp = fopen(filename, "r");
+    }
     if (!fp) {
         perror("File opening failed");
         return EXIT_FAILURE;
     }
-    printf("Client: sending file '%s'\n", filename);
+    if (fstat(fileno(fp), &st) != 0) {
+        perror("fstat");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    /* Verzeichnis: Batch; keine reguläre Datei (stdin, Pipe, FIFO): streamen */
+    batchMode  = S_ISDIR(st.st_mode);
+    streamMode = !batchMode && !S_ISREG(st.st_mode);
+    printf("Client: sending %s '%s'\n",
+           batchMode ? "directory" : streamMode ? "stream" : "file", filename);
+    if (deltaMode && (batchMode || streamMode || stripes > 1)) {
+        fprintf(stderr, "Client: delta mode needs a regular file without striping.\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    if (dedupMode && (batchMode || streamMode || deltaMode || sparseMode || mcastRx || stripes > 1)) {
+        fprintf(stderr, "Client: dedup mode needs a regular file without delta, sparse, multicast and striping.\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    if (sparseMode && (batchMode || streamMode || deltaMode || mcastRx)) {
+        fprintf(stderr, "Client: sparse mode needs a regular file without delta and multicast.\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    if (mcastRx && (deltaMode || secure || stripes > 1)) {
+        fprintf(stderr, "Client: multicast works without delta, encryption and striping.\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    if ((lifetimeMs || maxRetx) &&
+        (batchMode || deltaMode || dedupMode || sparseMode || mcastRx || stripes > 1)) {
+        fprintf(stderr, "Client: message mode needs plain lines (no batch, delta, dedup, sparse, multicast, striping).\n");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    if (stripes > 1) {
+        fclose(fp);
+        if (streamMode || batchMode) {
+            fprintf(stderr, "Client: striping needs a regular file.\n");
+            return EXIT_FAILURE;
+        }
+        printf("Client: striping over %d flows\n", stripes);
+        struct stripe_job proto;
+        memset(&proto, 0, sizeof(proto));
+        proto.server     = server;
+        proto.port       = port;
+        proto.filename   = filename;
+        proto.winSize    = atoi(windowSize);
+        proto.paceRate   = paceRate;
+        proto.useUring   = useUring;
+        proto.busyPollUs = busyPollUs;
+        proto.cpu        = cpu;
+        proto.timestamps = timestamps;
+        proto.secure     = secure;
+        proto.psk        = keyFile ? psk : NULL;
+        proto.sparse     = sparseMode;
+        proto.trace      = traceFile;
+        if (sendStriped(&proto, stripes, (unsigned long)st.st_size) != 0) {
+            fprintf(stderr, "Client: striped transfer failed.\n");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
 
 /* ==========================================
- * Schritt 4: ARQ-Client initialisieren und Hello-Nachricht senden
+ * Schritt 4: ARQ-Client initialisieren (das Hello reist mit der
+ * ersten app_unit, siehe struct unit_sender)
  * ========================================== */
 
     initClient((char *)server, port);
-
-    if (arqSendHello(atoi(windowSize)) != 0) {
-        fprintf(stderr, "Client: Hello failed, aborting.\n");
+    arqSetPacing(paceRate);
+    arqSetCoalesce(coalesceMs);
+    arqSetPartial(lifetimeMs, maxRetx);
+    if (traceFile && arqSetTrace(traceFile) != 0) {
+        fprintf(stderr, "Client: cannot write trace '%s'\n", traceFile);
         fclose(fp);
         closeClient();
         return EXIT_FAILURE;
     }
+    if (useUring && arqSetUring(1) != 0) {
+        fprintf(stderr, "Client: io_uring not available, using sockets\n");
+    }
+    arqSetBusyPoll(busyPollUs);
+    if (timestamps && arqSetTimestamps(1) > 0) {
+        fprintf(stderr, "Client: no kernel timestamps, measuring in user space\n");
+    }
+    if (secure && arqSetSecure(1, keyFile ? psk : NULL) != 0) {
+        fclose(fp);
+        closeClient();
+        return EXIT_FAILURE;
+    }
+    if (mcastRx && arqSetMulticast(mcastRx) != 0) {
+        fprintf(stderr, "Client: '%s' is not a multicast group\n", server ? server : "");
+        fclose(fp);
+        closeClient();
+        return EXIT_FAILURE;
+    }
+    if (cpu >= 0 && pinCpu(cpu) < 0) {
+        closeClient();
+        return EXIT_FAILURE;
+    }
+
+    struct unit_sender us;
+    memset(&us, 0, sizeof(us));
+    us.winSize = atoi(windowSize);
+    us.idleMs  = (coalesceMs > 0 && coalesceMs < GBN_TIMEOUT_INT_MS) ? (int)coalesceMs
+                                                                      : GBN_TIMEOUT_INT_MS;
+    us.lifetimeMs = lifetimeMs;
+    us.maxRetx    = maxRetx;
 
 /* ==========================================
- * Schritt 5: Datei Zeile für Zeile senden
+ * Schritt 5: Datei Zeile für Zeile senden (Pipe: blockweise, Batch: Records, Delta: Kopien und Literale,
+ * Sparse: Blöcke und Löcher, Dedup: neue Chunks und Verweise)
  * ========================================== */
 
-    struct app_unit app;
-    while (fgets(app.data, BufferSize, fp)) {
-        app.len = strlen(app.data);
-
-        if (arqSendData(&app, atoi(windowSize)) != 0) {
-            fprintf(stderr, "Client: Data send failed, aborting.\n");
-            fclose(fp);
-            closeClient();
-            return EXIT_FAILURE;
-        }
+    int rc = 0;
+    if (batchMode) {
+        rc = sendBatch(filename, &us);
+    } else if (streamMode) {
+        rc = sendStream(fileno(fp), &us, lifetimeMs || maxRetx);
+    } else if (sparseMode) {
+        rc = sendSparse(fileno(fp), (unsigned long)st.st_size, &us);
+    } else {
+        if (deltaMode) rc = sendDelta(fp, (unsigned long)st.st_size, &us);
+        else if (dedupMode) rc = sendDedup(fp, (unsigned long)st.st_size, &us);
+        if ((!deltaMode && !dedupMode) || rc > 0)
+            rc = sendLines(fp, &us);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "Client: Data send failed, aborting.\n");
+        fclose(fp);
+        closeClient();
+        return EXIT_FAILURE;
     }
 
 /* ==========================================
- * Schritt 6: Verbindung schließen
+ * Schritt 6: Verbindung schließen (FIN auf der letzten app_unit)
  * ========================================== */
 
-    if (arqSendClose(atoi(windowSize)) != 0) {
+    /* Daten sind erst mit dem Abschluss bestätigt (bzw. gesichert):
+     * ein Fehler hier heißt Datenverlust, auch für eine Pipeline */
+    int closeFailed = 0;
+    if (unitFinish(&us) != 0) {
         fprintf(stderr, "Client: error while sending close.\n");
+        closeFailed = 1;
     }
+    if (us.expired)
+        printf("Client: %lu messages expired before sending\n", us.expired);
 
     fclose(fp);
+    if (timestamps) arqReport(stdout);
     closeClient();
 
 /* ==========================================
  * Schritt 7: Rückgabewert
  * ========================================== */
 
-    return EXIT_SUCCESS;
+    return closeFailed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
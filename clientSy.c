@@ -1,421 +1,2643 @@
-#include <stdio.h>
-#include <string.h>
-#include <errno.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <sys/time.h>
-#include <sys/select.h>
-
-#include "data.h"
-#include "config.h"
-#include "clientSy.h"
-
-/* ============================================================
- * Globale Zustände (UDP + GBN)
- * ============================================================ */
-
-static int gSock = -1;
-
-static struct sockaddr_storage gServerAddr;
-static socklen_t gServerAddrLen = 0;
-
-/* GBN Sendefenster */
-static unsigned long gBase = 0;        /* kleinste unbestätigte Seq */
-static unsigned long gNext = 0;        /* nächste neue Seq (zu vergeben) */
-static int           gCount = 0;       /* # unbestätigte Pakete im Fenster */
-
-static struct request gBuf[GBN_BUFFER_SIZE];   /* Ringpuffer für Requests */
-static unsigned long  gLastSendTick[GBN_BUFFER_SIZE]; /* "Zeit" der letzten Sendung je Paket */
-
-/* "Zeit" in Intervallen (jedes doRequest = 1 Intervall) */
-static unsigned long gTick = 0;
-
-/* Retransmit-Mode: Go-Back-N resend ab base bis next-1 (1 Paket pro Intervall) */
-static int           gRetransmitActive = 0;
-static unsigned long gRetransmitPos    = 0;
-
-/* statischer Antwortpuffer */
-static struct answer gLastAnswer;
-
-/* ============================================================
- * Hilfsfunktionen
- * ============================================================ */
-
-static int set_nonblocking(int fd)
-{
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags < 0) return -1;
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return -1;
-    return 0;
-}
-
-static int send_request(const struct request *req)
-{
-    ssize_t n = sendto(gSock,
-                       req,
-                       sizeof(*req),
-                       0,
-                       (const struct sockaddr *)&gServerAddr,
-                       gServerAddrLen);
-    if (n < 0) return -1;
-    if ((size_t)n != sizeof(*req)) return -1;
-    return 0;
-}
-
-static struct answer *recv_answer_if_any(void)
-{
-    struct sockaddr_storage src;
-    socklen_t srclen = sizeof(src);
-
-    ssize_t n = recvfrom(gSock, &gLastAnswer, sizeof(gLastAnswer), 0,
-                         (struct sockaddr *)&src, &srclen);
-    if (n < 0) {
-        if (errno == EWOULDBLOCK || errno == EAGAIN) return NULL;
-        return NULL;
-    }
-    if ((size_t)n < sizeof(gLastAnswer)) {
-        return NULL;
-    }
-    return &gLastAnswer;
-}
-
-/* Fenster nach kumulativem ACK verschieben:
- * ACK bedeutet: alle SeNr < ackNo sind korrekt angekommen.
- */
-static void slide_window(unsigned long ackNo)
-{
-    while (gCount > 0 && gBase < ackNo) {
-        int idx = (int)(gBase % GBN_BUFFER_SIZE);
-        /* Slot "freigeben" ist implizit – wir überschreiben später */
-        gLastSendTick[idx] = 0;
-        gBase++;
-        gCount--;
-    }
-
-    /* Wenn Retransmit lief und base nach vorn ging: ggf. abbrechen */
-    if (gRetransmitActive && gBase >= gNext) {
-        gRetransmitActive = 0;
-    }
-    if (gRetransmitActive && gRetransmitPos < gBase) {
-        gRetransmitPos = gBase;
-    }
-}
-
-/* ============================================================
- * init / close
- * ============================================================ */
-
-void initClient(char *name, const char *port)
-{
-    struct addrinfo hints;
-    struct addrinfo *res = NULL;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family   = PF_INET6;     /* i.d.R. PF_INET6 */
-    hints.ai_socktype = SOCK_DGRAM;   /* UDP */
-    hints.ai_protocol = 0;
-
-    const char *host = name;
-    if (host == NULL) host = DEFAULT_LOOPBACK_HOST;
-
-    int rc = getaddrinfo(host, port, &hints, &res);
-    if (rc != 0 || !res) {
-        fprintf(stderr, "initClient: getaddrinfo failed: %s\n", gai_strerror(rc));
-        exit(EXIT_FAILURE);
-    }
-
-    gSock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (gSock < 0) {
-        perror("initClient: socket");
-        freeaddrinfo(res);
-        exit(EXIT_FAILURE);
-    }
-
-    if (set_nonblocking(gSock) < 0) {
-        perror("initClient: fcntl(O_NONBLOCK)");
-        freeaddrinfo(res);
-        close(gSock);
-        gSock = -1;
-        exit(EXIT_FAILURE);
-    }
-
-    memset(&gServerAddr, 0, sizeof(gServerAddr));
-    memcpy(&gServerAddr, res->ai_addr, res->ai_addrlen);
-    gServerAddrLen = (socklen_t)res->ai_addrlen;
-
-    freeaddrinfo(res);
-
-    /* GBN State reset */
-    gBase = 0;
-    gNext = 0;
-    gCount = 0;
-    gTick = 0;
-    gRetransmitActive = 0;
-    gRetransmitPos = 0;
-    memset(gLastSendTick, 0, sizeof(gLastSendTick));
-    memset(gBuf, 0, sizeof(gBuf));
-}
-
-void closeClient(void)
-{
-    if (gSock >= 0) {
-        close(gSock);
-        gSock = -1;
-    }
-    gServerAddrLen = 0;
-
-    gBase = 0;
-    gNext = 0;
-    gCount = 0;
-    gTick = 0;
-    gRetransmitActive = 0;
-    gRetransmitPos = 0;
-    memset(gLastSendTick, 0, sizeof(gLastSendTick));
-    memset(gBuf, 0, sizeof(gBuf));
-}
-
-/* ============================================================
- * doRequest: 1 Intervall (max 1 Send) + Empfang/ACK Auswertung
- * ============================================================ */
-
-#include <sys/time.h>
-#include <unistd.h>
-
-static struct answer *doRequest(struct request *req, int winSize, int *windowFull, int *retransmission)
-{
-    // Zeitmessung für den Zeitschlitz starten
-    struct timeval start, end;
-    gettimeofday(&start, NULL);
-
-    if (windowFull) *windowFull = 0;
-    if (retransmission) *retransmission = 0;
-
-    if (winSize < 1) winSize = 1;
-    if (winSize > GBN_MAX_WINDOW) winSize = GBN_MAX_WINDOW;
-
-    /* Intervall-Tick erhöhen */
-    gTick++;
-
-    /* 1) Timeout prüfen -> Retransmit-Flag setzen, falls das älteste Paket zu alt ist */
-    if (gCount > 0) {
-        int baseIdx = (int)(gBase % GBN_BUFFER_SIZE);
-        unsigned long last = gLastSendTick[baseIdx];
-        if (last > 0 && (gTick - last) >= (unsigned long)GBN_TIMEOUT_UNITS) {
-            gRetransmitActive = 1;
-            gRetransmitPos = gBase; // Go-Back-N startet bei gBase
-            if (retransmission) *retransmission = 1;
-        }
-    }
-
-    /* 2) Sende-Entscheidung: MAXIMAL EIN Paket pro Zeitschlitz versenden */
-    if (gRetransmitActive && gCount > 0) {
-        /* Wiederholte Übertragung hat laut Aufgabenstellung VORRANG */
-        if (gRetransmitPos < gNext) {
-            int idx = (int)(gRetransmitPos % GBN_BUFFER_SIZE);
-            if (send_request(&gBuf[idx]) == 0) {
-                gLastSendTick[idx] = gTick;
-            }
-            gRetransmitPos++;
-            // Wenn alle unquittierten Pakete einmal neu gesendet wurden, Retransmit beenden
-            if (gRetransmitPos >= gNext) {
-                gRetransmitActive = 0;
-            }
-        } else {
-            gRetransmitActive = 0;
-        }
-    }
-    else if (req != NULL) {
-        /* Falls kein Retransmit ansteht: Neues Paket senden, wenn Fenster Platz hat */
-        if (gCount >= winSize) {
-            if (windowFull) *windowFull = 1;
-        } else {
-            int idx = (int)(req->SeNr % GBN_BUFFER_SIZE);
-            gBuf[idx] = *req; // In Ringpuffer kopieren
-
-            if (send_request(&gBuf[idx]) == 0) {
-                gLastSendTick[idx] = gTick;
-            }
-            gNext++;
-            gCount++;
-        }
-    }
-
-    /* 3) Warten/Empfangen mit select() */
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(gSock, &rfds);
-
-    struct timeval tv;
-    tv.tv_sec  = 0;
-    tv.tv_usec = (int)GBN_TIMEOUT_INT_MS * 1000;
-
-    struct answer *receivedAnsw = NULL;
-    int rc = select(gSock + 1, &rfds, NULL, NULL, &tv);
-    
-    if (rc > 0 && FD_ISSET(gSock, &rfds)) {
-        struct answer *a = recv_answer_if_any();
-        if (a) {
-            /* Kumulatives ACK auswerten */
-            if (a->AnswType == AnswOk || a->AnswType == AnswHello) {
-                unsigned long ackNo = a->SeNo; 
-                // Wenn das ACK im gültigen Bereich liegt, Fenster verschieben
-                if (ackNo >= gBase && ackNo <= gNext) {
-                    slide_window(ackNo);
-                }
-            }
-            receivedAnsw = a;
-        }
-    }
-
-    /* 4) Zeitschlitz-Synchronisation: Restzeit schlafen */
-    gettimeofday(&end, NULL);
-    long elapsed_usec = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
-    long interval_usec = (long)GBN_TIMEOUT_INT_MS * 1000L;
-
-    if (elapsed_usec < interval_usec) {
-        usleep(interval_usec - elapsed_usec);
-    }
-
-    return receivedAnsw;
-}
-
-/* ============================================================
- * API Wrapper (blockierend bis Erfolg/Fehler)
- * ============================================================ */
-
-int arqSendHello(int winSize)
-{
-    /* Zustand neu starten */
-    gBase = 0;
-    gNext = 0;
-    gCount = 0;
-    gTick  = 0;
-    gRetransmitActive = 0;
-    gRetransmitPos = 0;
-    memset(gLastSendTick, 0, sizeof(gLastSendTick));
-
-    struct request req;
-    memset(&req, 0, sizeof(req));
-    req.ReqType = ReqHello;
-    req.FlNr    = 0;
-    req.SeNr    = 0;
-    /* 1. Versuch: Paket absenden */
-    int wf = 0, rt = 0;
-    struct answer *a = doRequest(&req, winSize, &wf, &rt);
-    if (a && (a->AnswType == AnswHello || a->AnswType == AnswOk)) return 0;
-
-    /* Hello: so lange senden bis AnswHello/AnswOk kommt oder zu viele Versuche ()*/
-    /* Weitere Versuche: Nur noch warten (NULL übergeben) */
-    /* doRequest kümmert sich via gLastSendTick automatisch um Retransmits, 
-       wenn nach GBN_TIMEOUT_UNITS Ticks keine Antwort kam! */
-    const int maxTries = 50; /* 50 * 100ms = 5s */
-    for (int i = 0; i < maxTries; i++) {
-        a = a = doRequest(NULL, winSize, &wf, &rt); // NULL = kein neues Paket, nur warten/retransmit
-        /*
-        int wf = 0, rt = 0;
-        struct answer *a = doRequest(&req, winSize, &wf, &rt);
-        (void)wf; (void)rt;
-        */
-        if (a) {
-            if (a->AnswType == AnswHello || a->AnswType == AnswOk) {
-                return 0;
-            }
-            if (a->AnswType == AnswErr) {
-                return -1;
-            }
-        }
-        
-        /* wenn keine Antwort: nächste Runde -> erneutes Hello (ggf. Retransmit-Mechanismus greift) */
-    }
-    return -1;
-}
-
-int arqSendData(const struct app_unit *app, int winSize)
-{
-    if (!app) return -1;
-
-    /* Request vorbereiten */
-    struct request req;
-    memset(&req, 0, sizeof(req));
-    req.ReqType = ReqData;
-
-    unsigned long len = app->len;
-    if (len > (unsigned long)BufferSize) len = (unsigned long)BufferSize;
-
-    req.FlNr = len;
-    req.SeNr = gNext; /* nächste Sequenznummer */
-    memcpy(req.name, app->data, len);
-
-    unsigned long mySeq = req.SeNr;
-
-    /* blockierend, bis unser Paket bestätigt wurde */
-    const int maxLoops = 20000; /* Sicherheitslimit */
-    for (int i = 0; i < maxLoops; i++) {
-        int wf = 0, rt = 0;
-
-        /* Nur beim ersten Mal "req" als neues Paket anbieten.
-           Danach req=NULL, damit doRequest nicht wieder ein neues Paket einreiht. */
-        struct request *toSend = (i == 0) ? &req : NULL;
-
-        struct answer *a = doRequest(toSend, winSize, &wf, &rt);
-
-        /* Falls Fenster voll wäre (kommt bei sequenzieller Nutzung selten): weiter iterieren */
-        if (wf) continue;
-
-        if (a) {
-            if (a->AnswType == AnswErr) {
-                return -1;
-            }
-            if (a->AnswType == AnswOk) {
-                /* Unser Paket ist geliefert, wenn ackNo >= mySeq+1 */
-                if (a->SeNo >= (mySeq + 1)) {
-                    return 0;
-                }
-            }
-            /* Warn behandeln wir wie "weiter versuchen" */
-        }
-
-        /* keine Antwort -> Schleife läuft weiter, Timeouts triggern Retransmits */
-    }
-
-    return -1;
-}
-
-int arqSendClose(int winSize)
-{
-    struct request req;
-    memset(&req, 0, sizeof(req));
-    req.ReqType = ReqClose;
-    req.FlNr    = 0;
-    req.SeNr    = gNext; /* Close bekommt auch eine Seq */
-
-    unsigned long mySeq = req.SeNr;
-
-    const int maxLoops = 20000;
-    for (int i = 0; i < maxLoops; i++) {
-        int wf = 0, rt = 0;
-
-        struct request *toSend = (i == 0) ? &req : NULL;
-        struct answer *a = doRequest(toSend, winSize, &wf, &rt);
-
-        if (wf) continue;
-
-        if (a) {
-            if (a->AnswType == AnswErr) return -1;
-
-            if (a->AnswType == AnswOk || a->AnswType == AnswHello) {
-                if (a->SeNo >= mySeq ) {
-                    printf("Client: Verbindung erfolgreich geschlossen.\n");
-                    return 0;
-                }
-            }
-            if (a->AnswType == AnswErr) return -1;
-        }
-    }
-    printf("Client: Close-Timeout, beende trotzdem (Daten waren bereits OK).\n");
-    return 0;
-}
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <pthread.h>
+
+#include "data.h"
+#include "config.h"
+#include "clientSy.h"
+#include "trace.h"
+#include "pacer.h"
+#include "arqio.h"
+#include "uring.h"
+#include "hdr.h"
+#include "aead.h"
+
+/* Zeitkonstanten in Nanosekunden (siehe data.h) */
+#define SLOT_NS    ((unsigned long long)GBN_TIMEOUT_INT_MS * 1000000ULL)
+#define RTO_NS     (GBN_TIMEOUT_UNITS * SLOT_NS)   /* Default, siehe arqClientSetRto */
+#define HELLO_NS   (GBN_HELLO_UNITS * SLOT_NS)
+#define GIVEUP_NS  (GBN_GIVEUP_UNITS * SLOT_NS)
+#define PERSIST_NS (GBN_PERSIST_UNITS * SLOT_NS)
+#define KEEPALIVE_NS (GBN_KEEPALIVE_UNITS * SLOT_NS)
+
+/* io_uring-Betrieb (arqClientSetUring) */
+#define URING_ENTRIES     64
+#define URING_RX_BUFS     64             /* Zweierpotenz */
+#define URING_TX_SLOTS    (2 * GBN_BUFFER_SIZE)
+
+enum { UD_RECV = 1, UD_SEND };
+
+/* größte Antwort auf dem Draht (verschlüsselt, mit Umschlag) */
+#define ANSW_PACKET_MAX   (sizeof(struct answer_data) + SEC_OVERHEAD)
+
+/* Abruf vor dem Hello (arqClientFetchSig) */
+#define SIG_WINDOW        8              /* ReqSig gleichzeitig unterwegs */
+#define SIG_MAX_LEN       (64UL << 20)   /* größte angenommene Gesamtlänge */
+
+/* Multicast-Sender (arqClientSetMulticast) */
+#define MC_RATE           (4UL << 20)    /* Default-Rate ohne Pacing-Vorgabe */
+#define MC_REPAIR_NS      ((unsigned long long)GBN_MC_NAK_MS * 1000000ULL / 2)
+#define MC_REPAIR_MAX     64             /* Wiederholungen je NAK     */
+
+/* Latenzmessung (arqClientSetTimestamps) */
+#define LAT_TX_RING       256            /* Kernel-Sendezeiten je OPT_ID */
+
+/* Speicherbedarf eines Datagramms im Socket-Puffer (Nutzdaten +
+ * sk_buff-Overhead, wie ARQ_RX_TRUESIZE im Server) */
+#define SOCK_TRUESIZE(len) (5 * (len) / 2)
+
+/* Kontrollnachrichten beim Empfang (Zeitstempel, Verwerfungszähler) */
+#define RX_CTRL_LEN       (CMSG_SPACE(sizeof(struct scm_timestamping)) + \
+                           CMSG_SPACE(sizeof(uint32_t)))
+
+/* ============================================================
+ * Client-Kontext (UDP + GBN)
+ *
+ * Der gesamte Zustand eines Flows liegt in struct arq_client; es gibt
+ * keine versteckten globalen Variablen außer dem Standard-Kontext der
+ * klassischen API (thread-lokal, siehe unten).
+ * ============================================================ */
+
+/*
+ * io_uring-Betrieb: ein Multishot-RECV liegt auf dem Socket, Antworten
+ * landen ohne Systemaufruf in rxQueue. Requests werden als SENDMSG
+ * eingetragen und erst beim nächsten Warten zusammen mit dem Warten
+ * selbst in einem io_uring_enter() übergeben.
+ */
+struct client_uring {
+    struct uring  ring;
+    int           rxArmed;
+    struct {
+        unsigned char  data[ANSW_PACKET_MAX];
+        unsigned short len;
+    } rxQueue[URING_RX_BUFS];
+    unsigned int  rxHead, rxLen;
+    struct {
+        unsigned char  pkt[SEC_MAX_PACKET];
+        struct msghdr  msg;
+        struct iovec   iov;
+    } tx[URING_TX_SLOTS];
+    unsigned short txFree[URING_TX_SLOTS];
+    unsigned int   txFreeN;
+};
+
+/*
+ * Latenzmessung: je Karn-Probe (nicht wiederholtes Paket) RTT,
+ * Servicezeit des Servers (ANSW_F_SVC) und die lokale Wartezeit im
+ * Client. Mit SO_TIMESTAMPING (nur Socket-Betrieb) zählt die RTT von
+ * Kernel-Sendung bis Kernel-Empfang; die Differenz zur Zeit im
+ * Userspace (Sendeweg bis zum Treiber, Empfangspuffer bis zur
+ * Auswertung) ist die Wartezeit. Sendezeitstempel kommen über die
+ * Fehlerqueue, zugeordnet über den OPT_ID-Zähler des Sockets.
+ */
+struct client_lat {
+    int                kernel;                   /* SO_TIMESTAMPING aktiv  */
+    unsigned int       txKey;                    /* OPT_ID der nächsten Sendung */
+    unsigned int       txId[GBN_BUFFER_SIZE];    /* OPT_ID je Fenster-Slot */
+    unsigned int       txKernId[LAT_TX_RING];
+    unsigned long long txKernNs[LAT_TX_RING];    /* CLOCK_REALTIME, 0 = fehlt */
+    unsigned long long txUserNs[LAT_TX_RING];
+    unsigned long long rxKernNs, rxUserNs;       /* letzte Antwort         */
+    struct hdr_hist    rtt, svc, net, queue;
+};
+
+/*
+ * Verschlüsselter Betrieb (arqClientSetSecure, Format siehe struct
+ * sec_hdr): je Hello ein neues X25519-Schlüsselpaar, bis zum AnswHello
+ * gilt der Hello-Schlüssel k0. Ein Zähler für alle Sendungen, damit
+ * keine Nonce je Schlüssel doppelt vorkommt. Unverschlüsselte oder
+ * verfälschte Antworten werden verworfen.
+ */
+struct client_sec {
+    uint8_t  psk[AEAD_KEY_LEN];
+    uint8_t  priv[AEAD_KEY_LEN], cpub[AEAD_PUB_LEN];
+    uint8_t  k0[AEAD_KEY_LEN];
+    struct aead_key c2s, s2c;          /* Verfahren aus dem AnswHello */
+    uint8_t  spub[AEAD_PUB_LEN];
+    int      keyed;                    /* Sitzungsschlüssel gültig */
+    uint64_t txCtr;
+    unsigned char pkt[SEC_MAX_PACKET]; /* Umschlag beim Senden/Empfangen */
+};
+
+/*
+ * Multicast-Sender (arqClientSetMulticast, siehe Multicast-Betrieb in
+ * data.h): jedes Paket geht einmal an die Gruppe, unabhängig von der
+ * Anzahl der Empfänger. Die letzten GBN_MC_WINDOW Pakete bleiben für
+ * Reparaturen im Ring; next - (kleinstes acked) begrenzt das Fenster.
+ * Ein Empfänger, der bei offenen Daten HELLO_NS lang schweigt, wird
+ * ausgeschlossen, damit er die übrigen nicht aufhält.
+ */
+enum { MC_RX_OPEN = 0, MC_RX_DONE, MC_RX_FAILED };
+
+struct client_mc {
+    unsigned int       expected;                 /* angekündigte Empfänger */
+    unsigned int       n;                        /* gemeldete Empfänger    */
+    struct {
+        uint64_t           id;
+        int                state;                /* MC_RX_*                */
+        int                durable;              /* DUR_* aus dem Abschluss-ACK */
+        unsigned long      acked;                /* kumulativ bestätigt    */
+        unsigned long long lastNs;               /* letzte Antwort         */
+    } rx[GBN_MC_MAX_RX];
+    unsigned long      closeSeq;                 /* SeNr des Close, 0 = offen */
+    unsigned long long probeNs;                  /* letzte ReqProbe        */
+    struct request     ring[GBN_MC_WINDOW];
+    unsigned long long repairNs[GBN_MC_WINDOW];  /* letzte Wiederholung    */
+    unsigned long      sent, repairs, naks;
+};
+
+struct arq_client {
+    int sock;
+    int timerFd;                       /* timerfd für Pacing-Deadlines */
+    struct arq_io io;                  /* Uhr und Transport (Socket oder Simulation) */
+    struct client_uring *ur;           /* io_uring-Betrieb, sonst NULL */
+    unsigned long long spinNs;         /* Busy-Poll vor dem Blockieren, 0 = aus */
+
+    struct sockaddr_storage serverAddr;
+    socklen_t serverAddrLen;
+    uint64_t  cookie;                  /* aus AnswCookie, 0 = keines */
+    struct arq_cookies *cookies;       /* gemeinsamer Cache, NULL = keiner */
+
+    /* GBN Sendefenster */
+    unsigned long base;                /* kleinste unbestätigte Seq */
+    unsigned long next;                /* nächste neue Seq (zu vergeben) */
+    int           count;               /* # unbestätigte Pakete im Fenster */
+
+    struct request     buf[GBN_BUFFER_SIZE];        /* Ringpuffer für Requests */
+    unsigned long long lastSendNs[GBN_BUFFER_SIZE]; /* Zeit der letzten Sendung je Paket */
+    unsigned char      retxFlag[GBN_BUFFER_SIZE];   /* Paket wurde wiederholt (Karn) */
+
+    /* Zeitpunkt des letzten Fortschritts (base bewegt) für den Abbruch */
+    unsigned long long lastProgressNs;
+
+    /* Zeitpunkt der letzten Sendung überhaupt (Keepalive) */
+    unsigned long long lastTxNs;
+
+    /* Geglättete RTT (0 = noch keine Messung) */
+    unsigned long long srttNs;
+    unsigned long long rtoNs;          /* Retransmit-Timeout */
+
+    /* Retransmit-Mode: Go-Back-N resend ab base bis next-1 (1 Paket pro Aufruf) */
+    int           retransmitActive;
+    unsigned long retransmitPos;
+
+    /* Flusskontrolle: vom Server angekündigtes Fenster (Pakete ab
+     * rwndBase), Persist-Timer für Zero-Window-Proben */
+    int                rwndKnown;
+    unsigned long      rwnd;
+    unsigned long      rwndBase;
+    unsigned long long persistNs;      /* aktueller Probe-Abstand */
+    unsigned long long probeAtNs;      /* 0 = Persist-Timer aus */
+
+    /* Pacing: 0 = aus (feste Zeitschlitze), sonst Rate bzw. ARQ_PACE_AUTO */
+    unsigned long paceSetting;
+    struct pacer  pacer;
+    int           winSize;
+
+    /* Coalescing (REQ_F_RECS): offenes Sammelpaket, 0 = aus */
+    unsigned long long coalDelayNs;
+    struct request     coal;
+    int                coalRecs;      /* Records in coal */
+    unsigned long long coalSinceNs;   /* Zeit des ersten Records */
+    unsigned long long coalExpireNs;  /* früheste Frist der Records */
+    unsigned int       coalMaxRetx;
+
+    /* Nachrichtenmodus (arqClientSetPartial): Frist bzw. höchstens
+     * so viele Wiederholungen je Paket, 0 = unbegrenzt. Abgelaufene
+     * Pakete gehen als REQ_F_SKIP ohne Nutzdaten. */
+    unsigned long      lifetimeMs;    /* Default je Nachricht */
+    unsigned int       maxRetx;
+    unsigned long long msgExpireNs;   /* für das nächste neue Paket */
+    unsigned int       msgMaxRetx;
+    unsigned long long expireNs[GBN_BUFFER_SIZE];
+    unsigned int       retxMax[GBN_BUFFER_SIZE];
+    unsigned int       retxCount[GBN_BUFFER_SIZE];
+    unsigned long      abandoned;     /* aufgegebene Pakete */
+
+    /* Antwortpuffer (lastAnswer ggf. mit Nutzdaten, siehe AnswSig) */
+    struct answer_data lastAnswer;
+    unsigned long      lastDataLen;
+    struct answer retAnswer;
+
+    int           quiet;           /* keine Statusmeldungen (CreateIo) */
+    int           durable;         /* DUR_* aus dem Abschluss-ACK, -1 = keine Angabe */
+
+    struct client_lat *lat;        /* Latenzmessung, sonst NULL */
+    struct client_sec *sec;        /* verschlüsselter Betrieb, sonst NULL */
+    struct client_mc  *mc;         /* Multicast-Sender, sonst NULL */
+    struct arq_trace  *trace;      /* Mitschnitt, sonst NULL */
+
+    int           rxqOvfl;         /* SO_RXQ_OVFL aktiv */
+    unsigned long kernelDrops;     /* vom Kernel verworfene Antworten (seit Start) */
+};
+
+/* Standard-Kontext der klassischen API (initClient ... closeClient) */
+static __thread struct arq_client *gDefault = NULL;
+
+/* ============================================================
+ * Hilfsfunktionen
+ * ============================================================ */
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return -1;
+    return 0;
+}
+
+/* Socket-Puffer opt auf mindestens bytes vergrößern (nie verkleinern);
+ * forceOpt (mit CAP_NET_ADMIN) über net.core.[rw]mem_max hinaus. Der
+ * Kernel verdoppelt den Wert und meldet die verdoppelte Größe. */
+static void sock_size_buf(int fd, int opt, int forceOpt, unsigned long bytes)
+{
+    int cur = 0, val;
+    socklen_t len = sizeof(cur);
+
+    if (getsockopt(fd, SOL_SOCKET, opt, &cur, &len) < 0 || (unsigned long)cur >= bytes)
+        return;
+    val = (bytes / 2 > INT_MAX) ? INT_MAX : (int)(bytes / 2);
+    if (setsockopt(fd, SOL_SOCKET, forceOpt, &val, sizeof(val)) < 0)
+        (void)setsockopt(fd, SOL_SOCKET, opt, &val, sizeof(val));
+}
+
+/* Socket-Puffer für ein volles Fenster (vor dem Hello): window
+ * Requests unterwegs, bis zu window Antworten je Empfänger. Sonst
+ * verwirft der Kernel bei Bursts lokal (sendto: EAGAIN bzw. voller
+ * Empfangspuffer), und der Sender wiederholt wie bei Netzverlust. */
+static void size_buffers(struct arq_client *c, unsigned long window, unsigned long receivers)
+{
+    unsigned long pkt = (c->sec != NULL) ? SEC_MAX_PACKET : sizeof(struct request);
+
+    if (c->sock < 0) return;
+    sock_size_buf(c->sock, SO_SNDBUF, SO_SNDBUFFORCE, window * SOCK_TRUESIZE(pkt));
+    sock_size_buf(c->sock, SO_RCVBUF, SO_RCVBUFFORCE,
+                  window * receivers * SOCK_TRUESIZE(ANSW_PACKET_MAX));
+}
+
+/* Kontrollnachricht SO_RXQ_OVFL (kommt nur, wenn der Zähler nicht 0 ist) */
+static void cmsg_drops(struct arq_client *c, struct msghdr *msg)
+{
+    struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+            c->kernelDrops = drops;
+        }
+    }
+}
+
+/* ------------------------------------------------------------
+ * Standard-Hooks (struct arq_io): UDP-Socket und CLOCK_MONOTONIC
+ * ------------------------------------------------------------ */
+
+static unsigned long long sys_now(void *user)
+{
+    (void)user;
+    return pacerNowNs();
+}
+
+static int sys_send(void *user, const void *buf, unsigned long len,
+                    const struct sockaddr_storage *to, socklen_t toLen)
+{
+    struct arq_client *c = user;
+    (void)to;
+    (void)toLen;
+
+    ssize_t n = sendto(c->sock,
+                       buf,
+                       len,
+                       0,
+                       (const struct sockaddr *)&c->serverAddr,
+                       c->serverAddrLen);
+    if (n < 0) return -1;
+    if ((size_t)n != len) return -1;
+    return 0;
+}
+
+/* Kernel-Zeitstempel sind CLOCK_REALTIME */
+static unsigned long long realtime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static unsigned long long cmsg_ts_ns(const struct cmsghdr *cm)
+{
+    struct scm_timestamping ts;
+    memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+    return (unsigned long long)ts.ts[0].tv_sec * 1000000000ULL +
+           (unsigned long long)ts.ts[0].tv_nsec;
+}
+
+/* Sendezeitstempel aus der Fehlerqueue abholen (OPT_TSONLY: ohne
+ * Paketinhalt, ee_data = OPT_ID der Sendung). */
+static void lat_drain_errqueue(struct arq_client *c)
+{
+    struct client_lat *l = c->lat;
+    char ctrl[CMSG_SPACE(sizeof(struct scm_timestamping)) +
+              CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    struct cmsghdr *cm;
+
+    for (;;) {
+        unsigned long long tsNs = 0;
+        unsigned int id = 0;
+        int haveId = 0;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        if (recvmsg(c->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+                tsNs = cmsg_ts_ns(cm);
+            } else if ((cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR) ||
+                       (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)) {
+                struct sock_extended_err ee;
+                memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+                if (ee.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                    id = ee.ee_data;
+                    haveId = 1;
+                }
+            }
+        }
+        if (haveId && tsNs) {
+            l->txKernId[id % LAT_TX_RING] = id;
+            l->txKernNs[id % LAT_TX_RING] = tsNs;
+        }
+    }
+}
+
+static long sys_recv(void *user, void *buf, unsigned long len)
+{
+    struct arq_client *c = user;
+    struct sockaddr_storage src;
+    socklen_t srclen = sizeof(src);
+    char ctrl[RX_CTRL_LEN];
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    ssize_t n;
+
+    if (c->lat == NULL || !c->lat->kernel) {
+        if (!c->rxqOvfl) {
+            n = recvfrom(c->sock, buf, len, 0, (struct sockaddr *)&src, &srclen);
+            if (n < 0) {
+                if (errno == EWOULDBLOCK || errno == EAGAIN) return -1;
+                return -1;
+            }
+            return (long)n;
+        }
+        /* nur der Verwerfungszähler als Kontrollnachricht */
+        iov.iov_base = buf;
+        iov.iov_len  = len;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name       = &src;
+        msg.msg_namelen    = srclen;
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        n = recvmsg(c->sock, &msg, 0);
+        if (n < 0) return -1;
+        cmsg_drops(c, &msg);
+        return (long)n;
+    }
+
+    /* mit Zeitstempeln: Kernel-Empfangszeit als Kontrollnachricht */
+    lat_drain_errqueue(c);
+    iov.iov_base = buf;
+    iov.iov_len  = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name       = &src;
+    msg.msg_namelen    = srclen;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    n = recvmsg(c->sock, &msg, 0);
+    if (n < 0) return -1;
+
+    c->lat->rxUserNs = realtime_ns();
+    c->lat->rxKernNs = 0;
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING)
+            c->lat->rxKernNs = cmsg_ts_ns(cm);
+    }
+    cmsg_drops(c, &msg);
+    return (long)n;
+}
+
+/* Busy-Poll: bis spinNs (höchstens deadlineNs) nicht blockierend auf
+ * ein Datagramm prüfen. Rückgabe: 1 = Socket lesbar. */
+static int sys_spin(struct arq_client *c, unsigned long long deadlineNs)
+{
+    unsigned long long now = pacerNowNs();
+    unsigned long long until = now + c->spinNs;
+    char peek;
+
+    if (until > deadlineNs) until = deadlineNs;
+    do {
+        if (recv(c->sock, &peek, sizeof(peek), MSG_PEEK | MSG_DONTWAIT) >= 0)
+            return 1;
+        sched_yield();  /* auf eigenem Kern sofort zurück */
+        now = pacerNowNs();
+    } while (now < until);
+    return 0;
+}
+
+/* Blockiert, bis eine Antwort anliegt oder deadlineNs erreicht ist.
+ * timerfd mit absoluter Deadline: Auflösung im Nanosekundenbereich.
+ * Mit Busy-Poll (spinNs) wird zuerst gepollt, dann blockiert.
+ * Rückgabe: 1 = Socket lesbar, 0 = Deadline erreicht.
+ */
+static int sys_wait(void *user, unsigned long long deadlineNs)
+{
+    struct arq_client *c = user;
+    struct itimerspec its;
+    struct pollfd pfd[2];
+    unsigned long long expirations;
+
+    if (c->spinNs && sys_spin(c, deadlineNs)) return 1;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = (time_t)(deadlineNs / 1000000000ULL);
+    its.it_value.tv_nsec = (long)(deadlineNs % 1000000000ULL);
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+        its.it_value.tv_nsec = 1; /* 0 würde den Timer deaktivieren */
+    timerfd_settime(c->timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+
+    pfd[0].fd = c->sock;    pfd[0].events = POLLIN; pfd[0].revents = 0;
+    pfd[1].fd = c->timerFd; pfd[1].events = POLLIN; pfd[1].revents = 0;
+
+    for (;;) {
+        while (poll(pfd, 2, -1) < 0) {
+            if (errno != EINTR) return 0;
+        }
+        /* Sendezeitstempel in der Fehlerqueue: abholen, weiter warten */
+        if ((pfd[0].revents & POLLERR) && c->lat != NULL) {
+            lat_drain_errqueue(c);
+            if (!(pfd[0].revents & POLLIN) && !(pfd[1].revents & POLLIN))
+                continue;
+        }
+        break;
+    }
+    if (pfd[1].revents & POLLIN)
+        (void)!read(c->timerFd, &expirations, sizeof(expirations));
+
+    return (pfd[0].revents & POLLIN) ? 1 : 0;
+}
+
+static void sys_sleep_until(void *user, unsigned long long deadlineNs)
+{
+    (void)user;
+    pacerSleepUntil(deadlineNs);
+}
+
+/* ------------------------------------------------------------
+ * io_uring-Hooks (struct arq_io), siehe struct client_uring
+ * ------------------------------------------------------------ */
+
+static int uring_arm_recv(struct client_uring *ur, int sock)
+{
+    struct io_uring_sqe *sqe = uringSqe(&ur->ring);
+
+    if (sqe == NULL) return -1;
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = sock;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = ur->ring.bgid;
+    sqe->user_data = UD_RECV;
+    ur->rxArmed = 1;
+    return 0;
+}
+
+/* Alle CQEs abholen (kein Systemaufruf): Antworten in die rxQueue,
+ * Sende-Slots freigeben. Rückgabewert: <0 bei Empfangsfehler des
+ * Multishot-RECV (z.B. vom Kernel nicht unterstützt). */
+static int uring_reap(struct arq_client *c)
+{
+    struct client_uring *ur = c->ur;
+    struct io_uring_cqe *cqe;
+    int rc = 0;
+
+    while ((cqe = uringPeek(&ur->ring)) != NULL) {
+        unsigned long long ud = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+
+        uringSeen(&ur->ring);
+        if (ud != UD_RECV) {
+            ur->txFree[ur->txFreeN++] = (unsigned short)(ud >> 32);
+            continue;
+        }
+        if (flags & IORING_CQE_F_BUFFER) {
+            unsigned short bid = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+            /* volle Warteschlange verwirft wie ein voller Socket-Puffer */
+            if (res > 0 && ur->rxLen < URING_RX_BUFS) {
+                unsigned int slot = (ur->rxHead + ur->rxLen) % URING_RX_BUFS;
+                unsigned int len = (res < (int)ANSW_PACKET_MAX) ? (unsigned)res : ANSW_PACKET_MAX;
+                memcpy(ur->rxQueue[slot].data, uringBuf(&ur->ring, bid), len);
+                ur->rxQueue[slot].len = (unsigned short)len;
+                ur->rxLen++;
+            }
+            uringBufPut(&ur->ring, bid);
+        } else if (res < 0 && res != -ENOBUFS && res != -EINTR) {
+            rc = -1;
+        }
+        if (!(flags & IORING_CQE_F_MORE))
+            ur->rxArmed = 0;
+    }
+    if (!ur->rxArmed && rc == 0)
+        (void)uring_arm_recv(ur, c->sock);
+    return rc;
+}
+
+static int uring_send(void *user, const void *buf, unsigned long len,
+                      const struct sockaddr_storage *to, socklen_t toLen)
+{
+    struct arq_client *c = user;
+    struct client_uring *ur = c->ur;
+    struct io_uring_sqe *sqe;
+    unsigned short idx;
+
+    (void)uring_reap(c);
+    if (ur->txFreeN == 0 || len > sizeof(ur->tx[0].pkt) ||
+        (sqe = uringSqe(&ur->ring)) == NULL)
+        return sys_send(user, buf, len, to, toLen);
+
+    idx = ur->txFree[--ur->txFreeN];
+    memcpy(ur->tx[idx].pkt, buf, len);
+    ur->tx[idx].iov.iov_base    = ur->tx[idx].pkt;
+    ur->tx[idx].iov.iov_len     = len;
+    memset(&ur->tx[idx].msg, 0, sizeof(ur->tx[idx].msg));
+    ur->tx[idx].msg.msg_name    = &c->serverAddr;
+    ur->tx[idx].msg.msg_namelen = c->serverAddrLen;
+    ur->tx[idx].msg.msg_iov     = &ur->tx[idx].iov;
+    ur->tx[idx].msg.msg_iovlen  = 1;
+
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = c->sock;
+    sqe->addr      = (unsigned long)&ur->tx[idx].msg;
+    sqe->len       = 1;
+    sqe->user_data = ((unsigned long long)idx << 32) | UD_SEND;
+    return 0;
+}
+
+static long uring_recv(void *user, void *buf, unsigned long len)
+{
+    struct arq_client *c = user;
+    struct client_uring *ur = c->ur;
+
+    (void)uring_reap(c);
+    if (ur->rxLen == 0) return -1;
+    if (len > ur->rxQueue[ur->rxHead].len) len = ur->rxQueue[ur->rxHead].len;
+    memcpy(buf, ur->rxQueue[ur->rxHead].data, len);
+    ur->rxHead = (ur->rxHead + 1) % URING_RX_BUFS;
+    ur->rxLen--;
+    return (long)len;
+}
+
+/* Gesammelte SQEs übergeben und im selben Aufruf warten. */
+static int uring_wait(void *user, unsigned long long deadlineNs)
+{
+    struct arq_client *c = user;
+    struct client_uring *ur = c->ur;
+    unsigned long long spinUntil = c->spinNs ? pacerNowNs() + c->spinNs : 0;
+
+    for (;;) {
+        unsigned long long now;
+
+        (void)uring_reap(c);
+        if (ur->rxLen > 0) {
+            (void)uringEnter(&ur->ring, 0, -1);
+            return 1;
+        }
+        now = pacerNowNs();
+        if (now >= deadlineNs) {
+            (void)uringEnter(&ur->ring, 0, -1);
+            return 0;
+        }
+        /* Busy-Poll: Abschlüsse ohne Schlafen abholen (Timeout 0) */
+        if (now < spinUntil) {
+            (void)uringEnter(&ur->ring, 1, 0);
+            sched_yield();
+            continue;
+        }
+        if (uringEnter(&ur->ring, 1, (long long)(deadlineNs - now)) < 0)
+            return 0;
+    }
+}
+
+static void uring_sleep_until(void *user, unsigned long long deadlineNs)
+{
+    struct arq_client *c = user;
+
+    (void)uringEnter(&c->ur->ring, 0, -1);
+    pacerSleepUntil(deadlineNs);
+}
+
+/* ============================================================
+ * Hilfsfunktionen (Zugriff auf Uhr/Transport nur über c->io)
+ * ============================================================ */
+
+static unsigned long long now_ns(struct arq_client *c)
+{
+    return c->io.now(c->io.user);
+}
+
+/* --- Cookies (AnswCookie, siehe GBN_COOKIE_MS) --- */
+
+/* Cookie-Cache für mehrere Kontexte (arqClientSetCookies): das Cookie
+ * hängt nur an der Adresse dieses Rechners, weitere Verbindungen zum
+ * selben Server (Stripes, spätere Transfers) sparen unter Last damit
+ * den Round Trip. Ohne Cache gilt das Cookie nur im Kontext (c->cookie). */
+#define COOKIE_CACHE  16
+
+struct arq_cookies {
+    pthread_mutex_t lock;
+    struct {
+        struct sockaddr_storage addr;
+        socklen_t               addrLen;     /* 0 = frei */
+        uint64_t                cookie;
+        unsigned long long      ns;          /* Empfang */
+    } slot[COOKIE_CACHE];
+};
+
+struct arq_cookies *arqCookiesCreate(void)
+{
+    struct arq_cookies *k = calloc(1, sizeof(*k));
+
+    if (k == NULL) return NULL;
+    if (pthread_mutex_init(&k->lock, NULL) != 0) {
+        free(k);
+        return NULL;
+    }
+    return k;
+}
+
+void arqCookiesDestroy(struct arq_cookies *k)
+{
+    if (k == NULL) return;
+    pthread_mutex_destroy(&k->lock);
+    free(k);
+}
+
+void arqClientSetCookies(struct arq_client *c, struct arq_cookies *k)
+{
+    c->cookies = k;
+}
+
+static void cookie_put(unsigned char b[GBN_COOKIE_LEN], uint64_t cookie)
+{
+    for (int i = 0; i < GBN_COOKIE_LEN; i++)
+        b[i] = (unsigned char)(cookie >> (8 * i));
+}
+
+/* Vor Hello bzw. ReqSig: ein noch gültiges Cookie für diesen Server */
+static void cookie_lookup(struct arq_client *c)
+{
+    struct arq_cookies *k = c->cookies;
+    unsigned long long now;
+
+    if (c->cookie != 0 || k == NULL || c->serverAddrLen == 0) return;
+    now = now_ns(c);
+    pthread_mutex_lock(&k->lock);
+    for (int i = 0; i < COOKIE_CACHE; i++) {
+        if (k->slot[i].addrLen == c->serverAddrLen &&
+            now - k->slot[i].ns < GBN_COOKIE_MS * 1000000ULL &&
+            memcmp(&k->slot[i].addr, &c->serverAddr, c->serverAddrLen) == 0) {
+            c->cookie = k->slot[i].cookie;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&k->lock);
+}
+
+/* Cookie aus AnswCookie übernehmen. Rückgabewert: 1 = neu (Request mit
+ * dem Cookie wiederholen), 0 = schon benutzt. */
+static int cookie_learn(struct arq_client *c, uint64_t cookie)
+{
+    struct arq_cookies *k = c->cookies;
+    int slot = 0;
+
+    if (cookie == 0 || cookie == c->cookie) return 0;
+    c->cookie = cookie;
+    if (k == NULL || c->serverAddrLen == 0) return 1;
+
+    pthread_mutex_lock(&k->lock);
+    for (int i = 0; i < COOKIE_CACHE; i++) {
+        if (k->slot[i].addrLen == c->serverAddrLen &&
+            memcmp(&k->slot[i].addr, &c->serverAddr, c->serverAddrLen) == 0) {
+            slot = i;
+            break;
+        }
+        if (k->slot[i].ns < k->slot[slot].ns) slot = i;   /* ältester */
+    }
+    memcpy(&k->slot[slot].addr, &c->serverAddr, c->serverAddrLen);
+    k->slot[slot].addrLen = c->serverAddrLen;
+    k->slot[slot].cookie  = cookie;
+    k->slot[slot].ns      = now_ns(c);
+    pthread_mutex_unlock(&k->lock);
+    return 1;
+}
+
+/* Request in den Umschlag (struct sec_hdr) stecken: vor dem AnswHello
+ * mit k0 und eigenem Pub, danach mit dem Sitzungsschlüssel. Versiegelt
+ * werden nur Kopf und FlNr Bytes Nutzdaten. Rückgabe: Länge. */
+static unsigned long sec_seal_request(struct client_sec *s, const struct request *req)
+{
+    struct sec_hdr *h = (struct sec_hdr *)s->pkt;
+    unsigned long len = offsetof(struct request, name) +
+                        (req->FlNr < BufferSize ? req->FlNr : BufferSize);
+    unsigned long adLen = sizeof(*h);
+
+    memset(h, 0, sizeof(*h));
+    h->Ctr = s->txCtr++;
+    if (!s->keyed) {
+        h->Magic = SEC_HELLO;
+        h->Alg = (unsigned char)aeadAlgs();
+        memcpy(h->Cookie, req->Cookie, GBN_COOKIE_LEN);   /* vor dem Öffnen prüfbar */
+        memcpy(s->pkt + adLen, s->cpub, AEAD_PUB_LEN);
+        adLen += AEAD_PUB_LEN;
+        aeadSeal(s->k0, h->Ctr, s->pkt, adLen, req, len, s->pkt + adLen);
+    } else {
+        h->Magic = SEC_DATA;
+        aeadSealKey(&s->c2s, h->Ctr, s->pkt, adLen, req, len, s->pkt + adLen);
+    }
+    return adLen + len + AEAD_TAG_LEN;
+}
+
+/* Antwort prüfen und entschlüsseln; das erste AnswHello mit Pub des
+ * Servers legt die Sitzungsschlüssel und ihr Verfahren (nur ein
+ * angebotenes) fest. Rückgabe: Länge der Antwort (mit Nutzdaten),
+ * <0 = verwerfen. */
+static long sec_open_answer(struct client_sec *s, const unsigned char *pkt, long n,
+                            struct answer_data *out)
+{
+    const struct sec_hdr *h = (const struct sec_hdr *)pkt;
+    static const uint8_t zeroPub[AEAD_PUB_LEN];
+    unsigned long adLen = sizeof(*h);
+    uint8_t shared[AEAD_KEY_LEN], c2s[AEAD_KEY_LEN], s2c[AEAD_KEY_LEN];
+    struct aead_key rx;
+    const uint8_t *pub = NULL;
+    unsigned long len;
+
+    if (n < (long)sizeof(*h)) return -1;
+    if (h->Magic == SEC_DATA) {
+        if (!s->keyed) return -1;
+    } else if (h->Magic == SEC_HELLO) {
+        adLen += AEAD_PUB_LEN;
+        pub = pkt + sizeof(*h);
+    } else {
+        return -1;
+    }
+    if (n < (long)(adLen + sizeof(out->Answ) + AEAD_TAG_LEN) ||
+        n > (long)(adLen + sizeof(*out) + AEAD_TAG_LEN))
+        return -1;
+    len = (unsigned long)n - adLen - AEAD_TAG_LEN;
+
+    if (h->Magic == SEC_HELLO) {
+        if (memcmp(pub, zeroPub, AEAD_PUB_LEN) == 0) {
+            /* Antwort ohne Sitzung (z.B. Fehler): Hello-Schlüssel */
+            if (!(h->Ctr & AEAD_CTR_S2C) ||
+                aeadOpen(s->k0, h->Ctr, pkt, adLen, pkt + adLen,
+                         (size_t)(n - (long)adLen), out) < 0)
+                return -1;
+            return (long)len;
+        }
+        if (!s->keyed || memcmp(pub, s->spub, AEAD_PUB_LEN) != 0) {
+            /* Schlüssel erst nach erfolgreicher Prüfung übernehmen */
+            if (h->Alg > AEAD_AESGCM || !(aeadAlgs() & (1u << h->Alg))) return -1;
+            if (aeadShared(shared, s->priv, pub) < 0) return -1;
+            aeadSessionKeys(c2s, s2c, s->psk, shared, s->cpub, pub);
+            memset(shared, 0, sizeof(shared));
+            aeadKeySet(&rx, h->Alg, s2c);
+            if ((h->Ctr & AEAD_CTR_S2C) == 0 ||
+                aeadOpenKey(&rx, h->Ctr, pkt, adLen, pkt + adLen,
+                            (size_t)(n - (long)adLen), out) < 0)
+                return -1;
+            aeadKeySet(&s->c2s, h->Alg, c2s);
+            s->s2c = rx;
+            memcpy(s->spub, pub, AEAD_PUB_LEN);
+            s->keyed = 1;
+            return (long)len;
+        }
+    }
+    if (!(h->Ctr & AEAD_CTR_S2C) ||
+        aeadOpenKey(&s->s2c, h->Ctr, pkt, adLen, pkt + adLen, (size_t)(n - (long)adLen), out) < 0)
+        return -1;
+    return (long)len;
+}
+
+/* Neues Schlüsselpaar je Verbindungsaufbau */
+static int sec_rekey(struct client_sec *s)
+{
+    if (aeadKeypair(s->priv, s->cpub) < 0) return -1;
+    aeadHelloKey(s->k0, s->psk, s->cpub);
+    s->keyed = 0;
+    return 0;
+}
+
+static int send_request(struct arq_client *c, const struct request *req)
+{
+    unsigned long long userNs = (c->lat && c->lat->kernel) ? realtime_ns() : 0;
+    int rc;
+
+    if (c->sec != NULL) {
+        unsigned long len = sec_seal_request(c->sec, req);
+        rc = c->io.send(c->io.user, c->sec->pkt, len, NULL, 0);
+        if (rc == 0 && c->trace)
+            traceRecord(c->trace, TRACE_TX, now_ns(c), NULL, 0, c->sec->pkt, len);
+    } else {
+        rc = c->io.send(c->io.user, req, sizeof(*req), NULL, 0);
+        if (rc == 0 && c->trace)
+            traceRecord(c->trace, TRACE_TX, now_ns(c), NULL, 0, req, sizeof(*req));
+    }
+    if (rc < 0) return -1;
+    c->lastTxNs = now_ns(c);
+
+    if (userNs) {
+        /* jede erfolgreiche Sendung erhöht den OPT_ID-Zähler des Sockets */
+        unsigned int id = c->lat->txKey++;
+        c->lat->txUserNs[id % LAT_TX_RING] = userNs;
+        c->lat->txKernNs[id % LAT_TX_RING] = 0;
+        if (req->ReqType == ReqHello)
+            c->lat->txId[0] = id;   /* immer Nummer 0 */
+        else if (req->ReqType != ReqProbe && req->ReqType != ReqSig)
+            c->lat->txId[req->SeNr % GBN_BUFFER_SIZE] = id;
+    }
+    return 0;
+}
+
+static struct answer *recv_answer_if_any(struct arq_client *c)
+{
+    long n;
+
+    if (c->sec != NULL) {
+        /* verworfene Pakete zählen wie nicht empfangene */
+        do {
+            n = c->io.recv(c->io.user, c->sec->pkt, sizeof(c->sec->pkt));
+            if (n < 0) return NULL;
+            if (c->trace)
+                traceRecord(c->trace, TRACE_RX, now_ns(c), NULL, 0, c->sec->pkt, (unsigned long)n);
+        } while ((n = sec_open_answer(c->sec, c->sec->pkt, n, &c->lastAnswer)) < 0);
+    } else {
+        n = c->io.recv(c->io.user, &c->lastAnswer, sizeof(c->lastAnswer));
+        if (n < 0) {
+            return NULL;
+        }
+        if (c->trace)
+            traceRecord(c->trace, TRACE_RX, now_ns(c), NULL, 0, &c->lastAnswer, (unsigned long)n);
+        if ((size_t)n < sizeof(c->lastAnswer.Answ)) {
+            return NULL;
+        }
+    }
+    c->lastDataLen = (unsigned long)n - sizeof(c->lastAnswer.Answ);
+    return &c->lastAnswer.Answ;
+}
+
+static int wait_readable_until(struct arq_client *c, unsigned long long deadlineNs)
+{
+    return c->io.wait(c->io.user, deadlineNs);
+}
+
+/* Pacing-Rate aus Fenster/RTT ableiten (ARQ_PACE_AUTO) */
+static void update_auto_rate(struct arq_client *c)
+{
+    unsigned long long rate;
+
+    if (c->paceSetting != ARQ_PACE_AUTO || c->srttNs == 0) return;
+
+    rate = (unsigned long long)c->winSize * sizeof(struct request) * 1000000000ULL / c->srttNs;
+    if (rate == 0) rate = 1;
+    pacerSetRate(&c->pacer, rate, 2 * sizeof(struct request));
+}
+
+static void rtt_sample(struct arq_client *c, unsigned long long rttNs)
+{
+    if (c->srttNs == 0) c->srttNs = rttNs;
+    else                c->srttNs = (7 * c->srttNs + rttNs) / 8;
+    update_auto_rate(c);
+}
+
+/* Karn-Probe für Slot idx in die Histogramme eintragen (siehe
+ * struct client_lat); userRttNs ist die im Userspace gemessene RTT. */
+static void lat_sample(struct arq_client *c, const struct answer *a, int idx,
+                       unsigned long long userRttNs)
+{
+    struct client_lat *l = c->lat;
+    unsigned long long rtt = userRttNs;
+
+    if (l->kernel && l->rxKernNs) {
+        unsigned int id = l->txId[idx];
+        unsigned int k  = id % LAT_TX_RING;
+        unsigned long long tx = l->txKernNs[k];
+
+        if (l->txKernId[k] == id && tx != 0 && l->rxKernNs > tx) {
+            rtt = l->rxKernNs - tx;
+            if (tx >= l->txUserNs[k] && l->rxUserNs >= l->rxKernNs)
+                hdrRecord(&l->queue, (tx - l->txUserNs[k]) + (l->rxUserNs - l->rxKernNs));
+        }
+    }
+    hdrRecord(&l->rtt, rtt);
+
+    if (a->Flags & ANSW_F_SVC) {
+        unsigned long long svc = (unsigned long long)a->SvcUs * 1000ULL;
+        hdrRecord(&l->svc, svc);
+        if (rtt > svc) hdrRecord(&l->net, rtt - svc);
+    }
+}
+
+/* Fenster nach kumulativem ACK verschieben:
+ * ACK bedeutet: alle SeNr < ackNo sind korrekt angekommen.
+ */
+static void slide_window(struct arq_client *c, unsigned long ackNo)
+{
+    while (c->count > 0 && c->base < ackNo) {
+        int idx = (int)(c->base % GBN_BUFFER_SIZE);
+        /* Slot "freigeben" ist implizit – wir überschreiben später */
+        c->lastSendNs[idx] = 0;
+        c->retxFlag[idx] = 0;
+        c->base++;
+        c->count--;
+    }
+
+    /* Wenn Retransmit lief und base nach vorn ging: ggf. abbrechen */
+    if (c->retransmitActive && c->base >= c->next) {
+        c->retransmitActive = 0;
+    }
+    if (c->retransmitActive && c->retransmitPos < c->base) {
+        c->retransmitPos = c->base;
+    }
+}
+
+/* Darf (nach Empfängerfenster) ein neues Paket gesendet werden? */
+static int flow_window_open(const struct arq_client *c)
+{
+    return !c->rwndKnown || c->next < c->rwndBase + c->rwnd;
+}
+
+/* Eine Antwort auswerten (kumulatives ACK, RTT-Messung, Fenster, NAK) */
+static void handle_answer(struct arq_client *c, const struct answer *a, unsigned long long now)
+{
+    if (a->AnswType == AnswOk || a->AnswType == AnswHello) {
+        unsigned long ackNo = a->SeNo;
+
+        if (a->Flags & ANSW_F_DUR) c->durable = a->Durable;
+        // Wenn das ACK im gültigen Bereich liegt, Fenster verschieben
+        if (ackNo > c->base && ackNo <= c->next) {
+            int idx = (int)((ackNo - 1) % GBN_BUFFER_SIZE);
+            /* Karn: nur nicht wiederholte Pakete liefern RTT-Proben */
+            if (!c->retxFlag[idx] && c->lastSendNs[idx] > 0 && now > c->lastSendNs[idx]) {
+                rtt_sample(c, now - c->lastSendNs[idx]);
+                if (c->lat) lat_sample(c, a, idx, now - c->lastSendNs[idx]);
+            }
+            slide_window(c, ackNo);
+            c->lastProgressNs = now;
+        }
+
+        /* Fensterangabe übernehmen; veraltete (umsortierte) ACKs ignorieren */
+        if ((a->Flags & ANSW_F_WND) && ackNo >= c->base && ackNo <= c->next &&
+            ackNo >= c->rwndBase) {
+            c->rwndKnown = 1;
+            c->rwndBase  = ackNo;
+            c->rwnd      = a->FlNr;
+            if (flow_window_open(c)) {
+                c->persistNs = c->rtoNs;
+                c->probeAtNs = 0;
+            }
+            /* Antwort auf eine Probe: Empfänger lebt */
+            if (c->count == 0) c->lastProgressNs = now;
+        }
+    } else if (a->AnswType == AnswNak) {
+        unsigned long nakNo = a->SeNo;
+        unsigned long long rtt = c->srttNs ? c->srttNs : c->rtoNs;
+        int idx = (int)(nakNo % GBN_BUFFER_SIZE);
+
+        /* Lücke beim Server: kumulativ bis SeNo, dann sofort ab SeNo
+         * wiederholen statt den Retransmit-Timeout abzuwarten. Läuft
+         * schon ein Go-Back-N oder ist SeNo vor weniger als einer RTT
+         * wiederholt worden, ist der NAK älter als die Reparatur. */
+        if (nakNo < c->base || nakNo >= c->next) return;
+        if (nakNo > c->base) {
+            slide_window(c, nakNo);
+            c->lastProgressNs = now;
+        }
+        if (c->retransmitActive ||
+            (c->retxFlag[idx] && c->lastSendNs[idx] + rtt > now))
+            return;
+        c->retransmitActive = 1;
+        c->retransmitPos = c->base;
+    } else if (a->AnswType == AnswCookie) {
+        struct request *hello = &c->buf[0];
+
+        /* Server verlangt den Adressnachweis: Hello (Nummer 0, noch
+         * unbestätigt) mit dem Cookie sofort wiederholen. Der
+         * Cookie-Round-Trip ist die erste RTT-Probe. */
+        if (c->base != 0 || c->next != 1 || hello->ReqType != ReqHello ||
+            !cookie_learn(c, a->SeNo))
+            return;
+        if (!c->retxFlag[0] && c->lastSendNs[0] > 0 && now > c->lastSendNs[0])
+            rtt_sample(c, now - c->lastSendNs[0]);
+        cookie_put(hello->Cookie, c->cookie);
+        c->retransmitActive = 1;
+        c->retransmitPos = 0;
+    }
+}
+
+/* ReqProbe senden (Zero-Window-Probe bzw. Keepalive) */
+static void send_probe(struct arq_client *c)
+{
+    struct request probe;
+
+    memset(&probe, 0, sizeof(probe));
+    probe.ReqType = ReqProbe;
+    probe.SeNr    = c->next;
+    (void)send_request(c, &probe);
+}
+
+/* Zero-Window-Probe senden, Persist-Timer mit Backoff neu stellen */
+static void persist_probe(struct arq_client *c, unsigned long long now)
+{
+    send_probe(c);
+
+    c->probeAtNs = now + c->persistNs;
+    c->persistNs *= 2;
+    if (c->persistNs > PERSIST_NS) c->persistNs = PERSIST_NS;
+}
+
+/* Alle anliegenden Antworten abholen. Rückgabe: letzte Antwort,
+ * ein AnswErr hat Vorrang; NULL wenn nichts anlag. */
+static struct answer *drain_answers(struct arq_client *c)
+{
+    struct answer *ret = NULL;
+    struct answer *a;
+
+    while ((a = recv_answer_if_any(c)) != NULL) {
+        handle_answer(c, a, now_ns(c));
+        if (ret == NULL || ret->AnswType != AnswErr) {
+            c->retAnswer = *a;
+            ret = &c->retAnswer;
+        }
+    }
+    return ret;
+}
+
+static void reset_window(struct arq_client *c)
+{
+    c->base = 0;
+    c->next = 0;
+    c->count = 0;
+    c->retransmitActive = 0;
+    c->retransmitPos = 0;
+    c->srttNs = 0;
+    c->lastProgressNs = 0;
+    c->rwndKnown = 0;
+    c->rwnd = 0;
+    c->rwndBase = 0;
+    c->persistNs = c->rtoNs;
+    c->probeAtNs = 0;
+    c->durable = -1;
+    memset(c->lastSendNs, 0, sizeof(c->lastSendNs));
+    memset(c->retxFlag, 0, sizeof(c->retxFlag));
+    memset(c->expireNs, 0, sizeof(c->expireNs));
+    memset(c->retxMax, 0, sizeof(c->retxMax));
+    memset(c->retxCount, 0, sizeof(c->retxCount));
+}
+
+/* ============================================================
+ * Kontext anlegen / freigeben
+ * ============================================================ */
+
+struct arq_client *arqClientCreate(const char *name, const char *port)
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    struct arq_client *c;
+
+    c = calloc(1, sizeof(*c));
+    if (!c) {
+        perror("arqClientCreate: calloc");
+        return NULL;
+    }
+    c->sock = -1;
+    c->timerFd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_INET6;     /* i.d.R. PF_INET6 */
+    hints.ai_socktype = SOCK_DGRAM;   /* UDP */
+    hints.ai_protocol = 0;
+
+    const char *host = name;
+    if (host == NULL) host = DEFAULT_LOOPBACK_HOST;
+
+    int rc = getaddrinfo(host, port, &hints, &res);
+    if (rc != 0 || !res) {
+        fprintf(stderr, "initClient: getaddrinfo failed: %s\n", gai_strerror(rc));
+        free(c);
+        return NULL;
+    }
+
+    c->sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (c->sock < 0) {
+        perror("initClient: socket");
+        freeaddrinfo(res);
+        free(c);
+        return NULL;
+    }
+
+    if (set_nonblocking(c->sock) < 0) {
+        perror("initClient: fcntl(O_NONBLOCK)");
+        freeaddrinfo(res);
+        arqClientDestroy(c);
+        return NULL;
+    }
+
+    {
+        int on = 1;
+        c->rxqOvfl = setsockopt(c->sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) == 0;
+    }
+
+    c->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (c->timerFd < 0) {
+        perror("initClient: timerfd_create");
+        freeaddrinfo(res);
+        arqClientDestroy(c);
+        return NULL;
+    }
+
+    memcpy(&c->serverAddr, res->ai_addr, res->ai_addrlen);
+    c->serverAddrLen = (socklen_t)res->ai_addrlen;
+
+    freeaddrinfo(res);
+
+    c->io.user       = c;
+    c->io.now        = sys_now;
+    c->io.send       = sys_send;
+    c->io.recv       = sys_recv;
+    c->io.wait       = sys_wait;
+    c->io.sleepUntil = sys_sleep_until;
+
+    /* GBN State reset */
+    c->rtoNs = RTO_NS;
+    reset_window(c);
+    c->winSize = 1;
+    return c;
+}
+
+struct arq_client *arqClientCreateIo(const struct arq_io *io)
+{
+    struct arq_client *c = calloc(1, sizeof(*c));
+    if (!c) {
+        perror("arqClientCreateIo: calloc");
+        return NULL;
+    }
+    c->sock = -1;
+    c->timerFd = -1;
+    c->io = *io;
+    c->quiet = 1;
+
+    c->rtoNs = RTO_NS;
+    reset_window(c);
+    c->winSize = 1;
+    return c;
+}
+
+void arqClientDestroy(struct arq_client *c)
+{
+    if (!c) return;
+    (void)arqClientSetTrace(c, NULL);
+    (void)arqClientSetUring(c, 0);
+    free(c->lat);
+    (void)arqClientSetSecure(c, 0, NULL);
+    free(c->mc);
+    if (c->sock >= 0) {
+        close(c->sock);
+    }
+    if (c->timerFd >= 0) {
+        close(c->timerFd);
+    }
+    free(c);
+}
+
+void arqClientSetRto(struct arq_client *c, unsigned long long rtoNs)
+{
+    c->rtoNs = rtoNs ? rtoNs : RTO_NS;
+    c->persistNs = c->rtoNs;
+}
+
+int arqClientSetUring(struct arq_client *c, int enable)
+{
+    struct client_uring *ur;
+    struct io_uring_cqe *cqe;
+
+    if (!enable) {
+        if (c->ur) {
+            uringExit(&c->ur->ring);
+            free(c->ur);
+            c->ur = NULL;
+            c->io.send       = sys_send;
+            c->io.recv       = sys_recv;
+            c->io.wait       = sys_wait;
+            c->io.sleepUntil = sys_sleep_until;
+        }
+        return 0;
+    }
+    if (c->ur) return 0;
+    if (c->sock < 0 || c->io.user != c) return -1;   /* nur mit eigenem Socket */
+
+    ur = calloc(1, sizeof(*ur));
+    if (ur == NULL) return -1;
+    if (uringInit(&ur->ring, URING_ENTRIES) < 0 ||
+        uringBufRing(&ur->ring, 0, URING_RX_BUFS, ANSW_PACKET_MAX) < 0 ||
+        uring_arm_recv(ur, c->sock) < 0 ||
+        uringEnter(&ur->ring, 0, -1) < 0) {
+        if (ur->ring.fd >= 0) uringExit(&ur->ring);
+        free(ur);
+        return -1;
+    }
+    /* Kernel ohne Multishot-RECV lehnt sofort ab */
+    cqe = uringPeek(&ur->ring);
+    if (cqe != NULL && cqe->res < 0 && !(cqe->flags & IORING_CQE_F_MORE)) {
+        errno = -cqe->res;
+        uringExit(&ur->ring);
+        free(ur);
+        return -1;
+    }
+    for (unsigned i = 0; i < URING_TX_SLOTS; i++)
+        ur->txFree[ur->txFreeN++] = (unsigned short)i;
+
+    /* die Fehlerqueue wird im io_uring-Betrieb nicht gelesen */
+    if (c->lat && c->lat->kernel) {
+        int off = 0;
+        (void)setsockopt(c->sock, SOL_SOCKET, SO_TIMESTAMPING, &off, sizeof(off));
+        c->lat->kernel = 0;
+    }
+
+    c->ur = ur;
+    c->io.send       = uring_send;
+    c->io.recv       = uring_recv;
+    c->io.wait       = uring_wait;
+    c->io.sleepUntil = uring_sleep_until;
+    return 0;
+}
+
+void arqClientSetBusyPoll(struct arq_client *c, unsigned long spinUs)
+{
+    int us = (int)spinUs;
+
+    c->spinNs = (unsigned long long)spinUs * 1000ULL;
+    if (c->sock < 0) return;
+    /* Treiber-Busy-Poll im Kernel: recv() pollt die Queue selbst
+     * (über net.core.busy_read hinaus nur mit CAP_NET_ADMIN) */
+    if (setsockopt(c->sock, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0 && spinUs > 0)
+        fprintf(stderr, "Client: SO_BUSY_POLL: %s (nur Spin im Userspace)\n", strerror(errno));
+}
+
+int arqClientDurability(const struct arq_client *c)
+{
+    return c->durable;
+}
+
+int arqClientSetTimestamps(struct arq_client *c, int enable)
+{
+    int flags;
+
+    if (!enable) {
+        if (c->lat && c->lat->kernel) {
+            flags = 0;
+            (void)setsockopt(c->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+        }
+        free(c->lat);
+        c->lat = NULL;
+        return 0;
+    }
+    if (c->lat == NULL) {
+        c->lat = calloc(1, sizeof(*c->lat));
+        if (c->lat == NULL) return -1;
+        hdrInit(&c->lat->rtt);
+        hdrInit(&c->lat->svc);
+        hdrInit(&c->lat->net);
+        hdrInit(&c->lat->queue);
+    }
+    if (c->lat->kernel) return 0;
+    if (c->sock < 0 || c->ur != NULL || c->io.recv != sys_recv) return 1;
+
+    /* Software-Zeitstempel für Senden und Empfang; OPT_ID nummeriert
+     * die Sendungen, OPT_TSONLY spart die Paketkopie in der Fehlerqueue */
+    flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+            SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID |
+            SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(c->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+        return 1;
+    c->lat->kernel = 1;
+    c->lat->txKey  = 0;
+    return 0;
+}
+
+int arqClientSetSecure(struct arq_client *c, int enable, const unsigned char *psk)
+{
+    if (!enable) {
+        if (c->sec) {
+            memset(c->sec, 0, sizeof(*c->sec));
+            free(c->sec);
+            c->sec = NULL;
+        }
+        return 0;
+    }
+    if (aeadSelfTest() != 0) {
+        fprintf(stderr, "Client: crypto self-test failed, not encrypting\n");
+        return -1;
+    }
+    if (c->sec == NULL) {
+        c->sec = calloc(1, sizeof(*c->sec));
+        if (c->sec == NULL) return -1;
+    }
+    if (psk) memcpy(c->sec->psk, psk, AEAD_KEY_LEN);
+    else     memset(c->sec->psk, 0, AEAD_KEY_LEN);
+    return 0;
+}
+
+void arqClientReport(struct arq_client *c, FILE *out, const char *label)
+{
+    char name[96];
+
+    if (c->lat == NULL) return;
+    snprintf(name, sizeof(name), "%s RTT%s", label, c->lat->kernel ? " (Kernel)" : "");
+    hdrPrintUs(out, name, &c->lat->rtt);
+    snprintf(name, sizeof(name), "%s Service", label);
+    hdrPrintUs(out, name, &c->lat->svc);
+    snprintf(name, sizeof(name), "%s Netz", label);
+    hdrPrintUs(out, name, &c->lat->net);
+    if (c->lat->kernel) {
+        snprintf(name, sizeof(name), "%s Wartezeit", label);
+        hdrPrintUs(out, name, &c->lat->queue);
+    }
+}
+
+void arqClientSetPacing(struct arq_client *c, unsigned long rate)
+{
+    c->paceSetting = rate;
+    /* AUTO startet ungebremst, bis die erste RTT-Probe vorliegt */
+    pacerInit(&c->pacer, (rate == ARQ_PACE_AUTO) ? 0 : rate, 2 * sizeof(struct request));
+}
+
+void arqClientSetCoalesce(struct arq_client *c, unsigned long delayMs)
+{
+    c->coalDelayNs = (unsigned long long)delayMs * 1000000ULL;
+}
+
+void arqClientSetPartial(struct arq_client *c, unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    c->lifetimeMs = lifetimeMs;
+    c->maxRetx    = maxRetx;
+}
+
+/* Grenzen für das nächste eingereihte Paket (0, 0: voll zuverlässig) */
+static void msg_limits(struct arq_client *c, unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    c->msgExpireNs = lifetimeMs ? now_ns(c) + (unsigned long long)lifetimeMs * 1000000ULL : 0;
+    c->msgMaxRetx  = maxRetx;
+}
+
+int arqClientSetTrace(struct arq_client *c, const char *path)
+{
+    struct trace_hdr h;
+    int rc = 0;
+
+    if (c->trace && traceClose(c->trace) < 0) rc = -1;
+    c->trace = NULL;
+    if (path == NULL) return rc;
+
+    memset(&h, 0, sizeof(h));
+    h.Side    = 'C';
+    h.StartNs = now_ns(c);
+    h.Conf.cli.pace        = c->paceSetting;
+    h.Conf.cli.rtoNs       = c->rtoNs;
+    h.Conf.cli.coalDelayNs = c->coalDelayNs;
+    h.Conf.cli.lifetimeMs  = c->lifetimeMs;
+    h.Conf.cli.maxRetx     = c->maxRetx;
+    c->trace = traceCreate(path, &h);
+    return c->trace ? 0 : -1;
+}
+
+/* Nachrichtenmodus: Paket im Slot idx aufgeben (Frist abgelaufen
+ * bzw. Wiederholungen erschöpft)? */
+static int slot_expired(const struct arq_client *c, int idx, unsigned long long now)
+{
+    return (c->expireNs[idx] != 0 && now >= c->expireNs[idx]) ||
+           (c->retxMax[idx] != 0 && c->retxCount[idx] >= c->retxMax[idx]);
+}
+
+/* Paket aufgeben: es behält seine SeNr (Go-Back-N braucht die Lücke
+ * gefüllt), verliert die Nutzdaten und wird als REQ_F_SKIP bis zur
+ * Bestätigung wiederholt; REQ_F_FIN bleibt erhalten. */
+static void slot_abandon(struct arq_client *c, int idx)
+{
+    struct request *r = &c->buf[idx];
+
+    r->Flags = (unsigned char)((r->Flags & REQ_F_FIN) | REQ_F_SKIP);
+    r->FlNr  = 0;
+    memset(r->name, 0, sizeof(r->name));
+    c->expireNs[idx] = 0;
+    c->retxMax[idx]  = 0;
+    c->abandoned++;
+}
+
+/* ============================================================
+ * doRequest: max 1 Send + Empfang/ACK Auswertung
+ *
+ * Ohne Pacing: genau 1 Intervall (GBN_TIMEOUT_INT_MS) je Aufruf.
+ * Mit Pacing: Sendezeitpunkt vom Token-Bucket bestimmt; blockiert
+ * wird nur, wenn nichts zu senden ist (bis ACK oder Timeout).
+ * Timeouts werden in beiden Fällen in Echtzeit (c->rtoNs) gemessen.
+ * Neue Pakete begrenzt zusätzlich das Empfängerfenster (Flusskontrolle).
+ * ============================================================ */
+
+static struct answer *doRequest(struct arq_client *c, struct request *req, int winSize, int *windowFull, int *retransmission)
+{
+    // Zeitmessung für den Zeitschlitz starten
+    unsigned long long start = now_ns(c);
+    unsigned long long now;
+    struct answer *receivedAnsw = NULL;
+    struct answer *a;
+    int sent = 0;
+
+    if (windowFull) *windowFull = 0;
+    if (retransmission) *retransmission = 0;
+
+    if (winSize < 1) winSize = 1;
+    if (winSize > GBN_MAX_WINDOW) winSize = GBN_MAX_WINDOW;
+    c->winSize = winSize;
+
+    /* 0) Pacing: vor einer möglichen Sendung auf Guthaben warten,
+     *    ankommende ACKs dabei schon auswerten */
+    if (c->paceSetting && (c->count > 0 || req != NULL)) {
+        unsigned long long ready;
+        while ((ready = pacerReadyAt(&c->pacer, now_ns(c))) > now_ns(c)) {
+            if (wait_readable_until(c, ready)) {
+                a = drain_answers(c);
+                if (a) receivedAnsw = a;
+            }
+        }
+    }
+    now = now_ns(c);
+
+    /* 1) Timeout prüfen -> Retransmit-Flag setzen, falls das älteste
+     *    Paket zu alt ist. Nachrichtenmodus: auch, wenn seine Frist
+     *    abgelaufen ist und seit der Sendung eine RTT ohne ACK verging
+     *    (dann geht es als REQ_F_SKIP), damit die Frist und nicht der
+     *    RTO das Warten dahinter begrenzt. */
+    if (c->count > 0 && !c->retransmitActive) {
+        int baseIdx = (int)(c->base % GBN_BUFFER_SIZE);
+        unsigned long long last = c->lastSendNs[baseIdx];
+        unsigned long long rtt = c->srttNs ? c->srttNs : c->rtoNs;
+        if (last > 0 && (now - last >= c->rtoNs ||
+                         (c->expireNs[baseIdx] != 0 && now >= c->expireNs[baseIdx] &&
+                          now - last >= rtt))) {
+            c->retransmitActive = 1;
+            c->retransmitPos = c->base; // Go-Back-N startet bei c->base
+            if (retransmission) *retransmission = 1;
+        }
+    }
+
+    /* 2) Sende-Entscheidung: MAXIMAL EIN Paket pro Aufruf versenden */
+    if (c->retransmitActive && c->count > 0) {
+        /* Wiederholte Übertragung hat laut Aufgabenstellung VORRANG */
+        if (c->retransmitPos < c->next) {
+            int idx = (int)(c->retransmitPos % GBN_BUFFER_SIZE);
+            if (slot_expired(c, idx, now)) slot_abandon(c, idx);
+            if (send_request(c, &c->buf[idx]) == 0) {
+                c->lastSendNs[idx] = now;
+                c->retxFlag[idx] = 1;
+                c->retxCount[idx]++;
+                sent = 1;
+            }
+            c->retransmitPos++;
+            // Wenn alle unquittierten Pakete einmal neu gesendet wurden, Retransmit beenden
+            if (c->retransmitPos >= c->next) {
+                c->retransmitActive = 0;
+            }
+        } else {
+            c->retransmitActive = 0;
+        }
+    }
+    else if (req != NULL) {
+        /* Falls kein Retransmit ansteht: Neues Paket senden, wenn Fenster Platz hat */
+        if (c->count >= winSize) {
+            if (windowFull) *windowFull = 1;
+        } else if (!flow_window_open(c)) {
+            /* Empfänger voll: nichts Neues senden. Ist nichts mehr
+             * unterwegs, kommt auch kein ACK mit neuem Fenster ->
+             * nach Ablauf des Persist-Timers eine Probe senden. */
+            if (windowFull) *windowFull = 1;
+            if (c->count == 0) {
+                if (c->probeAtNs == 0) {
+                    c->probeAtNs = now + c->persistNs;
+                    c->lastProgressNs = now;
+                } else if (now >= c->probeAtNs) {
+                    persist_probe(c, now);
+                }
+            }
+        } else {
+            int idx = (int)(req->SeNr % GBN_BUFFER_SIZE);
+            c->buf[idx] = *req; // In Ringpuffer kopieren
+            c->retxFlag[idx] = 0;
+            c->expireNs[idx]  = c->msgExpireNs;
+            c->retxMax[idx]   = c->msgMaxRetx;
+            c->retxCount[idx] = 0;
+
+            if (c->count == 0) c->lastProgressNs = now;
+            if (send_request(c, &c->buf[idx]) == 0) {
+                c->lastSendNs[idx] = now;
+                sent = 1;
+            }
+            c->next++;
+            c->count++;
+        }
+    }
+    if (sent && c->paceSetting)
+        pacerConsume(&c->pacer, sizeof(struct request), now);
+
+    /* 3) Empfangen */
+    if (c->paceSetting) {
+        a = drain_answers(c);
+        if (a) receivedAnsw = a;
+
+        /* Nichts gesendet und nichts empfangen: bis ACK, Timeout des
+         * ältesten Pakets oder höchstens ein Intervall warten */
+        if (!sent && !receivedAnsw) {
+            unsigned long long deadline = now + SLOT_NS;
+            if (c->count > 0) {
+                int baseIdx = (int)(c->base % GBN_BUFFER_SIZE);
+                unsigned long long last = c->lastSendNs[baseIdx];
+                if (last > 0 && last + c->rtoNs < deadline) deadline = last + c->rtoNs;
+                if (c->expireNs[baseIdx] > now && c->expireNs[baseIdx] < deadline)
+                    deadline = c->expireNs[baseIdx];
+            }
+            if (wait_readable_until(c, deadline)) {
+                a = drain_answers(c);
+                if (a) receivedAnsw = a;
+            }
+        }
+        return receivedAnsw;
+    }
+
+    /* Ohne Pacing: Warten/Empfangen bis höchstens Intervallende */
+    if (wait_readable_until(c, start + SLOT_NS)) {
+        a = drain_answers(c);
+        if (a) receivedAnsw = a;
+    }
+
+    /* 4) Zeitschlitz-Synchronisation: bis Intervallende schlafen */
+    c->io.sleepUntil(c->io.user, start + SLOT_NS);
+
+    return receivedAnsw;
+}
+
+/* ============================================================
+ * Kontext-API (blockierend bis Erfolg/Fehler)
+ * ============================================================ */
+
+/* Erfolgreichen Abschluss melden, mit der Zusage des Servers */
+static void print_closed(const struct arq_client *c)
+{
+    static const char *const what[] = {
+        "Daten im Cache des Servers", "Rückschreiben der Daten angestoßen",
+        "Daten auf stabilem Speicher"
+    };
+
+    if (c->quiet) return;
+    if (c->kernelDrops > 0)
+        printf("Client: %lu Antworten im Socket-Puffer verworfen\n", c->kernelDrops);
+    if (c->abandoned > 0)
+        printf("Client: %lu Pakete nach Frist bzw. Wiederholungen aufgegeben\n", c->abandoned);
+    if (c->durable >= 0 && c->durable <= DUR_SYNC)
+        printf("Client: Verbindung erfolgreich geschlossen (%s).\n", what[c->durable]);
+    else
+        printf("Client: Verbindung erfolgreich geschlossen.\n");
+}
+
+/* Hello (ggf. mit Nutzdaten) senden und auf die Bestätigung warten */
+static int hello_exchange(struct arq_client *c, int winSize, struct request *req)
+{
+    /* Zustand neu starten */
+    reset_window(c);
+    if (c->sec != NULL && sec_rekey(c->sec) < 0) return -1;
+    size_buffers(c, (unsigned long)winSize, 1);
+    cookie_lookup(c);
+    cookie_put(req->Cookie, c->cookie);
+
+    /* Hello: so lange warten bis AnswHello/AnswOk kommt oder die
+     * Hello-Frist (GBN_HELLO_UNITS Intervalle) abgelaufen ist.
+     * doRequest kümmert sich über c->lastSendNs automatisch um
+     * Retransmits, wenn nach RTO keine Antwort kam. */
+    unsigned long long deadline = now_ns(c) + HELLO_NS;
+    struct request *toSend = req;
+    while (now_ns(c) < deadline) {
+        int wf = 0, rt = 0;
+        struct answer *a = doRequest(c, toSend, winSize, &wf, &rt);
+        if (c->next > 0) toSend = NULL; // danach nur noch warten/retransmit
+
+        if (a) {
+            if (a->AnswType == AnswErr) {
+                return -1;
+            }
+        }
+        if (c->base > 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int sig_request(struct arq_client *c, unsigned long off)
+{
+    struct request req;
+
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqSig;
+    req.SeNr    = off;
+    cookie_put(req.Cookie, c->cookie);
+    return send_request(c, &req);
+}
+
+/* Abschnitte zu je BufferSize Bytes, bis zu SIG_WINDOW gleichzeitig
+ * angefordert; nach RTO ohne Antwort erneut. Die Gesamtlänge kommt mit
+ * der ersten Antwort, bis dahin ist nur Abschnitt 0 unterwegs. */
+long arqClientFetchSig(struct arq_client *c, char **out)
+{
+    unsigned long long rto = c->rtoNs ? c->rtoNs : RTO_NS;
+    unsigned long long now = now_ns(c), deadline = now + HELLO_NS, first = 0;
+    unsigned long long *sentNs = NULL;
+    unsigned char *have = NULL;
+    unsigned long total = 0, chunks = 0, low = 0;
+    char *buf = NULL;
+    struct answer *a;
+
+    *out = NULL;
+    if (c->sec != NULL && sec_rekey(c->sec) < 0) return -1;
+    cookie_lookup(c);
+
+    while (now < deadline) {
+        if (buf == NULL) {
+            if (first == 0 || now - first >= rto) {
+                if (sig_request(c, 0) < 0) goto fail;
+                first = now;
+            }
+        } else {
+            for (unsigned long i = low; i < chunks && i < low + SIG_WINDOW; i++) {
+                if (have[i] || (sentNs[i] != 0 && now - sentNs[i] < rto)) continue;
+                if (sig_request(c, i * BufferSize) < 0) goto fail;
+                sentNs[i] = now;
+            }
+        }
+        (void)wait_readable_until(c, now + rto);
+
+        while ((a = recv_answer_if_any(c)) != NULL) {
+            unsigned long idx, len;
+
+            if (a->AnswType == AnswErr) goto fail;   /* Server ohne Daten */
+            if (a->AnswType == AnswCookie && cookie_learn(c, a->SeNo)) {
+                /* Adressnachweis: offene Abschnitte sofort mit Cookie */
+                first = 0;
+                for (unsigned long i = 0; i < chunks; i++) sentNs[i] = 0;
+                continue;
+            }
+            if (a->AnswType != AnswSig) continue;
+            if (buf == NULL) {
+                total = a->FlNr;
+                if (total > SIG_MAX_LEN) goto fail;
+                chunks = (total + BufferSize - 1) / BufferSize;
+                buf    = malloc(total ? total : 1);
+                have   = calloc(chunks ? chunks : 1, 1);
+                sentNs = calloc(chunks ? chunks : 1, sizeof(*sentNs));
+                if (buf == NULL || have == NULL || sentNs == NULL) goto fail;
+                if (chunks > 0) sentNs[0] = first;
+            } else if (a->FlNr != total) {
+                goto fail;                           /* Daten haben sich geändert */
+            }
+            idx = a->SeNo / BufferSize;
+            if (a->SeNo % BufferSize != 0 || idx >= chunks || have[idx]) continue;
+            len = (total - a->SeNo < BufferSize) ? total - a->SeNo : BufferSize;
+            if (c->lastDataLen != len) continue;
+            memcpy(buf + a->SeNo, c->lastAnswer.Data, len);
+            have[idx] = 1;
+            deadline = now_ns(c) + HELLO_NS;
+        }
+        while (low < chunks && have[low]) low++;
+        if (buf != NULL && low == chunks) {
+            free(have);
+            free(sentNs);
+            *out = buf;
+            return (long)total;
+        }
+        now = now_ns(c);
+    }
+
+fail:
+    free(buf);
+    free(have);
+    free(sentNs);
+    return -1;
+}
+
+static int query_request(struct arq_client *c, unsigned long idx, const struct app_unit *q)
+{
+    struct request req;
+
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqSig;
+    req.SeNr    = idx;
+    req.FlNr    = (q->len < BufferSize) ? q->len : BufferSize;
+    cookie_put(req.Cookie, c->cookie);
+    memcpy(req.name, q->data, req.FlNr);
+    return send_request(c, &req);
+}
+
+/* Anfragen lückenlos nummeriert (SeNr = Index), bis zu SIG_WINDOW
+ * gleichzeitig unterwegs, nach RTO ohne Antwort erneut. Bis zur ersten
+ * Antwort nur Anfrage 0: ein Server ohne Anfragen antwortet so nur
+ * einmal mit AnswErr, das sonst vor dem Hello liegen bliebe. */
+int arqClientQuery(struct arq_client *c, const struct app_unit *q, struct app_unit *ans,
+                   unsigned long n)
+{
+    unsigned long long rto = c->rtoNs ? c->rtoNs : RTO_NS;
+    unsigned long long now = now_ns(c), deadline = now + HELLO_NS;
+    unsigned long long *sentNs;
+    unsigned char *have;
+    unsigned long low = 0, window = 1;
+    struct answer *a;
+    int rc = -1;
+
+    if (n == 0) return 0;
+    if (c->sec != NULL && sec_rekey(c->sec) < 0) return -1;
+    cookie_lookup(c);
+    have   = calloc(n, 1);
+    sentNs = calloc(n, sizeof(*sentNs));
+    if (have == NULL || sentNs == NULL) goto out;
+
+    while (now < deadline) {
+        for (unsigned long i = low; i < n && i < low + window; i++) {
+            if (have[i] || (sentNs[i] != 0 && now - sentNs[i] < rto)) continue;
+            if (query_request(c, i, &q[i]) < 0) goto out;
+            sentNs[i] = now;
+        }
+        (void)wait_readable_until(c, now + rto);
+
+        while ((a = recv_answer_if_any(c)) != NULL) {
+            if (a->AnswType == AnswErr) goto out;   /* Server ohne Anfragen */
+            if (a->AnswType == AnswCookie && cookie_learn(c, a->SeNo)) {
+                /* Adressnachweis: offene Anfragen sofort mit Cookie */
+                memset(sentNs, 0, n * sizeof(*sentNs));
+                continue;
+            }
+            if (a->AnswType != AnswSig || a->SeNo >= n || have[a->SeNo]) continue;
+            if (a->FlNr != c->lastDataLen || c->lastDataLen > BufferSize) continue;
+            ans[a->SeNo].len = c->lastDataLen;
+            memcpy(ans[a->SeNo].data, c->lastAnswer.Data, c->lastDataLen);
+            have[a->SeNo] = 1;
+            window = SIG_WINDOW;
+            deadline = now_ns(c) + HELLO_NS;
+        }
+        while (low < n && have[low]) low++;
+        if (low == n) {
+            rc = 0;
+            break;
+        }
+        now = now_ns(c);
+    }
+
+out:
+    free(have);
+    free(sentNs);
+    return rc;
+}
+
+/* ============================================================
+ * Multicast-Sender (struct client_mc)
+ * ============================================================ */
+
+/* Empfänger mit Kennung id; add: beim AnswHello neu aufnehmen.
+ * Rückgabewert: Index, <0 = unbekannt oder kein Platz. */
+static int mc_rx_find(struct client_mc *m, uint64_t id, int add)
+{
+    for (unsigned int i = 0; i < m->n; i++)
+        if (m->rx[i].id == id) return (int)i;
+    if (!add || m->n >= GBN_MC_MAX_RX) return -1;
+    memset(&m->rx[m->n], 0, sizeof(m->rx[m->n]));
+    m->rx[m->n].id      = id;
+    m->rx[m->n].acked   = 1;
+    m->rx[m->n].durable = -1;
+    return (int)m->n++;
+}
+
+static unsigned int mc_open(const struct client_mc *m)
+{
+    unsigned int open = 0;
+
+    for (unsigned int i = 0; i < m->n; i++)
+        if (m->rx[i].state == MC_RX_OPEN) open++;
+    return open;
+}
+
+/* Kleinstes acked der offenen Empfänger (next, wenn keiner offen ist).
+ * Wer bei offenen Daten HELLO_NS lang schweigt, wird ausgeschlossen. */
+static unsigned long mc_low(struct arq_client *c, unsigned long long now)
+{
+    struct client_mc *m = c->mc;
+    unsigned long low = c->next;
+
+    for (unsigned int i = 0; i < m->n; i++) {
+        if (m->rx[i].state != MC_RX_OPEN) continue;
+        if (m->rx[i].acked < c->next && m->rx[i].lastNs + HELLO_NS < now) {
+            if (!c->quiet) fprintf(stderr, "Client: Empfänger %u antwortet nicht, ausgeschlossen\n", i);
+            m->rx[i].state = MC_RX_FAILED;
+            continue;
+        }
+        if (m->rx[i].acked < low) low = m->rx[i].acked;
+    }
+    return low;
+}
+
+static void mc_probe(struct arq_client *c)
+{
+    struct request probe;
+
+    memset(&probe, 0, sizeof(probe));
+    probe.ReqType = ReqProbe;
+    probe.Flags   = REQ_F_MCAST;
+    probe.SeNr    = c->next;
+    (void)send_request(c, &probe);
+    c->mc->probeNs = now_ns(c);
+}
+
+/* Empfänger mit offenen Daten, von denen seit RTO nichts kam, nach
+ * ihrem Stand fragen: sie antworten mit ACK oder NAK, auch wenn die
+ * letzten Pakete verloren gingen (keine Lücke vor späteren Paketen). */
+static void mc_keepalive(struct arq_client *c, unsigned long long now)
+{
+    struct client_mc *m = c->mc;
+
+    if (m->probeNs + c->rtoNs > now) return;
+    for (unsigned int i = 0; i < m->n; i++) {
+        if (m->rx[i].state == MC_RX_OPEN && m->rx[i].acked < c->next &&
+            m->rx[i].lastNs + c->rtoNs <= now) {
+            mc_probe(c);
+            return;
+        }
+    }
+}
+
+/* Gemeldete Lücke erneut an die Gruppe senden. Was ein anderer
+ * Empfänger eben erst angefordert hat, geht nicht noch einmal. */
+static void mc_repair(struct arq_client *c, unsigned long from, unsigned long count,
+                      unsigned long long now)
+{
+    struct client_mc *m = c->mc;
+
+    if (count > MC_REPAIR_MAX) count = MC_REPAIR_MAX;
+    for (unsigned long seq = from; seq < from + count && seq < c->next; seq++) {
+        unsigned int idx = (unsigned int)(seq % GBN_MC_WINDOW);
+
+        if (seq == 0 || seq + GBN_MC_WINDOW < c->next) continue;    /* nicht mehr im Ring */
+        if (m->repairNs[idx] != 0 && now - m->repairNs[idx] < MC_REPAIR_NS) continue;
+        if (send_request(c, &m->ring[idx]) == 0) {
+            m->repairNs[idx] = now;
+            m->repairs++;
+            pacerConsume(&c->pacer, sizeof(struct request), now);
+        }
+    }
+}
+
+/* Alle anliegenden Antworten auswerten (Kennung in den Nutzdaten) */
+static void mc_drain(struct arq_client *c)
+{
+    struct client_mc *m = c->mc;
+    struct answer *a;
+
+    while ((a = recv_answer_if_any(c)) != NULL) {
+        unsigned long long now = now_ns(c);
+        uint64_t id;
+        int i;
+
+        if (c->lastDataLen != sizeof(id)) continue;
+        memcpy(&id, c->lastAnswer.Data, sizeof(id));
+        i = mc_rx_find(m, id, a->AnswType == AnswHello);
+        if (i < 0 || m->rx[i].state == MC_RX_FAILED) continue;
+        m->rx[i].lastNs = now;
+
+        if (a->AnswType == AnswErr || a->AnswType == AnswWarn) {
+            if (!c->quiet)
+                fprintf(stderr, "Client: Empfänger %d meldet Fehler %lu, ausgeschlossen\n",
+                        i, a->ErrNo);
+            m->rx[i].state = MC_RX_FAILED;
+            continue;
+        }
+        if (a->AnswType != AnswOk && a->AnswType != AnswNak) continue;
+        if (a->SeNo > m->rx[i].acked && a->SeNo <= c->next) {
+            m->rx[i].acked = a->SeNo;
+            c->lastProgressNs = now;
+        }
+        if (a->AnswType == AnswNak) {
+            m->naks++;
+            mc_repair(c, a->SeNo, a->FlNr, now);
+        } else if (m->closeSeq != 0 && a->SeNo > m->closeSeq) {
+            m->rx[i].state   = MC_RX_DONE;
+            m->rx[i].durable = (a->Flags & ANSW_F_DUR) ? a->Durable : -1;
+        }
+    }
+}
+
+static void mc_wait(struct arq_client *c, unsigned long long deadlineNs)
+{
+    if (wait_readable_until(c, deadlineNs)) mc_drain(c);
+}
+
+/* Hello an die Gruppe, bis sich die angekündigten Empfänger gemeldet
+ * haben oder die Hello-Frist abläuft (dann mit den gemeldeten weiter). */
+static int mc_hello(struct arq_client *c)
+{
+    struct client_mc *m = c->mc;
+    struct hello_info hi;
+    struct request req;
+    unsigned long long now = now_ns(c), deadline = now + HELLO_NS, sentNs = 0;
+
+    if (c->sec != NULL) return -1;
+    reset_window(c);
+    size_buffers(c, GBN_MC_WINDOW, m->expected);
+    c->next = 1;                       /* das Hello ist Nummer 0 */
+    m->n = 0;
+    m->closeSeq = 0;
+    m->probeNs = 0;
+    m->sent = m->repairs = m->naks = 0;
+    memset(m->repairNs, 0, sizeof(m->repairNs));
+    /* ohne ACK je Paket gibt nur die Rate den Takt vor */
+    if (c->paceSetting == 0 || c->paceSetting == ARQ_PACE_AUTO)
+        pacerInit(&c->pacer, MC_RATE, 2 * sizeof(struct request));
+
+    memset(&hi, 0, sizeof(hi));
+    hi.Stripes = 1;
+    hi.XferId  = (now ^ ((unsigned long)getpid() << 20) ^ (unsigned long)c) | 1;
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqHello;
+    req.Flags   = REQ_F_MCAST;
+    req.FlNr    = sizeof(hi);
+    memcpy(req.name, &hi, sizeof(hi));
+
+    while (now < deadline && m->n < m->expected) {
+        if (sentNs == 0 || now - sentNs >= c->rtoNs) {
+            (void)send_request(c, &req);
+            sentNs = now;
+        }
+        mc_wait(c, sentNs + c->rtoNs);
+        now = now_ns(c);
+    }
+    if (m->n == 0) return -1;
+    if (m->n < m->expected && !c->quiet)
+        printf("Client: nur %u von %u Empfängern gemeldet, sende an diese\n", m->n, m->expected);
+    c->lastProgressNs = now;
+    return 0;
+}
+
+/* Warten, bis das Fenster über dem langsamsten Empfänger Platz hat.
+ * Rückgabewert: 0, <0 wenn kein Empfänger mehr offen ist oder
+ * GIVEUP_NS lang nichts vorangeht. */
+static int mc_window(struct arq_client *c)
+{
+    for (;;) {
+        unsigned long long now = now_ns(c);
+        unsigned long low;
+
+        mc_drain(c);
+        mc_keepalive(c, now);
+        low = mc_low(c, now);
+        if (mc_open(c->mc) == 0) return -1;
+        if (c->next - low < GBN_MC_WINDOW) return 0;
+        if (c->lastProgressNs + GIVEUP_NS < now) return -1;
+        mc_wait(c, now + SLOT_NS);
+    }
+}
+
+/* Paket mit der nächsten SeNr in den Ring legen und einmal an die
+ * Gruppe senden (verlorene Sendungen reparieren die NAKs). */
+static struct request *mc_put(struct arq_client *c, unsigned char type,
+                              const char *data, unsigned long len)
+{
+    struct client_mc *m = c->mc;
+    unsigned int idx = (unsigned int)(c->next % GBN_MC_WINDOW);
+    struct request *req = &m->ring[idx];
+    unsigned long long ready, now;
+
+    while ((ready = pacerReadyAt(&c->pacer, now_ns(c))) > now_ns(c))
+        mc_wait(c, ready);
+    now = now_ns(c);
+
+    memset(req, 0, sizeof(*req));
+    req->ReqType = type;
+    req->Flags   = REQ_F_MCAST;
+    req->FlNr    = len;
+    req->SeNr    = c->next++;
+    if (len > 0) memcpy(req->name, data, len);
+    m->repairNs[idx] = 0;
+    (void)send_request(c, req);
+    pacerConsume(&c->pacer, sizeof(*req), now);
+    m->sent++;
+    return req;
+}
+
+static int mc_send_data(struct arq_client *c, const struct app_unit *app)
+{
+    unsigned long len = (app->len < BufferSize) ? app->len : BufferSize;
+
+    if (mc_window(c) < 0) return -1;
+    (void)mc_put(c, ReqData, app->data, len);
+    return 0;
+}
+
+static int mc_poll(struct arq_client *c)
+{
+    unsigned long long now = now_ns(c);
+
+    mc_drain(c);
+    mc_keepalive(c, now);
+    if (now - c->lastTxNs >= KEEPALIVE_NS) mc_probe(c);
+    (void)mc_low(c, now);
+    if (mc_open(c->mc) == 0) return -1;
+    mc_wait(c, now + SLOT_NS);
+    return 0;
+}
+
+/* Close an die Gruppe, alle RTO wiederholt, bis jeder offene Empfänger
+ * es bestätigt hat; Lücken davor reparieren die NAKs. Erfolgreich nur,
+ * wenn alle gemeldeten Empfänger vollständig sind. */
+static int mc_close(struct arq_client *c)
+{
+    struct client_mc *m = c->mc;
+    struct request *req;
+    unsigned long long now, sentNs;
+    unsigned int done = 0;
+
+    if (mc_window(c) == 0) {
+        m->closeSeq = c->next;
+        req = mc_put(c, ReqClose, NULL, 0);
+        sentNs = now_ns(c);
+        c->lastProgressNs = sentNs;
+        for (;;) {
+            now = now_ns(c);
+            mc_drain(c);
+            (void)mc_low(c, now);
+            if (mc_open(m) == 0 || c->lastProgressNs + GIVEUP_NS < now) break;
+            if (now - sentNs >= c->rtoNs) {
+                (void)send_request(c, req);
+                sentNs = now;
+            }
+            mc_wait(c, sentNs + c->rtoNs);
+        }
+    }
+
+    c->durable = DUR_SYNC;
+    for (unsigned int i = 0; i < m->n; i++) {
+        if (m->rx[i].state != MC_RX_DONE) continue;
+        done++;
+        if (m->rx[i].durable < c->durable) c->durable = m->rx[i].durable;
+    }
+    if (done == 0) c->durable = -1;
+    if (!c->quiet)
+        printf("Client: Multicast: %u von %u Empfängern vollständig, %lu Pakete, "
+               "%lu Wiederholungen auf %lu NAKs\n", done, m->n, m->sent, m->repairs, m->naks);
+    if (done < m->n) return -1;
+    print_closed(c);
+    return 0;
+}
+
+int arqClientSetMulticast(struct arq_client *c, unsigned int receivers)
+{
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)&c->serverAddr;
+    int ifindex, loop = 1;
+
+    if (receivers == 0) {
+        free(c->mc);
+        c->mc = NULL;
+        return 0;
+    }
+    if (receivers > GBN_MC_MAX_RX || c->sock < 0 || c->io.user != c || c->sec != NULL ||
+        c->serverAddr.ss_family != AF_INET6 || !IN6_IS_ADDR_MULTICAST(&sin6->sin6_addr))
+        return -1;
+
+    /* Interface aus dem Scope der Adresse ("ff01::4242%eth0"); Kopien an
+     * Empfänger auf diesem Rechner (IPV6_MULTICAST_LOOP) */
+    ifindex = (int)sin6->sin6_scope_id;
+    if ((ifindex != 0 &&
+         setsockopt(c->sock, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof(ifindex)) < 0) ||
+        setsockopt(c->sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop)) < 0)
+        return -1;
+    if (c->mc == NULL && (c->mc = calloc(1, sizeof(*c->mc))) == NULL) return -1;
+    c->mc->expected = receivers;
+    return 0;
+}
+
+int arqClientHello(struct arq_client *c, int winSize, const struct hello_info *info)
+{
+    if (c->mc) return mc_hello(c);
+
+    struct request req;
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqHello;
+    req.FlNr    = 0;
+    req.SeNr    = 0;
+    if (info) {
+        /* Stripe-Beschreibung als Nutzdaten des Hello mitsenden */
+        memcpy(req.name, info, sizeof(*info));
+        req.FlNr = sizeof(*info);
+    }
+    return hello_exchange(c, winSize, &req);
+}
+
+int arqClientHelloData(struct arq_client *c, int winSize, const struct hello_info *info,
+                       const struct app_unit *app, int fin)
+{
+    struct hello_info hi;
+    struct request req;
+    unsigned long len = app ? app->len : 0;
+
+    if (c->mc) {
+        /* Multicast: kein 0-RTT, Daten nach dem Hello an die Gruppe */
+        if (mc_hello(c) != 0 || (len > 0 && mc_send_data(c, app) != 0)) return -1;
+        return fin ? mc_close(c) : 0;
+    }
+
+    if (len > GBN_HELLO_DATA_MAX) {
+        /* passt nicht ins Hello: Hello und Daten getrennt */
+        if (arqClientHello(c, winSize, info) != 0) return -1;
+        return fin ? arqClientSendLast(c, app, winSize) : arqClientSendData(c, app, winSize);
+    }
+
+    if (info) {
+        hi = *info;
+    } else {
+        memset(&hi, 0, sizeof(hi));
+        hi.Stripes = 1;
+    }
+    /* XferId: Server erkennt daran ein wiederholtes Hello */
+    if (hi.XferId == 0)
+        hi.XferId = (now_ns(c) ^ ((unsigned long)getpid() << 20) ^ (unsigned long)c) | 1;
+
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqHello;
+    req.Flags   = REQ_F_DATA | (fin ? REQ_F_FIN : 0);
+    req.SeNr    = 0;
+    memcpy(req.name, &hi, sizeof(hi));
+    if (len > 0) memcpy(req.name + sizeof(hi), app->data, len);
+    req.FlNr    = sizeof(hi) + len;
+
+    if (hello_exchange(c, winSize, &req) != 0) return -1;
+    if (fin) print_closed(c);
+    return 0;
+}
+
+/* Request als nächstes Paket ins Sendefenster einreihen; blockiert nur,
+ * solange das Fenster voll ist. Rückgabewert: 0, <0 bei Fehler. */
+static int enqueue_request(struct arq_client *c, struct request *req, int winSize)
+{
+    req->SeNr = c->next; /* nächste Sequenznummer */
+
+    unsigned long mySeq = req->SeNr;
+
+    /* blockierend, bis unser Paket im Fenster ist */
+    for (;;) {
+        int wf = 0, rt = 0;
+
+        /* Solange nicht eingereiht, req anbieten; Retransmits haben Vorrang */
+        struct request *toSend = (c->next <= mySeq) ? req : NULL;
+
+        struct answer *a = doRequest(c, toSend, winSize, &wf, &rt);
+
+        if (a && a->AnswType == AnswErr) {
+            return -1;
+        }
+        if (c->next > mySeq) {
+            return 0;
+        }
+        /* Warn behandeln wir wie "weiter versuchen" */
+
+        /* kein Fortschritt mehr -> Server nicht erreichbar */
+        if ((c->count > 0 || !flow_window_open(c)) &&
+            now_ns(c) - c->lastProgressNs > GIVEUP_NS) {
+            return -1;
+        }
+    }
+}
+
+/* --- Coalescing (siehe arqClientSetCoalesce) --- */
+
+static int coal_fits(const struct arq_client *c, unsigned long len)
+{
+    return c->coal.FlNr + GBN_REC_HDR + len <= BufferSize;
+}
+
+/* Record anhängen; das Sammelpaket gilt mit der engsten Frist bzw.
+ * Wiederholungsgrenze seiner Records */
+static void coal_add(struct arq_client *c, const struct app_unit *app, unsigned long len)
+{
+    unsigned short rl = (unsigned short)len;
+
+    if (c->coalRecs == 0) {
+        memset(&c->coal, 0, sizeof(c->coal));
+        c->coal.ReqType = ReqData;
+        c->coal.Flags   = REQ_F_RECS;
+        c->coalSinceNs  = now_ns(c);
+        c->coalExpireNs = c->msgExpireNs;
+        c->coalMaxRetx  = c->msgMaxRetx;
+    }
+    if (c->msgExpireNs != 0 && (c->coalExpireNs == 0 || c->msgExpireNs < c->coalExpireNs))
+        c->coalExpireNs = c->msgExpireNs;
+    if (c->msgMaxRetx != 0 && (c->coalMaxRetx == 0 || c->msgMaxRetx < c->coalMaxRetx))
+        c->coalMaxRetx = c->msgMaxRetx;
+    memcpy(c->coal.name + c->coal.FlNr, &rl, GBN_REC_HDR);
+    memcpy(c->coal.name + c->coal.FlNr + GBN_REC_HDR, app->data, len);
+    c->coal.FlNr += GBN_REC_HDR + len;
+    c->coalRecs++;
+}
+
+/* Senden, wenn das Paket voll ist oder der erste Record coalDelayNs
+ * wartet; idle (die Anwendung hat gerade nichts): wie Nagle sofort,
+ * wenn nichts unterwegs ist */
+static int coal_due(struct arq_client *c, int idle)
+{
+    return c->coalRecs > 0 &&
+           ((idle && c->count == 0) || !coal_fits(c, 1) ||
+            now_ns(c) - c->coalSinceNs >= c->coalDelayNs);
+}
+
+/* Sammelpaket einreihen; ein einzelner Record geht als normales ReqData */
+static int coal_flush(struct arq_client *c, int winSize)
+{
+    struct request req;
+    unsigned long long expire = c->msgExpireNs;
+    unsigned int maxRetx = c->msgMaxRetx;
+    int rc;
+
+    if (c->coalRecs == 0) return 0;
+    if (c->coalRecs == 1) {
+        memset(&req, 0, sizeof(req));
+        req.ReqType = ReqData;
+        req.FlNr    = c->coal.FlNr - GBN_REC_HDR;
+        memcpy(req.name, c->coal.name + GBN_REC_HDR, req.FlNr);
+    } else {
+        req = c->coal;
+    }
+    c->coalRecs = 0;
+    c->coal.FlNr = 0;
+    c->msgExpireNs = c->coalExpireNs;
+    c->msgMaxRetx  = c->coalMaxRetx;
+    rc = enqueue_request(c, &req, winSize);
+    c->msgExpireNs = expire;
+    c->msgMaxRetx  = maxRetx;
+    return rc;
+}
+
+/* Nicht blockierend bis zur Bestätigung: die app_unit wird ins
+ * Sendefenster eingereiht; blockiert wird nur, solange das Fenster
+ * voll ist. Zuverlässigkeit garantiert erst arqSendClose().
+ */
+static int send_data(struct arq_client *c, const struct app_unit *app, int winSize)
+{
+    /* Request vorbereiten */
+    struct request req;
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqData;
+
+    unsigned long len = app->len;
+    if (len > (unsigned long)BufferSize) len = (unsigned long)BufferSize;
+
+    if (c->coalDelayNs) {
+        if (!coal_fits(c, len) && coal_flush(c, winSize) < 0) return -1;
+        if (coal_fits(c, len)) {
+            coal_add(c, app, len);
+            return coal_due(c, 0) ? coal_flush(c, winSize) : 0;
+        }
+        /* passt auch allein nicht mit Längenfeld: normal senden */
+    }
+
+    req.FlNr = len;
+    memcpy(req.name, app->data, len);
+    return enqueue_request(c, &req, winSize);
+}
+
+int arqClientSendData(struct arq_client *c, const struct app_unit *app, int winSize)
+{
+    return arqClientSendMsg(c, app, winSize, c->lifetimeMs, c->maxRetx);
+}
+
+int arqClientSendMsg(struct arq_client *c, const struct app_unit *app, int winSize,
+                     unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    int rc;
+
+    if (!app) return -1;
+    if (c->mc) return mc_send_data(c, app);
+
+    msg_limits(c, lifetimeMs, maxRetx);
+    rc = send_data(c, app, winSize);
+    msg_limits(c, 0, 0);
+    return rc;
+}
+
+/* Loch (len Nullbytes) als ein Paket mit REQ_F_HOLE einreihen */
+int arqClientSendHole(struct arq_client *c, unsigned long len, int winSize)
+{
+    struct request req;
+
+    if (c->mc) return -1;   /* Multicast-Empfänger kennen keine Löcher */
+    if (len == 0) return 0;
+    if (coal_flush(c, winSize) < 0) return -1;
+
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqData;
+    req.Flags   = REQ_F_HOLE;
+    req.FlNr    = sizeof(len);
+    memcpy(req.name, &len, sizeof(len));
+    return enqueue_request(c, &req, winSize);
+}
+
+/* Ohne neue Daten weiterarbeiten (die Anwendung wartet auf Eingabe):
+ * ACKs auswerten, fällige Retransmits senden; ist nichts unterwegs,
+ * hält nach GBN_KEEPALIVE_UNITS eine Probe die Sitzung am Leben.
+ */
+int arqClientPoll(struct arq_client *c, int winSize)
+{
+    struct answer *a;
+
+    if (c->mc) return mc_poll(c);
+    if (coal_due(c, 1) && coal_flush(c, winSize) < 0) return -1;
+    if (c->count == 0) {
+        if (now_ns(c) - c->lastTxNs >= KEEPALIVE_NS)
+            send_probe(c);
+        a = drain_answers(c);
+        return (a && a->AnswType == AnswErr) ? -1 : 0;
+    }
+
+    int wf = 0, rt = 0;
+    a = doRequest(c, NULL, winSize, &wf, &rt);
+    if (a && a->AnswType == AnswErr) return -1;
+    if (now_ns(c) - c->lastProgressNs > GIVEUP_NS) return -1;
+    return 0;
+}
+
+/* Abschließendes Paket (ReqClose oder Daten mit REQ_F_FIN) einreihen
+ * und warten, bis es und damit alle vorherigen Pakete bestätigt sind. */
+static int send_final(struct arq_client *c, struct request *req, int winSize)
+{
+    req->SeNr = c->next; /* Close bekommt auch eine Seq */
+
+    unsigned long mySeq = req->SeNr;
+
+    /* Close wird erst bestätigt (ACK >= mySeq+1), wenn alle vorherigen
+     * Datenpakete in Reihenfolge angekommen sind. */
+    for (;;) {
+        int wf = 0, rt = 0;
+
+        struct request *toSend = (c->next <= mySeq) ? req : NULL;
+        struct answer *a = doRequest(c, toSend, winSize, &wf, &rt);
+
+        if (a && a->AnswType == AnswErr) return -1;
+
+        if (c->base > mySeq) {
+            print_closed(c);
+            return 0;
+        }
+
+        if ((c->count > 0 || !flow_window_open(c)) &&
+            now_ns(c) - c->lastProgressNs > GIVEUP_NS) {
+            break;
+        }
+    }
+    /* Ein reines Close darf fehlen, ein FIN-Paket trägt noch Daten */
+    if (req->ReqType == ReqClose && c->base >= mySeq) {
+        if (!c->quiet) printf("Client: Close-Timeout, beende trotzdem (Daten waren bereits OK).\n");
+        return 0;
+    }
+    return -1;
+}
+
+static int send_last(struct arq_client *c, const struct app_unit *app, int winSize)
+{
+    struct request req;
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqData;
+    req.Flags   = REQ_F_FIN;
+
+    unsigned long len = app->len;
+    if (len > (unsigned long)BufferSize) len = (unsigned long)BufferSize;
+
+    /* Offenes Sammelpaket: letzten Record anhängen und mit FIN senden */
+    if (c->coalRecs > 0 && coal_fits(c, len)) {
+        coal_add(c, app, len);
+        req = c->coal;
+        req.Flags |= REQ_F_FIN;
+        c->coalRecs = 0;
+        c->coal.FlNr = 0;
+        c->msgExpireNs = c->coalExpireNs;
+        c->msgMaxRetx  = c->coalMaxRetx;
+        return send_final(c, &req, winSize);
+    }
+    if (coal_flush(c, winSize) < 0) return -1;
+
+    req.FlNr = len;
+    memcpy(req.name, app->data, len);
+    return send_final(c, &req, winSize);
+}
+
+int arqClientSendLast(struct arq_client *c, const struct app_unit *app, int winSize)
+{
+    return arqClientSendLastMsg(c, app, winSize, c->lifetimeMs, c->maxRetx);
+}
+
+int arqClientSendLastMsg(struct arq_client *c, const struct app_unit *app, int winSize,
+                         unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    int rc;
+
+    if (!app) return -1;
+    if (c->mc) return (mc_send_data(c, app) != 0) ? -1 : mc_close(c);
+
+    msg_limits(c, lifetimeMs, maxRetx);
+    rc = send_last(c, app, winSize);
+    msg_limits(c, 0, 0);
+    return rc;
+}
+
+int arqClientSendClose(struct arq_client *c, int winSize)
+{
+    struct request req;
+
+    if (c->mc) return mc_close(c);
+    if (coal_flush(c, winSize) < 0) return -1;
+    memset(&req, 0, sizeof(req));
+    req.ReqType = ReqClose;
+    req.FlNr    = 0;
+    return send_final(c, &req, winSize);
+}
+
+/* ============================================================
+ * Klassische API: Hüllen um den Standard-Kontext des Threads
+ * ============================================================ */
+
+void initClient(char *name, const char *port)
+{
+    arqClientDestroy(gDefault);
+    gDefault = arqClientCreate(name, port);
+    if (!gDefault) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+void closeClient(void)
+{
+    arqClientDestroy(gDefault);
+    gDefault = NULL;
+}
+
+void arqSetPacing(unsigned long rate)
+{
+    if (gDefault) arqClientSetPacing(gDefault, rate);
+}
+
+void arqSetCoalesce(unsigned long delayMs)
+{
+    if (gDefault) arqClientSetCoalesce(gDefault, delayMs);
+}
+
+void arqSetPartial(unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    if (gDefault) arqClientSetPartial(gDefault, lifetimeMs, maxRetx);
+}
+
+int arqSetTrace(const char *path)
+{
+    return gDefault ? arqClientSetTrace(gDefault, path) : -1;
+}
+
+void arqSetBusyPoll(unsigned long spinUs)
+{
+    if (gDefault) arqClientSetBusyPoll(gDefault, spinUs);
+}
+
+int arqSetUring(int enable)
+{
+    return gDefault ? arqClientSetUring(gDefault, enable) : -1;
+}
+
+int arqSetTimestamps(int enable)
+{
+    return gDefault ? arqClientSetTimestamps(gDefault, enable) : -1;
+}
+
+int arqSetSecure(int enable, const unsigned char *psk)
+{
+    return gDefault ? arqClientSetSecure(gDefault, enable, psk) : -1;
+}
+
+int arqSetMulticast(unsigned int receivers)
+{
+    return gDefault ? arqClientSetMulticast(gDefault, receivers) : -1;
+}
+
+long arqFetchSig(char **out)
+{
+    *out = NULL;
+    return gDefault ? arqClientFetchSig(gDefault, out) : -1;
+}
+
+int arqQuery(const struct app_unit *q, struct app_unit *ans, unsigned long n)
+{
+    return gDefault ? arqClientQuery(gDefault, q, ans, n) : -1;
+}
+
+void arqReport(FILE *out)
+{
+    if (gDefault) arqClientReport(gDefault, out, "Client:");
+}
+
+int arqSendHello(int winSize)
+{
+    return arqSendHelloStripe(winSize, NULL);
+}
+
+int arqSendHelloStripe(int winSize, const struct hello_info *info)
+{
+    if (!gDefault) return -1;
+    return arqClientHello(gDefault, winSize, info);
+}
+
+int arqSendData(const struct app_unit *app, int winSize)
+{
+    if (!gDefault) return -1;
+    return arqClientSendData(gDefault, app, winSize);
+}
+
+int arqSendMsg(const struct app_unit *app, int winSize,
+               unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    return gDefault ? arqClientSendMsg(gDefault, app, winSize, lifetimeMs, maxRetx) : -1;
+}
+
+int arqSendHole(unsigned long len, int winSize)
+{
+    if (!gDefault) return -1;
+    return arqClientSendHole(gDefault, len, winSize);
+}
+
+int arqSendHelloData(int winSize, const struct app_unit *app, int fin)
+{
+    if (!gDefault) return -1;
+    return arqClientHelloData(gDefault, winSize, NULL, app, fin);
+}
+
+int arqSendLastMsg(const struct app_unit *app, int winSize,
+                   unsigned long lifetimeMs, unsigned int maxRetx)
+{
+    return gDefault ? arqClientSendLastMsg(gDefault, app, winSize, lifetimeMs, maxRetx) : -1;
+}
+
+int arqSendLast(const struct app_unit *app, int winSize)
+{
+    if (!gDefault) return -1;
+    return arqClientSendLast(gDefault, app, winSize);
+}
+
+int arqPoll(int winSize)
+{
+    if (!gDefault) return -1;
+    return arqClientPoll(gDefault, winSize);
+}
+
+int arqSendClose(int winSize)
+{
+    if (!gDefault) return -1;
+    return arqClientSendClose(gDefault, winSize);
+}
@@ -1,7 +1,10 @@
 #ifndef CLIENTSY_H
 #define CLIENTSY_H
 
+#include <stdio.h>
+
 #include "data.h"
+#include "arqio.h"
 
 /*
  * ARQ-Client-API
@@ -10,7 +13,170 @@
  * Die Implementierung in clientSy.c kapselt:
  *   - UDP-Transport (Socket, sendto/recvfrom)
  *   - ARQ-Protokoll (Fenster, Timer, Retransmits)
+ *
+ * Der gesamte Zustand eines Flows liegt in einem Kontextobjekt
+ * (struct arq_client). Verschiedene Kontexte sind unabhängig und
+ * können gleichzeitig in verschiedenen Threads benutzt werden; ein
+ * einzelner Kontext gehört jeweils einem Thread.
+ */
+
+/* Opaker Client-Kontext (ein Socket, ein GBN-Sendefenster) */
+struct arq_client;
+
+/* Optionales Pacing (vor dem Hello setzen):
+ *   0             : aus, ein Paket je Intervall (GBN_TIMEOUT_INT_MS)
+ *   ARQ_PACE_AUTO : Rate = Fenster * Paketgröße / geglättete RTT
+ *   sonst         : feste Zielrate in Bytes/s
+ * Pakete werden per Token-Bucket mit ns-Auflösung (timerfd) verteilt,
+ * statt ein freies Fenster am Stück zu senden.
+ */
+#define ARQ_PACE_AUTO  (~0UL)
+
+/* ------------------------------------------------------------
+ * Kontext-API
+ * ------------------------------------------------------------ */
+
+/* Kontext anlegen und Server auflösen (name == NULL: Loopback).
+ * Rückgabewert: Kontext oder NULL bei Fehler.
+ */
+struct arq_client *arqClientCreate(const char *name, const char *port);
+
+/* Kontext ohne Socket anlegen: Uhr und Transport kommen aus io
+ * (z.B. simulierte Strecke, siehe sim.c). Gibt keine Statusmeldungen aus. */
+struct arq_client *arqClientCreateIo(const struct arq_io *io);
+
+/* Socket schließen und Kontext freigeben. */
+void arqClientDestroy(struct arq_client *c);
+
+/* Retransmit-Timeout in ns (0 = Default GBN_TIMEOUT_UNITS Intervalle). */
+void arqClientSetRto(struct arq_client *c, unsigned long long rtoNs);
+
+void arqClientSetPacing(struct arq_client *c, unsigned long rate);
+
+/* Coalescing (Nagle, siehe REQ_F_RECS): kleine app_units werden
+ * gesammelt und mit Längenfeldern in ein Paket gepackt; gesendet wird,
+ * sobald das Paket voll ist oder der erste Record delayMs wartet.
+ * arqClientPoll() sendet sofort, wenn nichts mehr unterwegs ist, und
+ * prüft sonst die Wartezeit. Der Server gibt die Records einzeln
+ * weiter. 0 = aus (ein Paket je app_unit). Nicht im Multicast-Betrieb. */
+void arqClientSetCoalesce(struct arq_client *c, unsigned long delayMs);
+
+/* Nachrichtenmodus (teilweise Zuverlässigkeit): eine app_unit, die
+ * nach lifetimeMs noch nicht bestätigt ist oder maxRetx-mal wiederholt
+ * wurde, wird aufgegeben und geht ohne Nutzdaten als REQ_F_SKIP; der
+ * Server überspringt sie, das Fenster läuft weiter. 0 = ohne Grenze,
+ * beide 0 (Default) = voll zuverlässig. Gilt für arqClientSendData()
+ * und arqClientSendLast(), je Nachricht siehe arqClientSendMsg().
+ * Nur für Daten ohne Offsets (nicht mit Stripes, Delta, Löchern), im
+ * Multicast-Betrieb ohne Wirkung. */
+void arqClientSetPartial(struct arq_client *c, unsigned long lifetimeMs, unsigned int maxRetx);
+
+/* Mitschnitt (nach Pacing, RTO, Coalescing und Nachrichtenmodus, vor dem Hello, siehe
+ * trace.h und replay.c): jedes gesendete und empfangene Datagramm mit
+ * Zeitstempel nach path; geschrieben spätestens bei
+ * arqClientDestroy(). path == NULL beendet den Mitschnitt.
+ * Rückgabewert: 0, <0 wenn die Datei nicht geschrieben werden kann. */
+int arqClientSetTrace(struct arq_client *c, const char *path);
+
+/* io_uring statt sendto/recvfrom/poll (vor dem Hello): Antworten per
+ * Multishot-Empfang, Requests werden gesammelt und mit dem nächsten
+ * Warten in einem Systemaufruf übergeben. enable == 0 schaltet zurück.
+ * Rückgabewert: 0, <0 wenn io_uring nicht verfügbar ist (der Kontext
+ * arbeitet dann unverändert mit dem Socket). */
+int arqClientSetUring(struct arq_client *c, int enable);
+
+/* Busy-Poll (Latenz statt CPU): vor jedem blockierenden Warten bis zu
+ * spinUs Mikrosekunden nicht blockierend auf Antworten prüfen, dazu
+ * SO_BUSY_POLL am Socket. 0 = aus. */
+void arqClientSetBusyPoll(struct arq_client *c, unsigned long spinUs);
+
+/* Latenzmessung (vor dem Hello): je RTT-Probe RTT, Servicezeit des
+ * Servers (falls das ACK sie trägt, siehe ANSW_F_SVC), daraus die
+ * Netzzeit, und mit Kernel-Zeitstempeln (SO_TIMESTAMPING, nicht im
+ * io_uring-Betrieb) die lokale Wartezeit im Client; gesammelt in
+ * Histogrammen (hdr.h). enable == 0 schaltet ab und verwirft sie.
+ * Rückgabewert: 0 mit Kernel-Zeitstempeln, 1 nur Userspace-Zeiten,
+ * <0 bei Fehler. */
+int arqClientSetTimestamps(struct arq_client *c, int enable);
+
+/* Verschlüsselter Betrieb (vor dem Hello, siehe struct sec_hdr):
+ * jedes Paket mit ChaCha20-Poly1305 bzw. AES-256-GCM (mit AES-NI auf
+ * beiden Seiten), Schlüsselaustausch im Hello.
+ * psk: gemeinsames Geheimnis (32 Bytes) für die Authentisierung der
+ * Gegenstelle, NULL = ohne (nur gegen passives Mithören). Der Server
+ * muss ebenfalls verschlüsseln. Rückgabewert: 0, <0 bei Fehler. */
+int arqClientSetSecure(struct arq_client *c, int enable, const unsigned char *psk);
+
+/* Cookie-Cache (AnswCookie, siehe GBN_COOKIE_MS), den mehrere Kontexte
+ * teilen, z.B. die Stripes eines Transfers: ein Cookie je Server für
+ * GBN_COOKIE_MS, threadsicher. Ohne Cache behält jeder Kontext sein
+ * eigenes Cookie. Der Cache muss die Kontexte überleben; nur für
+ * Kontexte mit Socket (Systemuhr). */
+struct arq_cookies;
+struct arq_cookies *arqCookiesCreate(void);
+void arqCookiesDestroy(struct arq_cookies *k);
+void arqClientSetCookies(struct arq_client *c, struct arq_cookies *k);
+
+/* Perzentile der Latenz-Histogramme ausgeben (je eine Zeile, label
+ * vorangestellt); ohne arqClientSetTimestamps() nichts. */
+void arqClientReport(struct arq_client *c, FILE *out, const char *label);
+
+/* Nach erfolgreichem Close: vom Server zugesicherte Dauerhaftigkeit
+ * der Daten (DUR_*, siehe struct answer), -1 = keine Angabe. */
+int arqClientDurability(const struct arq_client *c);
+
+/* Multicast-Betrieb (vor dem Hello, siehe REQ_F_MCAST): die
+ * Server-Adresse ist eine IPv6-Multicast-Gruppe mit Interface
+ * ("ff01::4242%eth0"), receivers Server sind ihr beigetreten. Jedes
+ * Paket geht einmal an die Gruppe; Lücken melden die Empfänger per NAK,
+ * der Client wiederholt die Pakete an die Gruppe. Ohne Pacing-Vorgabe
+ * sendet er mit einer festen Default-Rate. Kein 0-RTT, keine Stripes,
+ * nicht verschlüsselt; Close ist erfolgreich, wenn alle gemeldeten
+ * Empfänger vollständig sind. receivers == 0 schaltet ab.
+ * Rückgabewert: 0, <0 bei Fehler (keine Multicast-Adresse). */
+int arqClientSetMulticast(struct arq_client *c, unsigned int receivers);
+
+/* Vor dem Hello Daten der Server-Anwendung abrufen (ReqSig, z.B. die
+ * Signatur der vorhandenen Ausgabedatei für den Delta-Modus). *out
+ * erhält einen malloc-Puffer, den der Aufrufer freigibt.
+ * Rückgabewert: Länge in Bytes, <0 bei Fehler (Server ohne solche
+ * Daten oder nicht erreichbar). */
+long arqClientFetchSig(struct arq_client *c, char **out);
+
+/* Vor dem Hello n Anfragen an die Server-Anwendung stellen (ReqSig mit
+ * Nutzdaten, z.B. Chunk-Hashes im Dedup-Modus): q[i] reist als eine
+ * Anfrage, das Ergebnis landet in ans[i].
+ * Rückgabewert: 0, <0 bei Fehler (Server ohne Anfragen oder nicht
+ * erreichbar). */
+int arqClientQuery(struct arq_client *c, const struct app_unit *q, struct app_unit *ans,
+                   unsigned long n);
+
+/* Verbindungsaufbau; info != NULL meldet den Flow als Stripe eines
+ * parallelen Transfers an (siehe struct hello_info).
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
  */
+int arqClientHello(struct arq_client *c, int winSize, const struct hello_info *info);
+
+/* 0-RTT: wie arqClientHello, die erste app_unit reist im Hello mit
+ * (siehe REQ_F_DATA); info darf NULL sein. Siehe arqSendHelloData(). */
+int arqClientHelloData(struct arq_client *c, int winSize, const struct hello_info *info,
+                       const struct app_unit *app, int fin);
+
+/* Siehe arqSendData() / arqSendHole() / arqSendLast() / arqPoll() /
+ * arqSendClose(). */
+int arqClientSendData(struct arq_client *c, const struct app_unit *app, int winSize);
+int arqClientSendMsg(struct arq_client *c, const struct app_unit *app, int winSize,
+                     unsigned long lifetimeMs, unsigned int maxRetx);
+int arqClientSendHole(struct arq_client *c, unsigned long len, int winSize);
+int arqClientSendLast(struct arq_client *c, const struct app_unit *app, int winSize);
+int arqClientSendLastMsg(struct arq_client *c, const struct app_unit *app, int winSize,
+                         unsigned long lifetimeMs, unsigned int maxRetx);
+int arqClientPoll(struct arq_client *c, int winSize);
+int arqClientSendClose(struct arq_client *c, int winSize);
+
+/* ------------------------------------------------------------
+ * Klassische API: dünne Hüllen um einen Standard-Kontext je Thread
+ * ------------------------------------------------------------ */
 
 /* UDP- und ARQ-Client initialisieren (Servername & Port) */
 void initClient(char *name, const char *port);
@@ -23,15 +189,102 @@ void closeClient(void);
  */
 int arqSendHello(int winSize);
 
+/* Wie arqSendHello, meldet den Flow aber als Stripe eines parallelen
+ * Transfers an (siehe struct hello_info). info == NULL entspricht
+ * arqSendHello().
+ */
+int arqSendHelloStripe(int winSize, const struct hello_info *info);
+
+/* 0-RTT-Verbindungsaufbau: Hello mit der ersten app_unit (app darf
+ * NULL sein). fin != 0: app ist auch die letzte app_unit; bei Erfolg
+ * ist die Übertragung dann vollständig bestätigt und geschlossen
+ * (ein Round Trip, kein arqSendClose() nötig). Ist app länger als
+ * GBN_HELLO_DATA_MAX, werden Hello und Daten getrennt gesendet.
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+int arqSendHelloData(int winSize, const struct app_unit *app, int fin);
+
 /* Eine app_unit zuverlässig zum Server übertragen.
  * Es darf pro Aufruf genau eine app_unit gesendet werden.
+ * Kehrt zurück, sobald die app_unit im Sendefenster liegt (bis zu
+ * winSize Pakete sind unbestätigt unterwegs); die Bestätigung aller
+ * Daten stellt arqSendClose() sicher.
  * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
  */
 int arqSendData(const struct app_unit *app, int winSize);
 
+/* Wie arqSendData(), aber mit eigener Frist bzw. Wiederholungsgrenze
+ * für diese app_unit (siehe arqClientSetPartial()); 0, 0 = zuverlässig.
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+int arqSendMsg(const struct app_unit *app, int winSize,
+               unsigned long lifetimeMs, unsigned int maxRetx);
+
+/* Sparse-Modus: len Nullbytes als ein Paket (REQ_F_HOLE) einreihen,
+ * der Server legt dafür ein Loch an. Wie arqSendData() nach dem Hello;
+ * nicht im Multicast-Betrieb.
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+int arqSendHole(unsigned long len, int winSize);
+
+/* Letzte app_unit senden; sie trägt das Close (REQ_F_FIN) und ersetzt
+ * arqSendClose(). Wartet, bis alle Daten bestätigt sind.
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+int arqSendLast(const struct app_unit *app, int winSize);
+
+/* Wie arqSendLast(), mit eigener Frist bzw. Wiederholungsgrenze (wie
+ * arqSendMsg()). */
+int arqSendLastMsg(const struct app_unit *app, int winSize,
+                   unsigned long lifetimeMs, unsigned int maxRetx);
+
+/* Protokoll weiterführen, ohne neue Daten zu senden (ACKs, Retransmits,
+ * Keepalive). Für Quellen, die zeitweise nichts liefern (Pipes):
+ * regelmäßig aufrufen, solange keine app_unit bereitsteht.
+ * Blockiert höchstens ein Intervall (GBN_TIMEOUT_INT_MS).
+ * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
+ */
+int arqPoll(int winSize);
+
 /* Verbindung ordentlich schließen (Close/ACK).
+ * Wartet, bis alle Daten und das Close bestätigt sind.
  * Rückgabewert: 0 bei Erfolg, !=0 bei Fehler.
  */
 int arqSendClose(int winSize);
 
+/* Pacing für den Standard-Kontext (vor arqSendHello aufrufen). */
+void arqSetPacing(unsigned long rate);
+
+/* Coalescing für den Standard-Kontext, siehe arqClientSetCoalesce(). */
+void arqSetCoalesce(unsigned long delayMs);
+
+/* Nachrichtenmodus für den Standard-Kontext, siehe arqClientSetPartial(). */
+void arqSetPartial(unsigned long lifetimeMs, unsigned int maxRetx);
+
+/* Mitschnitt für den Standard-Kontext, siehe arqClientSetTrace(). */
+int  arqSetTrace(const char *path);
+
+/* io_uring für den Standard-Kontext, siehe arqClientSetUring(). */
+int arqSetUring(int enable);
+
+/* Busy-Poll für den Standard-Kontext, siehe arqClientSetBusyPoll(). */
+void arqSetBusyPoll(unsigned long spinUs);
+
+/* Latenzmessung für den Standard-Kontext, siehe arqClientSetTimestamps()
+ * und arqClientReport() (vor closeClient() aufrufen). */
+int  arqSetTimestamps(int enable);
+void arqReport(FILE *out);
+
+/* Verschlüsselung für den Standard-Kontext, siehe arqClientSetSecure(). */
+int  arqSetSecure(int enable, const unsigned char *psk);
+
+/* Multicast für den Standard-Kontext, siehe arqClientSetMulticast(). */
+int  arqSetMulticast(unsigned int receivers);
+
+/* Abruf vor dem Hello für den Standard-Kontext, siehe arqClientFetchSig(). */
+long arqFetchSig(char **out);
+
+/* Anfragen vor dem Hello für den Standard-Kontext, siehe arqClientQuery(). */
+int  arqQuery(const struct app_unit *q, struct app_unit *ans, unsigned long n);
+
 #endif /* CLIENTSY_H */
@@ -25,17 +25,73 @@ struct app_unit {
  * ReqType:
  *   ReqHello : Verbindungsaufbau / Beginn der Übertragung
  *   ReqData  : Datenpaket
- *   ReqClose : Übertragung beendet
+ *   ReqClose : Übertragung beendet (belegt eine eigene SeNr, wird wie
+ *              ein Datenpaket nur in Reihenfolge angenommen)
+ *   ReqProbe : Zero-Window-Probe bzw. Keepalive (keine eigene SeNr,
+ *              keine Nutzdaten); der Server antwortet mit ACK und
+ *              aktuellem Fenster
+ *   ReqSig   : vor dem Hello, ohne Sitzung: Daten der Anwendung vom
+ *              Server abrufen (Delta-Modus: Signatur der vorhandenen
+ *              Ausgabedatei); SeNr = Byte-Offset darin, Antwort AnswSig.
+ *              Mit FlNr > 0 eine Anfrage an die Anwendung (Dedup-Modus:
+ *              Chunk-Hashes), SeNr = Nummer der Anfrage; AnswSig trägt
+ *              das Ergebnis. Ohne gültiges Cookie antwortet der Server
+ *              mit AnswCookie (siehe GBN_COOKIE_MS)
  *
  * SeNr   : Paketnummer (0, 1, 2, ...) im ARQ-Protokoll
- *          (keine Byteposition)
+ *          (keine Byteposition); das Hello ist immer Nummer 0
  * FlNr   : Länge der Nutzdaten in Bytes
+ * Cookie : bei ReqHello und ReqSig das Cookie aus AnswCookie
+ *          (niederwertiges Byte zuerst), 0 = keines
+ *
+ * Flags (0-RTT, ein Round Trip für kleine Dateien):
+ *   REQ_F_DATA : nur ReqHello; name[] = struct hello_info, danach die
+ *                ersten Nutzdaten (höchstens GBN_HELLO_DATA_MAX Bytes).
+ *                XferId muss != 0 sein, damit der Server ein wiederholtes
+ *                Hello erkennt und die Daten nicht doppelt schreibt.
+ *   REQ_F_FIN  : ReqHello mit REQ_F_DATA oder ReqData; das Paket trägt
+ *                die letzten Nutzdaten und schließt die Übertragung
+ *                (ersetzt ReqClose, belegt keine zusätzliche SeNr).
+ *
+ * REQ_F_MCAST: Request ging an eine Multicast-Gruppe (alle Typen, siehe
+ *              Multicast-Betrieb unten).
+ *
+ * REQ_F_HOLE : nur ReqData (Sparse-Modus); das Paket steht für einen
+ *              Bereich aus Nullbytes, name[] = Länge in Bytes (unsigned
+ *              long, FlNr = sizeof). Der Server legt ein Loch an, statt
+ *              Nullen zu schreiben (ohne Unterstützung der Anwendung
+ *              schreibt er die Nullen).
+ *
+ * REQ_F_RECS : nur ReqData (auch mit REQ_F_FIN); name[] fasst mehrere
+ *              app_units zusammen, je Record GBN_REC_HDR Bytes Länge
+ *              (unsigned short), dann die Bytes. Der Server gibt jeden
+ *              Record einzeln an die Anwendung (Grenzen bleiben
+ *              erhalten). Nicht im Multicast-Betrieb.
+ *
+ * REQ_F_SKIP : nur ReqData (auch mit REQ_F_FIN, Nachrichtenmodus); der
+ *              Sender hat die Nachricht mit dieser SeNr aufgegeben
+ *              (Frist bzw. Wiederholungen erschöpft, siehe
+ *              arqClientSetPartial). Keine Nutzdaten; der Server nimmt
+ *              das Paket in Reihenfolge an wie ein Datenpaket, gibt aber
+ *              nichts an die Anwendung. Nicht mit Striping (Offsets).
  */
 struct request {
     unsigned char  ReqType;
 #define ReqHello 'H'
 #define ReqData  'D'
 #define ReqClose 'C'
+#define ReqProbe 'P'
+#define ReqSig   'S'
+
+    unsigned char  Flags;  /* belegt bisheriges Füllbyte, 0 = keine      */
+#define GBN_COOKIE_LEN 6
+    unsigned char  Cookie[GBN_COOKIE_LEN];  /* bisherige Füllbytes   */
+#define REQ_F_DATA 0x01
+#define REQ_F_FIN  0x02
+#define REQ_F_MCAST 0x04
+#define REQ_F_HOLE  0x08
+#define REQ_F_RECS  0x10
+#define REQ_F_SKIP  0x20
 
     unsigned long  FlNr;   /* Länge der übertragenen Daten in Bytes      */
     unsigned long  SeNr;   /* Byte-Offset (Sequence Number) im File      */
@@ -43,6 +99,109 @@ struct request {
     char           name[BufferSize];  /* Nutzdaten (Zeileninhalt)       */
 };
 
+/* Optionale Nutzdaten eines ReqHello (name[], FlNr = sizeof).
+ *
+ * Beim Striping wird eine Datei in Byte-Bereiche aufgeteilt; jeder
+ * Bereich läuft als eigener GBN-Flow (eigener Socket). Alle Stripes
+ * einer Datei tragen dieselbe XferId, der Server schreibt die Daten
+ * eines Stripes ab Offset in die gemeinsame Ausgabedatei.
+ * Ein Hello ohne Nutzdaten entspricht Stripes = 1, Offset = 0
+ * (klassischer sequentieller Transfer).
+ */
+struct hello_info {
+    unsigned long  XferId;   /* Kennung des Transfers (!= 0)            */
+    unsigned long  Offset;   /* Byte-Offset des Stripes in der Datei    */
+    unsigned short Stripe;   /* Index dieses Stripes (0..Stripes-1)     */
+    unsigned short Stripes;  /* Gesamtzahl der Stripes des Transfers    */
+};
+
+#define GBN_MAX_STRIPES      16
+
+/* Längenfeld eines Records in einem REQ_F_RECS-Paket */
+#define GBN_REC_HDR          sizeof(unsigned short)
+
+/* Nutzdaten, die ein Hello mit REQ_F_DATA zusätzlich tragen kann */
+#define GBN_HELLO_DATA_MAX   (BufferSize - sizeof(struct hello_info))
+
+/* Batch-Modus (Anwendungsebene): ein Verzeichnisbaum als ein einziger
+ * Datenstrom in einer Sitzung. Der Strom beginnt mit BATCH_MAGIC, dann
+ * folgen lückenlos Records: struct batch_rec, NameLen Bytes Pfad
+ * (relativ, '/' als Trenner, ohne NUL), bei BATCH_FILE Size Bytes
+ * Inhalt. Viele kleine Dateien teilen sich so ein Paket; die Dauer
+ * hängt von der Datenmenge ab, nicht von der Anzahl der Dateien.
+ */
+#define BATCH_MAGIC          "ARQBAT01"
+#define BATCH_MAGIC_LEN      8
+
+struct batch_rec {
+    unsigned char  Type;
+#define BATCH_DIR  'D'          /* Verzeichnis anlegen                */
+#define BATCH_FILE 'F'          /* Datei, Size Bytes Inhalt folgen     */
+#define BATCH_END  'E'          /* Ende des Stroms (NameLen = 0)       */
+    unsigned char  pad;
+    unsigned short NameLen;     /* Länge des Pfads in Bytes            */
+    unsigned int   Mode;        /* Zugriffsrechte (st_mode & 0777)     */
+    unsigned long  Size;        /* Dateigröße in Bytes                 */
+};
+
+/* Delta-Modus (Anwendungsebene, rsync-Verfahren): der Client ruft vor
+ * dem Hello per ReqSig die Signatur der vorhandenen Ausgabedatei ab,
+ * struct delta_sig_hdr und je vollem Block (ein kürzerer Rest am
+ * Dateiende hat keinen Eintrag) ein struct delta_sig. Der Datenstrom
+ * beginnt dann mit DELTA_MAGIC, es folgen lückenlos Records struct
+ * delta_rec; nur geänderte Bereiche reisen als Literale.
+ */
+#define DELTA_MAGIC          "ARQDLT01"
+#define DELTA_MAGIC_LEN      8
+#define DELTA_STRONG_LEN     12
+
+struct delta_sig_hdr {
+    unsigned int   BlockSize;   /* Blockgröße in Bytes                 */
+    unsigned int   pad;
+    unsigned long  FileSize;    /* Länge der vorhandenen Datei         */
+    unsigned long  Blocks;      /* Anzahl Einträge (FileSize / BlockSize) */
+};
+
+struct delta_sig {
+    unsigned int   Weak;        /* rollende Prüfsumme des Blocks       */
+    unsigned char  Strong[DELTA_STRONG_LEN]; /* BLAKE2s, gekürzt       */
+};
+
+struct delta_rec {
+    unsigned char  Type;
+#define DELTA_COPY 'C'          /* Len Bytes ab Offset aus der alten Datei */
+#define DELTA_DATA 'L'          /* Len Bytes Literale folgen           */
+#define DELTA_END  'E'          /* Ende, Offset = Länge der neuen Datei */
+    unsigned char  pad[3];
+    unsigned int   Len;
+    unsigned long  Offset;
+};
+
+/* Dedup-Modus (Anwendungsebene, Chunk-Store des Servers): der Client
+ * zerlegt die Datei inhaltsabhängig in Chunks und fragt vor dem Hello
+ * per ReqSig mit Nutzdaten nach deren Hashes (bis zu CAS_QUERY_MAX je
+ * Anfrage, lückenlos aneinander); das Ergebnis ist eine Bitmap, Bit i
+ * gesetzt = Chunk i fehlt dem Server. Der Datenstrom beginnt dann mit
+ * CAS_MAGIC, es folgen lückenlos Records struct cas_rec; nur fehlende
+ * Chunks reisen als Daten, der Server legt sie im Store ab und setzt
+ * die Ausgabedatei aus dem Store zusammen.
+ */
+#define CAS_MAGIC            "ARQCAS01"
+#define CAS_MAGIC_LEN        8
+#define CAS_HASH_LEN         16
+#define CAS_QUERY_MAX        (BufferSize / CAS_HASH_LEN)
+
+struct cas_rec {
+    unsigned char  Type;
+#define CAS_REF   'R'           /* Chunk aus dem Store (Len Bytes)     */
+#define CAS_DATA  'L'           /* neuer Chunk, Len Bytes folgen       */
+#define CAS_END   'E'           /* Ende, Size = Länge der Datei        */
+    unsigned char  pad[3];
+    unsigned int   Len;
+    unsigned long  Size;
+    unsigned char  Hash[CAS_HASH_LEN]; /* BLAKE2s des Chunks, gekürzt */
+};
+
 /* Fehlercodes für AnswWarn / AnswErr.
  * In AnswOk hat SeNo eine andere Bedeutung (siehe struct answer).
  */
@@ -61,24 +220,171 @@ enum {
  *  - AnswOk  : SeNo = Nummer des nächsten erwarteten Pakets
  *              (kumulativ: alle Pakete mit SeNr < SeNo sind korrekt angekommen)
  *  - AnswWarn/AnswErr : SeNo = Fehlercode (ERR_*)
+ *  - AnswSig : SeNo = Offset, FlNr = Gesamtlänge der abgerufenen Daten;
+ *              der Abschnitt folgt der Antwort (struct answer_data).
+ *              Auf eine Anfrage: SeNo = ihre Nummer, FlNr = Länge des
+ *              Ergebnisses
+ *  - AnswNak : SeNo = erstes fehlendes Paket, FlNr = Anzahl fehlender
+ *              Pakete ab SeNo; für SeNr < SeNo kumulativ wie AnswOk
+ *              (Lückenmeldung, siehe GBN_NAK_MS und Multicast-Betrieb)
+ *  - AnswCookie : SeNo = Cookie für den wiederholten Request (Hello
+ *              oder ReqSig, siehe GBN_COOKIE_MS)
+ *
+ * Flusskontrolle: mit ANSW_F_WND in Flags ist FlNr das Empfangsfenster,
+ * d.h. die Anzahl Pakete ab SeNo, die der Server noch aufnehmen kann.
+ * Der Client hält höchstens so viele Pakete unterwegs; bei FlNr = 0
+ * sendet er nur noch ReqProbe (Persist-Timer), bis sich das Fenster
+ * wieder öffnet. Ohne ANSW_F_WND gilt nur das eigene Sendefenster.
+ *
+ * Mit ANSW_F_SVC ist SvcUs die Servicezeit des Servers in µs: vom
+ * Kernel-Empfangszeitstempel des (zuletzt angenommenen) Requests bis
+ * zum Versand dieser Antwort. Der Client trennt damit Netz- und
+ * Serverzeit in der RTT. SvcUs und Durable belegen bisherige
+ * Füllbytes, die Größe der Antwort bleibt gleich.
+ *
+ * Abschluss-ACK (auf Close bzw. REQ_F_FIN, nach dem letzten Stripe):
+ * mit ANSW_F_DUR meldet Durable, was der Server vor dem Senden für die
+ * Daten des Transfers garantiert (DUR_*). Ohne ANSW_F_DUR ist nichts
+ * bekannt (z.B. weitere Stripes noch offen). Scheitert die
+ * Sicherung, kommt statt des ACKs AnswErr mit ERR_FILE_ERROR.
  */
 struct answer {
     unsigned char AnswType;
 #define AnswHello 'H'
 #define AnswOk    'O'
 #define AnswWarn  'W'
+#define AnswSig   'S'
+#define AnswNak   'N'
+#define AnswCookie 'K'
 #define AnswErr   0xFF
 
-    unsigned long FlNr;  /* derzeit ungenutzt, für spätere Erweiterungen */
+    unsigned char Flags; /* belegt bisheriges Füllbyte, 0 = keine Angaben */
+#define ANSW_F_WND 0x01  /* FlNr enthält das Empfangsfenster               */
+#define ANSW_F_SVC 0x02  /* SvcUs enthält die Servicezeit                 */
+#define ANSW_F_DUR 0x04  /* Durable enthält die Dauerhaftigkeit           */
+
+    unsigned short Durable; /* DUR_* (bei ANSW_F_DUR)                     */
+#define DUR_NONE      0  /* im Page Cache, Stromausfall kann Daten kosten */
+#define DUR_WRITEBACK 1  /* Rückschreiben angestoßen, nicht abgewartet    */
+#define DUR_SYNC      2  /* fdatasync: Daten auf stabilem Speicher        */
+
+    unsigned int  SvcUs; /* Servicezeit in µs (bei ANSW_F_SVC)             */
+
+    unsigned long FlNr;  /* Empfangsfenster in Paketen (bei ANSW_F_WND)  */
     unsigned long SeNo;  /* siehe Erklärung oben                          */
 
 #define ErrNo SeNo       /* Alias: bei Warn/Err ist SeNo der Fehlercode   */
 };
 
+/* Antwort mit Nutzdaten (AnswSig, Kennung im Multicast-Betrieb) */
+struct answer_data {
+    struct answer  Answ;
+    char           Data[BufferSize];
+};
+
+/* Multicast-Betrieb (REQ_F_MCAST): der Client sendet jedes Paket
+ * einmal an eine IPv6-Multicast-Gruppe; jeder Server der Gruppe ist
+ * ein Empfänger mit eigener Sitzung und antwortet per Unicast:
+ *   - AnswHello auf das Hello (XferId Pflicht, ohne REQ_F_DATA),
+ *   - AnswOk nur alle GBN_MC_ACK_EVERY Pakete sowie auf ReqProbe und
+ *     das Close,
+ *   - AnswNak bei einer Lücke, je Lücke höchstens alle GBN_MC_NAK_MS;
+ *     der Client wiederholt die fehlenden Pakete an die Gruppe.
+ * Duplikate bleiben unbeantwortet. Pakete hinter einer Lücke puffert der
+ * Empfänger (bis GBN_MC_WINDOW ab nextExpected), der Client hält
+ * höchstens so viele Pakete über dem langsamsten Empfänger. Jede Antwort
+ * trägt als Nutzdaten (struct answer_data) die Kennung des Empfängers
+ * (GBN_MC_ID_LEN Bytes): Empfänger auf einem Rechner teilen sich Adresse
+ * und Port. Nicht mit Verschlüsselung kombinierbar.
+ */
+#define GBN_MC_WINDOW        512
+#define GBN_MC_ACK_EVERY     64
+#define GBN_MC_NAK_MS        20
+#define GBN_MC_MAX_RX        64   /* Empfänger je Sender                */
+#define GBN_MC_ID_LEN        8
+
+/* Verschlüsselter Betrieb (ChaCha20-Poly1305 bzw. AES-256-GCM, siehe aead.h).
+ *
+ * Jedes Paket wird in einen Umschlag gesteckt:
+ *   struct sec_hdr | [Pub, nur SEC_HELLO] | Chiffrat | Tag (16 Bytes)
+ * Der Kopf (und Pub) ist unverschlüsselt, aber authentifiziert. Das
+ * Chiffrat ist ein struct request (nur Kopf und FlNr Bytes von name[],
+ * der Empfänger füllt den Rest mit Nullen) bzw. ein struct answer
+ * (AnswSig mit seinen Nutzdaten).
+ *
+ * Schlüsselaustausch im Hello (kein zusätzlicher Round Trip):
+ *   - Der Client sendet ReqHello als SEC_HELLO mit seinem X25519-
+ *     Schlüssel in Pub, versiegelt mit dem Hello-Schlüssel (aus PSK und
+ *     Pub); 0-RTT-Daten im Hello sind damit ebenfalls geschützt.
+ *   - Der Server antwortet mit AnswHello als SEC_HELLO mit seinem
+ *     Schlüssel in Pub, versiegelt mit dem Sitzungsschlüssel. Alle
+ *     weiteren Pakete sind SEC_DATA mit den Sitzungsschlüsseln.
+ *   - Das Verfahren der Sitzungsschlüssel handeln Hello und AnswHello
+ *     in Alg aus: der Server wählt AES-256-GCM, wenn der Client es
+ *     anbietet und beide AES-NI haben, sonst ChaCha20-Poly1305. Hello,
+ *     AnswCookie und alle Pakete mit dem Hello-Schlüssel bleiben bei
+ *     ChaCha20-Poly1305.
+ *   - Antworten auf ein Hello ohne Sitzung (z.B. AnswErr) tragen ein
+ *     Pub aus Nullen und sind mit dem Hello-Schlüssel versiegelt;
+ *     ebenso ReqSig und AnswSig vor dem Hello.
+ * Ctr zählt je Richtung und Schlüssel und bildet die Nonce; beim Server
+ * ist zusätzlich Bit 63 gesetzt. Ohne gemeinsames Geheimnis (PSK) ist
+ * der PSK 32 Nullbytes: vertraulich gegen passive Mithörer, aber ohne
+ * Authentisierung der Gegenstelle.
+ */
+struct sec_hdr {
+    unsigned char Magic;
+#define SEC_HELLO 'k'    /* Pub folgt dem Kopf                            */
+#define SEC_DATA  'e'
+    unsigned char Cookie[GBN_COOKIE_LEN]; /* SEC_HELLO des Clients: Cookie
+                            des Requests im Klartext, sonst 0            */
+    unsigned char Alg;   /* SEC_HELLO des Clients: angebotene Verfahren
+                            (Bitmaske 1 << AEAD_*), AnswHello: gewähltes
+                            Verfahren (AEAD_*), sonst 0                  */
+    unsigned long Ctr;   /* Paketzähler der Richtung (Nonce)              */
+};
+
+#define SEC_PUB_LEN     32
+#define SEC_TAG_LEN     16
+#define SEC_OVERHEAD    (sizeof(struct sec_hdr) + SEC_PUB_LEN + SEC_TAG_LEN)
+#define SEC_MAX_PACKET  (sizeof(struct request) + SEC_OVERHEAD)
+
 /* ARQ-Protokollparameter (Client-Seite, zentral dokumentiert) */
 #define GBN_MAX_WINDOW       10
 #define GBN_BUFFER_SIZE      (2 * GBN_MAX_WINDOW) // als Ringpuffer zu implementieren auf Client-Seite
 #define GBN_TIMEOUT_INT_MS   100  /* Zeiteinheit eines Intervalls in Millisekunden */
 #define GBN_TIMEOUT_UNITS    3    /* Timeout in Einheiten à TIMEOUT_INT   */
+#define GBN_HELLO_UNITS      50   /* Frist für den Verbindungsaufbau       */
+#define GBN_GIVEUP_UNITS     20000 /* Abbruch ohne Fortschritt (base fest)  */
+#define GBN_PERSIST_UNITS    20   /* max. Abstand der Zero-Window-Proben   */
+#define GBN_KEEPALIVE_UNITS  100  /* Probe nach so langer Sendepause        */
+
+/* Lückenmeldung (Server-Seite): statt eines doppelten ACKs meldet der
+ * Server eine Lücke (SeNr > nextExpected bei ReqData/ReqClose) sofort
+ * mit AnswNak, dieselbe Lücke höchstens alle GBN_NAK_MS. Besteht sie
+ * weiter, wiederholt ein Timer den NAK bis zu GBN_NAK_RETRIES mal. Der
+ * Client geht auf AnswNak sofort auf SeNo zurück (Go-Back-N); die
+ * Reparatur kostet so eine Laufzeit statt eines Retransmit-Timeouts. */
+#define GBN_NAK_MS           10
+#define GBN_NAK_RETRIES      3
+
+/* Cookie im Verbindungsaufbau (Server-Seite, abschaltbar): unter Last
+ * (viele neue Hellos, volle Sitzungstabelle) beantwortet der Server ein
+ * Hello ohne gültiges Cookie zustandslos mit AnswCookie, erst das Hello
+ * mit Cookie legt Sitzung und Datei an; ohne Last kostet der Transfer
+ * keinen zusätzlichen Round Trip. ReqSig ohne Sitzung verlangt immer ein
+ * Cookie (die Anwendung rechnet dafür, z.B. eine Signatur über die
+ * ganze Datei). Das Cookie ist ein MAC (BLAKE2s mit
+ * Server-Geheimnis, gekürzt auf GBN_COOKIE_LEN Bytes) über die
+ * Absenderadresse ohne Port und den Zeitabschnitt (GBN_COOKIE_MS); es
+ * gilt im laufenden und im vorigen Abschnitt. Der Client wiederholt
+ * den Request (mit 0-RTT-Daten) sofort mit dem Cookie und behält es je
+ * Server für weitere Verbindungen. Im verschlüsselten Betrieb steht es
+ * zusätzlich im Klartext im Umschlag (struct sec_hdr): ein gefälschtes
+ * Hello kostet einen Hash und eine kleine Antwort, keine Entschlüsselung.
+ * AnswCookie ist dann mit dem Hello-Schlüssel des Requests versiegelt
+ * (Pub aus Nullen), der Client verwirft Cookies im Klartext.
+ * Multicast-Hellos sind ausgenommen. */
+#define GBN_COOKIE_MS        10000
 
 #endif /* DATA_H_INCLUDED */
@@ -0,0 +1,261 @@
+/* delta.c - rsync-artige Delta-Übertragung, siehe delta.h */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "data.h"
+#include "aead.h"
+#include "delta.h"
+
+#define DELTA_MIN_BLOCK  512UL
+#define DELTA_MAX_BLOCK  (64UL << 10)
+#define DELTA_MAX_REC    (1UL << 30)      /* größter Len eines Records */
+
+unsigned long deltaBlockSize(unsigned long size)
+{
+    unsigned long bs = DELTA_MIN_BLOCK;
+
+    while (bs < DELTA_MAX_BLOCK && bs * bs < size) bs <<= 1;
+    return bs;
+}
+
+/* Schwache Prüfsumme (wie rsync): s1 = Summe der Bytes, s2 = Summe der
+ * Teilsummen, je 16 Bit. s1/s2 bleiben für das Rollen erhalten. */
+static uint32_t weak_sum(const unsigned char *p, unsigned long n, uint32_t *s1, uint32_t *s2)
+{
+    uint32_t a = 0, b = 0;
+
+    for (unsigned long i = 0; i < n; i++) {
+        a += p[i];
+        b += a;
+    }
+    *s1 = a;
+    *s2 = b;
+    return (a & 0xffff) | (b << 16);
+}
+
+static void strong_sum(const unsigned char *p, unsigned long n, unsigned char out[DELTA_STRONG_LEN])
+{
+    uint8_t full[32];
+
+    aeadHash(full, NULL, 0, p, n);
+    memcpy(out, full, DELTA_STRONG_LEN);
+}
+
+/* n Bytes ab off lesen; kürzere Datei ist ein Fehler */
+static int read_at(int fd, unsigned char *buf, unsigned long n, unsigned long off)
+{
+    while (n > 0) {
+        ssize_t got = pread(fd, buf, n, (off_t)off);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        buf += got;
+        off += (unsigned long)got;
+        n -= (unsigned long)got;
+    }
+    return 0;
+}
+
+int deltaSignature(int fd, unsigned long size, char **out, unsigned long *outLen)
+{
+    unsigned long bs = deltaBlockSize(size);
+    unsigned long blocks = size / bs;
+    unsigned long len = sizeof(struct delta_sig_hdr) + blocks * sizeof(struct delta_sig);
+    struct delta_sig_hdr *h;
+    struct delta_sig *e;
+    unsigned char *blk;
+    uint32_t s1, s2;
+    char *buf;
+
+    buf = malloc(len);
+    blk = malloc(bs);
+    if (buf == NULL || blk == NULL) goto fail;
+
+    h = (struct delta_sig_hdr *)buf;
+    e = (struct delta_sig *)(buf + sizeof(*h));
+    memset(h, 0, sizeof(*h));
+    h->BlockSize = (unsigned int)bs;
+    h->FileSize  = size;
+    h->Blocks    = blocks;
+    for (unsigned long i = 0; i < blocks; i++) {
+        if (read_at(fd, blk, bs, i * bs) < 0) goto fail;
+        e[i].Weak = weak_sum(blk, bs, &s1, &s2);
+        strong_sum(blk, bs, e[i].Strong);
+    }
+    free(blk);
+    *out = buf;
+    *outLen = len;
+    return 0;
+
+fail:
+    free(blk);
+    free(buf);
+    return -1;
+}
+
+/* --- Kodierer --- */
+
+struct delta_enc {
+    deltaEmitFn         emit;
+    void               *user;
+    unsigned long       copyOff, copyLen;   /* zusammenhängende Kopie, noch offen */
+    struct delta_stats  st;
+};
+
+static int enc_rec(struct delta_enc *e, unsigned char type, unsigned long len, unsigned long off)
+{
+    struct delta_rec rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.Type   = type;
+    rec.Len    = (unsigned int)len;
+    rec.Offset = off;
+    return e->emit(e->user, &rec, sizeof(rec));
+}
+
+static int enc_flush_copy(struct delta_enc *e)
+{
+    while (e->copyLen > 0) {
+        unsigned long n = (e->copyLen < DELTA_MAX_REC) ? e->copyLen : DELTA_MAX_REC;
+        if (enc_rec(e, DELTA_COPY, n, e->copyOff) < 0) return -1;
+        e->copyOff += n;
+        e->copyLen -= n;
+    }
+    return 0;
+}
+
+/* Aufeinanderfolgende Blöcke der alten Datei zu einem Record verbinden */
+static int enc_copy(struct delta_enc *e, unsigned long off, unsigned long len)
+{
+    e->st.copied += len;
+    if (e->copyLen > 0 && e->copyOff + e->copyLen == off) {
+        e->copyLen += len;
+        return 0;
+    }
+    if (enc_flush_copy(e) < 0) return -1;
+    e->copyOff = off;
+    e->copyLen = len;
+    return 0;
+}
+
+static int enc_literal(struct delta_enc *e, const unsigned char *p, unsigned long len)
+{
+    if (len == 0) return 0;
+    if (enc_flush_copy(e) < 0) return -1;
+    e->st.literal += len;
+    while (len > 0) {
+        unsigned long n = (len < DELTA_MAX_REC) ? len : DELTA_MAX_REC;
+        if (enc_rec(e, DELTA_DATA, n, 0) < 0 || e->emit(e->user, p, n) < 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Block mit Prüfsumme weak suchen, den auf den letzten Treffer
+ * folgenden zuerst (hält Kopien zusammenhängend). Die starke
+ * Prüfsumme wird nur bei passender schwacher berechnet.
+ * Rückgabewert: Blocknummer, -1 = keiner. */
+static long find_block(const struct delta_sig *sig, const int32_t *head, const int32_t *next,
+                       uint32_t mask, uint32_t weak, const unsigned char *p,
+                       unsigned long bs, long prefer)
+{
+    unsigned char strong[DELTA_STRONG_LEN];
+    int haveStrong = 0;
+
+    if (prefer >= 0 && sig[prefer].Weak == weak) {
+        strong_sum(p, bs, strong);
+        haveStrong = 1;
+        if (memcmp(strong, sig[prefer].Strong, DELTA_STRONG_LEN) == 0) return prefer;
+    }
+    for (int32_t i = head[(weak ^ (weak >> 16)) & mask]; i >= 0; i = next[i]) {
+        if (sig[i].Weak != weak) continue;
+        if (!haveStrong) {
+            strong_sum(p, bs, strong);
+            haveStrong = 1;
+        }
+        if (memcmp(strong, sig[i].Strong, DELTA_STRONG_LEN) == 0) return i;
+    }
+    return -1;
+}
+
+int deltaEncode(const char *sig, unsigned long sigLen,
+                const unsigned char *data, unsigned long size,
+                deltaEmitFn emit, void *user, struct delta_stats *st)
+{
+    struct delta_sig_hdr h;
+    const struct delta_sig *ent;
+    struct delta_enc e;
+    int32_t *head = NULL, *next = NULL;
+    uint32_t mask = 0, s1 = 0, s2 = 0, weak;
+    unsigned long bs, blocks, pos = 0, lit = 0;
+    long prefer = -1;
+    int rc = -1;
+
+    if (sigLen < sizeof(h)) return -1;
+    memcpy(&h, sig, sizeof(h));
+    bs = h.BlockSize;
+    blocks = h.Blocks;
+    if (bs == 0 || bs > DELTA_MAX_BLOCK || blocks > INT32_MAX ||
+        sigLen != sizeof(h) + blocks * sizeof(struct delta_sig))
+        return -1;
+    ent = (const struct delta_sig *)(sig + sizeof(h));
+
+    memset(&e, 0, sizeof(e));
+    e.emit = emit;
+    e.user = user;
+    if (emit(user, DELTA_MAGIC, DELTA_MAGIC_LEN) < 0) return -1;
+
+    if (blocks > 0 && size >= bs) {
+        /* Hashtabelle über die schwachen Prüfsummen (Ketten über next) */
+        uint32_t tbl = 1;
+        while (tbl < 2 * blocks) tbl <<= 1;
+        mask = tbl - 1;
+        head = malloc(tbl * sizeof(*head));
+        next = malloc(blocks * sizeof(*next));
+        if (head == NULL || next == NULL) goto out;
+        memset(head, 0xff, tbl * sizeof(*head));
+        for (long i = (long)blocks - 1; i >= 0; i--) {
+            uint32_t slot = (ent[i].Weak ^ (ent[i].Weak >> 16)) & mask;
+            next[i] = head[slot];
+            head[slot] = (int32_t)i;
+        }
+
+        weak = weak_sum(data, bs, &s1, &s2);
+        for (;;) {
+            long idx = find_block(ent, head, next, mask, weak, data + pos, bs, prefer);
+            if (idx >= 0) {
+                if (enc_literal(&e, data + lit, pos - lit) < 0 ||
+                    enc_copy(&e, (unsigned long)idx * bs, bs) < 0)
+                    goto out;
+                pos += bs;
+                lit = pos;
+                prefer = ((unsigned long)idx + 1 < blocks) ? idx + 1 : -1;
+                if (pos + bs > size) break;
+                weak = weak_sum(data + pos, bs, &s1, &s2);
+                continue;
+            }
+            if (pos + bs >= size) break;
+            /* Fenster um ein Byte weiterschieben */
+            s1 = s1 - data[pos] + data[pos + bs];
+            s2 = s2 - (uint32_t)bs * data[pos] + s1;
+            weak = (s1 & 0xffff) | (s2 << 16);
+            pos++;
+        }
+    }
+
+    if (enc_literal(&e, data + lit, size - lit) < 0 ||
+        enc_flush_copy(&e) < 0 ||
+        enc_rec(&e, DELTA_END, 0, size) < 0)
+        goto out;
+    if (st) *st = e.st;
+    rc = 0;
+
+out:
+    free(head);
+    free(next);
+    return rc;
+}
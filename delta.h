@@ -0,0 +1,41 @@
+#ifndef DELTA_H_INCLUDED
+#define DELTA_H_INCLUDED
+
+/*
+ * Delta-Übertragung nach dem rsync-Verfahren (Formate siehe struct
+ * delta_sig und struct delta_rec in data.h):
+ *   - der Server zerlegt seine vorhandene Ausgabedatei in Blöcke fester
+ *     Größe und liefert je Block eine schwache, rollende Prüfsumme und
+ *     eine starke (BLAKE2s, gekürzt) als Signatur
+ *   - der Client schiebt ein Fenster byteweise über seine Eingabe; passt
+ *     die rollende Summe (O(1) je Byte) zu einem Block und bestätigt die
+ *     starke Prüfsumme den Treffer, sendet er einen Kopierverweis statt
+ *     der Daten, sonst Literale
+ * Die Datenmenge wächst so mit der Änderung, nicht mit der Dateigröße.
+ */
+
+/* Blockgröße für eine Datei mit size Bytes (etwa Wurzel aus size) */
+unsigned long deltaBlockSize(unsigned long size);
+
+/* Signatur der Datei fd (size Bytes) in einem malloc-Puffer.
+ * Rückgabewert: 0, <0 bei Lese- oder Speicherfehler. */
+int deltaSignature(int fd, unsigned long size, char **out, unsigned long *outLen);
+
+/* Ausgabe des Kodierers: die nächsten len Bytes des Delta-Stroms.
+ * Rückgabewert: 0, <0 bricht die Kodierung ab. */
+typedef int (*deltaEmitFn)(void *user, const void *buf, unsigned long len);
+
+struct delta_stats {
+    unsigned long copied;    /* aus der alten Datei übernommene Bytes */
+    unsigned long literal;   /* als Literale gesendete Bytes          */
+};
+
+/* data (size Bytes) gegen die Signatur sig kodieren: vollständiger
+ * Strom von DELTA_MAGIC bis DELTA_END. st darf NULL sein.
+ * Rückgabewert: 0, <0 bei ungültiger Signatur, Speichermangel oder
+ * Abbruch durch emit. */
+int deltaEncode(const char *sig, unsigned long sigLen,
+                const unsigned char *data, unsigned long size,
+                deltaEmitFn emit, void *user, struct delta_stats *st);
+
+#endif /* DELTA_H_INCLUDED */
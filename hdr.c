@@ -0,0 +1,83 @@
+/* hdr.c - log-lineares Latenz-Histogramm, siehe hdr.h */
+
+#include <string.h>
+
+#include "hdr.h"
+
+static unsigned int value_index(unsigned long long v)
+{
+    unsigned int b;
+
+    if (v < HDR_SUB) return (unsigned int)v;
+    b = (unsigned int)(63 - __builtin_clzll(v)) - HDR_SUB_BITS;   /* v >> b in [SUB, 2*SUB) */
+    return (b + 1) * HDR_SUB + (unsigned int)((v >> b) - HDR_SUB);
+}
+
+/* Obergrenze des Fachs i */
+static unsigned long long index_value(unsigned int i)
+{
+    unsigned int b;
+    unsigned long long sub;
+
+    if (i < HDR_SUB) return i;
+    b = i / HDR_SUB - 1;
+    sub = i % HDR_SUB + HDR_SUB;
+    return ((sub + 1) << b) - 1;
+}
+
+void hdrInit(struct hdr_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = ~0ULL;
+}
+
+void hdrRecord(struct hdr_hist *h, unsigned long long value)
+{
+    h->counts[value_index(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void hdrAdd(struct hdr_hist *dst, const struct hdr_hist *src)
+{
+    for (unsigned int i = 0; i < HDR_BUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+    dst->count += src->count;
+    dst->sum   += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+unsigned long long hdrPercentile(const struct hdr_hist *h, double p)
+{
+    unsigned long long want, seen = 0;
+
+    if (h->count == 0) return 0;
+    if (p >= 100.0) return h->max;
+    want = (unsigned long long)(p / 100.0 * (double)h->count + 0.5);
+    if (want < 1) want = 1;
+
+    for (unsigned int i = 0; i < HDR_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            unsigned long long v = index_value(i);
+            return (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+void hdrPrintUs(FILE *out, const char *label, const struct hdr_hist *h)
+{
+    if (h->count == 0) {
+        fprintf(out, "%s: keine Messwerte\n", label);
+        return;
+    }
+    fprintf(out, "%s [us]: n=%llu min=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            label, h->count, h->min / 1e3,
+            hdrPercentile(h, 50.0) / 1e3, hdrPercentile(h, 90.0) / 1e3,
+            hdrPercentile(h, 99.0) / 1e3, hdrPercentile(h, 99.9) / 1e3,
+            h->max / 1e3);
+}
@@ -0,0 +1,40 @@
+#ifndef HDR_H_INCLUDED
+#define HDR_H_INCLUDED
+
+#include <stdio.h>
+
+/*
+ * Latenz-Histogramm nach dem HDR-Prinzip (log-linear).
+ *
+ * Werte bis 2^HDR_SUB_BITS werden exakt gezählt, darüber teilt sich jede
+ * Zweierpotenz in 2^HDR_SUB_BITS gleich breite Fächer: relative
+ * Auflösung ~3 % über den ganzen Wertebereich (ns bis Stunden), feste
+ * Größe, O(1) je Eintrag, keine Allokation. Perzentile liefern die
+ * Obergrenze des Fachs ("höchster äquivalenter Wert").
+ */
+
+#define HDR_SUB_BITS  5
+#define HDR_SUB       (1u << HDR_SUB_BITS)
+#define HDR_BUCKETS    ((64 - HDR_SUB_BITS + 1) * HDR_SUB)
+
+struct hdr_hist {
+    unsigned long long count;
+    unsigned long long min, max;
+    unsigned long long sum;
+    unsigned long long counts[HDR_BUCKETS];
+};
+
+void hdrInit(struct hdr_hist *h);
+void hdrRecord(struct hdr_hist *h, unsigned long long value);
+
+/* src zu dst addieren (z.B. Stripes zusammenfassen) */
+void hdrAdd(struct hdr_hist *dst, const struct hdr_hist *src);
+
+/* Wert, unter dem p Prozent (0..100) der Einträge liegen; 0 ohne Einträge. */
+unsigned long long hdrPercentile(const struct hdr_hist *h, double p);
+
+/* Eine Zeile: n, min, p50, p90, p99, p99.9, max in Mikrosekunden
+ * (Werte in ns erfasst). */
+void hdrPrintUs(FILE *out, const char *label, const struct hdr_hist *h);
+
+#endif /* HDR_H_INCLUDED */
@@ -0,0 +1,59 @@
+/* pacer.c - Token-Bucket-Pacing mit Nanosekunden-Auflösung */
+
+#include <errno.h>
+#include <time.h>
+
+#include "pacer.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+unsigned long long pacerNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * NS_PER_SEC + (unsigned long long)ts.tv_nsec;
+}
+
+static unsigned long long bytes_to_ns(unsigned long long rate, unsigned long bytes)
+{
+    if (rate == 0) return 0;
+    return (unsigned long long)bytes * NS_PER_SEC / rate;
+}
+
+void pacerInit(struct pacer *p, unsigned long long rate, unsigned long burst)
+{
+    p->nextNs = 0;
+    pacerSetRate(p, rate, burst);
+}
+
+void pacerSetRate(struct pacer *p, unsigned long long rate, unsigned long burst)
+{
+    p->rate    = rate;
+    p->burstNs = bytes_to_ns(rate, burst);
+}
+
+unsigned long long pacerReadyAt(const struct pacer *p, unsigned long long now)
+{
+    if (p->rate == 0) return now;
+    if (p->nextNs <= now + p->burstNs) return now;
+    return p->nextNs - p->burstNs;
+}
+
+void pacerConsume(struct pacer *p, unsigned long bytes, unsigned long long now)
+{
+    if (p->rate == 0) return;
+
+    /* Ungenutztes Guthaben verfällt oberhalb der Bucket-Tiefe */
+    if (p->nextNs + p->burstNs < now)
+        p->nextNs = now - p->burstNs;
+    p->nextNs += bytes_to_ns(p->rate, bytes);
+}
+
+void pacerSleepUntil(unsigned long long untilNs)
+{
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(untilNs / NS_PER_SEC);
+    ts.tv_nsec = (long)(untilNs % NS_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
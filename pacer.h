@@ -0,0 +1,38 @@
+#ifndef PACER_H_INCLUDED
+#define PACER_H_INCLUDED
+
+/*
+ * Token-Bucket-Pacer für den Sender.
+ *
+ * Statt ein ganzes Fenster am Stück zu senden, werden Pakete mit einer
+ * Zielrate (Bytes/s) verteilt. Implementiert als "virtueller Fahrplan":
+ * jedes Paket verschiebt nextNs um seine Sendedauer bei Zielrate; ein
+ * Paket darf gehen, sobald now >= nextNs - burstNs (Bucket-Tiefe).
+ * Alle Zeiten in Nanosekunden auf CLOCK_MONOTONIC.
+ */
+
+struct pacer {
+    unsigned long long rate;     /* Zielrate in Bytes/s, 0 = kein Pacing  */
+    unsigned long long burstNs;  /* Bucket-Tiefe als Zeitguthaben         */
+    unsigned long long nextNs;   /* frühester Sendezeitpunkt ohne Guthaben */
+};
+
+/* Monotone Uhr in Nanosekunden */
+unsigned long long pacerNowNs(void);
+
+/* Pacer auf rate Bytes/s setzen, burst = Bucket-Tiefe in Bytes. */
+void pacerInit(struct pacer *p, unsigned long long rate, unsigned long burst);
+
+/* Rate ändern, ohne den Fahrplan zurückzusetzen. */
+void pacerSetRate(struct pacer *p, unsigned long long rate, unsigned long burst);
+
+/* Frühester Zeitpunkt, zu dem ein Paket gesendet werden darf. */
+unsigned long long pacerReadyAt(const struct pacer *p, unsigned long long now);
+
+/* Gesendetes Paket mit bytes Länge verbuchen. */
+void pacerConsume(struct pacer *p, unsigned long bytes, unsigned long long now);
+
+/* Mit clock_nanosleep bis zum absoluten Zeitpunkt untilNs schlafen. */
+void pacerSleepUntil(unsigned long long untilNs);
+
+#endif /* PACER_H_INCLUDED */
@@ -0,0 +1,219 @@
+/* readahead.c - Vorauslesen in einem eigenen Thread, siehe readahead.h */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include "data.h"
+#include "readahead.h"
+
+#define RA_SLOTS      16                /* Blöcke im Ring                  */
+#define RA_BLOCK      (64UL << 10)      /* Größe eines Blocks (ein pread)  */
+#define RA_WILLNEED   (4UL << 20)       /* so weit voraus WILLNEED melden  */
+
+struct ra_block {
+    unsigned long   len;
+    char            data[RA_BLOCK];
+};
+
+/*
+ * head schreibt nur der Thread (Erzeuger), tail nur der Sender
+ * (Verbraucher); beide in eigenen Cache-Zeilen. Block i % RA_SLOTS ist
+ * belegt für tail <= i < head. Wer warten will, setzt sein *Waiting,
+ * prüft den Ring erneut und schläft dann am eventfd; die Gegenseite
+ * weckt nur, wenn das Flag gesetzt ist.
+ */
+struct read_ahead {
+    int              fd;
+    pthread_t        thread;
+    int              dataFd;      /* Ring nicht mehr leer (weckt Sender) */
+    int              spaceFd;     /* Ring nicht mehr voll (weckt Thread) */
+    struct ra_block *ring;
+    off_t            off;         /* nur Thread: nächste Leseposition    */
+
+    /* nur Sender: Position im Block tail, angefangene Zeile */
+    unsigned long    pos;
+    unsigned long    lineLen;
+    struct app_unit  unit;
+
+    unsigned long    head __attribute__((aligned(64)));
+    int              done;        /* 1 = Ende der Datei, -1 = Lesefehler */
+    int              prodWaiting;
+
+    unsigned long    tail __attribute__((aligned(64)));
+    int              consWaiting;
+    int              stop;
+};
+
+static void ev_signal(int fd)
+{
+    uint64_t one = 1;
+    (void)!write(fd, &one, sizeof(one));
+}
+
+static void ev_drain(int fd)
+{
+    uint64_t n;
+    (void)!read(fd, &n, sizeof(n));
+}
+
+/* Erzeuger: auf einen freien Block warten. Rückgabewert: 0, <0 bei raStop */
+static int wait_space(struct read_ahead *ra, unsigned long head)
+{
+    while (head - __atomic_load_n(&ra->tail, __ATOMIC_ACQUIRE) >= RA_SLOTS) {
+        __atomic_store_n(&ra->prodWaiting, 1, __ATOMIC_SEQ_CST);
+        if (head - __atomic_load_n(&ra->tail, __ATOMIC_SEQ_CST) >= RA_SLOTS &&
+            !__atomic_load_n(&ra->stop, __ATOMIC_SEQ_CST))
+            ev_drain(ra->spaceFd);
+        __atomic_store_n(&ra->prodWaiting, 0, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&ra->stop, __ATOMIC_ACQUIRE)) return -1;
+    }
+    return 0;
+}
+
+static void wake_consumer(struct read_ahead *ra)
+{
+    if (__atomic_load_n(&ra->consWaiting, __ATOMIC_SEQ_CST))
+        ev_signal(ra->dataFd);
+}
+
+static void *reader(void *arg)
+{
+    struct read_ahead *ra = arg;
+    unsigned long head = 0;
+    ssize_t got;
+
+    (void)posix_fadvise(ra->fd, ra->off, 0, POSIX_FADV_SEQUENTIAL);
+    (void)posix_fadvise(ra->fd, ra->off, RA_WILLNEED, POSIX_FADV_WILLNEED);
+
+    for (;;) {
+        struct ra_block *b = &ra->ring[head % RA_SLOTS];
+
+        if (wait_space(ra, head) < 0) return NULL;
+        do {
+            got = pread(ra->fd, b->data, RA_BLOCK, ra->off);
+        } while (got < 0 && errno == EINTR);
+        if (got <= 0) break;
+
+        /* Kernel rechtzeitig weiterlesen lassen */
+        if ((ra->off + got) / (RA_WILLNEED / 2) != ra->off / (RA_WILLNEED / 2))
+            (void)posix_fadvise(ra->fd, ra->off + got, RA_WILLNEED, POSIX_FADV_WILLNEED);
+        ra->off += got;
+        b->len = (unsigned long)got;
+
+        __atomic_store_n(&ra->head, ++head, __ATOMIC_SEQ_CST);
+        wake_consumer(ra);
+    }
+    __atomic_store_n(&ra->done, got < 0 ? -1 : 1, __ATOMIC_SEQ_CST);
+    wake_consumer(ra);
+    return NULL;
+}
+
+struct read_ahead *raStart(int fd)
+{
+    struct read_ahead *ra;
+
+    if (posix_memalign((void **)&ra, 64, sizeof(*ra)) != 0) return NULL;
+    memset(ra, 0, sizeof(*ra));
+    ra->fd      = fd;
+    ra->off     = lseek(fd, 0, SEEK_CUR);
+    ra->dataFd  = eventfd(0, EFD_CLOEXEC);
+    ra->spaceFd = eventfd(0, EFD_CLOEXEC);
+    ra->ring    = malloc(RA_SLOTS * sizeof(*ra->ring));
+    if (ra->off < 0 || ra->dataFd < 0 || ra->spaceFd < 0 || ra->ring == NULL ||
+        pthread_create(&ra->thread, NULL, reader, ra) != 0) {
+        if (ra->dataFd >= 0) close(ra->dataFd);
+        if (ra->spaceFd >= 0) close(ra->spaceFd);
+        free(ra->ring);
+        free(ra);
+        return NULL;
+    }
+    return ra;
+}
+
+/* Block tail ist aufgebraucht: an den Thread zurückgeben */
+static void release_block(struct read_ahead *ra)
+{
+    ra->pos = 0;
+    __atomic_store_n(&ra->tail, ra->tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ra->prodWaiting, __ATOMIC_SEQ_CST))
+        ev_signal(ra->spaceFd);
+}
+
+/* Zeile wie fgets(data, BufferSize) fortsetzen: bis einschließlich
+ * '\n', höchstens BufferSize - 1 Bytes. Rückgabewert: 1 = vollständig */
+static int take_line(struct read_ahead *ra, const struct ra_block *b)
+{
+    const char *p = b->data + ra->pos, *nl;
+    unsigned long avail = b->len - ra->pos;
+
+    if (avail > BufferSize - 1 - ra->lineLen) avail = BufferSize - 1 - ra->lineLen;
+    nl = memchr(p, '\n', avail);
+    if (nl) avail = (unsigned long)(nl - p) + 1;
+    memcpy(ra->unit.data + ra->lineLen, p, avail);
+    ra->lineLen += avail;
+    ra->pos += avail;
+    return nl != NULL || ra->lineLen == BufferSize - 1;
+}
+
+/* Zeile abschließen; len wie strlen (bis zum ersten Nullbyte) */
+static int finish_line(struct read_ahead *ra, const struct app_unit **unit)
+{
+    ra->unit.data[ra->lineLen] = '\0';
+    ra->unit.len = strnlen(ra->unit.data, ra->lineLen);
+    ra->lineLen = 0;
+    *unit = &ra->unit;
+    return RA_UNIT;
+}
+
+int raNext(struct read_ahead *ra, const struct app_unit **unit, int timeoutMs)
+{
+    struct pollfd pfd;
+    int waited = 0, done;
+
+    for (;;) {
+        if (__atomic_load_n(&ra->head, __ATOMIC_ACQUIRE) != ra->tail) {
+            const struct ra_block *b = &ra->ring[ra->tail % RA_SLOTS];
+            int complete = take_line(ra, b);
+
+            if (ra->pos == b->len) release_block(ra);
+            if (complete) return finish_line(ra, unit);
+            continue;
+        }
+        /* done kommt nach dem letzten head: danach head erneut prüfen */
+        done = __atomic_load_n(&ra->done, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&ra->head, __ATOMIC_ACQUIRE) != ra->tail) continue;
+        if (done < 0) return RA_ERROR;
+        if (done > 0) return ra->lineLen > 0 ? finish_line(ra, unit) : RA_EOF;
+        if (waited) return RA_IDLE;
+
+        __atomic_store_n(&ra->consWaiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ra->head, __ATOMIC_SEQ_CST) == ra->tail &&
+            !__atomic_load_n(&ra->done, __ATOMIC_SEQ_CST)) {
+            pfd.fd = ra->dataFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, timeoutMs) > 0) ev_drain(ra->dataFd);
+        }
+        __atomic_store_n(&ra->consWaiting, 0, __ATOMIC_RELAXED);
+        waited = 1;
+    }
+}
+
+void raStop(struct read_ahead *ra)
+{
+    if (ra == NULL) return;
+    __atomic_store_n(&ra->stop, 1, __ATOMIC_SEQ_CST);
+    ev_signal(ra->spaceFd);
+    pthread_join(ra->thread, NULL);
+    close(ra->dataFd);
+    close(ra->spaceFd);
+    free(ra->ring);
+    free(ra);
+}
@@ -0,0 +1,39 @@
+#ifndef READAHEAD_H_INCLUDED
+#define READAHEAD_H_INCLUDED
+
+#include "data.h"
+
+/*
+ * Vorauslesen der Eingabedatei in einem eigenen Thread.
+ *
+ * Der Thread liest die Datei in Blöcken (pread) in einen Ring vorab
+ * belegter Puffer, der Sender holt sie dort ohne Sperren ab (ein
+ * Erzeuger, ein Verbraucher, nur atomare Indizes) und zerlegt sie wie
+ * bisher fgets in Zeilen (eine Zeile je app_unit, höchstens
+ * BufferSize - 1 Bytes). Der Kernel liest mit posix_fadvise
+ * (SEQUENTIAL, WILLNEED) voraus. Ein langsamer Lesezugriff (kalter
+ * Cache, Netzlaufwerk) hält so nicht mehr das Protokoll an, solange
+ * der Ring Daten hat. Gewartet wird nur bei leerem bzw. vollem Ring
+ * (eventfd).
+ */
+
+struct read_ahead;
+
+/* Rückgabewerte von raNext() */
+#define RA_UNIT    1    /* *unit gültig bis zum nächsten raNext()        */
+#define RA_EOF     0    /* Ende der Datei, alle Zeilen abgeholt          */
+#define RA_IDLE    2    /* innerhalb von timeoutMs nichts gelesen        */
+#define RA_ERROR  (-1)  /* Lesefehler                                    */
+
+/* Thread für die Datei fd (ab der aktuellen Position) starten; bis
+ * raStop() nicht selbst aus fd lesen.
+ * Rückgabewert: Instanz oder NULL (dann selbst lesen). */
+struct read_ahead *raStart(int fd);
+
+/* Nächste Zeile, höchstens timeoutMs auf den Thread warten. */
+int  raNext(struct read_ahead *ra, const struct app_unit **unit, int timeoutMs);
+
+/* Thread beenden (auch vor dem Ende der Datei) und freigeben. */
+void raStop(struct read_ahead *ra);
+
+#endif /* READAHEAD_H_INCLUDED */
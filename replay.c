@@ -0,0 +1,707 @@
+/*
+ * Wiedergabe eines Mitschnitts (trace.h, Client/Server mit -x).
+ *
+ * Server-Trace: die aufgezeichneten Requests und Ticks gehen zu ihren
+ * Zeitpunkten an eine Server-Instanz ohne Socket (arqServerCreateIo)
+ * mit den Einstellungen aus dem Trace. Uhr, Timer, Verlustsimulation
+ * und Cookies laufen wie im Original; bei gleichem Code entstehen also
+ * dieselben Antworten. Verglichen werden Typ, SeNo und Empfänger.
+ * Antworten der Anwendung auf ReqSig (Delta-Signatur, Dedup-Anfragen)
+ * hängen an Daten außerhalb des Traces und kommen aus den
+ * aufgezeichneten AnswSig.
+ *
+ * Client-Trace: ein Client ohne Socket (arqClientCreateIo) sendet die
+ * aufgezeichneten Nutzdaten noch einmal (gleiches Hello, gleiche
+ * app_units, Löcher und Abschluss); die aufgezeichneten Antworten
+ * treffen zu ihren Zeitpunkten ein. Das ist eine offene Schleife: die
+ * Antworten reagieren nicht auf geänderte Requests, ab der ersten
+ * Abweichung ist das Ergebnis nur noch ein Anhaltspunkt. Verglichen
+ * werden Typ, Flags, SeNr und Länge der Requests. Entscheidungen, die
+ * an wenigen µs hängen (NAK-Unterdrückung bei einer RTT im
+ * µs-Bereich), können abweichen: der Trace kennt nur die Zeitpunkte
+ * der Datagramme, nicht jeden Aufruf der Uhr.
+ *
+ * Die Uhr ist in beiden Fällen die des Traces. Ohne -t läuft die
+ * Wiedergabe so schnell wie möglich (Rechenzeit als Benchmark), mit
+ * -t in der Originalgeschwindigkeit.
+ *
+ * Nicht wiedergebbar: verschlüsselte Traces (flüchtige Schlüssel) und
+ * Multicast. Servicezeiten und Empfangsfenster (Socket-Angaben) fehlen
+ * in den wiedergegebenen Antworten.
+ *
+ * Ausgabe: eine CSV-Zeile (-H: mit Kopfzeile), z.B. zum Vergleich
+ * zweier Stände mit demselben Trace.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "data.h"
+#include "clientSy.h"
+#include "serverSy.h"
+#include "trace.h"
+
+#define RP_SLACK_NS  1000000ULL   /* höchstens übernommene Rechenzeit */
+
+/* Vergleichsschlüssel eines gesendeten Datagramms */
+struct rp_key {
+    unsigned long long a, b, c;
+    unsigned long long ns;       /* Zeitpunkt (nur Trace)  */
+};
+
+struct rp_keys {
+    struct rp_key *v;
+    size_t         len, cap;
+};
+
+/* aufgezeichnetes Datagramm (Client: Antworten) */
+struct rp_pkt {
+    unsigned long long ns;
+    unsigned long      len;
+    unsigned char     *data;
+};
+
+/* Aktion des Client-Programms, aus den Requests rekonstruiert */
+enum { OP_SIG, OP_QUERY, OP_HELLO, OP_DATA, OP_HOLE, OP_LAST, OP_CLOSE };
+
+struct rp_op {
+    int               type;
+    int               fin;        /* OP_HELLO: Hello mit FIN  */
+    int               zeroRtt;    /* OP_HELLO mit REQ_F_DATA  */
+    int               hasInfo;    /* OP_HELLO ohne REQ_F_DATA */
+    int               hasUnit;
+    struct hello_info info;       /* OP_HELLO                 */
+    unsigned long     hole;       /* OP_HOLE                  */
+    struct app_unit   unit;
+};
+
+static struct {
+    struct trace_hdr   hdr;
+    struct arq_trace  *tr;
+    const char        *path;
+    unsigned long long now;          /* Uhr des Traces            */
+    int                realtime;     /* -t                        */
+    struct timespec    wall0;
+
+    struct rp_keys     txTrace, txReplay;
+    unsigned long      records, rx;
+    unsigned long long bytes;        /* Server: geschrieben, Client: gesendet */
+    int                outFd;        /* Server: -f, sonst -1      */
+
+    /* Client: Antworten; Server: AnswSig der Anwendung */
+    struct rp_pkt     *answ;
+    size_t             nAnsw, capAnsw, answPos;
+    struct rp_op      *ops;
+    size_t             nOps, capOps;
+    int                inSync;       /* bisher wie im Trace gesendet */
+} rp = { .outFd = -1, .inSync = 1 };
+
+static void *growArray(void *v, size_t *cap, size_t len, size_t size)
+{
+    if (len < *cap) return v;
+    *cap = *cap ? 2 * *cap : 1024;
+    v = realloc(v, *cap * size);
+    if (v == NULL) {
+        perror("replay: realloc");
+        exit(EXIT_FAILURE);
+    }
+    return v;
+}
+
+static void keyPush(struct rp_keys *k, unsigned long long a, unsigned long long b,
+                    unsigned long long c, unsigned long long ns)
+{
+    k->v = growArray(k->v, &k->cap, k->len, sizeof(*k->v));
+    k->v[k->len].a = a;
+    k->v[k->len].b = b;
+    k->v[k->len].c = c;
+    k->v[k->len].ns = ns;
+    k->len++;
+}
+
+/* Anzahl übereinstimmender Datagramme bis zur ersten Abweichung */
+static size_t keySame(const struct rp_keys *x, const struct rp_keys *y)
+{
+    size_t i = 0;
+
+    while (i < x->len && i < y->len && x->v[i].a == y->v[i].a &&
+           x->v[i].b == y->v[i].b && x->v[i].c == y->v[i].c)
+        i++;
+    return i;
+}
+
+static unsigned long long addrHash(const struct sockaddr_storage *a, socklen_t len)
+{
+    const unsigned char *p = (const unsigned char *)a;
+    unsigned long long h = 1469598103934665603ULL;
+
+    for (socklen_t i = 0; i < len; i++) h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+static int isSealed(const unsigned char *data, unsigned long len)
+{
+    return len > 0 && (data[0] == SEC_HELLO || data[0] == SEC_DATA);
+}
+
+/* ==========================================
+ * Uhr
+ * ========================================== */
+
+/* Uhr vorstellen; mit -t bis zum entsprechenden Zeitpunkt warten */
+static void advanceTo(unsigned long long ns)
+{
+    if (ns <= rp.now) return;
+    rp.now = ns;
+    if (rp.realtime) {
+        unsigned long long off = ns - rp.hdr.StartNs;
+        struct timespec ts = rp.wall0;
+
+        ts.tv_sec  += (time_t)(off / 1000000000ULL);
+        ts.tv_nsec += (long)(off % 1000000000ULL);
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+            ;
+    }
+}
+
+static unsigned long long ioNow(void *user)
+{
+    (void)user;
+    return rp.now;
+}
+
+/* ==========================================
+ * Server-Trace
+ * ========================================== */
+
+static int ioServerSend(void *user, const void *buf, unsigned long len,
+                        const struct sockaddr_storage *to, socklen_t toLen)
+{
+    struct answer a;
+
+    (void)user;
+    memset(&a, 0, sizeof(a));
+    memcpy(&a, buf, (len < sizeof(a)) ? len : sizeof(a));
+    keyPush(&rp.txReplay, addrHash(to, toLen), a.AnswType, a.SeNo, rp.now);
+    return 0;
+}
+
+static int appStart(void *user)
+{
+    (void)user;
+    if (rp.outFd >= 0 && (ftruncate(rp.outFd, 0) != 0 || lseek(rp.outFd, 0, SEEK_SET) != 0))
+        return -1;
+    return 0;
+}
+
+static int appWrite(void *user, const char *buf, unsigned long len)
+{
+    (void)user;
+    rp.bytes += len;
+    if (rp.outFd >= 0 && write(rp.outFd, buf, len) != (ssize_t)len) return -1;
+    return 0;
+}
+
+static int appWriteAt(void *user, const char *buf, unsigned long len, unsigned long offset)
+{
+    (void)user;
+    rp.bytes += len;
+    if (rp.outFd >= 0 && pwrite(rp.outFd, buf, len, (off_t)offset) != (ssize_t)len) return -1;
+    return 0;
+}
+
+static void appEnd(void *user)
+{
+    (void)user;
+}
+
+/* Antworten der Anwendung auf ReqSig (Delta-Signatur, Dedup-Anfragen)
+ * hängen an Daten außerhalb des Traces (alte Datei, Chunk-Store); sie
+ * kommen in Reihenfolge aus den aufgezeichneten AnswSig. */
+static int loadAppAnswers(void)
+{
+    struct trace_hdr h;
+    struct trace_rec rec;
+    struct arq_trace *t = traceOpen(rp.path, &h);
+    int r;
+
+    if (t == NULL) return -1;
+    while ((r = traceRead(t, &rec)) > 0) {
+        if (rec.kind != TRACE_TX || rec.len < sizeof(struct answer) ||
+            rec.data[0] != AnswSig)
+            continue;
+        rp.answ = growArray(rp.answ, &rp.capAnsw, rp.nAnsw, sizeof(*rp.answ));
+        rp.answ[rp.nAnsw].len  = rec.len;
+        rp.answ[rp.nAnsw].data = malloc(rec.len);
+        if (rp.answ[rp.nAnsw].data == NULL) break;
+        memcpy(rp.answ[rp.nAnsw].data, rec.data, rec.len);
+        rp.nAnsw++;
+    }
+    traceClose(t);
+    return r;
+}
+
+static long appAnswer(char *buf, unsigned long len, unsigned long *total)
+{
+    struct answer a;
+    struct rp_pkt *p;
+    unsigned long n;
+
+    if (rp.answPos >= rp.nAnsw) return -1;
+    p = &rp.answ[rp.answPos++];
+    memcpy(&a, p->data, sizeof(a));
+    n = p->len - sizeof(a);
+    if (n > len) n = len;
+    memcpy(buf, p->data + sizeof(a), n);
+    if (total) *total = a.FlNr;
+    return (long)n;
+}
+
+static long appSig(void *user, unsigned long offset, char *buf, unsigned long len,
+                   unsigned long *total)
+{
+    (void)user; (void)offset;
+    return appAnswer(buf, len, total);
+}
+
+static long appQuery(void *user, const char *q, unsigned long qLen, char *buf,
+                     unsigned long len)
+{
+    (void)user; (void)q; (void)qLen;
+    return appAnswer(buf, len, NULL);
+}
+
+static int replayServer(void)
+{
+    struct arq_server_opts opts;
+    struct arq_server_app app;
+    struct arq_io sio;
+    struct arq_server *srv;
+    struct trace_rec rec;
+    int r;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.lossReq       = rp.hdr.Conf.srv.lossReq;
+    opts.lossAck       = rp.hdr.Conf.srv.lossAck;
+    opts.delayedAckMs  = rp.hdr.Conf.srv.delAckMs;
+    opts.idleTimeoutMs = rp.hdr.Conf.srv.idleMs;
+    opts.cookies       = rp.hdr.Conf.srv.cookies;
+    opts.cookieKey     = rp.hdr.Conf.srv.cookieKey;
+    opts.quiet         = 1;
+
+    memset(&app, 0, sizeof(app));
+    app.start   = appStart;
+    app.write   = appWrite;
+    app.writeAt = appWriteAt;
+    app.end     = appEnd;
+    if (loadAppAnswers() < 0) return -1;
+    if (rp.nAnsw > 0) {
+        app.sig   = appSig;
+        app.query = appQuery;
+    }
+
+    memset(&sio, 0, sizeof(sio));
+    sio.now  = ioNow;
+    sio.send = ioServerSend;
+
+    srv = arqServerCreateIo(&opts, &app, &sio);
+    if (srv == NULL) return -1;
+
+    while ((r = traceRead(rp.tr, &rec)) > 0) {
+        rp.records++;
+        advanceTo(rec.ns);
+        switch (rec.kind) {
+        case TRACE_RX:
+            if (isSealed(rec.data, rec.len)) {
+                fprintf(stderr, "replay: verschlüsselter Trace, nicht wiedergebbar\n");
+                arqServerDestroy(srv);
+                return -1;
+            }
+            if (rec.peer == NULL) break;
+            rp.rx++;
+            arqServerInput(srv, rec.data, rec.len, rec.peer, rec.peerLen);
+            break;
+        case TRACE_TX: {
+            struct answer a;
+            memset(&a, 0, sizeof(a));
+            memcpy(&a, rec.data, (rec.len < sizeof(a)) ? rec.len : sizeof(a));
+            keyPush(&rp.txTrace, rec.peer ? addrHash(rec.peer, rec.peerLen) : 0,
+                    a.AnswType, a.SeNo, rec.ns);
+            break;
+        }
+        case TRACE_TICK:
+            (void)arqServerAdvance(srv);
+            break;
+        }
+    }
+    arqServerDestroy(srv);
+    for (size_t i = 0; i < rp.nAnsw; i++) free(rp.answ[i].data);
+    free(rp.answ);
+    if (r < 0) fprintf(stderr, "replay: Trace defekt nach %lu Records\n", rp.records);
+    return r;
+}
+
+/* ==========================================
+ * Client-Trace
+ * ========================================== */
+
+/* Solange die Wiedergabe dem Trace folgt, läuft die Uhr mit den
+ * aufgezeichneten Sendezeitpunkten mit (sonst ginge ihr die
+ * Rechenzeit des Originals verloren, und Timeouts fielen früher). */
+static int ioClientSend(void *user, const void *buf, unsigned long len,
+                        const struct sockaddr_storage *to, socklen_t toLen)
+{
+    struct request r;
+    size_t i = rp.txReplay.len;
+
+    (void)user; (void)to; (void)toLen;
+    memset(&r, 0, sizeof(r));
+    memcpy(&r, buf, (len < sizeof(r)) ? len : sizeof(r));
+    keyPush(&rp.txReplay, (unsigned long long)r.ReqType << 8 | r.Flags, r.SeNr, r.FlNr, rp.now);
+    if (rp.inSync && i < rp.txTrace.len && rp.txTrace.v[i].a == rp.txReplay.v[i].a &&
+        rp.txTrace.v[i].b == rp.txReplay.v[i].b && rp.txTrace.v[i].c == rp.txReplay.v[i].c)
+        advanceTo(rp.txTrace.v[i].ns);
+    else
+        rp.inSync = 0;
+    return 0;
+}
+
+static long ioClientRecv(void *user, void *buf, unsigned long len)
+{
+    struct rp_pkt *p;
+
+    (void)user;
+    if (rp.answPos >= rp.nAnsw || rp.answ[rp.answPos].ns > rp.now) return -1;
+    p = &rp.answ[rp.answPos++];
+    if (len > p->len) len = p->len;
+    memcpy(buf, p->data, len);
+    rp.rx++;
+    return (long)len;
+}
+
+static int ioClientWait(void *user, unsigned long long deadlineNs)
+{
+    (void)user;
+    if (rp.answPos < rp.nAnsw && rp.answ[rp.answPos].ns <= deadlineNs) {
+        advanceTo(rp.answ[rp.answPos].ns);
+        return 1;
+    }
+    advanceTo(deadlineNs);
+    return 0;
+}
+
+/* Pacing: auf die Sendung folgt das nächste Paket. Im Original lag es
+ * um die Rechenzeit hinter der Frist; diese bis RP_SLACK_NS übernehmen,
+ * damit auch der Sendezeitpunkt des Pakets (lastSendNs) stimmt. */
+static void ioClientSleepUntil(void *user, unsigned long long deadlineNs)
+{
+    size_t i = rp.txReplay.len;
+
+    (void)user;
+    if (rp.inSync && i < rp.txTrace.len && rp.txTrace.v[i].ns >= deadlineNs &&
+        rp.txTrace.v[i].ns - deadlineNs < RP_SLACK_NS)
+        deadlineNs = rp.txTrace.v[i].ns;
+    advanceTo(deadlineNs);
+}
+
+static struct rp_op *opPush(int type)
+{
+    rp.ops = growArray(rp.ops, &rp.capOps, rp.nOps, sizeof(*rp.ops));
+    memset(&rp.ops[rp.nOps], 0, sizeof(rp.ops[0]));
+    rp.ops[rp.nOps].type = type;
+    return &rp.ops[rp.nOps++];
+}
+
+static void opUnit(int type, const char *data, unsigned long len)
+{
+    struct rp_op *op = opPush(type);
+
+    if (len > BufferSize) len = BufferSize;
+    op->hasUnit = 1;
+    op->unit.len = len;
+    memcpy(op->unit.data, data, len);
+}
+
+/* Erste Sendung eines Requests in Aktionen übersetzen */
+static int parseRequest(const struct request *r, int *coalesced)
+{
+    unsigned long len = (r->FlNr < BufferSize) ? r->FlNr : BufferSize;
+
+    if (r->Flags & REQ_F_MCAST) return -1;
+    if (r->ReqType == ReqClose) {
+        opPush(OP_CLOSE);
+    } else if (r->Flags & REQ_F_HOLE) {
+        unsigned long hole = 0;
+        memcpy(&hole, r->name, (len < sizeof(hole)) ? len : sizeof(hole));
+        opPush(OP_HOLE)->hole = hole;
+    } else if (r->Flags & REQ_F_RECS) {
+        unsigned long pos = 0;
+        unsigned short rl;
+        *coalesced = 1;
+        while (pos + GBN_REC_HDR <= len) {
+            memcpy(&rl, r->name + pos, GBN_REC_HDR);
+            if (rl > len - pos - GBN_REC_HDR) return -1;
+            pos += GBN_REC_HDR + rl;
+            opUnit((pos >= len && (r->Flags & REQ_F_FIN)) ? OP_LAST : OP_DATA,
+                   r->name + pos - rl, rl);
+        }
+    } else {
+        opUnit((r->Flags & REQ_F_FIN) ? OP_LAST : OP_DATA, r->name, len);
+    }
+    return 0;
+}
+
+/* Trace lesen: Antworten sammeln, Aktionen rekonstruieren, Fenster
+ * schätzen (größter Abstand zwischen gesendeter SeNr und letztem ACK) */
+static int loadClient(int *winSize, int *coalesced)
+{
+    struct trace_rec rec;
+    struct request r;
+    unsigned long maxSeq = 0, acked = 0;
+    unsigned long queries = 0;
+    int r0, hello = 0, sig = 0;
+
+    while ((r0 = traceRead(rp.tr, &rec)) > 0) {
+        rp.records++;
+        if (rec.kind != TRACE_RX && rec.kind != TRACE_TX) continue;
+        if (isSealed(rec.data, rec.len)) {
+            fprintf(stderr, "replay: verschlüsselter Trace, nicht wiedergebbar\n");
+            return -1;
+        }
+        if (rec.kind == TRACE_RX) {
+            struct answer a;
+            rp.answ = growArray(rp.answ, &rp.capAnsw, rp.nAnsw, sizeof(*rp.answ));
+            rp.answ[rp.nAnsw].ns  = rec.ns;
+            rp.answ[rp.nAnsw].len = rec.len;
+            rp.answ[rp.nAnsw].data = malloc(rec.len);
+            if (rp.answ[rp.nAnsw].data == NULL) return -1;
+            memcpy(rp.answ[rp.nAnsw].data, rec.data, rec.len);
+            rp.nAnsw++;
+            memset(&a, 0, sizeof(a));
+            memcpy(&a, rec.data, (rec.len < sizeof(a)) ? rec.len : sizeof(a));
+            if (a.AnswType == AnswOk && a.SeNo > acked) acked = a.SeNo;
+            continue;
+        }
+
+        memset(&r, 0, sizeof(r));
+        memcpy(&r, rec.data, (rec.len < sizeof(r)) ? rec.len : sizeof(r));
+        keyPush(&rp.txTrace, (unsigned long long)r.ReqType << 8 | r.Flags, r.SeNr, r.FlNr,
+                rec.ns);
+
+        if (r.ReqType == ReqSig && r.FlNr > 0) {
+            /* Anfrage (arqClientQuery), je Nummer die erste Sendung;
+             * aufeinanderfolgende gehen in einem Aufruf */
+            if (hello || r.SeNr != queries) continue;
+            queries++;
+            opUnit(OP_QUERY, r.name, r.FlNr);
+            rp.ops[rp.nOps - 1].hasUnit = 0;   /* keine Nutzdaten */
+        } else if (r.ReqType == ReqSig) {
+            if (!sig && !hello) opPush(OP_SIG);
+            sig = 1;
+        } else if (r.ReqType == ReqHello) {
+            if (hello) continue;   /* Wiederholung bzw. Cookie-Echo */
+            struct rp_op *op = opPush(OP_HELLO);
+            unsigned long len = (r.FlNr < BufferSize) ? r.FlNr : BufferSize;
+            if (r.Flags & REQ_F_MCAST) return -1;
+            memcpy(&op->info, r.name, sizeof(op->info));
+            op->hasInfo = len >= sizeof(op->info);
+            if ((r.Flags & REQ_F_DATA) && op->hasInfo) {
+                op->zeroRtt  = 1;
+                op->hasUnit  = len > sizeof(op->info);
+                op->unit.len = len - sizeof(op->info);
+                memcpy(op->unit.data, r.name + sizeof(op->info), op->unit.len);
+                op->fin = (r.Flags & REQ_F_FIN) != 0;
+            }
+            hello = 1;
+        } else if ((r.ReqType == ReqData || r.ReqType == ReqClose) && r.SeNr > maxSeq) {
+            if (r.SeNr - acked + 1 > (unsigned long)*winSize)
+                *winSize = (int)(r.SeNr - acked + 1);
+            maxSeq = r.SeNr;
+            if (parseRequest(&r, coalesced) < 0) return -1;
+        }
+    }
+    if (r0 < 0) fprintf(stderr, "replay: Trace defekt nach %lu Records\n", rp.records);
+    if (!hello) {
+        fprintf(stderr, "replay: kein Hello im Trace (Multicast oder leer)\n");
+        return -1;
+    }
+    if (*winSize > GBN_MAX_WINDOW) *winSize = GBN_MAX_WINDOW;
+    return 0;
+}
+
+static int replayClient(int winSize)
+{
+    struct arq_io cio;
+    struct arq_client *c;
+    int est = 1, coalesced = 0, rc = 0;
+
+    if (loadClient(&est, &coalesced) < 0) return -1;
+    if (winSize == 0) winSize = est;
+
+    memset(&cio, 0, sizeof(cio));
+    cio.now        = ioNow;
+    cio.send       = ioClientSend;
+    cio.recv       = ioClientRecv;
+    cio.wait       = ioClientWait;
+    cio.sleepUntil = ioClientSleepUntil;
+
+    c = arqClientCreateIo(&cio);
+    if (c == NULL) return -1;
+    arqClientSetRto(c, rp.hdr.Conf.cli.rtoNs);
+    arqClientSetPacing(c, rp.hdr.Conf.cli.pace);
+    if (coalesced) arqClientSetCoalesce(c, rp.hdr.Conf.cli.coalDelayNs / 1000000ULL);
+    arqClientSetPartial(c, rp.hdr.Conf.cli.lifetimeMs, rp.hdr.Conf.cli.maxRetx);
+
+    for (size_t i = 0; rc == 0 && i < rp.nOps; i++) {
+        struct rp_op *op = &rp.ops[i];
+        char *sigBuf = NULL;
+
+        if (op->hasUnit) rp.bytes += op->unit.len;
+        switch (op->type) {
+        case OP_SIG:
+            if (arqClientFetchSig(c, &sigBuf) < 0) rc = -1;
+            free(sigBuf);
+            break;
+        case OP_QUERY: {
+            /* ohne Antwort hat das Client-Programm die Datei vollständig gesendet */
+            size_t k = i;
+            while (k < rp.nOps && rp.ops[k].type == OP_QUERY) k++;
+            struct app_unit *q = malloc((k - i) * sizeof(*q));
+            struct app_unit *ans = malloc((k - i) * sizeof(*ans));
+            if (q == NULL || ans == NULL) {
+                rc = -1;
+            } else {
+                for (size_t j = i; j < k; j++) q[j - i] = rp.ops[j].unit;
+                (void)arqClientQuery(c, q, ans, k - i);
+            }
+            free(q);
+            free(ans);
+            i = k - 1;
+            break;
+        }
+        case OP_HELLO:
+            if (op->zeroRtt)
+                rc = arqClientHelloData(c, winSize, &op->info,
+                                        op->hasUnit ? &op->unit : NULL, op->fin);
+            else
+                rc = arqClientHello(c, winSize, op->hasInfo ? &op->info : NULL);
+            break;
+        case OP_DATA:
+            rc = arqClientSendData(c, &op->unit, winSize);
+            break;
+        case OP_HOLE:
+            rc = arqClientSendHole(c, op->hole, winSize);
+            break;
+        case OP_LAST:
+            rc = arqClientSendLast(c, &op->unit, winSize);
+            break;
+        case OP_CLOSE:
+            rc = arqClientSendClose(c, winSize);
+            break;
+        }
+    }
+    arqClientDestroy(c);
+
+    for (size_t i = 0; i < rp.nAnsw; i++) free(rp.answ[i].data);
+    free(rp.answ);
+    free(rp.ops);
+    return rc != 0 ? -1 : 0;
+}
+
+/* ==========================================
+ * Hauptprogramm
+ * ========================================== */
+
+static void usage(const char *progName)
+{
+    fprintf(stderr, "Usage: %s [-t] [-f <outfile>] [-w <window>] [-H] <trace>\n", progName);
+    fprintf(stderr, "       -t : in Originalgeschwindigkeit (Default: so schnell wie möglich)\n");
+    fprintf(stderr, "       -f : Server-Trace: empfangene Daten in <outfile> schreiben\n");
+    fprintf(stderr, "       -w : Client-Trace: Fenstergröße (Default: aus dem Trace geschätzt)\n");
+    fprintf(stderr, "       -H : CSV-Kopfzeile ausgeben\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL, *outFile = NULL;
+    int winSize = 0, header = 0, rc;
+    unsigned long long start;
+    struct timespec w1;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (path != NULL) usage(argv[0]);
+            path = argv[i];
+            continue;
+        }
+        if (argv[i][1] == 0 || argv[i][2] != 0) usage(argv[0]);
+        switch (argv[i][1]) {
+        case 't': rp.realtime = 1; break;
+        case 'H': header = 1; break;
+        case 'f':
+            if (i + 1 >= argc) usage(argv[0]);
+            outFile = argv[++i];
+            break;
+        case 'w':
+            if (i + 1 >= argc) usage(argv[0]);
+            winSize = atoi(argv[++i]);
+            if (winSize < 1 || winSize > GBN_MAX_WINDOW) usage(argv[0]);
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (path == NULL) usage(argv[0]);
+
+    rp.path = path;
+    rp.tr = traceOpen(path, &rp.hdr);
+    if (rp.tr == NULL) {
+        fprintf(stderr, "replay: '%s' ist kein lesbarer Trace\n", path);
+        return EXIT_FAILURE;
+    }
+    if (outFile) {
+        rp.outFd = open(outFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (rp.outFd < 0) {
+            perror("replay: open");
+            return EXIT_FAILURE;
+        }
+    }
+    rp.now = start = rp.hdr.StartNs;
+
+    clock_gettime(CLOCK_MONOTONIC, &rp.wall0);
+    if (rp.hdr.Side == 'S') {
+        rc = replayServer();
+    } else if (rp.hdr.Side == 'C') {
+        rc = replayClient(winSize);
+    } else {
+        fprintf(stderr, "replay: unbekannte Seite '%c'\n", rp.hdr.Side);
+        rc = -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+
+    {
+        double wallMs = (w1.tv_sec - rp.wall0.tv_sec) * 1e3 +
+                        (w1.tv_nsec - rp.wall0.tv_nsec) / 1e6;
+
+        if (header)
+            printf("side,ok,records,rx,tx_trace,tx_replay,tx_same,bytes,replay_ms,wall_ms\n");
+        printf("%c,%d,%lu,%lu,%zu,%zu,%zu,%llu,%.3f,%.3f\n",
+               rp.hdr.Side, rc == 0, rp.records, rp.rx, rp.txTrace.len, rp.txReplay.len,
+               keySame(&rp.txTrace, &rp.txReplay), rp.bytes,
+               (double)(rp.now - start) / 1e6, wallMs);
+    }
+
+    traceClose(rp.tr);
+    if (rp.outFd >= 0) close(rp.outFd);
+    free(rp.txTrace.v);
+    free(rp.txReplay.v);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
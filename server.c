@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  /* sched_setaffinity, CPU_SET, O_DIRECT, sync_file_range */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,76 +9,982 @@
 #include <ctype.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <libgen.h>
+#include <sys/stat.h>
 
 #include "data.h"
 #include "config.h"
 #include "serverSy.h"
+#include "aead.h"
+#include "delta.h"
+#include "cas.h"
 
-/* Anwendungszustand: Ausgabedatei */
-static const char* gOutputFile = NULL;
-static FILE* gFp = NULL;
-static int         gFileOk = 0;
+/* Dauerhaftigkeit (-s), gemeldet im Abschluss-ACK (DUR_*):
+ *   none      : nur Page Cache (DUR_NONE)
+ *   writeback : alle SYNC_KICK_BYTES Rückschreiben per sync_file_range
+ *               anstoßen, am Ende für den Rest (DUR_WRITEBACK)
+ *   sync      : wie writeback, vor dem Abschluss-ACK fdatasync der Datei
+ *               und fsync des Verzeichnisses (DUR_SYNC)
+ *   direct    : O_DIRECT am Page Cache vorbei über einen ausgerichteten
+ *               Puffer, am Ende fdatasync (DUR_SYNC); ohne Striping
+ */
+enum { SYNC_NONE, SYNC_WRITEBACK, SYNC_DATA, SYNC_DIRECT };
+
+#define SYNC_KICK_BYTES    (8UL << 20)
+#define DIRECT_ALIGN       4096
+#define DIRECT_BUF_SIZE    (1UL << 20)
+
+/* Batch-Modus (Ausgabe ist ein Verzeichnis): Record-Strom entpacken,
+ * siehe struct batch_rec in data.h. Records und Inhalte liegen
+ * beliebig über Paketgrenzen verteilt. */
+enum { BATCH_S_MAGIC, BATCH_S_HDR, BATCH_S_NAME, BATCH_S_DATA, BATCH_S_DONE, BATCH_S_ERROR };
+
+/* Delta-Modus (siehe struct delta_rec in data.h): ruft ein Client die
+ * Signatur der vorhandenen Ausgabedatei ab (ReqSig), bleibt deren
+ * Inhalt über baseFd lesbar; der folgende Transfer legt die Datei neu
+ * an (unlink statt O_TRUNC) und setzt sie aus Kopien und Literalen
+ * zusammen. Beginnt der Strom nicht mit DELTA_MAGIC, wird er
+ * unverändert geschrieben. */
+enum { DELTA_S_PLAIN, DELTA_S_MAGIC, DELTA_S_HDR, DELTA_S_DATA, DELTA_S_DONE, DELTA_S_ERROR };
+
+#define DELTA_COPY_BUF     (64UL << 10)
+
+/* Dedup-Modus (siehe struct cas_rec in data.h und cas.h): mit -g hält
+ * der Server einen Chunk-Store. Fragt ein Client nach Chunks (ReqSig
+ * mit Nutzdaten), erwartet der folgende Transfer einen Strom ab
+ * CAS_MAGIC und setzt die Ausgabe aus dem Store und den neuen Chunks
+ * zusammen; beginnt der Strom anders, wird er unverändert geschrieben. */
+enum { CAS_S_PLAIN, CAS_S_MAGIC, CAS_S_HDR, CAS_S_DATA, CAS_S_DONE, CAS_S_ERROR };
+
+/* Anwendungszustand: kommt als Kontextzeiger (struct arq_server_app,
+ * user) in jeden Callback */
+struct app_state {
+    /* Ausgabedatei */
+    const char*      outputFile;
+    FILE*            fp;
+    int              fileOk;
+
+    /* Dauerhaftigkeit (-s, SYNC_*) */
+    int              syncMode;
+    unsigned long    fileOff;              /* sequentielle Schreibposition */
+    unsigned long    dirtyFrom, dirtyTo;   /* seit dem letzten Anstoß geschrieben */
+    int              directFd;
+    char*            directBuf;
+    unsigned long    directLen;            /* Bytes im Puffer */
+    unsigned long    directOff;            /* Dateiposition des Puffers */
+
+    /* Sparse-Modus (REQ_F_HOLE): die Ausgabe wird neu angelegt, ein nicht
+     * beschriebener Bereich ist schon ein Loch. Endet die Datei mit einem
+     * Loch, setzt ftruncate am Ende die Länge (sparseEnd). */
+    unsigned long    sparseEnd;
+
+    /* Pipe-Modus (stdout oder FIFO): genau ein Transfer, kein Seek */
+    int              pipeMode;
+    int              pipeUsed;
+
+    int              batchMode;
+    struct {
+        int              state;
+        unsigned long    have;             /* gesammelte Bytes (Magic/Header/Name) */
+        char             magic[BATCH_MAGIC_LEN];
+        struct batch_rec rec;
+        char             name[PATH_MAX];
+        unsigned long    left;             /* restliche Inhaltsbytes */
+        int              fd;               /* aktuelle Datei, -1 = keine */
+        unsigned long    files;
+    } batch;
+
+    struct {
+        int              baseFd;           /* alter Inhalt, -1 = kein Delta angekündigt */
+        unsigned long    baseSize;
+        char*            sig;              /* Signatur (struct delta_sig_hdr + Einträge) */
+        unsigned long    sigLen;
+        int              state;
+        unsigned long    have;
+        char             magic[DELTA_MAGIC_LEN];
+        struct delta_rec rec;
+        unsigned long    left;             /* restliche Literalbytes */
+        unsigned long    outLen;           /* Länge der neuen Datei */
+        unsigned long    copied;
+    } delta;
+    char             copyBuf[DELTA_COPY_BUF];  /* DELTA_COPY */
+
+    struct {
+        struct cas_store* store;           /* NULL = ohne Store */
+        int              armed;            /* Anfrage vor diesem bzw. dem nächsten Transfer */
+        int              state;
+        unsigned long    have;
+        char             magic[CAS_MAGIC_LEN];
+        struct cas_rec   rec;
+        unsigned long    outLen;           /* Länge der neuen Datei */
+        unsigned long    stored, reused;   /* neu abgelegte bzw. übernommene Bytes */
+        char             chunk[CAS_MAX_CHUNK];
+    } cas;
+
+    struct arq_server* srv;                /* für arqServerStop() */
+};
+
+/* laufende Instanz, nur für den Signal-Handler */
+static struct arq_server* volatile gStopSrv = NULL;
 
 static void usage(const char* progName)
 {
-    fprintf(stderr, "Usage: %s -p <port> -f <outfile> [-r <lossReq>] [-a <lossAck>]\n",
+    fprintf(stderr, "Usage: %s -p <port> -f <outfile> [-r <lossReq>] [-a <lossAck>] [-i <idle>] [-d <delack>] [-u] [-b <us>] [-c <cpu>] [-t] [-s <mode>] [-e] [-k <keyfile>] [-m <group>] [-o] [-x <trace>] [-w <bytes>] [-g <dir>] [-n <threads>]\n",
         progName);
     fprintf(stderr, "   -p <port>    : Server-Port (Default: %s)\n", DEFAULT_PORT);
-    fprintf(stderr, "   -f <outfile> : Ausgabedatei\n");
+    fprintf(stderr, "   -f <outfile> : Ausgabedatei, '-' = stdout (Pipe-Modus),\n");
+    fprintf(stderr, "                  Verzeichnis = Batch eines Clients dorthin entpacken\n");
     fprintf(stderr, "   -r <lossReq> : Request-Verlustwahrscheinlichkeit (0.0..1.0)\n");
     fprintf(stderr, "   -a <lossAck> : ACK-Verlustwahrscheinlichkeit (0.0..1.0)\n");
+    fprintf(stderr, "   -i <idle>    : inaktive Sitzungen nach <idle> Sekunden abbrechen (Default: 30)\n");
+    fprintf(stderr, "   -d <delack>  : verzögertes ACK in ms, 0 = aus (Default: 0)\n");
+    fprintf(stderr, "   -u           : io_uring statt epoll (Rückfall auf epoll ohne Kernel-Unterstützung)\n");
+    fprintf(stderr, "   -b <us>      : Busy-Poll: bis zu <us> Mikrosekunden pollen, bevor blockiert wird\n");
+    fprintf(stderr, "   -c <cpu>     : Server-Thread auf Kern <cpu> festlegen (mit -n: Kerne ab <cpu>)\n");
+    fprintf(stderr, "   -t           : Kernel-Zeitstempel, Servicezeit in jedem ACK melden\n");
+    fprintf(stderr, "   -s <mode>    : Dauerhaftigkeit vor dem Abschluss-ACK: none (Default), writeback,\n");
+    fprintf(stderr, "                  sync (fdatasync) oder direct (O_DIRECT + fdatasync, ohne Striping)\n");
+    fprintf(stderr, "   -e           : nur verschlüsselte Verbindungen annehmen (AES-256-GCM bzw. ChaCha20-Poly1305)\n");
+    fprintf(stderr, "   -k <keyfile> : gemeinsames Geheimnis mit den Clients (impliziert -e)\n");
+    fprintf(stderr, "   -m <group>   : Multicast-Gruppe beitreten, z.B. ff01::4242%%eth0 (Client mit -m)\n");
+    fprintf(stderr, "   -o           : Hello auch unter Last ohne Cookie-Austausch annehmen (Sitzung und\n");
+    fprintf(stderr, "                  Datei dann auch für gefälschte Absender)\n");
+    fprintf(stderr, "   -x <trace>   : alle Datagramme mit Zeitstempel mitschneiden (Wiedergabe mit replay)\n");
+    fprintf(stderr, "   -w <bytes>   : Socket-Empfangspuffer (Default: automatisch für 64 Flows mit vollem Fenster)\n");
+    fprintf(stderr, "   -g <dir>     : Chunk-Store für Dedup über alle Transfers (Client mit -g)\n");
+    fprintf(stderr, "   -n <threads> : Empfangs-Threads mit je eigenem Socket, z.B. einer je Stripe/Kern\n");
+    fprintf(stderr, "                  (Default: 1; ohne io_uring-Dateischreiben, nicht mit -m/-x)\n");
     exit(EXIT_FAILURE);
 }
 
+/* --- Dauerhaftigkeit --- */
+
+/* Geschriebenen Bereich merken und ab SYNC_KICK_BYTES das Rückschreiben
+ * anstoßen (ohne zu warten): der Dirty-Anteil im Page Cache bleibt klein,
+ * ein abschließendes fdatasync kurz. */
+static void syncNoteWrite(struct app_state* app, int fd, unsigned long off, unsigned long len)
+{
+    if (app->syncMode != SYNC_WRITEBACK && app->syncMode != SYNC_DATA) return;
+
+    if (app->dirtyTo == app->dirtyFrom || off < app->dirtyFrom) app->dirtyFrom = off;
+    if (off + len > app->dirtyTo) app->dirtyTo = off + len;
+    if (app->dirtyTo - app->dirtyFrom < SYNC_KICK_BYTES) return;
+
+    if (app->fp) (void)fflush(app->fp);
+    (void)sync_file_range(fd, (off64_t)app->dirtyFrom, (off64_t)(app->dirtyTo - app->dirtyFrom),
+                          SYNC_FILE_RANGE_WRITE);
+    app->dirtyFrom = app->dirtyTo = 0;
+}
+
+/* Verzeichnis der Ausgabedatei sichern (neuer Eintrag, O_TRUNC) */
+static int syncParentDir(struct app_state* app)
+{
+    char path[PATH_MAX];
+    int fd, rc;
+
+    snprintf(path, sizeof(path), "%s", app->outputFile);
+    fd = open(dirname(path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+/* Volle, ausgerichtete Blöcke des O_DIRECT-Puffers schreiben */
+static int directFlush(struct app_state* app)
+{
+    unsigned long whole = app->directLen & ~(unsigned long)(DIRECT_ALIGN - 1);
+    ssize_t written;
+
+    if (whole == 0) return 0;
+    written = pwrite(app->directFd, app->directBuf, whole, (off_t)app->directOff);
+    if (written != (ssize_t)whole) {
+        fprintf(stderr, "Server: O_DIRECT write failed: %s\n", strerror(errno));
+        return -1;
+    }
+    app->directOff += whole;
+    app->directLen -= whole;
+    memmove(app->directBuf, app->directBuf + whole, app->directLen);
+    return 0;
+}
+
+static int directWrite(struct app_state* app, const char* buf, unsigned long len)
+{
+    while (len > 0) {
+        unsigned long n = DIRECT_BUF_SIZE - app->directLen;
+        if (n > len) n = len;
+        memcpy(app->directBuf + app->directLen, buf, n);
+        app->directLen += n;
+        buf += n;
+        len -= n;
+        if (app->directLen == DIRECT_BUF_SIZE && directFlush(app) < 0) return -1;
+    }
+    return 0;
+}
+
+/* Rest des O_DIRECT-Puffers schreiben: ganze Blöcke direkt, den nicht
+ * ausgerichteten Schwanz gepuffert (O_DIRECT dafür abschalten). */
+static int directFinish(struct app_state* app)
+{
+    int flags;
+
+    if (app->directFd < 0) return 0;
+    if (directFlush(app) < 0) return -1;
+    if (app->directLen == 0) return 0;
+
+    flags = fcntl(app->directFd, F_GETFL);
+    if (flags < 0 || fcntl(app->directFd, F_SETFL, flags & ~O_DIRECT) < 0 ||
+        pwrite(app->directFd, app->directBuf, app->directLen, (off_t)app->directOff) !=
+            (ssize_t)app->directLen) {
+        fprintf(stderr, "Server: write failed: %s\n", strerror(errno));
+        return -1;
+    }
+    app->directOff += app->directLen;
+    app->directLen = 0;
+    return 0;
+}
+
+static void directClose(struct app_state* app)
+{
+    if (app->directFd >= 0) close(app->directFd);
+    app->directFd = -1;
+    free(app->directBuf);
+    app->directBuf = NULL;
+    app->directLen = app->directOff = 0;
+}
+
+/* Ausgabedatei für SYNC_DIRECT öffnen. Dateisysteme ohne O_DIRECT
+ * (z.B. tmpfs): Rückfall auf sync. */
+static int directOpen(struct app_state* app)
+{
+    app->directFd = open(app->outputFile, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC,
+                         0644);
+    if (app->directFd < 0 && errno == EINVAL) {
+        fprintf(stderr, "Server: O_DIRECT not supported for '%s', using sync\n", app->outputFile);
+        app->syncMode = SYNC_DATA;
+        return 1;
+    }
+    if (app->directFd < 0 ||
+        posix_memalign((void**)&app->directBuf, DIRECT_ALIGN, DIRECT_BUF_SIZE) != 0) {
+        fprintf(stderr, "Server: cannot open output file '%s': %s\n",
+            app->outputFile, strerror(errno));
+        directClose(app);
+        return -1;
+    }
+    app->directLen = app->directOff = 0;
+    return 0;
+}
+
+/* --- Batch-Modus --- */
+
+/* need Bytes nach dst sammeln (über Aufrufe hinweg, Stand in *have).
+ * 1 = vollständig */
+static int streamCollect(char* dst, unsigned long need, unsigned long* have,
+                         const char** buf, unsigned long* len)
+{
+    unsigned long n = need - *have;
+    if (n > *len) n = *len;
+
+    memcpy(dst + *have, *buf, n);
+    *have += n;
+    *buf += n;
+    *len -= n;
+
+    if (*have < need) return 0;
+    *have = 0;
+    return 1;
+}
+
+static int batchCollect(struct app_state* app, char* dst, unsigned long need,
+                        const char** buf, unsigned long* len)
+{
+    return streamCollect(dst, need, &app->batch.have, buf, len);
+}
+
+/* Nur relative Pfade ohne "", "." und ".." als Komponente zulassen */
+static int batchPathOk(const char* name, unsigned long len)
+{
+    const char* p = name;
+
+    if (len == 0 || name[0] == '/' || memchr(name, 0, len) != NULL) return 0;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == 0 || (n == 1 && p[0] == '.') || (n == 2 && p[0] == '.' && p[1] == '.'))
+            return 0;
+        p += n;
+        if (*p == '/') p++;
+    }
+    return 1;
+}
+
+/* Fertige Datei schließen; Dauerhaftigkeit je Datei, da sie vor dem
+ * Abschluss-ACK bereits geschlossen ist */
+static int batchCloseFile(struct app_state* app)
+{
+    int rc = 0;
+
+    if (app->syncMode == SYNC_WRITEBACK)
+        (void)sync_file_range(app->batch.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    else if (app->syncMode >= SYNC_DATA && fdatasync(app->batch.fd) != 0) {
+        fprintf(stderr, "Server: batch: fdatasync '%s' failed: %s\n", app->batch.name,
+                strerror(errno));
+        rc = -1;
+    }
+    close(app->batch.fd);
+    app->batch.fd = -1;
+    return rc;
+}
+
+/* Vollständigen Record (Header + Name) ausführen */
+static int batchStartRecord(struct app_state* app)
+{
+    char full[PATH_MAX];
+    unsigned int mode = app->batch.rec.Mode & 0777;
+
+    app->batch.name[app->batch.rec.NameLen] = 0;
+    app->batch.state = BATCH_S_HDR;
+
+    if (app->batch.rec.Type == BATCH_END) {
+        app->batch.state = BATCH_S_DONE;
+        return 0;
+    }
+    if (!batchPathOk(app->batch.name, app->batch.rec.NameLen) ||
+        snprintf(full, sizeof(full), "%s/%s", app->outputFile, app->batch.name) >=
+            (int)sizeof(full)) {
+        fprintf(stderr, "Server: batch: illegal path '%s'\n", app->batch.name);
+        return -1;
+    }
+
+    switch (app->batch.rec.Type) {
+    case BATCH_DIR:
+        if (mkdir(full, mode | 0700) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Server: mkdir '%s' failed: %s\n", full, strerror(errno));
+            return -1;
+        }
+        return 0;
+
+    case BATCH_FILE:
+        app->batch.fd = open(full, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode ? mode : 0644);
+        if (app->batch.fd < 0) {
+            fprintf(stderr, "Server: cannot open '%s': %s\n", full, strerror(errno));
+            return -1;
+        }
+        app->batch.files++;
+        app->batch.left = app->batch.rec.Size;
+        if (app->batch.left > 0) {
+            app->batch.state = BATCH_S_DATA;
+            return 0;
+        }
+        return batchCloseFile(app);
+
+    default:
+        fprintf(stderr, "Server: batch: unknown record type %u\n", app->batch.rec.Type);
+        return -1;
+    }
+}
+
+/* Nutzdaten eines Pakets in den Entpacker geben */
+static int batchFeed(struct app_state* app, const char* buf, unsigned long len)
+{
+    while (len > 0) {
+        switch (app->batch.state) {
+        case BATCH_S_MAGIC:
+            if (!batchCollect(app, app->batch.magic, BATCH_MAGIC_LEN, &buf, &len)) break;
+            if (memcmp(app->batch.magic, BATCH_MAGIC, BATCH_MAGIC_LEN) != 0) {
+                fprintf(stderr, "Server: output is a directory, but client did not send a batch\n");
+                app->batch.state = BATCH_S_ERROR;
+                return -1;
+            }
+            app->batch.state = BATCH_S_HDR;
+            break;
+
+        case BATCH_S_HDR:
+            if (!batchCollect(app, (char*)&app->batch.rec, sizeof(app->batch.rec), &buf, &len))
+                break;
+            if (app->batch.rec.NameLen >= sizeof(app->batch.name)) {
+                app->batch.state = BATCH_S_ERROR;
+                return -1;
+            }
+            app->batch.state = BATCH_S_NAME;
+            /* Record ohne Namen (Ende) sofort ausführen */
+            if (app->batch.rec.NameLen == 0 && batchStartRecord(app) != 0) {
+                app->batch.state = BATCH_S_ERROR;
+                return -1;
+            }
+            break;
+
+        case BATCH_S_NAME:
+            if (!batchCollect(app, app->batch.name, app->batch.rec.NameLen, &buf, &len)) break;
+            if (batchStartRecord(app) != 0) {
+                app->batch.state = BATCH_S_ERROR;
+                return -1;
+            }
+            break;
+
+        case BATCH_S_DATA: {
+            unsigned long n = (len < app->batch.left) ? len : app->batch.left;
+            ssize_t written = write(app->batch.fd, buf, (size_t)n);
+            if (written != (ssize_t)n) {
+                fprintf(stderr, "Server: batch write failed: %s\n", strerror(errno));
+                app->batch.state = BATCH_S_ERROR;
+                return -1;
+            }
+            buf += n;
+            len -= n;
+            app->batch.left -= n;
+            if (app->batch.left == 0) {
+                if (batchCloseFile(app) != 0) {
+                    app->batch.state = BATCH_S_ERROR;
+                    return -1;
+                }
+                app->batch.state = BATCH_S_HDR;
+            }
+            break;
+        }
+
+        default:
+            /* Daten nach dem Ende-Record oder nach einem Fehler */
+            app->batch.state = BATCH_S_ERROR;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* --- Ausgabedatei --- */
+
+/* Sequentiell an die Ausgabedatei anhängen (FILE oder O_DIRECT-Puffer) */
+static int fileWrite(struct app_state* app, const char* buf, unsigned long len)
+{
+    if (app->fileOk && app->directFd >= 0) {
+        return directWrite(app, buf, len);
+    }
+
+    if (!app->fileOk || !app->fp) {
+        fprintf(stderr, "Server: write failed (file not open)\n");
+        return -1;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    size_t written = fwrite(buf, 1, (size_t)len, app->fp);
+    if (written != (size_t)len) {
+        fprintf(stderr, "Server: fwrite failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (!app->pipeMode) syncNoteWrite(app, fileno(app->fp), app->fileOff, len);
+    app->fileOff += len;
+
+    return 0;
+}
+
+/* Loch: nur die Schreibposition weitersetzen. Pipe, Batch, Delta, Dedup
+ * und O_DIRECT brauchen die Nullen (>0, die ARQ-Schicht schreibt sie). */
+static int appHole(void* user, unsigned long offset, unsigned long len)
+{
+    struct app_state* app = user;
+    if (app->pipeMode || app->batchMode || app->delta.sig != NULL || app->cas.armed ||
+        app->directFd >= 0 ||
+        !app->fileOk || !app->fp)
+        return 1;
+
+    /* Striping und io_uring schreiben per Offset, dort ist die
+     * Position unerheblich */
+    if (fseeko(app->fp, (off_t)(offset + len), SEEK_SET) != 0) {
+        fprintf(stderr, "Server: fseek failed: %s\n", strerror(errno));
+        return -1;
+    }
+    app->fileOff = offset + len;
+    if (app->fileOff > app->sparseEnd) app->sparseEnd = app->fileOff;
+    return 0;
+}
+
+/* Loch am Dateiende: Länge setzen (nach allen Schreibvorgängen) */
+static int sparseFinish(struct app_state* app, int fd)
+{
+    struct stat st;
+
+    if (app->sparseEnd == 0) return 0;
+    if (fstat(fd, &st) != 0) return -1;
+    if ((unsigned long)st.st_size < app->sparseEnd && ftruncate(fd, (off_t)app->sparseEnd) != 0) {
+        fprintf(stderr, "Server: ftruncate failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* --- Delta-Modus --- */
+
+/* Vorhandene Ausgabedatei als Basis öffnen und ihre Signatur berechnen.
+ * Ohne alte Datei ist die Signatur leer (alles reist als Literal). */
+static int deltaOpenBase(struct app_state* app)
+{
+    struct stat st;
+
+    app->delta.baseSize = 0;
+    app->delta.baseFd = open(app->outputFile, O_RDONLY | O_CLOEXEC);
+    if (app->delta.baseFd < 0 && errno != ENOENT) return -1;
+    if (app->delta.baseFd >= 0) {
+        if (fstat(app->delta.baseFd, &st) != 0 || !S_ISREG(st.st_mode)) goto fail;
+        app->delta.baseSize = (unsigned long)st.st_size;
+    }
+    if (deltaSignature(app->delta.baseFd, app->delta.baseSize, &app->delta.sig,
+                       &app->delta.sigLen) < 0)
+        goto fail;
+    return 0;
+
+fail:
+    if (app->delta.baseFd >= 0) close(app->delta.baseFd);
+    app->delta.baseFd = -1;
+    return -1;
+}
+
+/* Basis und Signatur nach dem Transfer freigeben */
+static void deltaClose(struct app_state* app)
+{
+    if (app->delta.state == DELTA_S_DONE)
+        printf("Server: delta: %lu bytes, %lu copied from the old file\n",
+               app->delta.outLen, app->delta.copied);
+    if (app->delta.baseFd >= 0) close(app->delta.baseFd);
+    free(app->delta.sig);
+    memset(&app->delta, 0, sizeof(app->delta));
+    app->delta.baseFd = -1;
+}
+
+/* DELTA_COPY: len Bytes ab off aus der alten Datei übernehmen */
+static int deltaCopy(struct app_state* app, unsigned long off, unsigned long len)
+{
+    char* buf = app->copyBuf;
+
+    if (off > app->delta.baseSize || len > app->delta.baseSize - off) {
+        fprintf(stderr, "Server: delta: copy outside the old file\n");
+        return -1;
+    }
+    while (len > 0) {
+        size_t want = (len < DELTA_COPY_BUF) ? (size_t)len : DELTA_COPY_BUF;
+        ssize_t got = pread(app->delta.baseFd, buf, want, (off_t)off);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            fprintf(stderr, "Server: delta: read old file failed: %s\n", strerror(errno));
+            return -1;
+        }
+        if (fileWrite(app, buf, (unsigned long)got) < 0) return -1;
+        off += (unsigned long)got;
+        len -= (unsigned long)got;
+    }
+    return 0;
+}
+
+/* Vollständigen Record ausführen */
+static int deltaRecord(struct app_state* app)
+{
+    switch (app->delta.rec.Type) {
+    case DELTA_COPY:
+        if (deltaCopy(app, app->delta.rec.Offset, app->delta.rec.Len) < 0) return -1;
+        app->delta.outLen += app->delta.rec.Len;
+        app->delta.copied += app->delta.rec.Len;
+        return 0;
+
+    case DELTA_DATA:
+        app->delta.left = app->delta.rec.Len;
+        if (app->delta.left > 0) app->delta.state = DELTA_S_DATA;
+        return 0;
+
+    case DELTA_END:
+        if (app->delta.rec.Offset != app->delta.outLen) {
+            fprintf(stderr, "Server: delta: length mismatch (%lu instead of %lu bytes)\n",
+                    app->delta.outLen, app->delta.rec.Offset);
+            return -1;
+        }
+        app->delta.state = DELTA_S_DONE;
+        return 0;
+
+    default:
+        fprintf(stderr, "Server: delta: unknown record type %u\n", app->delta.rec.Type);
+        return -1;
+    }
+}
+
+/* Nutzdaten eines Pakets in den Delta-Dekodierer geben */
+static int deltaFeed(struct app_state* app, const char* buf, unsigned long len)
+{
+    while (len > 0) {
+        switch (app->delta.state) {
+        case DELTA_S_MAGIC:
+            if (!streamCollect(app->delta.magic, DELTA_MAGIC_LEN, &app->delta.have, &buf, &len))
+                break;
+            if (memcmp(app->delta.magic, DELTA_MAGIC, DELTA_MAGIC_LEN) != 0) {
+                /* Client sendet die Datei vollständig */
+                app->delta.state = DELTA_S_PLAIN;
+                if (fileWrite(app, app->delta.magic, DELTA_MAGIC_LEN) < 0) return -1;
+                return fileWrite(app, buf, len);
+            }
+            app->delta.state = DELTA_S_HDR;
+            break;
+
+        case DELTA_S_HDR:
+            if (!streamCollect((char*)&app->delta.rec, sizeof(app->delta.rec), &app->delta.have,
+                               &buf, &len))
+                break;
+            if (deltaRecord(app) != 0) {
+                app->delta.state = DELTA_S_ERROR;
+                return -1;
+            }
+            break;
+
+        case DELTA_S_DATA: {
+            unsigned long n = (len < app->delta.left) ? len : app->delta.left;
+            if (fileWrite(app, buf, n) < 0) {
+                app->delta.state = DELTA_S_ERROR;
+                return -1;
+            }
+            buf += n;
+            len -= n;
+            app->delta.left -= n;
+            app->delta.outLen += n;
+            if (app->delta.left == 0) app->delta.state = DELTA_S_HDR;
+            break;
+        }
+
+        case DELTA_S_PLAIN:
+            return fileWrite(app, buf, len);
+
+        default:
+            /* Daten nach dem Ende-Record oder nach einem Fehler */
+            app->delta.state = DELTA_S_ERROR;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Transferende: unvollständiger Delta-Strom ist ein Fehler; ein Strom
+ * kürzer als DELTA_MAGIC war eine vollständig gesendete Datei. */
+static int deltaFinish(struct app_state* app)
+{
+    switch (app->delta.state) {
+    case DELTA_S_PLAIN:
+    case DELTA_S_DONE:
+        return 0;
+    case DELTA_S_MAGIC:
+        app->delta.state = DELTA_S_PLAIN;
+        return fileWrite(app, app->delta.magic, app->delta.have);
+    default:
+        fprintf(stderr, "Server: delta stream incomplete\n");
+        return -1;
+    }
+}
+
+/* --- Dedup-Modus --- */
+
+/* Vollständigen Record ausführen */
+static int casRecord(struct app_state* app)
+{
+    long n;
+
+    switch (app->cas.rec.Type) {
+    case CAS_REF:
+        n = casGet(app->cas.store, app->cas.rec.Hash, app->cas.chunk, sizeof(app->cas.chunk));
+        if (n < 0 || (unsigned long)n != app->cas.rec.Len) {
+            fprintf(stderr, "Server: dedup: chunk missing in the store\n");
+            return -1;
+        }
+        if (fileWrite(app, app->cas.chunk, (unsigned long)n) < 0) return -1;
+        app->cas.outLen += (unsigned long)n;
+        app->cas.reused += (unsigned long)n;
+        return 0;
+
+    case CAS_DATA:
+        if (app->cas.rec.Len == 0 || app->cas.rec.Len > CAS_MAX_CHUNK) {
+            fprintf(stderr, "Server: dedup: bad chunk length %u\n", app->cas.rec.Len);
+            return -1;
+        }
+        app->cas.state = CAS_S_DATA;
+        return 0;
+
+    case CAS_END:
+        if (app->cas.rec.Size != app->cas.outLen) {
+            fprintf(stderr, "Server: dedup: length mismatch (%lu instead of %lu bytes)\n",
+                    app->cas.outLen, app->cas.rec.Size);
+            return -1;
+        }
+        app->cas.state = CAS_S_DONE;
+        return 0;
+
+    default:
+        fprintf(stderr, "Server: dedup: unknown record type %u\n", app->cas.rec.Type);
+        return -1;
+    }
+}
+
+/* Neuen Chunk prüfen, im Store ablegen und schreiben */
+static int casChunkDone(struct app_state* app)
+{
+    unsigned long len = app->cas.rec.Len;
+    int rc = casPut(app->cas.store, app->cas.rec.Hash, app->cas.chunk, len);
+
+    if (rc < 0) {
+        fprintf(stderr, "Server: dedup: chunk does not match its hash or store write failed\n");
+        return -1;
+    }
+    if (rc == 0) app->cas.stored += len;
+    else app->cas.reused += len;
+    app->cas.outLen += len;
+    app->cas.state = CAS_S_HDR;
+    return fileWrite(app, app->cas.chunk, len);
+}
+
+/* Nutzdaten eines Pakets in den Dedup-Dekodierer geben */
+static int casFeed(struct app_state* app, const char* buf, unsigned long len)
+{
+    while (len > 0) {
+        switch (app->cas.state) {
+        case CAS_S_MAGIC:
+            if (!streamCollect(app->cas.magic, CAS_MAGIC_LEN, &app->cas.have, &buf, &len)) break;
+            if (memcmp(app->cas.magic, CAS_MAGIC, CAS_MAGIC_LEN) != 0) {
+                /* Client sendet die Datei vollständig */
+                app->cas.state = CAS_S_PLAIN;
+                if (fileWrite(app, app->cas.magic, CAS_MAGIC_LEN) < 0) return -1;
+                return fileWrite(app, buf, len);
+            }
+            app->cas.state = CAS_S_HDR;
+            break;
+
+        case CAS_S_HDR:
+            if (!streamCollect((char*)&app->cas.rec, sizeof(app->cas.rec), &app->cas.have,
+                               &buf, &len))
+                break;
+            if (casRecord(app) != 0) {
+                app->cas.state = CAS_S_ERROR;
+                return -1;
+            }
+            break;
+
+        case CAS_S_DATA:
+            if (!streamCollect(app->cas.chunk, app->cas.rec.Len, &app->cas.have, &buf, &len)) break;
+            if (casChunkDone(app) != 0) {
+                app->cas.state = CAS_S_ERROR;
+                return -1;
+            }
+            break;
+
+        case CAS_S_PLAIN:
+            return fileWrite(app, buf, len);
+
+        default:
+            app->cas.state = CAS_S_ERROR;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Transferende wie deltaFinish(app); neue Chunks in den Index, mit -s
+ * sync vorher auf stabilen Speicher */
+static int casFinish(struct app_state* app)
+{
+    int rc = 0;
+
+    switch (app->cas.state) {
+    case CAS_S_PLAIN:
+    case CAS_S_DONE:
+        break;
+    case CAS_S_MAGIC:
+        app->cas.state = CAS_S_PLAIN;
+        rc = fileWrite(app, app->cas.magic, app->cas.have);
+        break;
+    default:
+        fprintf(stderr, "Server: dedup stream incomplete\n");
+        return -1;
+    }
+    if (app->cas.store && casFlush(app->cas.store, app->syncMode >= SYNC_DATA) < 0) {
+        fprintf(stderr, "Server: cannot write chunk store index: %s\n", strerror(errno));
+        return -1;
+    }
+    return rc;
+}
+
+/* Zustand nach dem Transfer zurücksetzen (der Store bleibt offen) */
+static void casEnd(struct app_state* app)
+{
+    if (app->cas.state == CAS_S_DONE)
+        printf("Server: dedup: %lu bytes, %lu new in the store, %lu from the store\n",
+               app->cas.outLen, app->cas.stored, app->cas.reused);
+    if (app->cas.store) (void)casFlush(app->cas.store, 0);
+    app->cas.armed = 0;
+    app->cas.state = CAS_S_PLAIN;
+    app->cas.have = app->cas.outLen = app->cas.stored = app->cas.reused = 0;
+}
+
 /* Anwendungscallbacks für die ARQ-Schicht */
 
+/* ReqSig: Signatur der vorhandenen Ausgabedatei abschnittsweise liefern.
+ * Beim ersten Abruf berechnet, gilt bis zum Ende des folgenden
+ * Transfers. Pipe und Batch haben keine vorhandene Datei. */
+static long appSignature(void* user, unsigned long offset, char* buf, unsigned long len,
+                         unsigned long* total)
+{
+    struct app_state* app = user;
+    if (app->pipeMode || app->batchMode || app->fileOk || app->cas.armed) return -1;
+
+    if (app->delta.sig == NULL && deltaOpenBase(app) < 0) {
+        fprintf(stderr, "Server: cannot read '%s' for delta: %s\n", app->outputFile,
+                strerror(errno));
+        return -1;
+    }
+    if (offset > app->delta.sigLen) return -1;
+    if (len > app->delta.sigLen - offset) len = app->delta.sigLen - offset;
+    memcpy(buf, app->delta.sig + offset, len);
+    *total = app->delta.sigLen;
+    return (long)len;
+}
+
+/* Anfrage im Dedup-Modus: Hashes der Chunks des Clients, Antwort eine
+ * Bitmap der Chunks, die dem Store fehlen. Gilt wie die Signatur im
+ * Delta-Modus für den folgenden Transfer. */
+static long appQuery(void* user, const char* q, unsigned long qLen, char* buf, unsigned long len)
+{
+    struct app_state* app = user;
+    unsigned long n = qLen / CAS_HASH_LEN, bytes = (n + 7) / 8;
+
+    if (app->cas.store == NULL || app->batchMode || app->fileOk || app->delta.sig != NULL ||
+        n == 0 || qLen % CAS_HASH_LEN != 0 || bytes > len)
+        return -1;
+    memset(buf, 0, bytes);
+    for (unsigned long i = 0; i < n; i++) {
+        if (!casHas(app->cas.store, (const unsigned char*)q + i * CAS_HASH_LEN))
+            buf[i / 8] |= (char)(1 << (i % 8));
+    }
+    app->cas.armed = 1;
+    return (long)bytes;
+}
+
 /* Ausgabedatei öffnen/neu anlegen. */
-static int appStartTransfer(void)
+static int appStartTransfer(void* user)
 {
-    gFileOk = 0;
+    struct app_state* app = user;
+    app->fileOk = 0;
 
-    if (!gOutputFile) {
+    if (!app->outputFile) {
         fprintf(stderr, "Server: no output file specified.\n");
         return -1;
     }
 
     /* TODO:
-     *   - Datei gOutputFile zum Schreiben öffnen
-     *   - Zeiger in gFp ablegen
-     *   - bei Erfolg gFileOk = 1 setzen
+     *   - Datei app->outputFile zum Schreiben öffnen
+     *   - Zeiger in app->fp ablegen
+     *   - bei Erfolg app->fileOk = 1 setzen
      *   - bei Fehler Fehlermeldung ausgeben und <0 zurückgeben
      */
 
-    if (gFp) {
-        fclose(gFp);
-        gFp = NULL;
+    if (app->batchMode) {
+        if (app->batch.fd >= 0) close(app->batch.fd);
+        memset(&app->batch, 0, sizeof(app->batch));
+        app->batch.fd = -1;
+        app->fileOk = 1;
+        printf("Server: start batch transfer -> unpacking into '%s'\n", app->outputFile);
+        return 0;
     }
+    app->cas.state = app->cas.armed ? CAS_S_MAGIC : CAS_S_PLAIN;
+    app->cas.have = app->cas.outLen = app->cas.stored = app->cas.reused = 0;
 
-    gFp = fopen(gOutputFile, "wb");
-    if (!gFp) {
+    if (app->pipeMode) {
+        /* Eine Pipe kann nur einen Transfer aufnehmen */
+        if (app->pipeUsed) {
+            fprintf(stderr, "Server: pipe already used, transfer rejected.\n");
+            return -1;
+        }
+        app->pipeUsed = 1;
+        if (app->fp) {
+            /* stdout ist bereits in main() geöffnet */
+            app->fileOk = 1;
+            printf("Server: start transfer -> writing to stdout\n");
+            return 0;
+        }
+    }
+
+    if (app->fp) {
+        fclose(app->fp);
+        app->fp = NULL;
+    }
+    directClose(app);
+    app->fileOff = app->dirtyFrom = app->dirtyTo = 0;
+    app->sparseEnd = 0;
+
+    if (app->delta.sig != NULL) {
+        /* neu anlegen statt kürzen: der alte Inhalt bleibt über baseFd lesbar */
+        if (unlink(app->outputFile) != 0 && errno != ENOENT) {
+            fprintf(stderr, "Server: cannot replace '%s': %s\n", app->outputFile, strerror(errno));
+            return -1;
+        }
+        app->delta.state = DELTA_S_MAGIC;
+        app->delta.have = app->delta.outLen = app->delta.copied = 0;
+    }
+
+    if (app->syncMode == SYNC_DIRECT) {
+        int rc = directOpen(app);
+        if (rc < 0) return -1;
+        if (rc == 0) {
+            app->fileOk = 1;
+            printf("Server: start transfer -> writing to '%s' (O_DIRECT)\n", app->outputFile);
+            return 0;
+        }
+    }
+
+    app->fp = fopen(app->outputFile, "wb");
+    if (!app->fp) {
         fprintf(stderr, "Server: cannot open output file '%s': %s\n",
-            gOutputFile, strerror(errno));
-        gFileOk = 0;
+            app->outputFile, strerror(errno));
+        app->fileOk = 0;
         return -1;
     }
 
-    gFileOk = 1;
+    app->fileOk = 1;
 
-    printf("Server: start transfer -> writing to '%s'\n", gOutputFile);
+    printf("Server: start transfer -> writing to '%s'\n", app->outputFile);
     return 0;
 }
 
 /* Nutzdaten in Datei schreiben. */
-static int appWriteData(const char* buf, unsigned long len)
+static int appWriteData(void* user, const char* buf, unsigned long len)
 {
+    struct app_state* app = user;
     /* TODO:
-     *   - prüfen, ob gFileOk und gFp gültig sind
-     *   - len Bytes aus buf in gFp schreiben (fwrite)
+     *   - prüfen, ob app->fileOk und app->fp gültig sind
+     *   - len Bytes aus buf in app->fp schreiben (fwrite)
      *   - bei Fehler <0 zurückgeben
      *   - bei Erfolg 0 zurückgeben
      */
 
-    if (!gFileOk || !gFp) {
+    if (app->batchMode) {
+        return app->fileOk ? batchFeed(app, buf, len) : -1;
+    }
+    if (app->delta.state != DELTA_S_PLAIN) {
+        return app->fileOk ? deltaFeed(app, buf, len) : -1;
+    }
+    if (app->cas.state != CAS_S_PLAIN) {
+        return app->fileOk ? casFeed(app, buf, len) : -1;
+    }
+
+    return fileWrite(app, buf, len);
+}
+
+/* Nutzdaten eines Stripes ab Offset schreiben.
+ * pwrite() am FILE-Puffer vorbei; mehrere Flows schreiben
+ * unabhängig voneinander in dieselbe Datei.
+ */
+static int appWriteDataAt(void* user, const char* buf, unsigned long len, unsigned long offset)
+{
+    struct app_state* app = user;
+    if (!app->fileOk || !app->fp) {
         fprintf(stderr, "Server: write failed (file not open)\n");
         return -1;
     }
@@ -86,29 +993,134 @@ static int appWriteData(const char* buf, unsigned long len)
         return 0;
     }
 
-    size_t written = fwrite(buf, 1, (size_t)len, gFp);
-    if (written != (size_t)len) {
-        fprintf(stderr, "Server: fwrite failed: %s\n", strerror(errno));
+    if (fflush(app->fp) != 0) {
+        fprintf(stderr, "Server: fflush failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    ssize_t written = pwrite(fileno(app->fp), buf, (size_t)len, (off_t)offset);
+    if (written != (ssize_t)len) {
+        fprintf(stderr, "Server: pwrite failed: %s\n", strerror(errno));
         return -1;
     }
+    syncNoteWrite(app, fileno(app->fp), offset, len);
 
     return 0;
 }
 
+/* Ausgabedatei für direktes Schreiben per Offset (io_uring).
+ * Pipe, Batch, Delta und Dedup brauchen die Reihenfolge bzw. den Dekodierer. */
+static int appWriteFd(void* user)
+{
+    struct app_state* app = user;
+    if (app->pipeMode || app->batchMode || app->delta.sig != NULL || app->cas.armed ||
+        !app->fileOk || !app->fp) {
+        return -1;
+    }
+    return fileno(app->fp);
+}
+
+/* Daten vor dem Abschluss-ACK sichern (siehe app->syncMode).
+ * Rückgabewert: erreichte Dauerhaftigkeit DUR_*, <0 bei Fehler. */
+static int appSyncTransfer(void* user)
+{
+    struct app_state* app = user;
+    int fd;
+
+    /* Pipe: Daten gehören dem Leser; Batch: je Datei beim Schließen */
+    if (app->pipeMode) return (casFinish(app) < 0) ? -1 : DUR_NONE;
+    if (app->batchMode) {
+        if (app->batch.state != BATCH_S_DONE) return -1;
+        return (app->syncMode >= SYNC_DATA) ? DUR_SYNC :
+               (app->syncMode == SYNC_WRITEBACK) ? DUR_WRITEBACK : DUR_NONE;
+    }
+    if (!app->fileOk || deltaFinish(app) < 0 || casFinish(app) < 0) return -1;
+
+    if (app->directFd >= 0) {
+        fd = app->directFd;
+        if (directFinish(app) < 0) return -1;
+    } else {
+        if (!app->fp || fflush(app->fp) != 0) return -1;
+        fd = fileno(app->fp);
+        if (sparseFinish(app, fd) < 0) return -1;
+    }
+
+    switch (app->syncMode) {
+    case SYNC_WRITEBACK:
+        (void)sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+        return DUR_WRITEBACK;
+    case SYNC_DATA:
+    case SYNC_DIRECT:
+        if (fdatasync(fd) != 0 || syncParentDir(app) != 0) {
+            fprintf(stderr, "Server: sync failed: %s\n", strerror(errno));
+            return -1;
+        }
+        return DUR_SYNC;
+    default:
+        return DUR_NONE;
+    }
+}
+
 /* Datei schließen. */
-static void appEndTransfer(void)
+static void appEndTransfer(void* user)
 {
+    struct app_state* app = user;
     /* TODO:
-     *   - falls gFp != NULL: Datei schließen (fclose)
-     *   - gFp auf NULL setzen
-     *   - gFileOk zurücksetzen
+     *   - falls app->fp != NULL: Datei schließen (fclose)
+     *   - app->fp auf NULL setzen
+     *   - app->fileOk zurücksetzen
      */
 
-    if (gFp != NULL) {
-        fclose(gFp);
-        gFp = NULL;
+    if (app->batchMode) {
+        if (app->batch.fd >= 0) {
+            close(app->batch.fd);
+            app->batch.fd = -1;
+        }
+        if (app->batch.state != BATCH_S_DONE)
+            fprintf(stderr, "Server: batch incomplete, last file may be truncated\n");
+        printf("Server: batch: %lu files unpacked\n", app->batch.files);
+    }
+
+    if (app->fp != NULL) {
+        fclose(app->fp);
+        app->fp = NULL;
+    }
+    if (app->directFd >= 0) {
+        /* abgebrochener Transfer: vorhandene Daten trotzdem ablegen */
+        (void)directFinish(app);
+        directClose(app);
+    }
+    deltaClose(app);
+    casEnd(app);
+    app->fileOk = 0;
+
+    /* Pipe geschlossen -> Leser sieht EOF; Server beenden */
+    if (app->pipeMode) {
+        arqServerStop(app->srv);
+    }
+}
+
+/* SIGINT/SIGTERM: Ereignisschleife verlassen statt Abbruch */
+static void onStopSignal(int sig)
+{
+    (void)sig;
+    if (gStopSrv) arqServerStop(gStopSrv);
+}
+
+/* Aufrufenden Thread auf die Kerne cpu..cpu+n-1 festlegen (Busy-Poll
+ * belegt sie); die Empfangs-Threads erben die Maske. */
+static int pinCpu(int cpu, unsigned int n)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (unsigned int k = 0; k < (n ? n : 1); k++)
+        CPU_SET(cpu + (int)k, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Server: cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+        return -1;
     }
-    gFileOk = 0;
+    return 0;
 }
 
 /* --- main: Argumente auswerten, ARQ-Schicht starten --- */
@@ -118,7 +1130,32 @@ int main(int argc, char* argv[])
     const char* port = DEFAULT_PORT;
     double lossReq = 0.0;
     double lossAck = 0.0;
+    unsigned long idleSec = 30;
+    unsigned long delAckMs = 0;
+    int useUring = 0;
+    unsigned long busyPollUs = 0;
+    int cpu = -1;
+    int timestamps = 0;
+    int secure = 0;
+    const char* keyFile = NULL;
+    const char* mcastGroup = NULL;
+    int cookies = 1;
+    const char* traceFile = NULL;
+    unsigned long rcvBuf = 0;
+    const char* casDir = NULL;
+    unsigned int rxThreads = 0;
+    unsigned char psk[AEAD_KEY_LEN];
+    struct app_state app;
+    struct arq_server_opts opts;
+    struct arq_server_app cb;
+    struct stat st;
     long i;
+    int rc;
+
+    memset(&app, 0, sizeof(app));
+    app.directFd = -1;
+    app.batch.fd = -1;
+    app.delta.baseFd = -1;
 
     /* Programmargumente auswerten */
     if (argc > 1) {
@@ -137,8 +1174,8 @@ int main(int argc, char* argv[])
                     break;
 
                 case 'f': /* Ausgabedatei */
-                    if (argv[i + 1] && argv[i + 1][0] != '-') {
-                        gOutputFile = argv[++i];
+                    if (argv[i + 1] && (argv[i + 1][0] != '-' || argv[i + 1][1] == 0)) {
+                        app.outputFile = argv[++i];
                         break;
                     }
                     usage(argv[0]);
@@ -160,6 +1197,116 @@ int main(int argc, char* argv[])
                     usage(argv[0]);
                     break;
 
+                case 'i': /* Idle-Timeout */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        idleSec = strtoul(argv[++i], NULL, 10);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'd': /* Delayed ACK */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        delAckMs = strtoul(argv[++i], NULL, 10);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'u': /* io_uring */
+                    useUring = 1;
+                    break;
+
+                case 't': /* Zeitstempel */
+                    timestamps = 1;
+                    break;
+
+                case 'e': /* Verschlüsselung */
+                    secure = 1;
+                    break;
+
+                case 'k': /* Schlüsseldatei */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        keyFile = argv[++i];
+                        secure = 1;
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 's': /* Dauerhaftigkeit */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        const char* m = argv[++i];
+                        if (strcmp(m, "none") == 0)           app.syncMode = SYNC_NONE;
+                        else if (strcmp(m, "writeback") == 0) app.syncMode = SYNC_WRITEBACK;
+                        else if (strcmp(m, "sync") == 0)      app.syncMode = SYNC_DATA;
+                        else if (strcmp(m, "direct") == 0)    app.syncMode = SYNC_DIRECT;
+                        else usage(argv[0]);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'b': /* Busy-Poll */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        busyPollUs = strtoul(argv[++i], NULL, 10);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'c': /* CPU-Pinning */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        cpu = atoi(argv[++i]);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'm': /* Multicast-Gruppe */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        mcastGroup = argv[++i];
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'o': /* ohne Cookie */
+                    cookies = 0;
+                    break;
+
+                case 'x': /* Mitschnitt */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        traceFile = argv[++i];
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'w': /* Empfangspuffer */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        rcvBuf = strtoul(argv[++i], NULL, 10);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'g': /* Chunk-Store */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        casDir = argv[++i];
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
+                case 'n': /* Empfangs-Threads */
+                    if (argv[i + 1] && argv[i + 1][0] != '-') {
+                        rxThreads = (unsigned int)strtoul(argv[++i], NULL, 10);
+                        break;
+                    }
+                    usage(argv[0]);
+                    break;
+
                 default:
                     usage(argv[0]);
                     break;
@@ -171,19 +1318,107 @@ int main(int argc, char* argv[])
         }
     }
 
-    if (!gOutputFile) {
+    if (!app.outputFile) {
         usage(argv[0]);
     }
+    if (mcastGroup && secure) {
+        fprintf(stderr, "Server: Multicast ist nicht verschlüsselt (-m ohne -e/-k)\n");
+        return EXIT_FAILURE;
+    }
+
+    if (strcmp(app.outputFile, "-") == 0) {
+        /* Nutzdaten auf stdout, Statusmeldungen nach stderr */
+        int dataFd = dup(STDOUT_FILENO);
+        if (dataFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 ||
+            (app.fp = fdopen(dataFd, "wb")) == NULL) {
+            perror("Server: stdout");
+            return EXIT_FAILURE;
+        }
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        app.pipeMode = 1;
+    } else if (stat(app.outputFile, &st) == 0) {
+        app.pipeMode  = S_ISFIFO(st.st_mode);
+        app.batchMode = S_ISDIR(st.st_mode);
+    }
+    if (app.pipeMode) {
+        /* Leser beendet: Schreibfehler statt Programmabbruch */
+        signal(SIGPIPE, SIG_IGN);
+    }
 
     printf("Server: listening on port %s\n", port);
     printf("Server: lossReq = %f, lossAck = %f\n", lossReq, lossAck);
 
-    if (arqServerLoop(port, lossReq, lossAck,
-        appStartTransfer, appWriteData, appEndTransfer) < 0) {
-        fprintf(stderr, "Server: arqServerLoop failed\n");
+    memset(&cb, 0, sizeof(cb));
+    cb.user  = &app;
+    cb.start = appStartTransfer;
+    cb.write = appWriteData;
+    cb.end   = appEndTransfer;
+    /* Striping braucht pwrite() mit Offset in eine Datei; O_DIRECT
+     * schreibt nur sequentiell über den ausgerichteten Puffer */
+    if (!app.pipeMode && !app.batchMode && app.syncMode != SYNC_DIRECT) {
+        cb.writeAt = appWriteDataAt;
+    }
+    cb.writeFd = appWriteFd;
+    cb.sync    = appSyncTransfer;
+    cb.sig     = appSignature;
+    cb.hole    = appHole;
+    if (casDir) {
+        unsigned long chunks, bytes;
+        if (app.batchMode || (app.cas.store = casOpen(casDir)) == NULL) {
+            fprintf(stderr, "Server: cannot open chunk store '%s': %s\n", casDir,
+                    app.batchMode ? "not with a batch directory" :
+                    (errno == EWOULDBLOCK) ? "in use by another server" : strerror(errno));
+            return EXIT_FAILURE;
+        }
+        casStats(app.cas.store, &chunks, &bytes);
+        printf("Server: chunk store '%s': %lu chunks, %lu bytes\n", casDir, chunks, bytes);
+        cb.query = appQuery;
+    }
+    if (keyFile && aeadKeyFile(psk, keyFile) < 0) {
+        fprintf(stderr, "Server: Schlüsseldatei %s nicht lesbar\n", keyFile);
+        return EXIT_FAILURE;
+    }
+
+    memset(&opts, 0, sizeof(opts));
+    opts.lossReq       = lossReq;
+    opts.lossAck       = lossAck;
+    opts.idleTimeoutMs = idleSec * 1000UL;
+    opts.delayedAckMs  = delAckMs;
+    opts.uring         = useUring;
+    opts.busyPollUs    = busyPollUs;
+    opts.timestamps    = timestamps;
+    opts.secure        = secure;
+    opts.psk           = keyFile ? psk : NULL;
+    opts.mcastGroup    = mcastGroup;
+    opts.cookies       = cookies;
+    opts.trace         = traceFile;
+    opts.rcvBuf        = rcvBuf;
+    opts.rxThreads     = rxThreads;
+
+    if (cpu >= 0 && pinCpu(cpu, rxThreads) < 0) {
+        return EXIT_FAILURE;
+    }
+    app.srv = arqServerCreate(port, &opts, &cb);
+    if (app.srv == NULL) {
+        fprintf(stderr, "Server: arqServerCreate failed\n");
+        casClose(app.cas.store);
         return EXIT_FAILURE;
     }
+    if (traceFile) {
+        /* Trace beim Beenden vollständig schreiben */
+        gStopSrv = app.srv;
+        signal(SIGINT, onStopSignal);
+        signal(SIGTERM, onStopSignal);
+    }
 
+    rc = arqServerRun(app.srv);
+    gStopSrv = NULL;
+    arqServerDestroy(app.srv);
+    casClose(app.cas.store);
+    if (rc < 0) {
+        fprintf(stderr, "Server: arqServerRun failed\n");
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
 
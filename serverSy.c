@@ -3,12 +3,13 @@
  * Schichten:
  *   - SAP-Schicht (UDP): initServer, getRequest, sendAnswer, exitServer
  *   - ARQ-Schicht: processRequest(), arqServerLoop()
+ *     (epoll- oder io_uring-Ereignisschleife, Sitzungs-Timer im Timer Wheel)
  *
  * Die Anwendung (Datei öffnen/schreiben/schließen) wird über Callbacks
- * aus server.c angebunden:
- *   appStartFn  appStartTransfer
- *   appWriteFn  appWriteData
- *   appEndFn    appEndTransfer
+ * aus server.c angebunden (struct arq_server_app, Zustand in user):
+ *   start  appStartTransfer
+ *   write  appWriteData
+ *   end    appEndTransfer
  *
  * WICHTIG:
  *   - Dateiname und Funktionssignaturen in serverSy.h sollen
@@ -19,40 +20,333 @@
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #include <time.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include <netinet/in.h>
+#include <linux/sock_diag.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 
 #include "data.h"
 #include "config.h"
 #include "serverSy.h"
+#include "timerwheel.h"
+#include "arqio.h"
+#include "uring.h"
+#include "aead.h"
+#include "trace.h"
 
-/* Optionale globale Variablen:
+/* --------------------------------------------------------------- */
+/*  Sitzungen und Transfers                                        */
+/* --------------------------------------------------------------- */
+
+/*
+ * Jeder Client-Socket (Adresse + Port) ist eine eigene GBN-Sitzung mit
+ * eigenem nextExpected. Mehrere Sitzungen mit derselben XferId bilden
+ * einen Transfer (Striping, siehe struct hello_info): appStart wird beim
+ * ersten Stripe, appEnd nach dem Close des letzten Stripes aufgerufen.
+ *
+ * Sitzungen werden über eine Hash-Tabelle (Client-Adresse) in O(1)
+ * gefunden. Zeitgesteuerte Arbeit läuft über das Timer Wheel:
+ *   - Idle-Timer: offene Sitzung ohne Pakete -> abbrechen, Datei zu
+ *   - Linger-Timer: geschlossene Sitzung nach Ablauf freigeben
+ *   - Delayed-ACK: ACK spätestens nach delAckMs
+ *   - Statistik: periodische Ausgabe der Zähler
+ */
+#define ARQ_MAX_SESSIONS   1024
+#define ARQ_HASH_SIZE      2048          /* Zweierpotenz */
+#define ARQ_MAX_XFERS      64
+#define ARQ_MAX_RX_THREADS 64            /* opts.rxThreads */
+
+#define ARQ_IDLE_MS        30000         /* Default Idle-Timeout       */
+#define ARQ_LINGER_MS      10000         /* geschlossene Sitzung behalten */
+#define ARQ_CLOSED_KEEP    ARQ_MAX_SESSIONS /* abgeschlossene Transfers merken */
+#define ARQ_CLOSED_MS      ((unsigned long long)GBN_GIVEUP_UNITS * GBN_TIMEOUT_INT_MS)
+#define ARQ_STATS_MS       5000          /* Statistik-Intervall        */
+#define ARQ_COOKIE_HELLOS  32            /* neue Hellos je Sekunde ohne Cookie */
+
+/* Speicherbedarf eines Request-Datagramms im Socket-Empfangspuffer
+ * (Nutzdaten + sk_buff-Overhead, auf Loopback gemessen ~2.4 x),
+ * großzügig aufgerundet */
+#define ARQ_RX_TRUESIZE    (5 * sizeof(struct request) / 2)
+
+/* Automatische Größe des Socket-Empfangspuffers (opts.rcvBuf = 0):
+ * volle Fenster für so viele Flows gleichzeitig. Der Default des
+ * Kernels (rmem_default, meist 208 KiB) reicht nur für ~16; was
+ * darüber hinaus ankommt, verwirft der Kernel wie Netzverlust. */
+#define ARQ_RCVBUF_FLOWS   64
+#define ARQ_RCVBUF_AUTO    (ARQ_RCVBUF_FLOWS * GBN_MAX_WINDOW * ARQ_RX_TRUESIZE)
+
+enum { SESS_FREE = 0, SESS_OPEN, SESS_CLOSED };
+enum { XFER_FREE = 0, XFER_ACTIVE, XFER_DONE };
+
+struct arq_xfer {
+    int           state;        /* XFER_*                              */
+    unsigned long xferId;       /* 0 = klassischer Transfer ohne Info  */
+    unsigned int  stripes;      /* angekündigte Anzahl Stripes         */
+    unsigned int  closedMask;   /* Bit i: Stripe i hat Close gesendet  */
+    unsigned int  open;         /* offene Sitzungen                    */
+    unsigned int  refs;         /* Sitzungen, die auf den Transfer zeigen */
+    unsigned int  writes;       /* io_uring-Schreibvorgänge unterwegs  */
+    int           failed;       /* asynchroner Schreib- oder Sync-Fehler */
+    int           durable;      /* DUR_* nach Abschluss, <0 = unbekannt */
+};
+
+/* Sauber abgeschlossene Sitzung nach Ablauf des Linger-Timers: ein
+ * wiederholtes FIN/Close (alle Abschluss-ACKs verloren) wird noch so
+ * lange erkannt, wie der Client wiederholt (ARQ_CLOSED_MS). Ohne
+ * Eintrag (Neustart, Idle-Abbruch) ist der Abschluss nicht belegt. */
+struct arq_closed {
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;      /* 0 = frei                  */
+    unsigned long long      closedMs;
+    struct answer           answ;         /* Abschluss-ACK             */
+};
+
+struct arq_server;
+
+/*
+ * Mehrere Empfangs-Threads (opts.rxThreads): je Thread eine Instanz mit
+ * eigenem Socket auf demselben Port (SO_REUSEPORT, der Kernel verteilt
+ * die Flows nach Adresse und Port), eigener Ereignisschleife, eigenen
+ * Sitzungen und Timern. Die Stripes eines Transfers landen meist auf
+ * verschiedenen Instanzen: die Transfertabelle ist gemeinsam, Transfers
+ * und Anwendungscallbacks nur unter lock (die Anwendung muss nicht
+ * threadsicher sein). Empfang, Entschlüsseln, Versiegeln und Senden
+ * laufen parallel. shard[0] ist die Instanz aus arqServerCreate().
+ */
+struct arq_shared {
+    pthread_mutex_t         lock;
+    struct arq_xfer         xfers[ARQ_MAX_XFERS];
+    struct arq_server      *shard[ARQ_MAX_RX_THREADS];
+    pthread_t               thread[ARQ_MAX_RX_THREADS];
+    unsigned int            n;
+    int                     failed;       /* eine Ereignisschleife mit Fehler */
+};
+
+/* Multicast-Empfang (siehe data.h): Pakete hinter einer Lücke, bis
+ * nextExpected sie erreicht; seq = 0 ist ein freier Platz. */
+struct session_mc {
+    struct {
+        unsigned long       seq;
+        unsigned long       len;
+        char                data[BufferSize];
+    }                       slot[GBN_MC_WINDOW];
+    unsigned int            buffered;     /* belegte Plätze            */
+};
+
+struct arq_session {
+    struct arq_server      *srv;
+    int                     state;        /* SESS_*                    */
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;
+    unsigned int            hash;
+    struct arq_session     *hnext;        /* Hash-Kette / Freiliste    */
+    unsigned long           nextExpected;
+    struct arq_xfer        *xfer;
+    unsigned int            stripe;
+    int                     striped;      /* Schreiben per Offset      */
+    unsigned long           offset;       /* nächste Schreibposition   */
+    unsigned int            unacked;      /* Pakete seit letztem ACK   */
+    unsigned long           recDone;      /* REQ_F_RECS: schon geschriebene Bytes von nextExpected */
+    unsigned long long      lastRxNs;     /* Empfangszeit des zuletzt angenommenen Pakets */
+    unsigned long long      lastActiveMs;
+    unsigned long           nakSeq;       /* Beginn der zuletzt gemeldeten Lücke */
+    unsigned long           nakEnd;       /* erstes Paket danach, das ankam */
+    unsigned long long      nakMs;        /* Zeit des letzten NAK      */
+    unsigned int            nakTries;     /* Wiederholungen per Timer  */
+    struct {                              /* verschlüsselter Betrieb   */
+        int                 keyed;        /* Schlüssel aus dem Hello   */
+        uint8_t             cpub[AEAD_PUB_LEN], spub[AEAD_PUB_LEN];
+        struct aead_key     rx, tx;       /* Verfahren aus dem Hello   */
+        uint64_t            txCtr;
+    }                       sec;
+    struct session_mc      *mc;           /* Multicast-Empfang, sonst NULL */
+    struct tw_timer         idleTimer;    /* Idle bzw. Linger          */
+    struct tw_timer         ackTimer;     /* verzögertes ACK           */
+    struct tw_timer         nakTimer;     /* NAK wiederholen           */
+};
+
+/*
+ * io_uring-Betrieb (opts.uring): Ein Multishot-RECVMSG bleibt auf dem
+ * Socket stehen, der Kernel legt jedes Datagramm samt Absender in einen
+ * Puffer des Buffer-Rings. ACKs (SENDMSG) und Dateischreiben (WRITE mit
+ * Offset) werden als SQEs gesammelt und mit dem nächsten Warten in
+ * einem io_uring_enter() übergeben. Tick und Stop kommen als READ auf
+ * timerfd/eventfd über denselben Ring.
+ */
+#define URING_ENTRIES      512
+#define URING_RX_BUFS      256           /* Zweierpotenz */
+#define URING_RX_BUF_SIZE  1024          /* recvmsg_out + Adresse + Kontroll-
+                                            daten + Request (ggf. im Umschlag) */
+#define URING_TX_SLOTS     256
+#define URING_WR_SLOTS     128
+
+/* user_data: Art im oberen, Slot im unteren Wort */
+enum { UD_RECV = 1, UD_TICK, UD_STOP, UD_SEND, UD_WRITE, UD_DONE };
+#define UD(kind, idx)  (((unsigned long long)(kind) << 32) | (idx))
+#define UD_KIND(ud)    ((unsigned)((ud) >> 32))
+#define UD_IDX(ud)     ((unsigned)((ud) & 0xffffffffu))
+
+/* größte Antwort auf dem Draht (verschlüsselt, mit Umschlag) */
+#define ANSW_PACKET_MAX    (sizeof(struct answer_data) + SEC_OVERHEAD)
+
+struct uring_tx {
+    unsigned char           pkt[ANSW_PACKET_MAX];
+    struct sockaddr_storage addr;
+    struct msghdr           msg;
+    struct iovec            iov;
+};
+
+struct uring_wr {
+    struct arq_xfer        *xfer;
+    unsigned long           len;
+    char                    data[BufferSize];
+};
+
+struct server_uring {
+    struct uring            ring;
+    struct msghdr           rxMsg;        /* Vorlage für Multishot-RECVMSG */
+    int                     rxOk;         /* Multishot-Empfang funktioniert */
+    unsigned long long      tickBuf, stopBuf;
+    struct uring_tx         tx[URING_TX_SLOTS];
+    unsigned short          txFree[URING_TX_SLOTS];
+    unsigned int            txFreeN;
+    struct uring_wr         wr[URING_WR_SLOTS];
+    unsigned short          wrFree[URING_WR_SLOTS];
+    unsigned int            wrFreeN;
+};
+
+/* Statistik-Zähler einer Server-Instanz */
+struct arq_stats {
+    unsigned long pkts, bytes, holes, dups, acks, delayedAcks, reaped, zeroWnd, naks;
+    unsigned long cookies;     /* Hellos mit AnswCookie beantwortet */
+    unsigned long skipped;     /* vom Sender aufgegebene Nachrichten (REQ_F_SKIP) */
+    unsigned long kernelDrops; /* vom Kernel verworfen (SO_RXQ_OVFL, seit Start) */
+    unsigned long openSessions;
+};
+
+/*
+ * Verschlüsselter Betrieb (opts.secure, Format siehe struct sec_hdr):
+ * nur Pakete im Umschlag werden angenommen. Die Schlüssel einer
+ * Sitzung entstehen beim Hello (struct arq_session, sec); rx* gilt nur
+ * für den gerade verarbeiteten Request.
+ */
+struct server_sec {
+    uint8_t                 psk[AEAD_KEY_LEN];
+    uint64_t                ctr;          /* Antworten mit k0 (ohne Sitzung) */
+    int                     rxHello;      /* aktueller Request: SEC_HELLO */
+    int                     rxCookieOk;   /* Cookie im Kopf schon geprüft */
+    unsigned                rxAlgs;       /* vom Client angebotene Verfahren */
+    uint8_t                 rxPub[AEAD_PUB_LEN];
+    uint8_t                 rxK0[AEAD_KEY_LEN];
+    unsigned char           pkt[SEC_MAX_PACKET];  /* Empfangspuffer   */
+};
+
+/*
+ * Server-Kontext: gesamter Zustand einer Server-Instanz
  *   - Socket-Deskriptor
  *   - zuletzt bekannte Client-Adresse (für sendto)
- *   - nächst erwartete Sequenznummer (nextExpected)
- *   - Zeiger auf die Anwendungscallbacks
+ *   - Sitzungstabelle (je Client-Adresse ein nextExpected)
+ *   - Anwendungscallbacks, Optionen, Timer, Statistik
  */
+struct arq_server {
+    int                     sock;
+    struct arq_io           io;           /* Uhr und Transport (Socket oder Simulation) */
+    struct sockaddr_storage lastClientAddr;
+    socklen_t               lastClientAddrLen;
+    struct request          req;          /* Empfangspuffer           */
+
+    struct arq_server_app   app;
+    double                  lossReq;
+    double                  lossAck;
+    unsigned long           idleMs;
+    unsigned long           delAckMs;     /* 0 = jedes Paket sofort bestätigen */
+    unsigned int            randState;    /* rand_r() für Verlustsimulation */
+    int                     quiet;        /* keine Statusausgaben      */
+    unsigned long long      spinNs;       /* Busy-Poll vor dem Blockieren */
+    int                     timestamps;   /* SO_TIMESTAMPING, Servicezeit im ACK */
+    int                     rxqOvfl;      /* SO_RXQ_OVFL, Verwerfungen zählen */
+    unsigned long long      rxNs;         /* Kernel-Empfangszeit des aktuellen
+                                             Requests (CLOCK_REALTIME), 0 = unbekannt */
+    struct server_sec      *sec;          /* verschlüsselter Betrieb, sonst NULL */
+    char                    ansData[BufferSize];  /* Nutzdaten der aktuellen
+                                             Antwort (AnswSig)          */
+    unsigned long           ansDataLen;
+    uint64_t                mcId;         /* Kennung als Multicast-Empfänger */
+    int                     cookies;      /* unter Last Hello nur mit Cookie */
+    uint8_t                 cookieKey[AEAD_KEY_LEN];  /* Geheimnis für die Cookies */
+    unsigned long long      helloMs;      /* Beginn der laufenden Sekunde */
+    unsigned int            hellos;       /* neue Hellos darin         */
+    struct arq_trace       *trace;        /* Mitschnitt, sonst NULL    */
+
+    int                     epfd;
+    int                     tfd;          /* periodischer Tick (timerfd) */
+    int                     stopFd;       /* eventfd für arqServerStop  */
+    struct server_uring    *ur;           /* io_uring-Betrieb, sonst NULL */
+    int                     uringLater;   /* Ring erst im eigenen Thread anlegen
+                                             (IORING_SETUP_SINGLE_ISSUER) */
+
+    /* SO_MEMINFO je Ereignisbündel einmal abfragen (advertise_window) */
+    uint32_t                mem[SK_MEMINFO_VARS];
+    int                     memValid;
+
+    struct arq_session      sessions[ARQ_MAX_SESSIONS];
+    struct arq_session     *sessHash[ARQ_HASH_SIZE];
+    struct arq_session     *sessFree;
+    struct arq_xfer        *xfers;        /* xferTab bzw. shared->xfers */
+    struct arq_xfer         xferTab[ARQ_MAX_XFERS];
+    struct arq_shared      *shared;       /* mehrere Empfangs-Threads, sonst NULL */
+    unsigned int            shardNo;      /* Index in shared->shard    */
+    struct arq_closed       closed[ARQ_CLOSED_KEEP];  /* Ring */
+    unsigned int            closedNext;
+
+    struct timer_wheel      wheel;
+    struct tw_timer         statsTimer;
+    unsigned long long      nowMs;        /* Zeit des aktuellen Ereignisses */
+
+    /* Zähler für die periodische Statistik */
+    struct arq_stats        stats, statsFlushed;
+
+    /* klassische API (nur Standard-Instanz): Einstellungen der
+     * arqServerSet*()-Aufrufe und Callbacks ohne Kontextzeiger */
+    struct {
+        struct arq_server_opts opts;
+        uint8_t             psk[AEAD_KEY_LEN];
+        appStartFn          start;
+        appWriteFn          write;
+        appEndFn            end;
+        appWriteAtFn        writeAt;
+        appWriteFdFn        writeFd;
+        appSyncFn           sync;
+        appSigFn            sig;
+        appHoleFn           hole;
+        appQueryFn          query;
+    }                       classic;
+};
+
+/* Standard-Instanz der klassischen API (initServer ... arqServerLoop) */
+static struct arq_server *gServer = NULL;
 
 /* --------------------------------------------------------------- */
 /*  SAP-Schicht (UDP)                                              */
 /* --------------------------------------------------------------- */
-static int serverSock = -1;
-static struct sockaddr_storage lastClientAddr;
-static socklen_t lastClientAddrLen = 0;
 
-static unsigned int nextExpected = 0;
-static int initialized = 0;
-
-static appStartFn g_appStart = NULL;
-static appWriteFn g_appWrite = NULL;
-static appEndFn g_appEnd = NULL;
-
-int initServer(const char *port)
+static int sap_init(struct arq_server *srv, const char *port)
 {
-    (void)port;
 
     /* TODO:
      *  - mit getaddrinfo(NULL, port, ...) eine lokale Adresse für UDP/IPv6
@@ -86,6 +380,13 @@ int initServer(const char *port)
                 continue;
             }
             (void)setsockopt(sfd,SOL_SOCKET,SO_REUSEADDR,&opt,sizeof(opt));
+            /* Empfangs-Threads teilen sich den Port (struct arq_shared) */
+            if (srv->shared &&
+                setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+                close(sfd);
+                sfd = -1;
+                continue;
+            }
             
             if(bind(sfd, rp->ai_addr, rp->ai_addrlen) == 0){
                 break;
@@ -99,13 +400,120 @@ int initServer(const char *port)
             fprintf(stderr,"initServer: unable to bind in port %s: %s\n",use_port,strerror(errno));
             return -1;
         }
-        serverSock = sfd;
+        srv->sock = sfd;
         return 0;
 }
 
-struct request *getRequest(void)
+/* Empfangspuffer auf bytes setzen (exact = 0: nur vergrößern):
+ * SO_RCVBUFFORCE mit CAP_NET_ADMIN, sonst SO_RCVBUF bis
+ * net.core.rmem_max. Der Kernel verdoppelt den Wert für seinen
+ * Verwaltungsaufwand und meldet die verdoppelte Größe zurück, die
+ * auch advertise_window() sieht. Dazu SO_RXQ_OVFL, damit Verluste im
+ * Puffer nicht wie Netzverlust aussehen. */
+static void sap_size_rcvbuf(struct arq_server *srv, unsigned long bytes, int exact)
+{
+    int cur = 0, val, on = 1;
+    socklen_t len = sizeof(cur);
+
+    srv->rxqOvfl = setsockopt(srv->sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) == 0;
+
+    if (getsockopt(srv->sock, SOL_SOCKET, SO_RCVBUF, &cur, &len) < 0 ||
+        (unsigned long)cur == bytes || (!exact && (unsigned long)cur > bytes))
+        return;
+    val = (bytes / 2 > INT_MAX) ? INT_MAX : (int)(bytes / 2);
+    if (setsockopt(srv->sock, SOL_SOCKET, SO_RCVBUFFORCE, &val, sizeof(val)) < 0)
+        (void)setsockopt(srv->sock, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+
+    len = sizeof(cur);
+    if (getsockopt(srv->sock, SOL_SOCKET, SO_RCVBUF, &cur, &len) == 0 &&
+        (unsigned long)cur < bytes && !srv->quiet)
+        fprintf(stderr, "Server: Empfangspuffer %d statt %lu Bytes "
+                "(net.core.rmem_max erhöhen)\n", cur, bytes);
+}
+
+/* Multicast-Gruppe beitreten; group = "Adresse%Interface", das
+ * Interface (Scope) bestimmt, wo die Gruppe empfangen wird. */
+static int sap_join(struct arq_server *srv, const char *group)
+{
+    struct addrinfo hints, *res;
+    struct ipv6_mreq mreq;
+    const struct sockaddr_in6 *sin6;
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = AI_NUMERICHOST;
+    ret = getaddrinfo(group, NULL, &hints, &res);
+    if (ret != 0) {
+        fprintf(stderr, "initServer: multicast group %s: %s\n", group, gai_strerror(ret));
+        return -1;
+    }
+    sin6 = (const struct sockaddr_in6 *)res->ai_addr;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.ipv6mr_multiaddr = sin6->sin6_addr;
+    mreq.ipv6mr_interface = sin6->sin6_scope_id;
+    freeaddrinfo(res);
+
+    if (!IN6_IS_ADDR_MULTICAST(&mreq.ipv6mr_multiaddr)) {
+        fprintf(stderr, "initServer: %s is not a multicast address\n", group);
+        return -1;
+    }
+    if (setsockopt(srv->sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) < 0) {
+        fprintf(stderr, "initServer: join %s: %s\n", group, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Software-Empfangszeitstempel (SCM_TIMESTAMPING, ts[0]) in ns,
+ * 0 wenn keiner beiliegt */
+/* Platz für die Kontrollnachrichten beim Empfang (Zeitstempel, Zähler) */
+#define SAP_CTRL_LEN  (CMSG_SPACE(sizeof(struct scm_timestamping)) + \
+                       CMSG_SPACE(sizeof(uint32_t)))
+
+/* Kontrollnachrichten eines Datagramms: Empfangszeit nach srv->rxNs
+ * (0 = unbekannt), Zähler der Verwerfungen (kommt nur, wenn er nicht
+ * 0 ist) in die Statistik */
+static void parse_cmsgs(struct arq_server *srv, struct msghdr *msg)
+{
+    struct cmsghdr *cm;
+
+    srv->rxNs = 0;
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET) continue;
+        if (cm->cmsg_type == SCM_TIMESTAMPING && srv->timestamps) {
+            struct scm_timestamping ts;
+            memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+            srv->rxNs = (unsigned long long)ts.ts[0].tv_sec * 1000000000ULL +
+                        (unsigned long long)ts.ts[0].tv_nsec;
+        } else if (cm->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+            srv->stats.kernelDrops = drops;
+        }
+    }
+}
+
+static int sec_unwrap(struct arq_server *srv, const unsigned char *pkt, unsigned long len);
+
+/* Datagramm bzw. Tick mitschneiden (opts.trace) */
+static void trace_datagram(struct arq_server *srv, int kind, const void *buf, unsigned long len,
+                           const struct sockaddr_storage *addr, socklen_t addrLen)
 {
-    static struct request req;
+    if (srv->trace)
+        traceRecord(srv->trace, kind, srv->io.now(srv->io.user), addr, addrLen, buf, len);
+}
+
+static void trace_tick(struct arq_server *srv)
+{
+    if (srv->trace)
+        traceRecord(srv->trace, TRACE_TICK, srv->io.now(srv->io.user), NULL, 0, NULL, 0);
+}
+
+static struct request *sap_recv(struct arq_server *srv)
+{
+    struct request *req = &srv->req;
 
     /* TODO:
      *  - mit recvfrom(...) ein Request-Paket vom Socket lesen
@@ -115,61 +523,83 @@ struct request *getRequest(void)
      *  - bei Fehler oder wenn keine Daten vorliegen: NULL zurückgeben
      */
     ssize_t n;
+    struct iovec iov;
+    struct msghdr msg;
+    char ctrl[SAP_CTRL_LEN];
 
-    if(serverSock < 0) return NULL; //Verhindert recvfrom() auf ungültige Socket
+    if(srv->sock < 0) return NULL; //Verhindert recvfrom() auf ungültige Socket
 
-    lastClientAddrLen = sizeof(lastClientAddr);
-    memset(&req,0,sizeof(req));
+again:
+    /* verschlüsselt: in den Umschlagpuffer, sec_unwrap füllt req */
+    if (srv->sec != NULL) {
+        iov.iov_base = srv->sec->pkt;
+        iov.iov_len  = sizeof(srv->sec->pkt);
+    } else {
+        memset(req,0,sizeof(*req));
+        iov.iov_base = req;
+        iov.iov_len  = sizeof(*req);
+    }
 
-    n = recvfrom(serverSock,
-                 &req,
-                sizeof(req),
-                0,
-        (struct sockaddr *)&lastClientAddr,&lastClientAddrLen);
+    /* recvmsg statt recvfrom: mit SO_TIMESTAMPING liegt der
+     * Empfangszeitstempel des Kernels als Kontrollnachricht bei, mit
+     * SO_RXQ_OVFL der Zähler der verworfenen Datagramme */
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name       = &srv->lastClientAddr;
+    msg.msg_namelen    = sizeof(srv->lastClientAddr);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = (srv->timestamps || srv->rxqOvfl) ? ctrl : NULL;
+    msg.msg_controllen = (srv->timestamps || srv->rxqOvfl) ? sizeof(ctrl) : 0;
+
+    n = recvmsg(srv->sock, &msg, 0);
 
     if(n == -1){
         if(errno == EAGAIN || errno == EWOULDBLOCK) return NULL;
-        perror("getRequest: recvfrom");
+        perror("getRequest: recvmsg");
         return NULL;
     }
+    srv->lastClientAddrLen = msg.msg_namelen;
+    parse_cmsgs(srv, &msg);
+    trace_datagram(srv, TRACE_RX, iov.iov_base, (unsigned long)n,
+                   &srv->lastClientAddr, srv->lastClientAddrLen);
+
+    /* unverschlüsselte oder verfälschte Pakete: nächstes lesen */
+    if (srv->sec != NULL && sec_unwrap(srv, srv->sec->pkt, (unsigned long)n) < 0)
+        goto again;
 
-    return &req;
+    return req;
 }
 
-int sendAnswer(struct answer *answerPtr)
+/* Standard-Hooks (struct arq_io): UDP-Socket und CLOCK_MONOTONIC */
+static unsigned long long sys_now(void *user)
 {
-    (void)answerPtr;
-
-    /* TODO:
-     *  - mit sendto(...) eine Antwort an die zuletzt bekannte
-     *    Client-Adresse schicken
-     *  - bei Erfolg 0, bei Fehler <0 zurückgeben
-     */
+    (void)user;
+    return twNowMs() * 1000000ULL;
+}
 
+static int sys_send(void *user, const void *buf, unsigned long len,
+                    const struct sockaddr_storage *to, socklen_t toLen)
+{
+     struct arq_server *srv = user;
      ssize_t n;
 
-     if(serverSock < 0){
+     if(srv->sock < 0){
         fprintf(stderr,"sendAnswer: server socket not initialized\n");
         return -1;
      }
 
-     if(lastClientAddrLen == 0){
-        fprintf(stderr,"sendAnswer: no client address known\n");
-        return -1;
-     }
-
-     n = sendto(serverSock,
-                answerPtr,
-                sizeof(*answerPtr),
+     n = sendto(srv->sock,
+                buf,
+                len,
                 0,
-                (struct sockaddr *)&lastClientAddr,
-                lastClientAddrLen);
+                (const struct sockaddr *)to,
+                toLen);
     if(n == -1){
         perror("sendAnswer: sendto");
         return -1;
     }
 
-    if((size_t)n != sizeof(*answerPtr)){
+    if((size_t)n != len){
         fprintf(stderr,"sendAnswer: partial send(%zd bytes)\n",n);
         return -1;
     }
@@ -177,214 +607,2390 @@ int sendAnswer(struct answer *answerPtr)
     return 0;
 }
 
-int exitServer(void)
+/* io_uring-Hook: ACK als SENDMSG eintragen, übergeben wird gesammelt.
+ * Sind alle Slots unterwegs, direkt per sendto(). */
+static int uring_send(void *user, const void *buf, unsigned long len,
+                      const struct sockaddr_storage *to, socklen_t toLen)
 {
-    /* TODO:
-     *  - Socket schließen (close)
-     *  - globale Zustandsvariablen zurücksetzen
-     */
+    struct arq_server *srv = user;
+    struct server_uring *ur = srv->ur;
+    struct io_uring_sqe *sqe;
+    struct uring_tx *tx;
+    unsigned short idx;
+
+    if (ur->txFreeN == 0 || len > sizeof(tx->pkt) ||
+        (sqe = uringSqe(&ur->ring)) == NULL)
+        return sys_send(user, buf, len, to, toLen);
+
+    idx = ur->txFree[--ur->txFreeN];
+    tx = &ur->tx[idx];
+    memcpy(tx->pkt, buf, len);
+    memcpy(&tx->addr, to, toLen);
+    tx->iov.iov_base    = tx->pkt;
+    tx->iov.iov_len     = len;
+    memset(&tx->msg, 0, sizeof(tx->msg));
+    tx->msg.msg_name    = &tx->addr;
+    tx->msg.msg_namelen = toLen;
+    tx->msg.msg_iov     = &tx->iov;
+    tx->msg.msg_iovlen  = 1;
+
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = srv->sock;
+    sqe->addr      = (unsigned long)&tx->msg;
+    sqe->len       = 1;
+    sqe->user_data = UD(UD_SEND, idx);
+    return 0;
+}
+
+static unsigned long long now_ms(struct arq_server *srv)
+{
+    return srv->io.now(srv->io.user) / 1000000ULL;
+}
+
+static long sec_seal_answer(struct arq_server *srv,
+                            const struct sockaddr_storage *addr, socklen_t addrLen,
+                            const void *plain, unsigned long plainLen, unsigned char *pkt);
+
+/* Antwort mit dataLen Bytes Nutzdaten (AnswSig) senden */
+static int send_answer_data(struct arq_server *srv,
+                            const struct sockaddr_storage *addr, socklen_t addrLen,
+                            const struct answer *answerPtr,
+                            const char *data, unsigned long dataLen)
+{
+     unsigned char pkt[ANSW_PACKET_MAX];
+     struct answer_data ad;
+     const void *plain = answerPtr;
+     unsigned long plainLen = sizeof(*answerPtr);
+     long len;
+
+     if(addrLen == 0){
+        fprintf(stderr,"sendAnswer: no client address known\n");
+        return -1;
+     }
+     if (dataLen > 0) {
+        ad.Answ = *answerPtr;
+        memcpy(ad.Data, data, dataLen);
+        plain = &ad;
+        plainLen += dataLen;
+     }
+     if (srv->sec != NULL) {
+        len = sec_seal_answer(srv, addr, addrLen, plain, plainLen, pkt);
+        if (len < 0) return 0;   /* ohne Schlüssel nicht beantworten */
+        trace_datagram(srv, TRACE_TX, pkt, (unsigned long)len, addr, addrLen);
+        return srv->io.send(srv->io.user, pkt, (unsigned long)len, addr, addrLen);
+     }
+     trace_datagram(srv, TRACE_TX, plain, plainLen, addr, addrLen);
+     return srv->io.send(srv->io.user, plain, plainLen, addr, addrLen);
+}
+
+/* Antwort an eine beliebige Client-Adresse (verzögerte ACKs, Timer) */
+static int send_answer_to(struct arq_server *srv,
+                          const struct sockaddr_storage *addr, socklen_t addrLen,
+                          const struct answer *answerPtr)
+{
+     return send_answer_data(srv, addr, addrLen, answerPtr, NULL, 0);
+}
+
+static int sap_exit(struct arq_server *srv)
+{
+    int rc = 0;
 
-    if(serverSock >= 0){
-        if(close(serverSock) == -1){
+    if(srv->sock >= 0){
+        if(close(srv->sock) == -1){
             perror("exitServer: close");
-            serverSock = -1;
-            lastClientAddrLen = 0;
-            memset(&lastClientAddr, 0, sizeof(lastClientAddr));
-            return -1;
+            rc = -1;
         }
-        serverSock = -1;
+        srv->sock = -1;
     }
-    lastClientAddrLen = 0;
-    memset(&lastClientAddr, 0 , sizeof(lastClientAddr));
-    return 0;
+    srv->lastClientAddrLen = 0;
+    memset(&srv->lastClientAddr, 0 , sizeof(srv->lastClientAddr));
+    return rc;
 }
 
-/* --------------------------------------------------------------- */
-/*  ARQ-/GBN-Logik (Empfänger)                                     */
-/* --------------------------------------------------------------- */
-
-/*
- * processRequest:
- *  - nimmt ein Request-Paket entgegen
- *  - führt die ARQ-/GBN-Empfangslogik aus
- *  - erzeugt eine passende Antwort (ACK/Fehler)
- *
- *   ReqHello:
- *     - Sequenznummernzustand initialisieren (z.B. nextExpected = 0)
- *     - Anwendung per appStartFn informieren
- *     - eine passende Antwort (AnswHello/AnswOk) eintragen
- *
- *   ReqData:
- *         * ggf. Nutzdaten an appWriteFn übergeben
- *         * (kumulatives) ACK senden 
- *       
- *   ReqClose:
- *     - appEndFn aufrufen
- *     - Abschluss-ACK senden
- *
- * lossReq:
- *   - simulierte Paketverlustrate für Requests (0.0..1.0)
- *     (z.B. über Zufallszahlvergleich ein Paket "fallen lassen")
- *
- * Rückgabewert:
- *   - Zeiger auf ausgefüllte Antwortstruktur (answPtr)
- *   - NULL, wenn das Request-Paket vollständig verworfen wurde
- */
-static struct answer *processRequest(struct request *reqPtr,
-                                     struct answer *answPtr,
-                                     double lossReq)
+/* FNV-1a über die Adressbytes */
+static unsigned int addr_hash(const struct sockaddr_storage *addr, socklen_t len)
 {
-    (void)reqPtr;
-    (void)answPtr;
-    (void)lossReq;
-    int writeRet;
-    double r;
-    if(reqPtr == NULL || answPtr == NULL) return NULL;
+    const unsigned char *p = (const unsigned char *)addr;
+    unsigned int h = 2166136261u;
+    for (socklen_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
 
-    //Verlustsimulation
+static struct arq_session *session_find(struct arq_server *srv,
+                                        const struct sockaddr_storage *addr,
+                                        socklen_t len)
+{
+    unsigned int h = addr_hash(addr, len);
+    struct arq_session *s;
 
-    r = (double)rand() / (double)RAND_MAX;
-    if(r < lossReq){
-        return NULL; //Paket wird verworfen
+    for (s = srv->sessHash[h & (ARQ_HASH_SIZE - 1)]; s != NULL; s = s->hnext) {
+        if (s->hash == h && s->addrLen == len && memcmp(&s->addr, addr, len) == 0)
+            return s;
     }
+    return NULL;
+}
 
-    //Default-Antwort intitialisieren
-    memset(answPtr,0,sizeof(*answPtr));
+static void session_timeout(struct tw_timer *t, void *arg);
+static void session_ack_timeout(struct tw_timer *t, void *arg);
+static void session_nak_timeout(struct tw_timer *t, void *arg);
 
-    switch (reqPtr->ReqType)
-    {
-    case ReqHello:
-    //Neustart / Initialisierung
-        
-        if (g_appStart)
-            (void)g_appStart();
+static struct arq_session *session_alloc(struct arq_server *srv,
+                                         const struct sockaddr_storage *addr,
+                                         socklen_t len)
+{
+    struct arq_session *s = srv->sessFree;
+    unsigned int h;
 
-        /* Das Hello-Paket selbst ist die Nummer 0. 
-         * Nach erfolgreichem Hello erwarten wir als nächstes Paket 1. */
-        nextExpected = 1;
+    if (s == NULL) return NULL;
+    srv->sessFree = s->hnext;
 
-        answPtr->AnswType = AnswHello;
-        answPtr->SeNo = 1; /* Wir bestätigen 0 und erwarten 1 */
-        break;
+    memset(s, 0, sizeof(*s));
+    s->srv = srv;
+    memcpy(&s->addr, addr, len);
+    s->addrLen = len;
+    twTimerInit(&s->idleTimer, session_timeout, s);
+    twTimerInit(&s->ackTimer, session_ack_timeout, s);
+    twTimerInit(&s->nakTimer, session_nak_timeout, s);
 
-    case ReqData:
-       if (reqPtr->SeNr == nextExpected) {
-            /* In-order: an Anwendung weitergeben */
-            if (g_appWrite) {
-                writeRet = g_appWrite(reqPtr->name, reqPtr->FlNr);
-                if (writeRet < 0) {
-                    /* Anwendungsfehler -> Warnung/Err zurückgeben */
-                    answPtr->AnswType = AnswWarn;
-                    answPtr->SeNo = ERR_FILE_ERROR;
-                    break;
-                }
-            }
-            nextExpected++;
-            answPtr->AnswType = AnswOk;
-            answPtr->SeNo = nextExpected; /* kumulatives ACK = nextExpected */
-        } else {
-            /* Duplikat / out-of-order: ACK für bereits empfangenes (kumulativ) */
-            answPtr->AnswType = AnswOk;
-            answPtr->SeNo = nextExpected;
-        }
-        break;
+    h = addr_hash(addr, len);
+    s->hash  = h;
+    s->hnext = srv->sessHash[h & (ARQ_HASH_SIZE - 1)];
+    srv->sessHash[h & (ARQ_HASH_SIZE - 1)] = s;
+    return s;
+}
 
-    case ReqClose:
-        /* Sitzung beenden */
-        if (g_appEnd)
-            g_appEnd();
-        answPtr->AnswType = AnswOk;
-        answPtr->SeNo = nextExpected;
-        nextExpected = 0;
-        printf("Server: Transfer beendet, Datei geschlossen.\n");
-        break;
-    default:
-    /* unbekannter Request-Typ -> Fehler */
-        answPtr->AnswType = AnswErr;
-        answPtr->ErrNo = 1;
-        break;
+static void xfer_release(struct arq_xfer *x)
+{
+    if (x->refs > 0) x->refs--;
+    if (x->refs == 0 && x->state == XFER_DONE)
+        x->state = XFER_FREE;
+}
+
+static void session_free(struct arq_session *s)
+{
+    struct arq_server *srv = s->srv;
+    struct arq_session **pp = &srv->sessHash[s->hash & (ARQ_HASH_SIZE - 1)];
+
+    while (*pp != NULL && *pp != s) pp = &(*pp)->hnext;
+    if (*pp == s) *pp = s->hnext;
+
+    twCancel(&s->idleTimer);
+    twCancel(&s->ackTimer);
+    twCancel(&s->nakTimer);
+    free(s->mc);
+    s->mc = NULL;
+    if (s->xfer) xfer_release(s->xfer);
+
+    s->state = SESS_FREE;
+    s->xfer  = NULL;
+    s->hnext = srv->sessFree;
+    srv->sessFree = s;
+}
+
+static void sessions_init(struct arq_server *srv)
+{
+    memset(srv->sessions, 0, sizeof(srv->sessions));
+    memset(srv->sessHash, 0, sizeof(srv->sessHash));
+    memset(srv->xferTab, 0, sizeof(srv->xferTab));
+    srv->xfers = srv->xferTab;
+    memset(srv->closed, 0, sizeof(srv->closed));
+    srv->closedNext = 0;
+    srv->sessFree = NULL;
+    for (int i = ARQ_MAX_SESSIONS - 1; i >= 0; i--) {
+        srv->sessions[i].hnext = srv->sessFree;
+        srv->sessFree = &srv->sessions[i];
     }
-    
-    /* TODO:
-     *  - Paketverlust über lossReq simulieren
-     *  - je nach ReqType (ReqHello / ReqData / ReqClose) handeln
-     *  - Antwort (AnswType, SeNo/ErrNo) setzen
-     *  - bei verworfenem Request NULL zurückgeben
-     */
-    return answPtr; 
 }
 
-/* --------------------------------------------------------------- */
-/*  ARQ-Server-Hauptschleife                                       */
-/* --------------------------------------------------------------- */
+static struct arq_xfer *xfer_find(struct arq_server *srv, unsigned long xferId)
+{
+    if (xferId == 0) return NULL; /* klassische Transfers nie teilen */
+    for (int i = 0; i < ARQ_MAX_XFERS; i++) {
+        if (srv->xfers[i].state != XFER_FREE && srv->xfers[i].xferId == xferId)
+            return &srv->xfers[i];
+    }
+    return NULL;
+}
 
-int arqServerLoop(const char *port,
-                  double lossReq,
-                  double lossAck,
-                  appStartFn appStart,
-                  appWriteFn appWrite,
-                  appEndFn appEnd)
+static struct arq_xfer *xfer_alloc(struct arq_server *srv, unsigned long xferId,
+                                   unsigned int stripes)
 {
-    (void)port;
-    (void)lossReq;
-    (void)lossAck;
-    (void)appStart;
-    (void)appWrite;
-    (void)appEnd;
+    for (int i = 0; i < ARQ_MAX_XFERS; i++) {
+        struct arq_xfer *x = &srv->xfers[i];
+        if (x->state != XFER_FREE) continue;
 
-    /* TODO:
-     *  - Callbacks in globalen Variablen speichern oder für Weiterreichen 
-	 *    Parameterliste in processRequest erweitern
-     *  - initServer(port) aufrufen
-     *  - Sequenznummerzustand initialisieren (z.B. nextExpected = 0)
-     *  - Endlosschleife:
-	 *		 * Paketverlust mit lossReq simulieren
-     *       * ggf. getRequest() aufrufen
-     *       * processRequest(..) aufrufen
-     *       * ACK-Verlust mit lossAck simulieren
-     *       * bei "kein ACK-Verlust": sendAnswer(..) aufrufen
-     *  - exitServer() im Fehlerfall oder bei Beenden verwenden
-     */
+        memset(x, 0, sizeof(*x));
+        x->state   = XFER_ACTIVE;
+        x->xferId  = xferId;
+        x->stripes = stripes;
+        x->durable = -1;
+        return x;
+    }
+    return NULL;
+}
 
-    struct request *req;
-    struct answer answ;
-    struct answer *resp;
-    double r;
+static void uring_drain_writes(struct arq_server *srv, struct arq_xfer *x);
+
+/* Transfer beenden; complete: alle Stripes haben geschlossen, die
+ * Daten werden vor dem Abschluss-ACK gesichert (app.sync). */
+static void xfer_finish(struct arq_server *srv, struct arq_xfer *x, int complete,
+                        const char *why)
+{
+    /* Datei erst sichern/schließen, wenn alle Schreibvorgänge durch sind */
+    if (srv->ur) uring_drain_writes(srv, x);
+    if (complete && !x->failed && srv->app.sync) {
+        x->durable = srv->app.sync(srv->app.user);
+        if (x->durable < 0) x->failed = 1;
+    }
+    if (x->failed)
+        fprintf(stderr, "Server: Schreibfehler, Datei unvollständig\n");
+
+    x->state = XFER_DONE;
+    if (srv->app.end)
+        srv->app.end(srv->app.user);
+    if (!srv->quiet)
+        printf("Server: %s\n", why);
+    if (x->refs == 0) x->state = XFER_FREE;
+}
+
+/* Offene Sitzung schließen (Close oder Idle-Abbruch). */
+static void session_close(struct arq_session *s, int aborted)
+{
+    struct arq_server *srv = s->srv;
+    struct arq_xfer *x = s->xfer;
+    unsigned int all = (x->stripes >= 32) ? ~0u : ((1u << x->stripes) - 1u);
+
+    s->state = SESS_CLOSED;
+    twCancel(&s->ackTimer);
+    twCancel(&s->nakTimer);
+    free(s->mc);                 /* Reorder-Puffer wird nicht mehr gebraucht */
+    s->mc = NULL;
+    twAdd(&srv->wheel, &s->idleTimer, ARQ_LINGER_MS);
+    srv->stats.openSessions--;
+
+    if (x->open > 0) x->open--;
+    if (!aborted)
+        x->closedMask |= 1u << s->stripe;
+
+    if (x->state != XFER_ACTIVE) return;
+    if ((x->closedMask & all) == all)
+        xfer_finish(srv, x, 1, "Transfer beendet, Datei geschlossen.");
+    else if (aborted && x->open == 0)
+        xfer_finish(srv, x, 0, "Transfer abgebrochen (Client inaktiv), Datei geschlossen.");
+}
+
+/* --------------------------------------------------------------- */
+/*  Verschlüsselter Betrieb (struct sec_hdr)                       */
+/* --------------------------------------------------------------- */
 
-    /* callbacks speichern (können in processRequest verwendet werden) */
-    g_appStart = appStart;
-    g_appWrite = appWrite;
-    g_appEnd = appEnd;
+static uint64_t cookie_get(const unsigned char b[GBN_COOKIE_LEN]);
+static int hello_cookie_check(struct arq_server *srv, uint64_t cookie,
+                              struct answer *answPtr);
+static void sec_send_cookie(struct arq_server *srv);
 
-   
+/* Umschlag eines Requests von srv->lastClientAddr öffnen und nach
+ * srv->req entschlüsseln (Rest von name[] mit Nullen). SEC_HELLO mit
+ * dem Hello-Schlüssel, SEC_DATA mit dem Schlüssel der Sitzung.
+ * Rückgabewert: 0, <0 = verwerfen. */
+static int sec_unwrap(struct arq_server *srv, const unsigned char *pkt, unsigned long len)
+{
+    struct server_sec *sec = srv->sec;
+    const struct sec_hdr *h = (const struct sec_hdr *)pkt;
+    struct arq_session *s;
+    unsigned long adLen = sizeof(*h);
+    int rc;
 
-    if (initServer(port) < 0) {
+    sec->rxHello = 0;
+    sec->rxCookieOk = 0;
+    if (len < sizeof(*h) || (h->Ctr & AEAD_CTR_S2C)) return -1;
+    if (h->Magic == SEC_HELLO) {
+        adLen += AEAD_PUB_LEN;
+        if (len < adLen) return -1;
+        /* Cookie im Klartext prüfen, bevor Schlüssel und AEAD Arbeit
+         * kosten (nur neue Absender, siehe processHello) */
+        if (session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen) == NULL) {
+            if (!hello_cookie_check(srv, cookie_get(h->Cookie), NULL)) {
+                memcpy(sec->rxPub, pkt + sizeof(*h), AEAD_PUB_LEN);
+                aeadHelloKey(sec->rxK0, sec->psk, sec->rxPub);
+                sec_send_cookie(srv);
+                return -1;
+            }
+            sec->rxCookieOk = 1;
+        }
+        memcpy(sec->rxPub, pkt + sizeof(*h), AEAD_PUB_LEN);
+        aeadHelloKey(sec->rxK0, sec->psk, sec->rxPub);
+        sec->rxAlgs = h->Alg;
+        s = NULL;
+    } else if (h->Magic == SEC_DATA) {
+        s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (s == NULL || !s->sec.keyed) return -1;
+    } else {
         return -1;
     }
+    if (len < adLen + offsetof(struct request, name) + AEAD_TAG_LEN ||
+        len > adLen + sizeof(struct request) + AEAD_TAG_LEN)
+        return -1;
 
-    nextExpected = 0;
+    memset(&srv->req, 0, sizeof(srv->req));
+    if (s == NULL) rc = aeadOpen(sec->rxK0, h->Ctr, pkt, adLen, pkt + adLen, len - adLen, &srv->req);
+    else           rc = aeadOpenKey(&s->sec.rx, h->Ctr, pkt, adLen, pkt + adLen, len - adLen, &srv->req);
+    if (rc < 0) return -1;
+    sec->rxHello = (h->Magic == SEC_HELLO);
+    return 0;
+}
 
-    for (;;) {
-        req = getRequest();
-        if (req == NULL) {
-            /* keine Daten oder Fehler (getRequest loggt Fehler) */
-            continue;
-        }
+/* Nach einem Hello im Umschlag: Sitzungsschlüssel aus eigenem
+ * Schlüsselpaar und dem Pub des Clients ableiten, sofern die Sitzung
+ * noch keine zu diesem Pub hat (wiederholtes Hello behält sie).
+ * AES-256-GCM, wenn der Client es anbietet und die CPU es kann. */
+static void sec_hello_keys(struct arq_server *srv)
+{
+    struct server_sec *sec = srv->sec;
+    struct arq_session *s;
+    uint8_t priv[AEAD_KEY_LEN], shared[AEAD_KEY_LEN], rx[AEAD_KEY_LEN], tx[AEAD_KEY_LEN];
+    int alg;
 
-        /* Request verarbeiten (kann NULL zurückgeben = verworfen) */
-        resp = processRequest(req, &answ, lossReq);
-        if (resp == NULL) {
-            /* Request wurde simuliert verworfen -> weiter warten */
-            continue;
-        }
+    if (!sec->rxHello || srv->req.ReqType != ReqHello) return;
+    s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+    if (s == NULL) return;
+    if (s->sec.keyed && memcmp(s->sec.cpub, sec->rxPub, AEAD_PUB_LEN) == 0) return;
 
-        if (sendAnswer(&answ) < 0) {
-            /* schwerer Fehler beim Senden -> beenden */
-            exitServer();
-            return -1;
+    s->sec.keyed = 0;
+    if (aeadKeypair(priv, s->sec.spub) < 0 || aeadShared(shared, priv, sec->rxPub) < 0) {
+        memset(priv, 0, sizeof(priv));
+        return;   /* Antwort dann mit k0, der Client versucht es erneut */
+    }
+    memcpy(s->sec.cpub, sec->rxPub, AEAD_PUB_LEN);
+    aeadSessionKeys(rx, tx, sec->psk, shared, s->sec.cpub, s->sec.spub);
+    alg = (sec->rxAlgs & aeadAlgs() & (1u << AEAD_AESGCM)) ? AEAD_AESGCM : AEAD_CHACHA;
+    aeadKeySet(&s->sec.rx, alg, rx);
+    aeadKeySet(&s->sec.tx, alg, tx);
+    s->sec.txCtr = 0;
+    s->sec.keyed = 1;
+    memset(priv, 0, sizeof(priv));
+    memset(shared, 0, sizeof(shared));
+    memset(rx, 0, sizeof(rx));
+    memset(tx, 0, sizeof(tx));
+}
+
+/* Antwort (plainLen Bytes, ggf. mit Nutzdaten) in den Umschlag
+ * stecken: mit dem Schlüssel der Sitzung (AnswHello trägt das Pub des
+ * Servers), ohne Sitzung sowie AnswSig und AnswCookie als Antwort auf
+ * das gerade verarbeitete Hello bzw. ReqSig mit dessen k0. Rückgabewert: Länge,
+ * <0 wenn kein Schlüssel vorliegt. */
+static long sec_seal_answer(struct arq_server *srv,
+                            const struct sockaddr_storage *addr, socklen_t addrLen,
+                            const void *plain, unsigned long plainLen, unsigned char *pkt)
+{
+    struct server_sec *sec = srv->sec;
+    const struct answer *answ = plain;
+    struct sec_hdr *h = (struct sec_hdr *)pkt;
+    struct arq_session *s = session_find(srv, addr, addrLen);
+    unsigned long adLen = sizeof(*h);
+
+    memset(h, 0, sizeof(*h));
+    if (s != NULL && s->sec.keyed && answ->AnswType != AnswSig &&
+        answ->AnswType != AnswCookie) {
+        h->Ctr = s->sec.txCtr++ | AEAD_CTR_S2C;
+        if (answ->AnswType == AnswHello) {
+            h->Magic = SEC_HELLO;
+            h->Alg = (unsigned char)s->sec.tx.alg;
+            memcpy(pkt + adLen, s->sec.spub, AEAD_PUB_LEN);
+            adLen += AEAD_PUB_LEN;
+        } else {
+            h->Magic = SEC_DATA;
         }
+        aeadSealKey(&s->sec.tx, h->Ctr, pkt, adLen, plain, plainLen, pkt + adLen);
+    } else if (sec->rxHello && addrLen == srv->lastClientAddrLen &&
+               memcmp(addr, &srv->lastClientAddr, addrLen) == 0) {
+        h->Ctr = sec->ctr++ | AEAD_CTR_S2C;
+        h->Magic = SEC_HELLO;
+        memset(pkt + adLen, 0, AEAD_PUB_LEN);
+        adLen += AEAD_PUB_LEN;
+        aeadSeal(sec->rxK0, h->Ctr, pkt, adLen, plain, plainLen, pkt + adLen);
+    } else {
+        return -1;
     }
+    return (long)(adLen + plainLen + AEAD_TAG_LEN);
+}
 
+/* Abschluss-ACK einer geschlossenen Sitzung: Dauerhaftigkeit des
+ * Transfers melden, sobald der letzte Stripe geschlossen hat. */
+static void close_answer(const struct arq_session *s, struct answer *answ)
+{
+    const struct arq_xfer *x = s->xfer;
 
-    return -1;
+    if (s->state != SESS_CLOSED || x == NULL || x->state != XFER_DONE) return;
+    if (x->failed) {
+        answ->AnswType = AnswErr;
+        answ->ErrNo = ERR_FILE_ERROR;
+        return;
+    }
+    if (x->durable >= 0) {
+        answ->Flags |= ANSW_F_DUR;
+        answ->Durable = (unsigned short)x->durable;
+    }
+}
+
+/* Sauber geschlossene Sitzung samt Abschluss-ACK merken (Ring, der
+ * älteste Eintrag weicht) */
+static void closed_add(const struct arq_session *s)
+{
+    struct arq_server *srv = s->srv;
+    struct arq_closed *c;
+
+    if (s->state != SESS_CLOSED || s->xfer == NULL ||
+        !(s->xfer->closedMask & (1u << s->stripe)))
+        return;   /* Idle-Abbruch */
+
+    c = &srv->closed[srv->closedNext];
+    srv->closedNext = (srv->closedNext + 1) % ARQ_CLOSED_KEEP;
+    memcpy(&c->addr, &s->addr, sizeof(c->addr));
+    c->addrLen  = s->addrLen;
+    c->closedMs = srv->nowMs;
+    memset(&c->answ, 0, sizeof(c->answ));
+    c->answ.AnswType = AnswOk;
+    c->answ.SeNo     = s->nextExpected;
+    close_answer(s, &c->answ);
+}
+
+/* Wiederholtes FIN/Close (SeNr) von srv->lastClientAddr ohne Sitzung:
+ * Abschluss-ACK nach answ, wenn der Transfer bekannt ist.
+ * Rückgabewert: 0, <0 = unbekannt. */
+static int closed_answer(struct arq_server *srv, unsigned long seq, struct answer *answ)
+{
+    for (unsigned int i = 1; i <= ARQ_CLOSED_KEEP; i++) {   /* neueste zuerst */
+        struct arq_closed *c =
+            &srv->closed[(srv->closedNext + ARQ_CLOSED_KEEP - i) % ARQ_CLOSED_KEEP];
+
+        if (c->addrLen != srv->lastClientAddrLen ||
+            srv->nowMs - c->closedMs > ARQ_CLOSED_MS ||
+            memcmp(&c->addr, &srv->lastClientAddr, c->addrLen) != 0)
+            continue;
+        if (seq >= c->answ.SeNo) return -1;   /* neuere Daten: nicht dieser Transfer */
+        *answ = c->answ;
+        srv->stats.dups++;
+        return 0;
+    }
+    return -1;
+}
+
+/* Empfangsfenster ankündigen (Flusskontrolle, siehe struct answer):
+ * freie Plätze im Socket-Empfangspuffer in Paketen, fair auf die
+ * offenen Sitzungen verteilt. Ein voller Puffer (langsame Platte,
+ * ausgelasteter Server) ergibt Fenster 0 statt Paketverlust. */
+static void advertise_window(struct arq_server *srv, struct answer *answ)
+{
+    uint32_t *mem = srv->mem;
+    socklen_t len = sizeof(srv->mem);
+    unsigned long freeBytes, slots, open;
+
+    if (!srv->memValid) {
+        if (getsockopt(srv->sock, SOL_SOCKET, SO_MEMINFO, mem, &len) < 0)
+            return; /* ohne Angabe begrenzt der Client nicht */
+        srv->memValid = 1;
+    }
+
+    freeBytes = 0;
+    if (mem[SK_MEMINFO_RCVBUF] > mem[SK_MEMINFO_RMEM_ALLOC])
+        freeBytes = mem[SK_MEMINFO_RCVBUF] - mem[SK_MEMINFO_RMEM_ALLOC];
+    slots = freeBytes / ARQ_RX_TRUESIZE;
+
+    open = srv->stats.openSessions ? srv->stats.openSessions : 1;
+    answ->Flags |= ANSW_F_WND;
+    answ->FlNr = slots / open;
+    if (answ->FlNr == 0 && slots > 0) answ->FlNr = 1;
+    if (answ->FlNr == 0) srv->stats.zeroWnd++;
+}
+
+/* Servicezeit (Kernel-Empfang des Requests bis jetzt) eintragen,
+ * damit der Client sie von seiner RTT abziehen kann. */
+static void stamp_service(struct answer *answ, unsigned long long rxNs)
+{
+    struct timespec ts;
+    unsigned long long now, us;
+
+    if (rxNs == 0) return;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+    us = (now > rxNs) ? (now - rxNs) / 1000ULL : 0;
+    answ->SvcUs = (us > 0xffffffffULL) ? 0xffffffffu : (unsigned int)us;
+    answ->Flags |= ANSW_F_SVC;
+}
+
+/* Kumulatives ACK der Sitzung sofort senden */
+static void session_send_ack(struct arq_session *s)
+{
+    struct arq_server *srv = s->srv;
+    struct answer answ;
+
+    memset(&answ, 0, sizeof(answ));
+    answ.AnswType = AnswOk;
+    answ.SeNo = s->nextExpected;
+    advertise_window(srv, &answ);
+    stamp_service(&answ, s->lastRxNs);
+    s->unacked = 0;
+    twCancel(&s->ackTimer);
+    srv->stats.acks++;
+    (void)send_answer_to(srv, &s->addr, s->addrLen, &answ);
+}
+
+static void session_ack_timeout(struct tw_timer *t, void *arg)
+{
+    struct arq_session *s = arg;
+    (void)t;
+
+    if (s->state == SESS_OPEN && s->unacked > 0) {
+        s->srv->stats.delayedAcks++;
+        session_send_ack(s);
+    }
+}
+
+/* Idle-Timer (offen) bzw. Linger-Timer (geschlossen).
+ * Aktivität verschiebt den Timer nicht, sondern wird hier nachgeprüft. */
+static void session_timeout(struct tw_timer *t, void *arg)
+{
+    struct arq_session *s = arg;
+    struct arq_server *srv = s->srv;
+
+    if (s->state == SESS_OPEN) {
+        unsigned long long idle = srv->nowMs - s->lastActiveMs;
+        if (idle < srv->idleMs) {
+            twAdd(&srv->wheel, t, (unsigned long)(srv->idleMs - idle));
+            return;
+        }
+        srv->stats.reaped++;
+        session_close(s, 1);
+        return;
+    }
+    closed_add(s);
+    session_free(s);
+}
+
+static void stats_flush(struct tw_timer *t, void *arg)
+{
+    struct arq_server *srv = arg;
+    char label[16] = "";
+
+    if (srv->shared) snprintf(label, sizeof(label), "[%u]", srv->shardNo);
+    if (!srv->quiet && memcmp(&srv->stats, &srv->statsFlushed, sizeof(srv->stats)) != 0) {
+        printf("Server%s: stats: %lu offen, %lu Pakete, %lu Bytes (%lu in Löchern), %lu Duplikate, "
+               "%lu ACKs (%lu verzögert, %lu Fenster 0, %lu NAKs), %lu Cookies, %lu abgebrochen, "
+               "%lu im Kernel verworfen, %lu Nachrichten übersprungen\n",
+               label, srv->stats.openSessions, srv->stats.pkts, srv->stats.bytes, srv->stats.holes,
+               srv->stats.dups,
+               srv->stats.acks, srv->stats.delayedAcks, srv->stats.zeroWnd, srv->stats.naks,
+               srv->stats.cookies, srv->stats.reaped, srv->stats.kernelDrops,
+               srv->stats.skipped);
+        fflush(stdout);
+        srv->statsFlushed = srv->stats;
+    }
+    twAdd(&srv->wheel, t, ARQ_STATS_MS);
+}
+
+/* Transfers und Anwendung gegen die anderen Empfangs-Threads sperren */
+static void shared_lock(struct arq_server *srv)
+{
+    if (srv->shared) pthread_mutex_lock(&srv->shared->lock);
+}
+
+static void shared_unlock(struct arq_server *srv)
+{
+    if (srv->shared) pthread_mutex_unlock(&srv->shared->lock);
+}
+
+/* --------------------------------------------------------------- */
+/*  ARQ-/GBN-Logik (Empfänger)                                     */
+/* --------------------------------------------------------------- */
+
+/* In-order Nutzdaten an die Anwendung (Stripes per Offset).
+ * Rückgabewert: 0 bei Erfolg, <0 bei Fehler der Anwendung. */
+static int uring_write(struct arq_server *srv, struct arq_session *s, int fd,
+                       const char *buf, unsigned long len);
+
+static int session_write(struct arq_session *s, const char *buf, unsigned long len)
+{
+    struct arq_server *srv = s->srv;
+    int writeRet, fd;
+
+    if (s->xfer->failed) return -1;
+
+    if (srv->ur && srv->app.writeFd && (fd = srv->app.writeFd(srv->app.user)) >= 0)
+        writeRet = uring_write(srv, s, fd, buf, len);
+    else if (s->striped)
+        writeRet = srv->app.writeAt(srv->app.user, buf, len, s->offset);
+    else if (srv->app.write)
+        writeRet = srv->app.write(srv->app.user, buf, len);
+    else
+        writeRet = 0;
+    if (writeRet < 0) return writeRet;
+
+    s->offset += len;
+    srv->stats.bytes += len;
+    return 0;
+}
+
+/* REQ_F_RECS: die Records einzeln an die Anwendung. Das Paket wird
+ * vorher vollständig geprüft; nach einem Fehler der Anwendung setzt
+ * die Wiederholung hinter dem letzten geschriebenen Record fort.
+ * Rückgabewert: 0, -1 Fehler der Anwendung, -2 ungültiges Paket. */
+static int session_records(struct arq_session *s, const char *buf, unsigned long len)
+{
+    unsigned long pos = 0;
+    unsigned short rl;
+
+    while (pos < len) {
+        if (len - pos < GBN_REC_HDR) return -2;
+        memcpy(&rl, buf + pos, GBN_REC_HDR);
+        if (rl > len - pos - GBN_REC_HDR) return -2;
+        pos += GBN_REC_HDR + rl;
+    }
+    for (pos = 0; pos < len; pos += GBN_REC_HDR + rl) {
+        memcpy(&rl, buf + pos, GBN_REC_HDR);
+        if (pos < s->recDone) continue;
+        if (session_write(s, buf + pos + GBN_REC_HDR, rl) < 0) return -1;
+        s->recDone = pos + GBN_REC_HDR + rl;
+    }
+    s->recDone = 0;
+    return 0;
+}
+
+/* REQ_F_HOLE: len Nullbytes ab s->offset. Als Loch per app.hole, sonst
+ * (oder wenn die Ausgabe keine Löcher kann) als Nullen schreiben. */
+static int session_hole(struct arq_session *s, unsigned long len)
+{
+    static const char zeros[BufferSize];
+    struct arq_server *srv = s->srv;
+    int rc = 1;
+
+    if (s->xfer->failed) return -1;
+    if (srv->app.hole) rc = srv->app.hole(srv->app.user, s->offset, len);
+    if (rc < 0) return rc;
+    if (rc == 0) {
+        s->offset += len;
+        srv->stats.holes += len;
+        return 0;
+    }
+    while (len > 0) {
+        unsigned long n = (len < BufferSize) ? len : BufferSize;
+        if (session_write(s, zeros, n) < 0) return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+/* --- Cookie im Verbindungsaufbau (AnswCookie, siehe GBN_COOKIE_MS) --- */
+
+/* MAC über Zeitabschnitt und Absenderadresse ohne Port: alle Sockets
+ * eines Clients teilen das Cookie, er kann es je Server behalten.
+ * GBN_COOKIE_LEN Bytes, 0 bleibt "kein Cookie". */
+static uint64_t hello_cookie(const struct arq_server *srv, uint64_t epoch)
+{
+    unsigned char in[sizeof(uint64_t) + sizeof(struct sockaddr_storage)];
+    struct sockaddr_storage addr = srv->lastClientAddr;
+    uint8_t mac[32];
+    uint64_t cookie;
+
+    if (addr.ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)&addr)->sin6_port = 0;
+        ((struct sockaddr_in6 *)&addr)->sin6_flowinfo = 0;
+    } else if (addr.ss_family == AF_INET) {
+        ((struct sockaddr_in *)&addr)->sin_port = 0;
+    }
+    memcpy(in, &epoch, sizeof(epoch));
+    memcpy(in + sizeof(epoch), &addr, srv->lastClientAddrLen);
+    aeadHash(mac, srv->cookieKey, sizeof(srv->cookieKey),
+             in, sizeof(epoch) + srv->lastClientAddrLen);
+    memcpy(&cookie, mac, sizeof(cookie));
+    cookie &= (1ULL << (8 * GBN_COOKIE_LEN)) - 1;
+    return cookie ? cookie : 1;
+}
+
+/* Cookie aus request.Cookie bzw. sec_hdr.Cookie */
+static uint64_t cookie_get(const unsigned char b[GBN_COOKIE_LEN])
+{
+    uint64_t cookie = 0;
+
+    for (int i = 0; i < GBN_COOKIE_LEN; i++)
+        cookie |= (uint64_t)b[i] << (8 * i);
+    return cookie;
+}
+
+/* Verlangt der Server für ein neues Hello ein Cookie? Nur unter Last:
+ * mehr als ARQ_COOKIE_HELLOS neue Hellos in der laufenden Sekunde oder
+ * die Sitzungstabelle halb voll. Sonst kostet das Cookie jeden Transfer
+ * einen Round Trip. */
+static int cookie_due(struct arq_server *srv)
+{
+    if (!srv->cookies) return 0;
+    if (srv->nowMs - srv->helloMs >= 1000) {
+        srv->helloMs = srv->nowMs;
+        srv->hellos  = 0;
+    }
+    srv->hellos++;
+    return srv->hellos > ARQ_COOKIE_HELLOS ||
+           srv->stats.openSessions >= ARQ_MAX_SESSIONS / 2;
+}
+
+/* Cookie prüfen (laufender oder voriger Zeitabschnitt). Ohne gültiges
+ * Cookie: AnswCookie nach answPtr (falls != NULL), Rückgabewert 0. */
+static int cookie_verify(struct arq_server *srv, uint64_t cookie, struct answer *answPtr)
+{
+    uint64_t epoch, good;
+
+    epoch = srv->nowMs / GBN_COOKIE_MS;
+    good  = hello_cookie(srv, epoch);
+    if (cookie != 0 &&
+        (cookie == good || (epoch > 0 && cookie == hello_cookie(srv, epoch - 1))))
+        return 1;
+    if (answPtr) {
+        answPtr->AnswType = AnswCookie;
+        answPtr->SeNo = good;
+    }
+    srv->stats.cookies++;
+    return 0;
+}
+
+/* Cookie eines neuen Hellos prüfen, sofern eines verlangt wird */
+static int hello_cookie_check(struct arq_server *srv, uint64_t cookie,
+                              struct answer *answPtr)
+{
+    return !cookie_due(srv) || cookie_verify(srv, cookie, answPtr);
+}
+
+/* AnswCookie auf ein verschlüsseltes Hello ohne gültiges Cookie
+ * (sec_unwrap): mit dessen k0 versiegelt (ein Hash, keine
+ * Entschlüsselung, kein Zustand), damit nur der Absender des Pubs
+ * das Cookie annimmt */
+static void sec_send_cookie(struct arq_server *srv)
+{
+    struct answer answ;
+
+    memset(&answ, 0, sizeof(answ));
+    answ.AnswType = AnswCookie;
+    answ.SeNo = hello_cookie(srv, srv->nowMs / GBN_COOKIE_MS);
+    srv->sec->rxHello = 1;
+    (void)send_answer_to(srv, &srv->lastClientAddr, srv->lastClientAddrLen, &answ);
+    srv->sec->rxHello = 0;
+}
+
+/* Hello: Sitzung anlegen bzw. Duplikat erkennen, Transfer zuordnen. */
+static void processHello(struct arq_server *srv, struct request *reqPtr,
+                         struct answer *answPtr)
+{
+    struct hello_info info;
+    struct arq_session *s;
+    struct arq_xfer *x;
+
+    memset(&info, 0, sizeof(info));
+    info.Stripes = 1;
+    if (reqPtr->FlNr >= sizeof(info))
+        memcpy(&info, reqPtr->name, sizeof(info));
+
+    if (((reqPtr->Flags & REQ_F_DATA) &&
+         (reqPtr->FlNr < sizeof(info) || reqPtr->FlNr > BufferSize || info.XferId == 0)) ||
+        ((reqPtr->Flags & REQ_F_FIN) && !(reqPtr->Flags & REQ_F_DATA)) ||
+        info.Stripes < 1 || info.Stripes > GBN_MAX_STRIPES ||
+        info.Stripe >= info.Stripes ||
+        (info.Stripes > 1 && srv->app.writeAt == NULL) ||
+        ((reqPtr->Flags & REQ_F_MCAST) &&
+         (info.XferId == 0 || info.Stripes != 1 || (reqPtr->Flags & REQ_F_DATA)))) {
+        answPtr->AnswType = AnswErr;
+        answPtr->ErrNo = ERR_ILLEGAL_REQUEST;
+        return;
+    }
+
+    s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+
+    /* Wiederholtes Hello (ACK verloren): nur erneut bestätigen. Mit
+     * XferId auch nach einem 0-RTT-Hello mit FIN (Sitzung geschlossen),
+     * damit mitgesendete Daten nicht doppelt geschrieben werden. */
+    if (s && s->xfer &&
+        ((s->state == SESS_OPEN && s->nextExpected == 1 && s->xfer->xferId == info.XferId) ||
+         (info.XferId != 0 && s->xfer->xferId == info.XferId))) {
+        answPtr->AnswType = AnswHello;
+        answPtr->SeNo = 1;
+        close_answer(s, answPtr);   /* wiederholtes Hello mit FIN */
+        return;
+    }
+
+    /* Neuer Transfer: unter Last erst mit Cookie Zustand anlegen (im
+     * verschlüsselten Betrieb schon in sec_unwrap geprüft) */
+    if (!(reqPtr->Flags & REQ_F_MCAST) && !(srv->sec && srv->sec->rxCookieOk) &&
+        !hello_cookie_check(srv, cookie_get(reqPtr->Cookie), answPtr))
+        return;
+
+    /* Gleicher Absender beginnt neu: alte Sitzung aufgeben */
+    if (s) {
+        if (s->state == SESS_OPEN)
+            session_close(s, 1);
+        session_free(s);
+    }
+
+    s = session_alloc(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+    if (s == NULL) {
+        fprintf(stderr, "Server: zu viele Sitzungen, Hello abgelehnt\n");
+        answPtr->AnswType = AnswErr;
+        answPtr->ErrNo = ERR_INTERNAL;
+        return;
+    }
+
+    x = xfer_find(srv, info.XferId);
+    if (x == NULL) {
+        x = xfer_alloc(srv, info.XferId, info.Stripes);
+        if (x == NULL) {
+            session_free(s);
+            answPtr->AnswType = AnswErr;
+            answPtr->ErrNo = ERR_INTERNAL;
+            return;
+        }
+        if (srv->app.start)
+            (void)srv->app.start(srv->app.user);
+    }
+    if (x->state != XFER_ACTIVE) {
+        /* Verspätetes Hello eines bereits abgeschlossenen Transfers */
+        session_free(s);
+        answPtr->AnswType = AnswErr;
+        answPtr->ErrNo = ERR_ILLEGAL_REQUEST;
+        return;
+    }
+    x->refs++;
+    x->open++;
+    srv->stats.openSessions++;
+
+    s->state   = SESS_OPEN;
+    s->xfer    = x;
+    s->stripe  = info.Stripe;
+    s->striped = (info.Stripes > 1);
+    s->offset  = info.Offset;
+    s->lastActiveMs = srv->nowMs;
+    twAdd(&srv->wheel, &s->idleTimer, srv->idleMs);
+
+    if ((reqPtr->Flags & REQ_F_MCAST) && (s->mc = calloc(1, sizeof(*s->mc))) == NULL) {
+        session_close(s, 1);
+        session_free(s);
+        answPtr->AnswType = AnswErr;
+        answPtr->ErrNo = ERR_INTERNAL;
+        return;
+    }
+
+    /* Das Hello-Paket selbst ist die Nummer 0.
+     * Nach erfolgreichem Hello erwarten wir als nächstes Paket 1. */
+    s->nextExpected = 1;
+
+    /* 0-RTT: erste Nutzdaten und ggf. FIN im Hello */
+    if (reqPtr->Flags & REQ_F_DATA) {
+        unsigned long len = reqPtr->FlNr - sizeof(info);
+        if (len > 0 && session_write(s, reqPtr->name + sizeof(info), len) < 0) {
+            /* Sitzung verwerfen, das wiederholte Hello beginnt neu */
+            session_close(s, 1);
+            session_free(s);
+            answPtr->AnswType = AnswWarn;
+            answPtr->ErrNo = ERR_FILE_ERROR;
+            return;
+        }
+        if (reqPtr->Flags & REQ_F_FIN)
+            session_close(s, 0);
+    }
+
+    answPtr->AnswType = AnswHello;
+    answPtr->SeNo = 1; /* Wir bestätigen 0 und erwarten 1 */
+    close_answer(s, answPtr);
+}
+
+/* --- Lücken melden (AnswNak, siehe data.h) --- */
+
+/* Neue Lücke sofort melden, dieselbe höchstens alle GBN_NAK_MS
+ * (Multicast: GBN_MC_NAK_MS) */
+static int nak_due(const struct arq_session *s)
+{
+    unsigned long ms = s->mc ? GBN_MC_NAK_MS : GBN_NAK_MS;
+
+    return s->nextExpected != s->nakSeq || s->srv->nowMs - s->nakMs >= ms;
+}
+
+/* AnswNak für die Pakete nextExpected .. end-1 eintragen und den
+ * NAK-Timer stellen */
+static void session_nak(struct arq_session *s, unsigned long end, struct answer *answ)
+{
+    struct arq_server *srv = s->srv;
+
+    if (s->nakSeq != s->nextExpected) s->nakTries = 0;
+    memset(answ, 0, sizeof(*answ));
+    answ->AnswType = AnswNak;
+    answ->SeNo = s->nextExpected;
+    answ->FlNr = end - s->nextExpected;
+    s->nakSeq = s->nextExpected;
+    s->nakEnd = end;
+    s->nakMs  = srv->nowMs;
+    srv->stats.naks++;
+    if (!twPending(&s->nakTimer))
+        twAdd(&srv->wheel, &s->nakTimer, s->mc ? GBN_MC_NAK_MS : GBN_NAK_MS);
+}
+
+static void mc_nak(struct arq_session *s, unsigned long limit, struct answer *answ);
+
+/* NAK wiederholen, solange die Lücke besteht: im Multicast-Betrieb bis
+ * die gepufferten Pakete ausgeliefert sind, sonst höchstens
+ * GBN_NAK_RETRIES mal (danach hilft der Retransmit-Timeout des Clients) */
+static void session_nak_timeout(struct tw_timer *t, void *arg)
+{
+    struct arq_session *s = arg;
+    struct arq_server *srv = s->srv;
+    struct answer answ;
+    (void)t;
+
+    if (s->state != SESS_OPEN) return;
+    if (s->mc != NULL) {
+        if (s->mc->buffered == 0) return;
+        if (!nak_due(s)) {
+            twAdd(&srv->wheel, &s->nakTimer, GBN_MC_NAK_MS);
+            return;
+        }
+        mc_nak(s, ~0UL, &answ);
+        (void)send_answer_data(srv, &s->addr, s->addrLen, &answ,
+                               (const char *)&srv->mcId, sizeof(srv->mcId));
+        return;
+    }
+    if (s->nextExpected != s->nakSeq || s->nakTries >= GBN_NAK_RETRIES) return;
+    if (!nak_due(s)) {
+        twAdd(&srv->wheel, &s->nakTimer, GBN_NAK_MS);
+        return;
+    }
+    s->nakTries++;
+    session_nak(s, s->nakEnd, &answ);
+    (void)send_answer_to(srv, &s->addr, s->addrLen, &answ);
+}
+
+/* --- Multicast-Empfang (REQ_F_MCAST, siehe data.h) --- */
+
+/* AnswNak für die Lücke ab nextExpected bis zum ersten gepufferten
+ * Paket (höchstens bis limit) eintragen. Solange Pakete gepuffert
+ * sind, wiederholt der NAK-Timer die Meldung. */
+static void mc_nak(struct arq_session *s, unsigned long limit, struct answer *answ)
+{
+    struct session_mc *m = s->mc;
+    unsigned long end = s->nextExpected + 1;
+
+    if (limit > s->nextExpected + GBN_MC_WINDOW) limit = s->nextExpected + GBN_MC_WINDOW;
+    while (end < limit && m->slot[end % GBN_MC_WINDOW].seq != end) end++;
+    session_nak(s, end, answ);
+}
+
+/* In-order Paket schreiben, danach gepufferte Nachfolger.
+ * Rückgabewert: Anzahl geschriebener Pakete, <0 bei Schreibfehler. */
+static int mc_deliver(struct arq_session *s, const char *buf, unsigned long len)
+{
+    struct session_mc *m = s->mc;
+    int n = 0;
+
+    for (;;) {
+        if (session_write(s, buf, len) < 0) return -1;
+        s->nextExpected++;
+        n++;
+        if (m->slot[s->nextExpected % GBN_MC_WINDOW].seq != s->nextExpected) return n;
+        m->slot[s->nextExpected % GBN_MC_WINDOW].seq = 0;
+        m->buffered--;
+        buf = m->slot[s->nextExpected % GBN_MC_WINDOW].data;
+        len = m->slot[s->nextExpected % GBN_MC_WINDOW].len;
+    }
+}
+
+/* Multicast-Request bearbeiten. Duplikate und Pakete unbekannter
+ * Transfers bleiben unbeantwortet: die Last beim Sender soll nicht mit
+ * der Anzahl der Empfänger wachsen. Antworten tragen srv->mcId.
+ * Rückgabewert wie processRequest (ohne Empfangsfenster). */
+static struct answer *processMcast(struct arq_server *srv, struct request *reqPtr,
+                                   struct answer *answPtr)
+{
+    struct arq_session *s;
+    struct session_mc *m;
+    unsigned long seq = reqPtr->SeNr;
+    int n;
+
+    if (reqPtr->ReqType == ReqHello) {
+        processHello(srv, reqPtr, answPtr);
+        goto reply;
+    }
+
+    s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+    if (s == NULL || s->xfer == NULL) return NULL;
+    if (s->state == SESS_CLOSED) {
+        /* fertig: nur Probe und Close bestätigen, der Sender wartet darauf */
+        if (reqPtr->ReqType != ReqProbe && reqPtr->ReqType != ReqClose) return NULL;
+        answPtr->AnswType = AnswOk;
+        answPtr->SeNo = s->nextExpected;
+        close_answer(s, answPtr);
+        goto reply;
+    }
+    if (s->state != SESS_OPEN || (m = s->mc) == NULL) return NULL;
+    s->lastActiveMs = srv->nowMs;
+
+    switch (reqPtr->ReqType) {
+    case ReqData:
+        if (reqPtr->FlNr > BufferSize) reqPtr->FlNr = BufferSize;
+        if (seq < s->nextExpected) {
+            srv->stats.dups++;
+            return NULL;
+        }
+        if (seq > s->nextExpected) {
+            /* hinter einer Lücke: puffern (sonst fehlt es später mit) */
+            if (seq < s->nextExpected + GBN_MC_WINDOW) {
+                unsigned int i = (unsigned int)(seq % GBN_MC_WINDOW);
+                if (m->slot[i].seq == seq) {
+                    srv->stats.dups++;
+                    return NULL;
+                }
+                m->slot[i].seq = seq;
+                m->slot[i].len = reqPtr->FlNr;
+                memcpy(m->slot[i].data, reqPtr->name, reqPtr->FlNr);
+                m->buffered++;
+            }
+            if (!nak_due(s)) return NULL;
+            mc_nak(s, seq + 1, answPtr);
+            goto reply;
+        }
+        n = mc_deliver(s, reqPtr->name, reqPtr->FlNr);
+        if (n < 0) {
+            session_close(s, 1);
+            answPtr->AnswType = AnswErr;
+            answPtr->ErrNo = ERR_FILE_ERROR;
+            goto reply;
+        }
+        s->unacked += (unsigned int)n;
+        if (s->unacked < GBN_MC_ACK_EVERY) {
+            /* nächste Lücke gleich melden */
+            if (m->buffered == 0 || !nak_due(s)) return NULL;
+            mc_nak(s, ~0UL, answPtr);
+            goto reply;
+        }
+        s->unacked = 0;
+        answPtr->AnswType = AnswOk;
+        answPtr->SeNo = s->nextExpected;
+        goto reply;
+
+    case ReqProbe:
+    case ReqClose:
+        /* SeNr = nächstes Paket des Senders: alles davor muss da sein */
+        if (seq > s->nextExpected) {
+            mc_nak(s, seq, answPtr);
+            goto reply;
+        }
+        if (reqPtr->ReqType == ReqClose && seq == s->nextExpected) {
+            s->nextExpected++;
+            session_close(s, 0);
+        }
+        s->unacked = 0;
+        answPtr->AnswType = AnswOk;
+        answPtr->SeNo = s->nextExpected;
+        close_answer(s, answPtr);
+        goto reply;
+
+    default:
+        return NULL;
+    }
+
+reply:
+    memcpy(srv->ansData, &srv->mcId, sizeof(srv->mcId));
+    srv->ansDataLen = sizeof(srv->mcId);
+    srv->stats.acks++;
+    return answPtr;
+}
+
+/*
+ * processRequest:
+ *  - nimmt ein Request-Paket entgegen
+ *  - führt die ARQ-/GBN-Empfangslogik aus
+ *  - erzeugt eine passende Antwort (ACK/Fehler)
+ *
+ *   ReqHello:
+ *     - Sitzung des Absenders anlegen (nextExpected = 1)
+ *     - Anwendung per appStartFn informieren (einmal je Transfer)
+ *     - eine passende Antwort (AnswHello/AnswOk) eintragen
+ *     - mit REQ_F_DATA: erste Nutzdaten schreiben, bei REQ_F_FIN
+ *       Sitzung sofort wieder schließen (0-RTT)
+ *
+ *   ReqData:
+ *         * ggf. Nutzdaten an appWriteFn bzw. appWriteAtFn übergeben,
+ *           REQ_F_HOLE per appHoleFn als Loch anlegen, REQ_F_RECS
+ *           Record für Record (ein Aufruf je Record), REQ_F_SKIP
+ *           nur zählen (Nachricht vom Sender aufgegeben)
+ *         * REQ_F_FIN: danach wie ReqClose abschließen
+ *         * (kumulatives) ACK senden, bei delAckMs > 0 für in-order
+ *           Pakete nur jedes zweite sofort, sonst per Timer
+ *         * SeNr > nextExpected: AnswNak für die Lücke (je Lücke
+ *           höchstens alle GBN_NAK_MS, Wiederholung per NAK-Timer)
+ *
+ *   ReqClose:
+ *     - nur in Reihenfolge (SeNr == nextExpected) annehmen, sonst wie
+ *       ReqData (AnswNak bzw. kumulatives ACK)
+ *     - appSyncFn und appEndFn aufrufen (nach dem letzten Stripe)
+ *     - Abschluss-ACK (SeNr + 1) mit Dauerhaftigkeit senden
+ *
+ *   ReqProbe:
+ *     - Zero-Window-Probe: kumulatives ACK mit aktuellem Fenster
+ *
+ *   ReqSig:
+ *     - ohne Sitzung: Abschnitt ab SeNr per app.sig holen und als
+ *       AnswSig mit Nutzdaten (srv->ansData) beantworten, ohne Fenster
+ *     - mit Nutzdaten (FlNr > 0): Anfrage an app.query, das Ergebnis
+ *       geht ebenso als AnswSig (SeNo = SeNr, Nummer der Anfrage)
+ *
+ *   REQ_F_MCAST (alle Typen): processMcast(), NAKs statt ACK je Paket
+ *
+ * Jede Antwort trägt das Empfangsfenster (ANSW_F_WND, FlNr).
+ *
+ * lossReq:
+ *   - simulierte Paketverlustrate für Requests (0.0..1.0)
+ *     (z.B. über Zufallszahlvergleich ein Paket "fallen lassen")
+ *
+ * Rückgabewert:
+ *   - Zeiger auf ausgefüllte Antwortstruktur (answPtr)
+ *   - NULL, wenn das Request-Paket vollständig verworfen wurde
+ *     oder das ACK verzögert wird
+ */
+static struct answer *processRequest(struct arq_server *srv,
+                                     struct request *reqPtr,
+                                     struct answer *answPtr,
+                                     double lossReq)
+{
+    double r;
+    struct arq_session *s;
+    if(reqPtr == NULL || answPtr == NULL) return NULL;
+
+    //Verlustsimulation
+
+    r = (double)rand_r(&srv->randState) / (double)RAND_MAX;
+    if(r < lossReq){
+        return NULL; //Paket wird verworfen
+    }
+
+    //Default-Antwort intitialisieren
+    memset(answPtr,0,sizeof(*answPtr));
+    srv->ansDataLen = 0;
+    srv->stats.pkts++;
+
+    if (reqPtr->Flags & REQ_F_MCAST)
+        return processMcast(srv, reqPtr, answPtr);
+
+    switch (reqPtr->ReqType)
+    {
+    case ReqHello:
+        processHello(srv, reqPtr, answPtr);
+        break;
+
+    case ReqData:
+        s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (s == NULL && (reqPtr->Flags & REQ_F_FIN)) {
+            /* Sitzung bereits aufgeräumt: nur ein bekannter Abschluss
+             * wird bestätigt, sonst fehlen Daten (ERR_WRONG_SEQ unten) */
+            if (closed_answer(srv, reqPtr->SeNr, answPtr) == 0) break;
+        }
+        if (s != NULL && s->state == SESS_CLOSED && reqPtr->SeNr < s->nextExpected) {
+            /* Wiederholung nach FIN/Close (ACK verloren): kumulativ bestätigen */
+            srv->stats.dups++;
+            answPtr->AnswType = AnswOk;
+            answPtr->SeNo = s->nextExpected;
+            close_answer(s, answPtr);
+            break;
+        }
+        if (s == NULL || s->state != SESS_OPEN) {
+            /* Daten ohne Hello (z.B. nach Server-Neustart) */
+            answPtr->AnswType = AnswErr;
+            answPtr->ErrNo = ERR_WRONG_SEQ;
+            break;
+        }
+        s->lastActiveMs = srv->nowMs;
+        if (reqPtr->FlNr > BufferSize) reqPtr->FlNr = BufferSize;
+
+        if (reqPtr->SeNr == s->nextExpected) {
+            /* In-order: an Anwendung weitergeben (Loch: Länge in name[]) */
+            unsigned long hole = 0;
+            int wr;
+            if (reqPtr->Flags & REQ_F_HOLE) {
+                if (reqPtr->FlNr < sizeof(hole)) {
+                    answPtr->AnswType = AnswErr;
+                    answPtr->ErrNo = ERR_ILLEGAL_REQUEST;
+                    break;
+                }
+                memcpy(&hole, reqPtr->name, sizeof(hole));
+            }
+            if (reqPtr->Flags & REQ_F_SKIP) {
+                srv->stats.skipped++;
+                s->recDone = 0;   /* Rest eines Sammelpakets entfällt */
+                wr = 0;
+            } else if (reqPtr->Flags & REQ_F_HOLE)
+                wr = session_hole(s, hole);
+            else if (reqPtr->Flags & REQ_F_RECS)
+                wr = session_records(s, reqPtr->name, reqPtr->FlNr);
+            else
+                wr = session_write(s, reqPtr->name, reqPtr->FlNr);
+            if (wr == -2) {
+                answPtr->AnswType = AnswErr;
+                answPtr->ErrNo = ERR_ILLEGAL_REQUEST;
+                break;
+            }
+            if (wr < 0) {
+                /* Anwendungsfehler -> Warnung/Err zurückgeben; ein
+                 * asynchroner Schreibfehler (io_uring) ist endgültig */
+                answPtr->AnswType = s->xfer->failed ? AnswErr : AnswWarn;
+                answPtr->ErrNo = ERR_FILE_ERROR;
+                break;
+            }
+            s->nextExpected++;
+
+            /* FIN: letzte Daten, Sitzung schließen und sofort bestätigen */
+            if (reqPtr->Flags & REQ_F_FIN) {
+                session_close(s, 0);
+                answPtr->AnswType = AnswOk;
+                answPtr->SeNo = s->nextExpected;
+                close_answer(s, answPtr);
+                break;
+            }
+
+            /* Delayed ACK: jedes zweite Paket sofort, sonst per Timer */
+            if (srv->delAckMs > 0 && ++s->unacked < 2) {
+                s->lastRxNs = srv->rxNs;
+                if (!twPending(&s->ackTimer))
+                    twAdd(&srv->wheel, &s->ackTimer, srv->delAckMs);
+                return NULL;
+            }
+            s->unacked = 0;
+            twCancel(&s->ackTimer);
+            answPtr->AnswType = AnswOk;
+            answPtr->SeNo = s->nextExpected; /* kumulatives ACK = nextExpected */
+        } else {
+            /* Duplikat / out-of-order: ACK für bereits empfangenes (kumulativ) */
+            srv->stats.dups++;
+            s->unacked = 0;
+            twCancel(&s->ackTimer);
+            if (reqPtr->SeNr > s->nextExpected && nak_due(s)) {
+                /* Lücke: sofort melden, nicht erst den RTO des Clients abwarten */
+                session_nak(s, reqPtr->SeNr, answPtr);
+                srv->stats.acks++;
+                return answPtr;   /* FlNr ist kein Fenster */
+            }
+            answPtr->AnswType = AnswOk;
+            answPtr->SeNo = s->nextExpected;
+        }
+        break;
+
+    case ReqProbe:
+        s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (s == NULL || s->state != SESS_OPEN) {
+            answPtr->AnswType = AnswErr;
+            answPtr->ErrNo = ERR_WRONG_SEQ;
+            break;
+        }
+        s->lastActiveMs = srv->nowMs;
+        answPtr->AnswType = AnswOk;
+        answPtr->SeNo = s->nextExpected;
+        break;
+
+    case ReqSig: {
+        unsigned long total = 0;
+        int known;
+        long n;
+
+        /* ohne Sitzung immer mit Cookie: ein gefälschter Absender soll
+         * weder eine Signatur über die ganze Datei berechnen lassen noch
+         * die Anwendung für den nächsten Transfer vorbereiten */
+        s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (srv->cookies && s == NULL &&
+            !cookie_verify(srv, cookie_get(reqPtr->Cookie), answPtr)) {
+            srv->stats.acks++;
+            return answPtr;   /* FlNr ist kein Fenster */
+        }
+        if (reqPtr->FlNr > 0) {
+            known = srv->app.query != NULL && reqPtr->FlNr <= BufferSize;
+            n = known ? srv->app.query(srv->app.user, reqPtr->name, reqPtr->FlNr,
+                                       srv->ansData, sizeof(srv->ansData))
+                      : -1;
+            if (n >= 0) total = (unsigned long)n;
+        } else {
+            known = srv->app.sig != NULL;
+            n = known ? srv->app.sig(srv->app.user, reqPtr->SeNr, srv->ansData,
+                                     sizeof(srv->ansData), &total)
+                      : -1;
+        }
+        if (n < 0) {
+            answPtr->AnswType = AnswErr;
+            answPtr->ErrNo = known ? ERR_FILE_ERROR : ERR_ILLEGAL_REQUEST;
+            break;
+        }
+        answPtr->AnswType = AnswSig;
+        answPtr->FlNr = total;
+        answPtr->SeNo = reqPtr->SeNr;
+        srv->ansDataLen = (unsigned long)n;
+        srv->stats.acks++;
+        return answPtr;   /* FlNr ist kein Fenster */
+    }
+
+    case ReqClose:
+        s = session_find(srv, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (s == NULL) {
+            /* Sitzung bereits aufgeräumt: wie ein FIN nur bestätigen,
+             * wenn der Abschluss bekannt ist */
+            if (closed_answer(srv, reqPtr->SeNr, answPtr) < 0) {
+                answPtr->AnswType = AnswErr;
+                answPtr->ErrNo = ERR_WRONG_SEQ;
+            }
+            break;
+        }
+        answPtr->AnswType = AnswOk;
+        if (s->state == SESS_OPEN) {
+            s->lastActiveMs = srv->nowMs;
+            if (reqPtr->SeNr != s->nextExpected) {
+                /* Es fehlen noch Daten: NAK bzw. kumulatives ACK wie bei ReqData */
+                if (reqPtr->SeNr > s->nextExpected && nak_due(s)) {
+                    session_nak(s, reqPtr->SeNr, answPtr);
+                    srv->stats.acks++;
+                    return answPtr;
+                }
+                answPtr->SeNo = s->nextExpected;
+                break;
+            }
+            /* Sitzung beenden */
+            s->nextExpected++;
+            session_close(s, 0);
+        }
+        answPtr->SeNo = s->nextExpected;
+        close_answer(s, answPtr);
+        break;
+    default:
+    /* unbekannter Request-Typ -> Fehler */
+        answPtr->AnswType = AnswErr;
+        answPtr->ErrNo = 1;
+        break;
+    }
+
+    advertise_window(srv, answPtr);
+    srv->stats.acks++;
+    return answPtr;
+}
+
+/* --------------------------------------------------------------- */
+/*  Server-Kontext anlegen / freigeben                             */
+/* --------------------------------------------------------------- */
+
+/* Instanz mit Optionen und Sitzungstabelle anlegen (ohne Socket) */
+static struct arq_server *server_alloc(const struct arq_server_opts *opts,
+                                       const struct arq_server_app *app)
+{
+    struct arq_server *srv;
+
+    srv = calloc(1, sizeof(*srv));
+    if (srv == NULL) {
+        perror("arqServerCreate: calloc");
+        return NULL;
+    }
+    srv->sock = srv->epfd = srv->tfd = srv->stopFd = -1;
+    srv->randState = 1;
+    srv->idleMs = ARQ_IDLE_MS;
+    if (app) srv->app = *app;
+    if (opts) {
+        srv->lossReq = opts->lossReq;
+        srv->lossAck = opts->lossAck;
+        if (opts->idleTimeoutMs > 0) srv->idleMs = opts->idleTimeoutMs;
+        srv->delAckMs = opts->delayedAckMs;
+        srv->quiet = opts->quiet;
+        srv->spinNs = (unsigned long long)opts->busyPollUs * 1000ULL;
+        srv->timestamps = opts->timestamps;
+        srv->cookies = opts->cookies;
+        if (opts->secure) {
+            if (aeadSelfTest() != 0) {
+                fprintf(stderr, "arqServerCreate: crypto self-test failed\n");
+                free(srv);
+                return NULL;
+            }
+            srv->sec = calloc(1, sizeof(*srv->sec));
+            if (srv->sec == NULL) {
+                perror("arqServerCreate: calloc");
+                free(srv);
+                return NULL;
+            }
+            if (opts->psk) memcpy(srv->sec->psk, opts->psk, AEAD_KEY_LEN);
+        }
+    }
+    srv->io.user = srv;
+    srv->io.now  = sys_now;
+    srv->io.send = sys_send;
+
+    /* Kennung als Multicast-Empfänger: Server auf einem Rechner teilen
+     * sich Adresse und Port */
+    if (getrandom(&srv->mcId, sizeof(srv->mcId), 0) != sizeof(srv->mcId))
+        srv->mcId = ((uint64_t)getpid() << 32) ^ (uint64_t)time(NULL);
+    if (srv->cookies && opts->cookieKey) {
+        memcpy(srv->cookieKey, opts->cookieKey, sizeof(srv->cookieKey));
+    } else if (srv->cookies &&
+        getrandom(srv->cookieKey, sizeof(srv->cookieKey), 0) != sizeof(srv->cookieKey)) {
+        perror("arqServerCreate: getrandom");
+        free(srv->sec);
+        free(srv);
+        return NULL;
+    }
+
+    sessions_init(srv);
+    return srv;
+}
+
+/* --------------------------------------------------------------- */
+/*  io_uring-Betrieb                                               */
+/* --------------------------------------------------------------- */
+
+static int server_uring_init(struct arq_server *srv)
+{
+    struct server_uring *ur = calloc(1, sizeof(*ur));
+    int err;
+
+    if (ur == NULL) return -1;
+    if (uringInit(&ur->ring, URING_ENTRIES) < 0) {
+        err = errno;
+        free(ur);
+        errno = err;
+        return -1;
+    }
+    if (uringBufRing(&ur->ring, 0, URING_RX_BUFS, URING_RX_BUF_SIZE) < 0) {
+        err = errno;
+        uringExit(&ur->ring);
+        free(ur);
+        errno = err;
+        return -1;
+    }
+    ur->rxMsg.msg_namelen = sizeof(struct sockaddr_storage);
+    if (srv->timestamps || srv->rxqOvfl)
+        ur->rxMsg.msg_controllen = SAP_CTRL_LEN;
+    for (unsigned i = 0; i < URING_TX_SLOTS; i++)
+        ur->txFree[ur->txFreeN++] = (unsigned short)i;
+    for (unsigned i = 0; i < URING_WR_SLOTS; i++)
+        ur->wrFree[ur->wrFreeN++] = (unsigned short)i;
+
+    srv->ur = ur;
+    srv->io.send = uring_send;
+    return 0;
+}
+
+static void server_uring_free(struct arq_server *srv)
+{
+    if (srv->ur == NULL) return;
+    uringExit(&srv->ur->ring);
+    free(srv->ur);
+    srv->ur = NULL;
+    srv->io.send = sys_send;
+}
+
+/* Nutzdaten als WRITE mit Offset eintragen (Kopie im Slot). Sind alle
+ * Slots unterwegs, synchron per pwrite(). */
+static int uring_write(struct arq_server *srv, struct arq_session *s, int fd,
+                       const char *buf, unsigned long len)
+{
+    struct server_uring *ur = srv->ur;
+    struct io_uring_sqe *sqe;
+    struct uring_wr *wr;
+    unsigned short idx;
+
+    if (len == 0) return 0;
+    if (ur->wrFreeN == 0 || len > sizeof(wr->data) ||
+        (sqe = uringSqe(&ur->ring)) == NULL) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)s->offset);
+        if (n != (ssize_t)len) {
+            fprintf(stderr, "Server: pwrite failed: %s\n", strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    idx = ur->wrFree[--ur->wrFreeN];
+    wr = &ur->wr[idx];
+    memcpy(wr->data, buf, len);
+    wr->len  = len;
+    wr->xfer = s->xfer;
+    s->xfer->writes++;
+
+    sqe->opcode    = IORING_OP_WRITE;
+    sqe->fd        = fd;
+    sqe->addr      = (unsigned long)wr->data;
+    sqe->len       = (unsigned)len;
+    sqe->off       = s->offset;
+    sqe->user_data = UD(UD_WRITE, idx);
+    return 0;
+}
+
+static void uring_write_done(struct arq_server *srv, unsigned idx, int res)
+{
+    struct server_uring *ur = srv->ur;
+    struct uring_wr *wr = &ur->wr[idx];
+
+    if (res < 0 || (unsigned long)res != wr->len) {
+        fprintf(stderr, "Server: write failed: %s\n",
+                res < 0 ? strerror(-res) : "short write");
+        wr->xfer->failed = 1;
+    }
+    if (wr->xfer->writes > 0) wr->xfer->writes--;
+    wr->xfer = NULL;
+    ur->wrFree[ur->wrFreeN++] = (unsigned short)idx;
+}
+
+/* Auf alle Schreibvorgänge von x warten. Andere CQEs bleiben für die
+ * Ereignisschleife liegen; ausgewertete WRITE-CQEs werden als UD_DONE
+ * markiert. */
+static void uring_drain_writes(struct arq_server *srv, struct arq_xfer *x)
+{
+    struct uring *u = &srv->ur->ring;
+
+    while (x->writes > 0) {
+        unsigned head = *u->cqHead;
+        unsigned tail = __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE);
+
+        for (unsigned i = head; i != tail; i++) {
+            struct io_uring_cqe *cqe = &u->cqes[i & *u->cqMask];
+            if (UD_KIND(cqe->user_data) != UD_WRITE) continue;
+            uring_write_done(srv, UD_IDX(cqe->user_data), cqe->res);
+            cqe->user_data = UD(UD_DONE, 0);
+        }
+        if (x->writes == 0) break;
+        if (uringEnter(u, (tail - head) + 1, -1) < 0) {
+            perror("Server: io_uring_enter");
+            x->failed = 1;
+            break;
+        }
+    }
+}
+
+static int uring_arm_recv(struct arq_server *srv)
+{
+    struct io_uring_sqe *sqe = uringSqe(&srv->ur->ring);
+
+    if (sqe == NULL) return -1;
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = srv->sock;
+    sqe->addr      = (unsigned long)&srv->ur->rxMsg;
+    sqe->len       = 1;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = srv->ur->ring.bgid;
+    sqe->user_data = UD(UD_RECV, 0);
+    return 0;
+}
+
+static int uring_arm_read(struct arq_server *srv, int fd, unsigned long long *buf, unsigned kind)
+{
+    struct io_uring_sqe *sqe = uringSqe(&srv->ur->ring);
+
+    if (sqe == NULL) return -1;
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = fd;
+    sqe->addr      = (unsigned long)buf;
+    sqe->len       = sizeof(*buf);
+    sqe->off       = (unsigned long long)-1;   /* aktuelle Position */
+    sqe->user_data = UD(kind, 0);
+    return 0;
+}
+
+/* Mitschnitt ab der aktuellen Zeit (srv->io) anlegen, siehe opts.trace.
+ * Rückgabewert: 0, <0 wenn die Datei nicht angelegt werden kann. */
+static int server_open_trace(struct arq_server *srv, const struct arq_server_opts *opts)
+{
+    struct trace_hdr h;
+
+    if (opts == NULL || opts->trace == NULL) return 0;
+    memset(&h, 0, sizeof(h));
+    h.Side    = 'S';
+    h.StartNs = srv->io.now(srv->io.user);
+    h.Conf.srv.lossReq  = srv->lossReq;
+    h.Conf.srv.lossAck  = srv->lossAck;
+    h.Conf.srv.delAckMs = srv->delAckMs;
+    h.Conf.srv.idleMs   = srv->idleMs;
+    h.Conf.srv.cookies  = srv->cookies;
+    memcpy(h.Conf.srv.cookieKey, srv->cookieKey, sizeof(h.Conf.srv.cookieKey));
+    srv->trace = traceCreate(opts->trace, &h);
+    if (srv->trace == NULL) {
+        fprintf(stderr, "arqServerCreate: trace '%s': %s\n", opts->trace, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Timer Wheel ab der aktuellen Zeit (srv->io) starten */
+static void server_start_timers(struct arq_server *srv)
+{
+    srv->nowMs = now_ms(srv);
+    twInit(&srv->wheel, srv->nowMs);
+    twTimerInit(&srv->statsTimer, stats_flush, srv);
+    twAdd(&srv->wheel, &srv->statsTimer, ARQ_STATS_MS);
+}
+
+/* Instanz mit Socket anlegen; sh: Empfangs-Thread von struct arq_shared */
+static struct arq_server *server_create(const char *port,
+                                        const struct arq_server_opts *opts,
+                                        const struct arq_server_app *app,
+                                        struct arq_shared *sh)
+{
+    struct arq_server *srv;
+    struct epoll_event ev;
+    struct itimerspec its;
+    int flags;
+
+    srv = server_alloc(opts, app);
+    if (srv == NULL) {
+        return NULL;
+    }
+    if (sh) {
+        srv->shared = sh;
+        srv->xfers  = sh->xfers;
+    }
+
+    if (sap_init(srv, port) < 0) {
+        free(srv);
+        return NULL;
+    }
+    if (opts && opts->mcastGroup && sap_join(srv, opts->mcastGroup) < 0) {
+        arqServerDestroy(srv);
+        return NULL;
+    }
+
+    if (opts && opts->rcvBuf)
+        sap_size_rcvbuf(srv, opts->rcvBuf, 1);
+    else
+        sap_size_rcvbuf(srv, ARQ_RCVBUF_AUTO, 0);
+
+    flags = fcntl(srv->sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(srv->sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("arqServerCreate: fcntl(O_NONBLOCK)");
+        arqServerDestroy(srv);
+        return NULL;
+    }
+
+    srv->epfd   = epoll_create1(EPOLL_CLOEXEC);
+    srv->tfd    = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    srv->stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (srv->epfd < 0 || srv->tfd < 0 || srv->stopFd < 0) {
+        perror("arqServerCreate: epoll/timerfd/eventfd");
+        arqServerDestroy(srv);
+        return NULL;
+    }
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_nsec    = TW_TICK_MS * 1000000L;
+    its.it_interval.tv_nsec = TW_TICK_MS * 1000000L;
+    timerfd_settime(srv->tfd, 0, &its, NULL);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = srv->sock;
+    epoll_ctl(srv->epfd, EPOLL_CTL_ADD, srv->sock, &ev);
+    ev.data.fd = srv->tfd;
+    epoll_ctl(srv->epfd, EPOLL_CTL_ADD, srv->tfd, &ev);
+    ev.data.fd = srv->stopFd;
+    epoll_ctl(srv->epfd, EPOLL_CTL_ADD, srv->stopFd, &ev);
+
+    if (srv->spinNs) {
+        /* Treiber-Busy-Poll im Kernel (über net.core.busy_read hinaus
+         * nur mit CAP_NET_ADMIN) */
+        int us = (int)opts->busyPollUs;
+        if (setsockopt(srv->sock, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0)
+            fprintf(stderr, "Server: SO_BUSY_POLL: %s (nur Spin im Userspace)\n",
+                    strerror(errno));
+    }
+
+    if (srv->timestamps) {
+        /* Software-Zeitstempel beim Empfang (Treiber bzw. Loopback) */
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (setsockopt(srv->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            fprintf(stderr, "Server: SO_TIMESTAMPING: %s (ohne Servicezeit)\n",
+                    strerror(errno));
+            srv->timestamps = 0;
+        }
+    }
+
+    if (opts && opts->uring && sh) {
+        srv->uringLater = 1;
+    } else if (opts && opts->uring && server_uring_init(srv) < 0) {
+        fprintf(stderr, "Server: io_uring nicht verfügbar (%s), benutze epoll\n",
+                strerror(errno));
+    }
+
+    if (server_open_trace(srv, opts) < 0) {
+        arqServerDestroy(srv);
+        return NULL;
+    }
+    server_start_timers(srv);
+    return srv;
+}
+
+struct arq_server *arqServerCreate(const char *port,
+                                   const struct arq_server_opts *opts,
+                                   const struct arq_server_app *app)
+{
+    struct arq_server_opts o;
+    struct arq_server_app a;
+    struct arq_shared *sh;
+    struct arq_server *srv;
+    unsigned int n = opts ? opts->rxThreads : 0;
+
+    if (n <= 1) return server_create(port, opts, app, NULL);
+    if (opts->mcastGroup || opts->trace) {
+        fprintf(stderr, "Server: Multicast und Mitschnitt nur mit einem Empfangs-Thread\n");
+        return server_create(port, opts, app, NULL);
+    }
+    if (n > ARQ_MAX_RX_THREADS) n = ARQ_MAX_RX_THREADS;
+
+    sh = calloc(1, sizeof(*sh));
+    if (sh == NULL) {
+        perror("arqServerCreate: calloc");
+        return NULL;
+    }
+    pthread_mutex_init(&sh->lock, NULL);
+
+    /* Schreiben per io_uring bliebe im Ring des schreibenden Threads
+     * liegen, den der Thread des letzten Stripes nicht abwarten kann */
+    memset(&a, 0, sizeof(a));
+    if (app) a = *app;
+    a.writeFd = NULL;
+
+    srv = server_create(port, opts, &a, sh);
+    if (srv == NULL) {
+        pthread_mutex_destroy(&sh->lock);
+        free(sh);
+        return NULL;
+    }
+    sh->shard[sh->n++] = srv;
+
+    /* alle Instanzen mit demselben Cookie-Geheimnis */
+    o = *opts;
+    o.cookieKey = srv->cookieKey;
+    while (sh->n < n) {
+        struct arq_server *s = server_create(port, &o, &a, sh);
+        if (s == NULL) {
+            arqServerDestroy(srv);
+            return NULL;
+        }
+        s->shardNo = sh->n;
+        sh->shard[sh->n++] = s;
+    }
+    return srv;
+}
+
+struct arq_server *arqServerCreateIo(const struct arq_server_opts *opts,
+                                     const struct arq_server_app *app,
+                                     const struct arq_io *io)
+{
+    struct arq_server *srv = server_alloc(opts, app);
+    if (srv == NULL) {
+        return NULL;
+    }
+    srv->io = *io;
+    if (server_open_trace(srv, opts) < 0) {
+        arqServerDestroy(srv);
+        return NULL;
+    }
+    server_start_timers(srv);
+    return srv;
+}
+
+void arqServerStop(struct arq_server *srv)
+{
+    unsigned long long one = 1;
+    (void)!write(srv->stopFd, &one, sizeof(one));
+}
+
+void arqServerDestroy(struct arq_server *srv)
+{
+    if (srv == NULL) return;
+    if (srv->shared && srv->shared->shard[0] == srv) {
+        struct arq_shared *sh = srv->shared;
+        for (unsigned int i = 1; i < sh->n; i++)
+            arqServerDestroy(sh->shard[i]);
+        pthread_mutex_destroy(&sh->lock);
+        free(sh);
+    }
+    if (srv->stopFd >= 0) close(srv->stopFd);
+    if (srv->tfd >= 0) close(srv->tfd);
+    if (srv->epfd >= 0) close(srv->epfd);
+    server_uring_free(srv);
+    (void)sap_exit(srv);
+    if (traceClose(srv->trace) < 0)
+        fprintf(stderr, "Server: trace unvollständig geschrieben\n");
+    if (srv->sec) {
+        memset(srv->sec, 0, sizeof(*srv->sec));
+        free(srv->sec);
+    }
+    for (int i = 0; i < ARQ_MAX_SESSIONS; i++)
+        free(srv->sessions[i].mc);
+    memset(srv->sessions, 0, sizeof(srv->sessions));   /* Sitzungsschlüssel */
+    free(srv);
+}
+
+/* --------------------------------------------------------------- */
+/*  ARQ-Server-Hauptschleife                                       */
+/* --------------------------------------------------------------- */
+
+/* Empfangenen Request (srv->req von srv->lastClientAddr) verarbeiten
+ * und ggf. beantworten. Rückgabewert: <0 bei schwerem Sendefehler. */
+static int handle_request(struct arq_server *srv)
+{
+    struct answer answ;
+    struct answer *ok;
+
+    /* Request verarbeiten (kann NULL zurückgeben = verworfen) */
+    shared_lock(srv);
+    ok = processRequest(srv, &srv->req, &answ, srv->lossReq);
+    shared_unlock(srv);
+    if (ok == NULL) {
+        /* Request wurde simuliert verworfen -> weiter warten */
+        return 0;
+    }
+    if (srv->sec != NULL && answ.AnswType != AnswCookie) sec_hello_keys(srv);
+    stamp_service(&answ, srv->rxNs);
+    return send_answer_data(srv, &srv->lastClientAddr, srv->lastClientAddrLen, &answ,
+                            srv->ansData, srv->ansDataLen);
+}
+
+/*
+ * Ereignisschleife auf epoll:
+ *   - Server-Socket (nicht blockierend): alle anliegenden Requests
+ *     abholen und verarbeiten
+ *   - timerfd (periodisch, TW_TICK_MS): Timer Wheel weiterschalten
+ *   - eventfd: arqServerStop()
+ * Kein Thread je Sitzung; Kosten je Ereignis O(1).
+ */
+static int run_epoll(struct arq_server *srv)
+{
+    struct epoll_event events[8];
+
+    for (;;) {
+        int n = 0;
+
+        /* Busy-Poll: erst nicht blockierend, dann schlafen */
+        if (srv->spinNs) {
+            unsigned long long until = srv->io.now(srv->io.user) + srv->spinNs;
+            while ((n = epoll_wait(srv->epfd, events, 8, 0)) == 0 &&
+                   srv->io.now(srv->io.user) < until)
+                sched_yield();  /* auf eigenem Kern sofort zurück */
+        }
+        if (n == 0)
+            n = epoll_wait(srv->epfd, events, 8, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("arqServerLoop: epoll_wait");
+            return -1;
+        }
+        srv->nowMs = now_ms(srv);
+        srv->memValid = 0;
+
+        for (int i = 0; i < n; i++) {
+            unsigned long long expirations;
+
+            if (events[i].data.fd == srv->stopFd) {
+                (void)!read(srv->stopFd, &expirations, sizeof(expirations));
+                return 0;
+            }
+            if (events[i].data.fd == srv->tfd) {
+                (void)!read(srv->tfd, &expirations, sizeof(expirations));
+                trace_tick(srv);
+                shared_lock(srv);
+                twAdvance(&srv->wheel, srv->nowMs);
+                shared_unlock(srv);
+                continue;
+            }
+
+            /* alle anliegenden Requests abholen */
+            while (sap_recv(srv) != NULL) {
+                srv->memValid = 0;
+                if (handle_request(srv) < 0) {
+                    /* schwerer Fehler beim Senden -> beenden */
+                    return -1;
+                }
+            }
+        }
+    }
+}
+
+/* Ein Datagramm aus dem Buffer-Ring (Multishot-RECVMSG) verarbeiten. */
+static void uring_recv_done(struct arq_server *srv, int res, unsigned flags)
+{
+    struct server_uring *ur = srv->ur;
+    struct io_uring_recvmsg_out *out;
+    unsigned short bid;
+    const char *name;
+
+    if (!(flags & IORING_CQE_F_BUFFER)) return;
+    bid = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+    out = uringBuf(&ur->ring, bid);
+    name = (const char *)(out + 1);
+
+    if (res >= (int)sizeof(*out) && out->namelen <= ur->rxMsg.msg_namelen) {
+        const char *payload = name + ur->rxMsg.msg_namelen + ur->rxMsg.msg_controllen;
+        unsigned long len = out->payloadlen;
+
+        memcpy(&srv->lastClientAddr, name, out->namelen);
+        srv->lastClientAddrLen = out->namelen;
+        trace_datagram(srv, TRACE_RX, payload, len, &srv->lastClientAddr, srv->lastClientAddrLen);
+        if (srv->sec != NULL) {
+            if (sec_unwrap(srv, (const unsigned char *)payload, len) < 0) {
+                uringBufPut(&ur->ring, bid);
+                return;
+            }
+        } else {
+            if (len > sizeof(srv->req)) len = sizeof(srv->req);
+            memset(&srv->req, 0, sizeof(srv->req));
+            memcpy(&srv->req, payload, len);
+        }
+        srv->rxNs = 0;
+        if (ur->rxMsg.msg_controllen > 0) {
+            struct msghdr ctl;
+            memset(&ctl, 0, sizeof(ctl));
+            ctl.msg_control    = (char *)name + ur->rxMsg.msg_namelen;
+            ctl.msg_controllen = out->controllen;
+            parse_cmsgs(srv, &ctl);
+        }
+        (void)handle_request(srv);
+    }
+    uringBufPut(&ur->ring, bid);
+}
+
+/*
+ * Ereignisschleife auf io_uring: ein io_uring_enter() übergibt alle
+ * gesammelten SQEs (ACKs, Schreibvorgänge, neu aufgesetzte READs) und
+ * wartet auf das nächste Ereignis; die CQEs werden ohne weitere
+ * Systemaufrufe abgearbeitet.
+ * Rückgabewert wie arqServerRun(); 1 = Multishot-Empfang vom Kernel
+ * nicht unterstützt, epoll benutzen.
+ */
+static int run_uring(struct arq_server *srv)
+{
+    struct server_uring *ur = srv->ur;
+    struct io_uring_cqe *cqe;
+
+    if (uring_arm_recv(srv) < 0 ||
+        uring_arm_read(srv, srv->tfd, &ur->tickBuf, UD_TICK) < 0 ||
+        uring_arm_read(srv, srv->stopFd, &ur->stopBuf, UD_STOP) < 0)
+        return 1;
+
+    for (;;) {
+        int rc;
+
+        /* Busy-Poll: Abschlüsse mit Timeout 0 abholen, dann schlafen */
+        if (srv->spinNs) {
+            unsigned long long until = srv->io.now(srv->io.user) + srv->spinNs;
+            while ((rc = uringEnter(&ur->ring, 1, 0)) == 0 &&
+                   uringReady(&ur->ring) == 0 && srv->io.now(srv->io.user) < until)
+                sched_yield();
+        }
+        rc = (uringReady(&ur->ring) > 0) ? uringEnter(&ur->ring, 0, -1)
+                                         : uringEnter(&ur->ring, 1, -1);
+        if (rc < 0) {
+            perror("arqServerLoop: io_uring_enter");
+            return -1;
+        }
+        srv->nowMs = now_ms(srv);
+        srv->memValid = 0;
+
+        while ((cqe = uringPeek(&ur->ring)) != NULL) {
+            unsigned long long ud = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+
+            uringSeen(&ur->ring);
+            switch (UD_KIND(ud)) {
+            case UD_RECV:
+                if (res < 0 && !(flags & IORING_CQE_F_BUFFER)) {
+                    if (!ur->rxOk && (res == -EINVAL || res == -EOPNOTSUPP))
+                        return 1;
+                    if (res != -ENOBUFS && res != -EINTR)
+                        fprintf(stderr, "getRequest: recvmsg: %s\n", strerror(-res));
+                } else {
+                    ur->rxOk = 1;
+                    uring_recv_done(srv, res, flags);
+                }
+                /* Multishot beendet (z.B. keine freien Puffer): neu aufsetzen */
+                if (!(flags & IORING_CQE_F_MORE) && uring_arm_recv(srv) < 0)
+                    return -1;
+                break;
+            case UD_TICK:
+                trace_tick(srv);
+                shared_lock(srv);
+                twAdvance(&srv->wheel, srv->nowMs);
+                shared_unlock(srv);
+                if (uring_arm_read(srv, srv->tfd, &ur->tickBuf, UD_TICK) < 0)
+                    return -1;
+                break;
+            case UD_STOP:
+                (void)uringEnter(&ur->ring, 0, -1);  /* letzte ACKs übergeben */
+                return 0;
+            case UD_SEND:
+                if (res < 0)
+                    fprintf(stderr, "sendAnswer: sendmsg: %s\n", strerror(-res));
+                ur->txFree[ur->txFreeN++] = (unsigned short)UD_IDX(ud);
+                break;
+            case UD_WRITE:
+                uring_write_done(srv, UD_IDX(ud), res);
+                break;
+            default:
+                break;  /* UD_DONE: schon in uring_drain_writes() ausgewertet */
+            }
+        }
+    }
+}
+
+static int server_run(struct arq_server *srv)
+{
+    if (srv->uringLater) {
+        srv->uringLater = 0;
+        if (server_uring_init(srv) < 0)
+            fprintf(stderr, "Server: io_uring nicht verfügbar (%s), benutze epoll\n",
+                    strerror(errno));
+    }
+    if (srv->ur) {
+        int rc = run_uring(srv);
+        if (rc <= 0) return rc;
+        fprintf(stderr, "Server: io_uring ohne Multishot-Empfang, benutze epoll\n");
+        server_uring_free(srv);
+    }
+    return run_epoll(srv);
+}
+
+/* Thread eines weiteren Empfangs-Threads; ein schwerer Fehler beendet
+ * alle (über shard[0]) */
+static void *shard_main(void *arg)
+{
+    struct arq_server *srv = arg;
+
+    if (server_run(srv) < 0) {
+        srv->shared->failed = 1;
+        arqServerStop(srv->shared->shard[0]);
+    }
+    return NULL;
+}
+
+int arqServerRun(struct arq_server *srv)
+{
+    struct arq_shared *sh = srv->shared;
+    unsigned int started;
+    int rc = -1;
+
+    if (sh == NULL || sh->shard[0] != srv) return server_run(srv);
+
+    for (started = 1; started < sh->n; started++) {
+        if (pthread_create(&sh->thread[started], NULL, shard_main, sh->shard[started]) != 0) {
+            fprintf(stderr, "arqServerRun: pthread_create failed\n");
+            break;
+        }
+    }
+    if (started == sh->n) rc = server_run(srv);
+    for (unsigned int i = 1; i < started; i++)
+        arqServerStop(sh->shard[i]);
+    for (unsigned int i = 1; i < started; i++)
+        pthread_join(sh->thread[i], NULL);
+    return sh->failed ? -1 : rc;
+}
+
+/* --------------------------------------------------------------- */
+/*  Ereignisgesteuerter Betrieb ohne Socket (Simulation)           */
+/* --------------------------------------------------------------- */
+
+void arqServerInput(struct arq_server *srv, const void *buf, unsigned long len,
+                    const struct sockaddr_storage *from, socklen_t fromLen)
+{
+    srv->nowMs = now_ms(srv);
+    srv->memValid = 0;
+
+    memcpy(&srv->lastClientAddr, from, fromLen);
+    srv->lastClientAddrLen = fromLen;
+    trace_datagram(srv, TRACE_RX, buf, len, from, fromLen);
+    if (srv->sec != NULL) {
+        if (sec_unwrap(srv, buf, len) < 0) return;
+    } else {
+        memset(&srv->req, 0, sizeof(srv->req));
+        memcpy(&srv->req, buf, (len < sizeof(srv->req)) ? len : sizeof(srv->req));
+    }
+
+    (void)handle_request(srv);
+}
+
+unsigned long long arqServerAdvance(struct arq_server *srv)
+{
+    unsigned long long next;
+
+    srv->nowMs = now_ms(srv);
+    trace_tick(srv);
+    twAdvance(&srv->wheel, srv->nowMs);
+
+    next = twNextExpiryMs(&srv->wheel);
+    return (next == ~0ULL) ? next : next * 1000000ULL;
+}
+
+/* --------------------------------------------------------------- */
+/*  Klassische API: Hüllen um die Standard-Instanz                 */
+/* --------------------------------------------------------------- */
+
+/* Standard-Instanz anlegen (ohne Socket), nimmt die Einstellungen bis
+ * initServer() bzw. arqServerLoop() auf */
+static struct arq_server *default_server(void)
+{
+    if (gServer == NULL) gServer = server_alloc(NULL, NULL);
+    return gServer;
+}
+
+/* Hüllen: user ist die Standard-Instanz (auch für weitere Empfangs-Threads) */
+static int legacy_start(void *user)
+{
+    struct arq_server *srv = user;
+    return srv->classic.start ? srv->classic.start() : 0;
+}
+
+static int legacy_write(void *user, const char *buf, unsigned long len)
+{
+    struct arq_server *srv = user;
+    return srv->classic.write ? srv->classic.write(buf, len) : 0;
+}
+
+static int legacy_write_at(void *user, const char *buf, unsigned long len,
+                           unsigned long offset)
+{
+    struct arq_server *srv = user;
+    return srv->classic.writeAt(buf, len, offset);
+}
+
+static void legacy_end(void *user)
+{
+    struct arq_server *srv = user;
+    if (srv->classic.end) srv->classic.end();
+}
+
+void arqServerSetWriteAt(appWriteAtFn appWriteAt)
+{
+    if (default_server()) gServer->classic.writeAt = appWriteAt;
+}
+
+static int legacy_write_fd(void *user)
+{
+    struct arq_server *srv = user;
+    return srv->classic.writeFd();
+}
+
+static int legacy_sync(void *user)
+{
+    struct arq_server *srv = user;
+    return srv->classic.sync();
+}
+
+void arqServerSetSync(appSyncFn appSync)
+{
+    if (default_server()) gServer->classic.sync = appSync;
+}
+
+static long legacy_sig(void *user, unsigned long offset, char *buf, unsigned long len,
+                       unsigned long *total)
+{
+    struct arq_server *srv = user;
+    return srv->classic.sig(offset, buf, len, total);
+}
+
+void arqServerSetSig(appSigFn appSig)
+{
+    if (default_server()) gServer->classic.sig = appSig;
+}
+
+static int legacy_hole(void *user, unsigned long offset, unsigned long len)
+{
+    struct arq_server *srv = user;
+    return srv->classic.hole(offset, len);
+}
+
+void arqServerSetHole(appHoleFn appHole)
+{
+    if (default_server()) gServer->classic.hole = appHole;
+}
+
+static long legacy_query(void *user, const char *q, unsigned long qLen, char *buf,
+                         unsigned long len)
+{
+    struct arq_server *srv = user;
+    return srv->classic.query(q, qLen, buf, len);
+}
+
+void arqServerSetQuery(appQueryFn appQuery)
+{
+    if (default_server()) gServer->classic.query = appQuery;
+}
+
+void arqServerSetBusyPoll(unsigned long spinUs)
+{
+    if (default_server()) gServer->classic.opts.busyPollUs = spinUs;
+}
+
+void arqServerSetTimestamps(int enable)
+{
+    if (default_server()) gServer->classic.opts.timestamps = enable;
+}
+
+void arqServerSetSecure(int enable, const unsigned char *psk)
+{
+    if (default_server() == NULL) return;
+    gServer->classic.opts.secure = enable;
+    if (psk) memcpy(gServer->classic.psk, psk, AEAD_KEY_LEN);
+    else     memset(gServer->classic.psk, 0, AEAD_KEY_LEN);
+}
+
+void arqServerSetMulticast(const char *group)
+{
+    if (default_server()) gServer->classic.opts.mcastGroup = group;
+}
+
+void arqServerSetCookies(int enable)
+{
+    if (default_server()) gServer->classic.opts.cookies = enable;
+}
+
+void arqServerSetTrace(const char *path)
+{
+    if (default_server()) gServer->classic.opts.trace = path;
+}
+
+void arqServerSetRcvBuf(unsigned long bytes)
+{
+    if (default_server()) gServer->classic.opts.rcvBuf = bytes;
+}
+
+void arqServerSetRxThreads(unsigned int n)
+{
+    if (default_server()) gServer->classic.opts.rxThreads = n;
+}
+
+void arqServerSetUring(int enable, appWriteFdFn appWriteFd)
+{
+    if (default_server() == NULL) return;
+    gServer->classic.opts.uring = enable;
+    gServer->classic.writeFd    = appWriteFd;
+}
+
+void arqServerSetTimers(unsigned long idleTimeoutMs, unsigned long delayedAckMs)
+{
+    if (default_server() == NULL) return;
+    gServer->classic.opts.idleTimeoutMs = idleTimeoutMs;
+    gServer->classic.opts.delayedAckMs  = delayedAckMs;
+}
+
+void arqServerShutdown(void)
+{
+    if (gServer != NULL && gServer->stopFd >= 0)
+        arqServerStop(gServer);
+}
+
+int initServer(const char *port)
+{
+    /* TODO:
+     *  - mit getaddrinfo(NULL, port, ...) eine lokale Adresse für UDP/IPv6
+     *    ermitteln
+     *  - mit socket(...) einen UDP/IPv6-Socket erzeugen
+     *  - mit bind(...) an die Adresse binden
+     *  - Socket-Deskriptor in globaler Variable speichern
+     *  - bei Erfolg 0, bei Fehler <0 zurückgeben
+     */
+    if (default_server() == NULL || gServer->sock >= 0) return -1;
+    return sap_init(gServer, port);
+}
+
+struct request *getRequest(void)
+{
+    /* TODO:
+     *  - mit recvfrom(...) ein Request-Paket vom Socket lesen
+     *  - die Adresse des Clients (struct sockaddr_storage) merken,
+     *    damit sendAnswer() dorthin antworten kann
+     *  - bei Erfolg &req zurückgeben
+     *  - bei Fehler oder wenn keine Daten vorliegen: NULL zurückgeben
+     */
+    if (gServer == NULL || gServer->sock < 0) return NULL;
+    return sap_recv(gServer);
+}
+
+int sendAnswer(struct answer *answerPtr)
+{
+    /* TODO:
+     *  - mit sendto(...) eine Antwort an die zuletzt bekannte
+     *    Client-Adresse schicken
+     *  - bei Erfolg 0, bei Fehler <0 zurückgeben
+     */
+    if (gServer == NULL || gServer->sock < 0) {
+        fprintf(stderr,"sendAnswer: server socket not initialized\n");
+        return -1;
+    }
+    return send_answer_to(gServer, &gServer->lastClientAddr,
+                          gServer->lastClientAddrLen, answerPtr);
+}
+
+int exitServer(void)
+{
+    /* TODO:
+     *  - Socket schließen (close)
+     *  - globale Zustandsvariablen zurücksetzen
+     */
+    int rc;
+
+    if (gServer == NULL) return 0;
+    rc = sap_exit(gServer);
+    arqServerDestroy(gServer);
+    gServer = NULL;
+    return rc;
+}
+
+int arqServerLoop(const char *port,
+                  double lossReq,
+                  double lossAck,
+                  appStartFn appStart,
+                  appWriteFn appWrite,
+                  appEndFn appEnd)
+{
+    struct arq_server_opts opts;
+    struct arq_server_app app;
+    struct arq_server *srv;
+    int rc;
+
+    if (default_server() == NULL) return -1;
+
+    /* callbacks speichern (werden über die legacy_* Hüllen aufgerufen) */
+    gServer->classic.start = appStart;
+    gServer->classic.write = appWrite;
+    gServer->classic.end   = appEnd;
+
+    opts = gServer->classic.opts;
+    opts.lossReq = lossReq;
+    opts.lossAck = lossAck;
+    opts.psk = gServer->classic.psk;
+
+    memset(&app, 0, sizeof(app));
+    app.start   = legacy_start;
+    app.write   = legacy_write;
+    app.writeAt = gServer->classic.writeAt ? legacy_write_at : NULL;
+    app.end     = legacy_end;
+    app.writeFd = gServer->classic.writeFd ? legacy_write_fd : NULL;
+    app.sync    = gServer->classic.sync ? legacy_sync : NULL;
+    app.sig     = gServer->classic.sig ? legacy_sig : NULL;
+    app.hole    = gServer->classic.hole ? legacy_hole : NULL;
+    app.query   = gServer->classic.query ? legacy_query : NULL;
+
+    /* Die laufende Instanz ersetzt die Standard-Instanz (Socket von
+     * initServer() zuerst schließen) und übernimmt deren Einstellungen */
+    (void)sap_exit(gServer);
+    srv = arqServerCreate(port, &opts, &app);
+    if (srv == NULL) {
+        return -1;
+    }
+    srv->classic = gServer->classic;
+    for (unsigned int i = 0; i < (srv->shared ? srv->shared->n : 1); i++)
+        (srv->shared ? srv->shared->shard[i] : srv)->app.user = srv;
+    arqServerDestroy(gServer);
+    gServer = srv;
+
+    rc = arqServerRun(srv);
+
+    /* Einstellungen bleiben für einen weiteren Aufruf erhalten */
+    gServer = server_alloc(NULL, NULL);
+    if (gServer) gServer->classic = srv->classic;
+    arqServerDestroy(srv);
+    return rc < 0 ? -1 : 0;
 }
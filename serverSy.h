@@ -2,6 +2,7 @@
 #define SERVERSY_H_INCLUDED
 
 #include "data.h"
+#include "arqio.h"
 
 /*
  * Anwendungscallbacks:
@@ -22,11 +23,59 @@ typedef int  (*appWriteFn)(const char *buf, unsigned long len);
 typedef void (*appEndFn)(void);
 /* Transferende (z.B. Datei schließen). */
 
+typedef int  (*appWriteAtFn)(const char *buf, unsigned long len,
+                             unsigned long offset);
+/* Nutzdaten ab Byte-Offset schreiben (Striping, mehrere Flows
+ * schreiben in dieselbe Datei). Rückgabewert: 0 bei Erfolg, <0 bei Fehler.
+ */
+
+typedef int  (*appWriteFdFn)(void);
+/* Dateideskriptor der Ausgabe, in den die ARQ-Schicht selbst per Offset
+ * schreiben darf (io_uring-Betrieb); <0 = appWriteFn/appWriteAtFn
+ * benutzen (z.B. Pipe). Die Schreibvorgänge sind abgeschlossen, bevor
+ * appEndFn aufgerufen wird.
+ */
+
+
+typedef int  (*appSyncFn)(void);
+/* Daten des beendeten Transfers sichern, bevor der Server das
+ * Abschluss-ACK sendet (nach dem letzten Stripe und allen
+ * Schreibvorgängen, vor appEndFn). Rückgabewert: erreichte
+ * Dauerhaftigkeit DUR_* (wird im ACK gemeldet), <0 bei Fehler
+ * (Close wird mit AnswErr/ERR_FILE_ERROR beantwortet).
+ */
+
+
+typedef long (*appSigFn)(unsigned long offset, char *buf, unsigned long len,
+                         unsigned long *total);
+/* Daten für einen Client vor dem Hello (ReqSig, z.B. Signatur der
+ * vorhandenen Ausgabedatei für den Delta-Modus): bis zu len Bytes ab
+ * offset nach buf, Gesamtlänge nach *total. Rückgabewert: Anzahl
+ * Bytes, <0 bei Fehler (Client erhält AnswErr).
+ */
+
+
+typedef long (*appQueryFn)(const char *q, unsigned long qLen, char *buf,
+                           unsigned long len);
+/* Anfrage eines Clients vor dem Hello (ReqSig mit Nutzdaten, z.B.
+ * Chunk-Hashes im Dedup-Modus): Ergebnis (bis zu len Bytes) nach buf.
+ * Rückgabewert: Anzahl Bytes, <0 bei Fehler (Client erhält AnswErr).
+ */
+
+
+typedef int  (*appHoleFn)(unsigned long offset, unsigned long len);
+/* len Nullbytes ab Byte-Offset offset der Ausgabe als Loch anlegen,
+ * statt sie zu schreiben (REQ_F_HOLE, Sparse-Modus). Rückgabewert: 0,
+ * >0 = hier nicht möglich (die ARQ-Schicht schreibt dann Nullen über
+ * appWriteFn/appWriteAtFn), <0 bei Fehler.
+ */
+
 
 /*
  * SAP-Funktionen – UDP-Schicht:
  * Diese Funktionen kapseln Socket-Erzeugung, recvfrom/sendto, close.
  * Die Signaturen sind vorgegeben und sollen beibehalten werden.
+ * Sie arbeiten auf der Standard-Instanz der klassischen API.
  */
 
 int initServer(const char *port);
@@ -34,6 +83,210 @@ struct request *getRequest(void);
 int sendAnswer(struct answer *answerPtr);
 int exitServer(void);
 
+/*
+ * Kontext-API
+ *
+ * Der gesamte Zustand einer Server-Instanz (Socket, Sitzungen, Timer,
+ * Statistik) liegt in struct arq_server. Mehrere Instanzen (z.B. auf
+ * verschiedenen Ports) können in eigenen Threads parallel laufen; eine
+ * Instanz wird von genau einem Thread betrieben (arqServerStop() darf
+ * aus jedem Thread aufgerufen werden). Mit opts.rxThreads > 1 startet
+ * arqServerRun() selbst weitere Empfangs-Threads auf demselben Port;
+ * die Anwendungscallbacks laufen auch dann nie gleichzeitig.
+ */
+struct arq_server;
+
+/* Anwendungscallbacks mit Kontextzeiger user (Bedeutung wie oben) */
+struct arq_server_app {
+    void *user;
+    int  (*start)(void *user);
+    int  (*write)(void *user, const char *buf, unsigned long len);
+    int  (*writeAt)(void *user, const char *buf, unsigned long len,
+                    unsigned long offset);   /* optional, für Striping */
+    void (*end)(void *user);
+    int  (*writeFd)(void *user);              /* optional, für io_uring */
+    int  (*sync)(void *user);                 /* optional, Dauerhaftigkeit */
+    long (*sig)(void *user, unsigned long offset, char *buf,
+                unsigned long len, unsigned long *total); /* optional, ReqSig */
+    int  (*hole)(void *user, unsigned long offset, unsigned long len); /* optional, REQ_F_HOLE */
+    long (*query)(void *user, const char *q, unsigned long qLen, char *buf,
+                  unsigned long len);        /* optional, ReqSig mit Anfrage */
+};
+
+struct arq_server_opts {
+    double        lossReq;        /* simulierte Request-Verlustrate      */
+    double        lossAck;        /* simulierte ACK-Verlustrate          */
+    unsigned long idleTimeoutMs;  /* 0 = Default (30 s)                  */
+    unsigned long delayedAckMs;   /* 0 = jedes Paket sofort bestätigen   */
+    int           quiet;          /* keine Status-/Statistikausgaben     */
+    int           uring;          /* io_uring statt epoll (mit Rückfall) */
+    unsigned long busyPollUs;     /* Busy-Poll je Warten in µs, 0 = aus  */
+    int           timestamps;     /* Servicezeit im ACK (SO_TIMESTAMPING) */
+    int           secure;         /* nur verschlüsselte Pakete annehmen  */
+    const unsigned char *psk;     /* 32 Bytes gemeinsames Geheimnis, NULL = ohne */
+    const char   *mcastGroup;     /* Multicast-Gruppe "Adresse%Interface", NULL = keine */
+    int           cookies;        /* unter Last Hello erst nach Cookie-Austausch (AnswCookie) */
+    const char   *trace;          /* Datagramme mitschneiden (trace.h), NULL = nein */
+    const unsigned char *cookieKey; /* 32 Bytes Cookie-Geheimnis (Wiedergabe), NULL = zufällig */
+    unsigned long rcvBuf;         /* Socket-Empfangspuffer in Bytes, 0 = automatisch */
+    unsigned int  rxThreads;      /* Empfangs-Threads mit je eigenem Socket (SO_REUSEPORT),
+                                     0/1 = einer; ohne io_uring-Dateischreiben */
+};
+
+/* Instanz anlegen und Socket binden. opts darf NULL sein.
+ * Rückgabewert: Instanz oder NULL bei Fehler.
+ */
+struct arq_server *arqServerCreate(const char *port,
+                                   const struct arq_server_opts *opts,
+                                   const struct arq_server_app *app);
+
+/* Ereignisschleife; kehrt nach arqServerStop() mit 0 zurück,
+ * bei schwerem Fehler mit <0. */
+int  arqServerRun(struct arq_server *srv);
+void arqServerStop(struct arq_server *srv);
+void arqServerDestroy(struct arq_server *srv);
+
+/*
+ * Ereignisgesteuerter Betrieb ohne Socket (z.B. Simulation, sim.c):
+ * Uhr und Versand der Antworten kommen aus io (recv/wait/sleepUntil
+ * werden nicht benutzt), der Aufrufer liefert die Requests.
+ */
+struct arq_server *arqServerCreateIo(const struct arq_server_opts *opts,
+                                     const struct arq_server_app *app,
+                                     const struct arq_io *io);
+
+/* Ein empfangenes Datagramm von from verarbeiten. Fällige Timer
+ * feuern nur über arqServerAdvance() (wie der Tick im Socket-Betrieb). */
+void arqServerInput(struct arq_server *srv, const void *buf, unsigned long len,
+                    const struct sockaddr_storage *from, socklen_t fromLen);
+
+/* Fällige Timer auslösen. Rückgabewert: Zeitpunkt (ns, io->now) des
+ * nächsten Timers, ~0ULL wenn keiner aktiv ist. */
+unsigned long long arqServerAdvance(struct arq_server *srv);
+
+/*
+ * Klassische API: dünne Hüllen um eine Standard-Instanz.
+ */
+
+/*
+ * Optionaler Callback für Striping (siehe struct hello_info):
+ * Ohne registrierten appWriteAtFn lehnt der Server Hellos mit
+ * Stripes > 1 ab. Vor arqServerLoop() aufrufen.
+ */
+void arqServerSetWriteAt(appWriteAtFn appWriteAt);
+
+/*
+ * Optionale Timer-Einstellungen (vor arqServerLoop() aufrufen):
+ *   idleTimeoutMs : offene Sitzung ohne Pakete wird danach abgebrochen,
+ *                   appEndFn schließt die Datei (Default 30 s)
+ *   delayedAckMs  : >0 -> in-order Daten nur jedes zweite Paket sofort
+ *                   bestätigen, sonst spätestens nach delayedAckMs
+ *                   (Default 0 = jedes Paket sofort)
+ */
+void arqServerSetTimers(unsigned long idleTimeoutMs, unsigned long delayedAckMs);
+
+/*
+ * io_uring-Backend (vor arqServerLoop() aufrufen): Multishot-Empfang,
+ * ACKs und Dateischreiben (appWriteFdFn, optional) als gesammelte SQEs,
+ * ein Systemaufruf je Ereignisbündel. Ohne Kernel-Unterstützung läuft
+ * die epoll-Schleife.
+ */
+void arqServerSetUring(int enable, appWriteFdFn appWriteFd);
+
+/*
+ * Dauerhaftigkeit (vor arqServerLoop() aufrufen): appSync sichert die
+ * Daten vor dem Abschluss-ACK, das Ergebnis steht im ACK (ANSW_F_DUR).
+ * Ohne Callback meldet der Server nichts.
+ */
+void arqServerSetSync(appSyncFn appSync);
+
+/*
+ * Abruf vor dem Hello (vor arqServerLoop() aufrufen): appSig liefert
+ * die Daten für ReqSig. Ohne Callback beantwortet der Server ReqSig
+ * mit AnswErr (ERR_ILLEGAL_REQUEST).
+ */
+void arqServerSetSig(appSigFn appSig);
+
+/*
+ * Anfragen vor dem Hello (vor arqServerLoop() aufrufen): appQuery
+ * beantwortet ReqSig mit Nutzdaten. Ohne Callback antwortet der Server
+ * mit AnswErr (ERR_ILLEGAL_REQUEST).
+ */
+void arqServerSetQuery(appQueryFn appQuery);
+
+/*
+ * Löcher (vor arqServerLoop() aufrufen): appHole legt die Nullbereiche
+ * von REQ_F_HOLE-Paketen an. Ohne Callback schreibt der Server Nullen.
+ */
+void arqServerSetHole(appHoleFn appHole);
+
+/*
+ * Busy-Poll (vor arqServerLoop() aufrufen): vor jedem blockierenden
+ * Warten bis zu spinUs Mikrosekunden nicht blockierend pollen, dazu
+ * SO_BUSY_POLL am Socket. Kürzere ACK-Latenz, belegt einen Kern.
+ */
+void arqServerSetBusyPoll(unsigned long spinUs);
+
+/*
+ * Kernel-Zeitstempel (vor arqServerLoop() aufrufen): SO_TIMESTAMPING
+ * beim Empfang, jedes ACK trägt die Zeit vom Eintreffen des Requests
+ * bis zum Versand (SvcUs, ANSW_F_SVC), inkl. verzögertem ACK.
+ */
+void arqServerSetTimestamps(int enable);
+
+/*
+ * Verschlüsselter Betrieb (vor arqServerLoop() aufrufen, siehe struct
+ * sec_hdr): jedes Paket mit ChaCha20-Poly1305 bzw. AES-256-GCM,
+ * Schlüsselaustausch im Hello; unverschlüsselte Requests werden verworfen. psk (32 Bytes)
+ * authentisiert die Clients, NULL = ohne (nur gegen passives Mithören).
+ */
+void arqServerSetSecure(int enable, const unsigned char *psk);
+
+/*
+ * Multicast-Empfang (vor arqServerLoop() aufrufen, siehe REQ_F_MCAST):
+ * der Socket tritt der Gruppe group ("Adresse%Interface", z.B.
+ * "ff01::4242%eth0") bei. Mehrere Server auf einem Rechner können
+ * denselben Port benutzen und empfangen jeder eine Kopie.
+ */
+void arqServerSetMulticast(const char *group);
+
+/*
+ * Cookie-Austausch (vor arqServerLoop() aufrufen, siehe GBN_COOKIE_MS):
+ * unter Last Sitzung und Ausgabedatei erst für ein Hello mit gültigem
+ * Cookie, ein Hello von einer gefälschten Adresse bleibt ohne Zustand.
+ */
+void arqServerSetCookies(int enable);
+
+/*
+ * Mitschnitt (vor arqServerLoop() aufrufen, siehe trace.h und
+ * replay.c): alle Datagramme und Ticks mit Zeitstempel nach path.
+ * NULL = aus.
+ */
+void arqServerSetTrace(const char *path);
+
+/*
+ * Größe des Socket-Empfangspuffers in Bytes (vor arqServerLoop()
+ * aufrufen). 0 = automatisch: volle Fenster für 64 Flows (nur
+ * vergrößern). Datagramme, die der Kernel trotzdem verwirft, zählt
+ * die Statistik ("im Kernel verworfen").
+ */
+void arqServerSetRcvBuf(unsigned long bytes);
+
+/*
+ * Anzahl Empfangs-Threads (vor arqServerLoop() aufrufen): je Thread ein
+ * eigener Socket auf dem Port (SO_REUSEPORT) mit eigener Ereignisschleife,
+ * der Kernel verteilt die Flows (z.B. Stripes) darauf. Die Callbacks
+ * werden serialisiert. 0/1 = ein Thread; nicht mit Multicast/Mitschnitt.
+ */
+void arqServerSetRxThreads(unsigned int n);
+
+/*
+ * Standard-Instanz nach dem laufenden Ereignis beenden (z.B. aus
+ * appEndFn, wenn nur ein Transfer bedient werden soll);
+ * arqServerLoop() kehrt dann mit 0 zurück.
+ */
+void arqServerShutdown(void);
+
 /*
  * ARQ-Server-Hauptschleife:
  *   - empfängt Requests über UDP
@@ -44,7 +297,6 @@ int exitServer(void);
  * appStart/appWrite/appEnd: Anwendungscallbacks.
  * Die Signatur ist vorgegeben und soll beibehalten werden.
  */
-
 int arqServerLoop(const char *port,
                   double lossReq,
                   double lossAck,
@@ -0,0 +1,468 @@
+/*
+ * Ereignisdiskrete Simulation einer ARQ-Übertragung.
+ *
+ * Client (clientSy.c) und Server (serverSy.c) laufen unverändert in
+ * einem Prozess; Uhr und Transport kommen über struct arq_io aus der
+ * Simulation. Die Strecke wird je Richtung durch Verlust, Laufzeit,
+ * Bandbreite (Serialisierung) und eine Drop-Tail-Warteschlange
+ * modelliert. Die virtuelle Uhr springt von Ereignis zu Ereignis, eine
+ * Übertragung über Minuten Simulationszeit dauert so nur Millisekunden
+ * und ist bei gleichem Seed exakt reproduzierbar.
+ *
+ * Nicht modelliert: Socket-Puffer des Servers (kein Empfangsfenster,
+ * der Client begrenzt nur über winSize).
+ *
+ * Ausgabe: eine CSV-Zeile je Lauf (-H: mit Kopfzeile), z.B. für
+ *   for l in 0 0.01 0.05; do ./sim -l $l -w 8; done
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "data.h"
+#include "clientSy.h"
+#include "serverSy.h"
+#include "timerwheel.h"
+
+#define SIM_START_NS  1000000000ULL   /* virtuelle Uhr startet bei 1 s   */
+#define SIM_RX_MAX    1024            /* Empfangsschlange des Clients    */
+
+/* Ereignistypen */
+#define EV_TO_SERVER  1   /* Request erreicht den Server      */
+#define EV_TO_CLIENT  2   /* Antwort erreicht den Client      */
+#define EV_SRV_WAKE   3   /* nächster Timer des Servers fällig */
+
+struct sim_event {
+    unsigned long long at;
+    unsigned long long seq;     /* FIFO bei gleichem Zeitpunkt */
+    int                type;
+    unsigned long      len;
+    union {
+        struct request req;
+        struct answer  answ;
+    } pkt;
+};
+
+/* Eine Richtung der Strecke */
+struct sim_link {
+    double             loss;        /* Verlustwahrscheinlichkeit      */
+    unsigned long long delayNs;     /* Ausbreitungsverzögerung        */
+    unsigned long long bw;          /* Bytes/s, 0 = unbegrenzt        */
+    unsigned long      queueMax;    /* Pakete in der Warteschlange, 0 = unbegrenzt */
+    unsigned long long busyUntil;   /* Sender frei ab                 */
+    unsigned long      tx;          /* gesendete Pakete               */
+    unsigned long      dropLoss;    /* durch Verlust verworfen        */
+    unsigned long      dropQueue;   /* durch volle Warteschlange      */
+};
+
+static struct {
+    unsigned long long now;
+    unsigned long long seq;
+    unsigned long long rng;
+
+    struct sim_event  *heap;
+    size_t             heapLen, heapCap;
+
+    struct sim_link    up, down;
+
+    struct arq_server *srv;
+    unsigned long long wakeAt;       /* geplanter Server-Wake, 0 = keiner */
+    struct sockaddr_storage clientAddr;
+
+    struct answer      rx[SIM_RX_MAX];
+    size_t             rxHead, rxLen;
+
+    /* Empfänger-Anwendung */
+    unsigned long long rcvBytes;
+    unsigned long      rcvBad;
+    unsigned long long doneAt;
+    int                ended;
+} sim;
+
+/* ==========================================
+ * Zufall (xorshift64*, deterministisch je Seed)
+ * ========================================== */
+
+static double simRandom(void)
+{
+    sim.rng ^= sim.rng >> 12;
+    sim.rng ^= sim.rng << 25;
+    sim.rng ^= sim.rng >> 27;
+    return (double)((sim.rng * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+/* ==========================================
+ * Ereignis-Heap (Min-Heap nach at, seq)
+ * ========================================== */
+
+static int evBefore(const struct sim_event *a, const struct sim_event *b)
+{
+    return (a->at != b->at) ? a->at < b->at : a->seq < b->seq;
+}
+
+static void evPush(struct sim_event *ev)
+{
+    size_t i;
+
+    if (sim.heapLen == sim.heapCap) {
+        sim.heapCap = sim.heapCap ? 2 * sim.heapCap : 256;
+        sim.heap = realloc(sim.heap, sim.heapCap * sizeof(*sim.heap));
+        if (sim.heap == NULL) {
+            perror("sim: realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ev->seq = sim.seq++;
+    i = sim.heapLen++;
+    while (i > 0 && evBefore(ev, &sim.heap[(i - 1) / 2])) {
+        sim.heap[i] = sim.heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim.heap[i] = *ev;
+}
+
+static void evPop(struct sim_event *ev)
+{
+    struct sim_event last;
+    size_t i = 0;
+
+    *ev = sim.heap[0];
+    last = sim.heap[--sim.heapLen];
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= sim.heapLen) break;
+        if (c + 1 < sim.heapLen && evBefore(&sim.heap[c + 1], &sim.heap[c])) c++;
+        if (!evBefore(&sim.heap[c], &last)) break;
+        sim.heap[i] = sim.heap[c];
+        i = c;
+    }
+    sim.heap[i] = last;
+}
+
+/* ==========================================
+ * Strecke
+ * ========================================== */
+
+/* Paket auf die Strecke legen: Warteschlange, Serialisierung, Laufzeit */
+static void linkSend(struct sim_link *l, int type, const void *buf, unsigned long len)
+{
+    struct sim_event ev;
+    unsigned long long start = (l->busyUntil > sim.now) ? l->busyUntil : sim.now;
+    unsigned long long txNs = l->bw ? (unsigned long long)len * 1000000000ULL / l->bw : 0;
+
+    l->tx++;
+    if (l->queueMax && txNs && (start - sim.now) / txNs >= l->queueMax) {
+        l->dropQueue++;
+        return;
+    }
+    l->busyUntil = start + txNs;
+    if (l->loss > 0 && simRandom() < l->loss) {
+        l->dropLoss++;
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.at = l->busyUntil + l->delayNs;
+    ev.type = type;
+    ev.len = (len < sizeof(ev.pkt)) ? len : sizeof(ev.pkt);
+    memcpy(&ev.pkt, buf, ev.len);
+    evPush(&ev);
+}
+
+/* Nächsten Server-Timer einplanen (nur wenn früher als der geplante) */
+static void scheduleWake(unsigned long long at)
+{
+    struct sim_event ev;
+
+    if (at == ~0ULL) return;
+    if (at <= sim.now) at = sim.now + 1;
+    if (sim.wakeAt != 0 && sim.wakeAt <= at) return;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.at = at;
+    ev.type = EV_SRV_WAKE;
+    sim.wakeAt = at;
+    evPush(&ev);
+}
+
+static void dispatch(struct sim_event *ev)
+{
+    switch (ev->type) {
+    case EV_TO_SERVER:
+        (void)arqServerAdvance(sim.srv);
+        arqServerInput(sim.srv, &ev->pkt.req, ev->len,
+                       &sim.clientAddr, sizeof(struct sockaddr_in6));
+        /* Verzögerte ACKs/Idle-Timer können neu gesetzt worden sein */
+        scheduleWake(arqServerAdvance(sim.srv));
+        break;
+    case EV_TO_CLIENT:
+        if (sim.rxLen < SIM_RX_MAX) {
+            sim.rx[(sim.rxHead + sim.rxLen) % SIM_RX_MAX] = ev->pkt.answ;
+            sim.rxLen++;
+        }
+        break;
+    case EV_SRV_WAKE:
+        if (ev->at != sim.wakeAt) break;   /* überholt */
+        sim.wakeAt = 0;
+        scheduleWake(arqServerAdvance(sim.srv));
+        break;
+    }
+}
+
+/* Ereignisse bis deadline abarbeiten; stopOnRx: schon zurückkehren,
+ * sobald für den Client etwas empfangen wurde.
+ * Rückgabewert: 1 = Client hat Empfangsdaten */
+static int runUntil(unsigned long long deadline, int stopOnRx)
+{
+    struct sim_event ev;
+
+    while (!(stopOnRx && sim.rxLen > 0) &&
+           sim.heapLen > 0 && sim.heap[0].at <= deadline) {
+        evPop(&ev);
+        if (ev.at > sim.now) sim.now = ev.at;
+        dispatch(&ev);
+    }
+    if (stopOnRx && sim.rxLen > 0) return 1;
+    if (deadline > sim.now) sim.now = deadline;
+    return sim.rxLen > 0;
+}
+
+/* ==========================================
+ * arq_io-Hooks
+ * ========================================== */
+
+static unsigned long long ioNow(void *user)
+{
+    (void)user;
+    return sim.now;
+}
+
+static int ioClientSend(void *user, const void *buf, unsigned long len,
+                        const struct sockaddr_storage *to, socklen_t toLen)
+{
+    (void)user; (void)to; (void)toLen;
+    linkSend(&sim.up, EV_TO_SERVER, buf, len);
+    return 0;
+}
+
+static long ioClientRecv(void *user, void *buf, unsigned long len)
+{
+    (void)user;
+    if (sim.rxLen == 0) return -1;
+    if (len > sizeof(struct answer)) len = sizeof(struct answer);
+    memcpy(buf, &sim.rx[sim.rxHead], len);
+    sim.rxHead = (sim.rxHead + 1) % SIM_RX_MAX;
+    sim.rxLen--;
+    return (long)len;
+}
+
+static int ioClientWait(void *user, unsigned long long deadlineNs)
+{
+    (void)user;
+    return runUntil(deadlineNs, 1);
+}
+
+static void ioClientSleepUntil(void *user, unsigned long long deadlineNs)
+{
+    (void)user;
+    runUntil(deadlineNs, 0);
+}
+
+static int ioServerSend(void *user, const void *buf, unsigned long len,
+                        const struct sockaddr_storage *to, socklen_t toLen)
+{
+    (void)user; (void)to; (void)toLen;
+    linkSend(&sim.down, EV_TO_CLIENT, buf, len);
+    return 0;
+}
+
+/* ==========================================
+ * Empfänger-Anwendung: prüft den Datenstrom gegen das Muster
+ * ========================================== */
+
+static unsigned char patternByte(unsigned long long off)
+{
+    return (unsigned char)((off * 131) ^ (off >> 9));
+}
+
+static int appStart(void *user)
+{
+    (void)user;
+    sim.rcvBytes = 0;
+    return 0;
+}
+
+static int appWrite(void *user, const char *buf, unsigned long len)
+{
+    (void)user;
+    for (unsigned long i = 0; i < len; i++) {
+        if ((unsigned char)buf[i] != patternByte(sim.rcvBytes + i)) {
+            sim.rcvBad++;
+            break;
+        }
+    }
+    sim.rcvBytes += len;
+    return 0;
+}
+
+static void appEnd(void *user)
+{
+    (void)user;
+    sim.ended = 1;
+    sim.doneAt = sim.now;
+}
+
+static void fillUnit(struct app_unit *u, unsigned long seq)
+{
+    unsigned long long off = (unsigned long long)seq * BufferSize;
+
+    u->len = BufferSize;
+    for (unsigned long i = 0; i < u->len; i++)
+        u->data[i] = (char)patternByte(off + i);
+}
+
+/* ==========================================
+ * Hauptprogramm
+ * ========================================== */
+
+static void usage(const char *progName)
+{
+    fprintf(stderr, "Usage: %s [-n <pakete>] [-w <window>] [-l <verlust>] [-d <ms>] [-b <bytes/s>]\n"
+                    "          [-q <pakete>] [-t <rto ms>] [-r <rate>] [-D <ms>] [-s <seed>] [-H]\n", progName);
+    fprintf(stderr, "       -n : Anzahl app_units à %d Bytes (Default: 1000)\n", BufferSize);
+    fprintf(stderr, "       -w : Fenstergröße (1..%d, Default: 8)\n", GBN_MAX_WINDOW);
+    fprintf(stderr, "       -l : Verlustrate je Richtung (0..1)\n");
+    fprintf(stderr, "       -d : einfache Laufzeit in ms (Default: 10)\n");
+    fprintf(stderr, "       -b : Bandbreite je Richtung in Bytes/s (Default: unbegrenzt)\n");
+    fprintf(stderr, "       -q : Warteschlange in Paketen (Drop-Tail, nur mit -b)\n");
+    fprintf(stderr, "       -t : Retransmit-Timeout in ms (Default: %d)\n",
+            GBN_TIMEOUT_UNITS * GBN_TIMEOUT_INT_MS);
+    fprintf(stderr, "       -r : Pacing in Bytes/s oder 'auto' (Default: aus = Zeitschlitze)\n");
+    fprintf(stderr, "       -D : verzögerte ACKs des Servers in ms\n");
+    fprintf(stderr, "       -s : Seed des Zufallsgenerators\n");
+    fprintf(stderr, "       -H : CSV-Kopfzeile ausgeben\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long n = 1000, seed = 1, rtoMs = 0, delAckMs = 0, rate = 0;
+    int winSize = 8, header = 0, rc = 0;
+    double delayMs = 10.0;
+    struct arq_io cio, sio;
+    struct arq_server_opts opts;
+    struct arq_server_app app;
+    struct arq_client *c;
+    struct app_unit unit;
+    struct sockaddr_in6 *sa;
+    struct timespec w0, w1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-H") == 0) { header = 1; continue; }
+        if (argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 || i + 1 >= argc)
+            usage(argv[0]);
+        switch (argv[i][1]) {
+        case 'n': n = strtoul(argv[++i], NULL, 10); break;
+        case 'w': winSize = atoi(argv[++i]); break;
+        case 'l': sim.up.loss = sim.down.loss = atof(argv[++i]); break;
+        case 'd': delayMs = atof(argv[++i]); break;
+        case 'b': sim.up.bw = sim.down.bw = strtoull(argv[++i], NULL, 10); break;
+        case 'q': sim.up.queueMax = sim.down.queueMax = strtoul(argv[++i], NULL, 10); break;
+        case 't': rtoMs = strtoul(argv[++i], NULL, 10); break;
+        case 'r':
+            i++;
+            rate = (strcmp(argv[i], "auto") == 0) ? ARQ_PACE_AUTO : strtoul(argv[i], NULL, 10);
+            break;
+        case 'D': delAckMs = strtoul(argv[++i], NULL, 10); break;
+        case 's': seed = strtoul(argv[++i], NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (n == 0 || winSize < 1 || winSize > GBN_MAX_WINDOW) usage(argv[0]);
+
+    sim.now = SIM_START_NS;
+    sim.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    sim.up.delayNs = sim.down.delayNs = (unsigned long long)(delayMs * 1e6);
+
+    sa = (struct sockaddr_in6 *)&sim.clientAddr;
+    sa->sin6_family = AF_INET6;
+    sa->sin6_addr = in6addr_loopback;
+    sa->sin6_port = htons(1);
+
+    memset(&sio, 0, sizeof(sio));
+    sio.now  = ioNow;
+    sio.send = ioServerSend;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.delayedAckMs = delAckMs;
+    opts.quiet = 1;
+
+    memset(&app, 0, sizeof(app));
+    app.start = appStart;
+    app.write = appWrite;
+    app.end   = appEnd;
+
+    sim.srv = arqServerCreateIo(&opts, &app, &sio);
+    if (sim.srv == NULL) return EXIT_FAILURE;
+    scheduleWake(arqServerAdvance(sim.srv));
+
+    memset(&cio, 0, sizeof(cio));
+    cio.now        = ioNow;
+    cio.send       = ioClientSend;
+    cio.recv       = ioClientRecv;
+    cio.wait       = ioClientWait;
+    cio.sleepUntil = ioClientSleepUntil;
+
+    c = arqClientCreateIo(&cio);
+    if (c == NULL) return EXIT_FAILURE;
+    arqClientSetRto(c, rtoMs * 1000000ULL);
+    arqClientSetPacing(c, rate);
+
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+
+    /* Übertragung: erste Einheit im Hello, letzte trägt das FIN */
+    fillUnit(&unit, 0);
+    if (arqClientHelloData(c, winSize, NULL, &unit, n == 1) != 0) rc = 1;
+    for (unsigned long i = 1; rc == 0 && i < n; i++) {
+        fillUnit(&unit, i);
+        if (i + 1 < n) {
+            if (arqClientSendData(c, &unit, winSize) != 0) rc = 1;
+        } else {
+            if (arqClientSendLast(c, &unit, winSize) != 0) rc = 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+
+    if (rc == 0 && (!sim.ended || sim.rcvBad || sim.rcvBytes != (unsigned long long)n * BufferSize))
+        rc = 2;
+
+    {
+        double simS = (double)((sim.doneAt ? sim.doneAt : sim.now) - SIM_START_NS) / 1e9;
+        double wallMs = (w1.tv_sec - w0.tv_sec) * 1e3 + (w1.tv_nsec - w0.tv_nsec) / 1e6;
+        char rateStr[32];
+
+        if (rate == ARQ_PACE_AUTO)
+            snprintf(rateStr, sizeof(rateStr), "auto");
+        else
+            snprintf(rateStr, sizeof(rateStr), "%lu", rate);
+
+        if (header)
+            printf("seed,units,window,loss,delay_ms,bw,queue,rto_ms,rate,delack_ms,"
+                   "ok,sim_s,goodput_Bps,tx_up,tx_down,loss_up,loss_down,qdrop_up,qdrop_down,wall_ms\n");
+        printf("%lu,%lu,%d,%g,%g,%llu,%lu,%lu,%s,%lu,%d,%.6f,%.0f,%lu,%lu,%lu,%lu,%lu,%lu,%.3f\n",
+               seed, n, winSize, sim.up.loss, delayMs, sim.up.bw, sim.up.queueMax, rtoMs,
+               rateStr,
+               delAckMs, rc == 0, simS, simS > 0 ? (double)sim.rcvBytes / simS : 0.0,
+               sim.up.tx, sim.down.tx, sim.up.dropLoss, sim.down.dropLoss,
+               sim.up.dropQueue, sim.down.dropQueue, wallMs);
+    }
+
+    arqClientDestroy(c);
+    arqServerDestroy(sim.srv);
+    free(sim.heap);
+    return rc;
+}
@@ -0,0 +1,99 @@
+/* timerwheel.c - Hashed Timer Wheel (O(1) Einfügen/Entfernen) */
+
+#include <stddef.h>
+#include <time.h>
+
+#include "timerwheel.h"
+
+unsigned long long twNowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+void twInit(struct timer_wheel *w, unsigned long long nowMs)
+{
+    for (int i = 0; i < TW_SLOTS; i++) {
+        w->slots[i].next = &w->slots[i];
+        w->slots[i].prev = &w->slots[i];
+    }
+    w->tick = nowMs / TW_TICK_MS;
+}
+
+void twTimerInit(struct tw_timer *t, twFn fn, void *arg)
+{
+    t->next = NULL;
+    t->prev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+int twPending(const struct tw_timer *t)
+{
+    return t->next != NULL;
+}
+
+void twCancel(struct tw_timer *t)
+{
+    if (t->next == NULL) return;
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+void twAdd(struct timer_wheel *w, struct tw_timer *t, unsigned long delayMs)
+{
+    struct tw_timer *head;
+    unsigned long long ticks = (delayMs + TW_TICK_MS - 1) / TW_TICK_MS;
+
+    twCancel(t);
+    if (ticks == 0) ticks = 1;
+    t->expires = w->tick + ticks;
+
+    head = &w->slots[t->expires % TW_SLOTS];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+void twAdvance(struct timer_wheel *w, unsigned long long nowMs)
+{
+    unsigned long long target = nowMs / TW_TICK_MS;
+
+    /* Nach langer Pause höchstens eine Umdrehung nachholen */
+    if (target > w->tick + TW_SLOTS)
+        w->tick = target - TW_SLOTS;
+
+    while (w->tick < target) {
+        struct tw_timer *head, *t, *next;
+
+        w->tick++;
+        head = &w->slots[w->tick % TW_SLOTS];
+        for (t = head->next; t != head; t = next) {
+            next = t->next;
+            if (t->expires > w->tick) continue;
+            twCancel(t);
+            /* Callback darf Timer (auch diesen) neu setzen oder löschen;
+             * next kann dadurch ungültig werden -> Slot neu beginnen */
+            t->fn(t, t->arg);
+            next = head->next;
+        }
+    }
+}
+
+unsigned long long twNextExpiryMs(const struct timer_wheel *w)
+{
+    unsigned long long best = ~0ULL;
+
+    for (int i = 0; i < TW_SLOTS; i++) {
+        const struct tw_timer *head = &w->slots[i];
+        for (const struct tw_timer *t = head->next; t != head; t = t->next) {
+            if (t->expires < best) best = t->expires;
+        }
+    }
+    return (best == ~0ULL) ? best : best * TW_TICK_MS;
+}
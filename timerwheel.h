@@ -0,0 +1,57 @@
+#ifndef TIMERWHEEL_H_INCLUDED
+#define TIMERWHEEL_H_INCLUDED
+
+/*
+ * Hashed Timer Wheel für die Server-Sitzungen.
+ *
+ * Ein Timer liegt im Slot (Ablauf-Tick % TW_SLOTS) einer doppelt
+ * verketteten Liste; Einfügen und Entfernen sind O(1). twAdvance()
+ * arbeitet je vergangenem Tick genau einen Slot ab. Timer, die weiter
+ * als eine Umdrehung in der Zukunft liegen, bleiben im Slot liegen,
+ * bis ihr Tick erreicht ist.
+ */
+
+#define TW_SLOTS    512
+#define TW_TICK_MS  5
+
+struct tw_timer;
+typedef void (*twFn)(struct tw_timer *t, void *arg);
+
+struct tw_timer {
+    struct tw_timer   *next;
+    struct tw_timer   *prev;
+    unsigned long long expires;   /* Ablauf in Ticks */
+    twFn               fn;
+    void              *arg;
+};
+
+struct timer_wheel {
+    struct tw_timer    slots[TW_SLOTS];  /* Listenköpfe (Sentinels) */
+    unsigned long long tick;             /* zuletzt abgearbeiteter Tick */
+};
+
+/* Monotone Uhr in Millisekunden */
+unsigned long long twNowMs(void);
+
+void twInit(struct timer_wheel *w, unsigned long long nowMs);
+
+/* Timer vorbereiten (nicht aktiv). */
+void twTimerInit(struct tw_timer *t, twFn fn, void *arg);
+
+/* Timer in delayMs Millisekunden auslösen (ersetzt einen aktiven Lauf). */
+void twAdd(struct timer_wheel *w, struct tw_timer *t, unsigned long delayMs);
+
+/* Aktiven Timer entfernen; für inaktive Timer ohne Wirkung. */
+void twCancel(struct tw_timer *t);
+
+int twPending(const struct tw_timer *t);
+
+/* Alle bis nowMs fälligen Timer auslösen. */
+void twAdvance(struct timer_wheel *w, unsigned long long nowMs);
+
+/* Ablaufzeitpunkt (ms) des frühesten aktiven Timers, ~0ULL wenn keiner
+ * aktiv ist. O(TW_SLOTS + Timer), für Simulation/ereignisgesteuerte
+ * Aufrufer statt eines festen Ticks. */
+unsigned long long twNextExpiryMs(const struct timer_wheel *w);
+
+#endif /* TIMERWHEEL_H_INCLUDED */
@@ -0,0 +1,281 @@
+/* trace.c - Mitschnitt der Datagramme, siehe trace.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "trace.h"
+
+#define TRACE_PEER     4                /* Adresse, nur in der Datei       */
+#define TRACE_BUF      (64UL << 10)     /* Schreibpuffer                   */
+#define TRACE_REC_MAX  (1UL << 16)      /* längstes Datagramm beim Lesen   */
+
+struct trace_peer {
+    struct sockaddr_storage addr;
+    socklen_t               len;
+};
+
+struct arq_trace {
+    int                fd;          /* Schreiben */
+    FILE              *fp;          /* Lesen     */
+    int                err;
+    unsigned long long lastNs;
+
+    /* Gegenstellen: Nummer i + 1 = peers[i]; beim Schreiben dazu eine
+     * Hash-Tabelle (offene Adressierung, 0 = frei) */
+    struct trace_peer *peers;
+    unsigned long      nPeers, capPeers;
+    unsigned long     *slots;
+    unsigned long      nSlots;
+
+    unsigned char     *buf;         /* Schreibpuffer bzw. Record-Daten */
+    unsigned long      used;
+};
+
+static unsigned long peer_hash(const struct sockaddr_storage *a, socklen_t len)
+{
+    const unsigned char *p = (const unsigned char *)a;
+    unsigned long h = 1469598103934665603UL;   /* FNV-1a */
+
+    for (socklen_t i = 0; i < len; i++) h = (h ^ p[i]) * 1099511628211UL;
+    return h;
+}
+
+static int peer_add(struct arq_trace *t, const struct sockaddr_storage *a, socklen_t len)
+{
+    if (t->nPeers == t->capPeers) {
+        unsigned long cap = t->capPeers ? 2 * t->capPeers : 16;
+        struct trace_peer *p = realloc(t->peers, cap * sizeof(*p));
+        if (p == NULL) return -1;
+        t->peers = p;
+        t->capPeers = cap;
+    }
+    memset(&t->peers[t->nPeers].addr, 0, sizeof(t->peers[0].addr));
+    memcpy(&t->peers[t->nPeers].addr, a, len);
+    t->peers[t->nPeers].len = len;
+    t->nPeers++;
+    return 0;
+}
+
+/* Hash-Tabelle auf doppelte Größe bringen */
+static int slots_grow(struct arq_trace *t)
+{
+    unsigned long n = t->nSlots ? 2 * t->nSlots : 64;
+    unsigned long *s = calloc(n, sizeof(*s));
+
+    if (s == NULL) return -1;
+    for (unsigned long i = 0; i < t->nPeers; i++) {
+        unsigned long h = peer_hash(&t->peers[i].addr, t->peers[i].len) & (n - 1);
+        while (s[h] != 0) h = (h + 1) & (n - 1);
+        s[h] = i + 1;
+    }
+    free(t->slots);
+    t->slots = s;
+    t->nSlots = n;
+    return 0;
+}
+
+static void put_byte(struct arq_trace *t, unsigned char b)
+{
+    t->buf[t->used++] = b;
+}
+
+static void put_varint(struct arq_trace *t, unsigned long long v)
+{
+    while (v >= 0x80) {
+        put_byte(t, (unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(t, (unsigned char)v);
+}
+
+void traceFlush(struct arq_trace *t)
+{
+    unsigned long off = 0;
+
+    while (off < t->used) {
+        ssize_t n = write(t->fd, t->buf + off, t->used - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            t->err = 1;
+            break;
+        }
+        off += (unsigned long)n;
+    }
+    t->used = 0;
+}
+
+/* Nummer der Gegenstelle; neue Adressen als TRACE_PEER eintragen */
+static unsigned long peer_id(struct arq_trace *t, unsigned long long dt,
+                             const struct sockaddr_storage *a, socklen_t len)
+{
+    unsigned long h;
+
+    if (a == NULL || len == 0 || len > sizeof(*a)) return 0;
+    if (2 * (t->nPeers + 1) > t->nSlots && slots_grow(t) < 0) return 0;
+    for (h = peer_hash(a, len) & (t->nSlots - 1); t->slots[h] != 0;
+         h = (h + 1) & (t->nSlots - 1)) {
+        const struct trace_peer *p = &t->peers[t->slots[h] - 1];
+        if (p->len == len && memcmp(&p->addr, a, len) == 0) return t->slots[h];
+    }
+    if (peer_add(t, a, len) < 0) return 0;
+    t->slots[h] = t->nPeers;
+
+    put_byte(t, TRACE_PEER);
+    put_varint(t, dt);
+    put_byte(t, (unsigned char)len);
+    memcpy(t->buf + t->used, a, len);
+    t->used += len;
+    return t->nPeers;
+}
+
+struct arq_trace *traceCreate(const char *path, const struct trace_hdr *hdr)
+{
+    struct arq_trace *t = calloc(1, sizeof(*t));
+    struct trace_hdr h = *hdr;
+
+    if (t == NULL || (t->buf = malloc(TRACE_BUF)) == NULL) {
+        free(t);
+        return NULL;
+    }
+    t->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (t->fd < 0) {
+        free(t->buf);
+        free(t);
+        return NULL;
+    }
+    memcpy(h.Magic, "GBNTRC", sizeof(h.Magic));
+    h.Version = TRACE_VERSION;
+    memcpy(t->buf, &h, sizeof(h));
+    t->used = sizeof(h);
+    t->lastNs = h.StartNs;
+    return t;
+}
+
+void traceRecord(struct arq_trace *t, int kind, unsigned long long ns,
+                 const struct sockaddr_storage *peer, socklen_t peerLen,
+                 const void *buf, unsigned long len)
+{
+    const unsigned char *p = buf;
+    unsigned long long dt = (ns > t->lastNs) ? ns - t->lastNs : 0;
+    unsigned long stored = len, id, before;
+
+    /* Platz für Record, Adresse und fünf varints */
+    if (t->used + len + sizeof(*peer) + 64 > TRACE_BUF) traceFlush(t);
+    if (t->used + len + sizeof(*peer) + 64 > TRACE_BUF) return;   /* zu lang */
+    t->lastNs += dt;
+
+    if (kind == TRACE_TICK) {
+        put_byte(t, (unsigned char)kind);
+        put_varint(t, dt);
+        return;
+    }
+    before = t->nPeers;
+    id = peer_id(t, dt, peer, peerLen);
+    if (t->nPeers != before) dt = 0;   /* Abstand steht im TRACE_PEER davor */
+    while (stored > 0 && p[stored - 1] == 0) stored--;
+
+    put_byte(t, (unsigned char)kind);
+    put_varint(t, dt);
+    put_varint(t, id);
+    put_varint(t, len);
+    put_varint(t, stored);
+    memcpy(t->buf + t->used, p, stored);
+    t->used += stored;
+}
+
+struct arq_trace *traceOpen(const char *path, struct trace_hdr *hdr)
+{
+    struct arq_trace *t = calloc(1, sizeof(*t));
+
+    if (t == NULL || (t->buf = malloc(TRACE_REC_MAX)) == NULL) {
+        free(t);
+        return NULL;
+    }
+    t->fd = -1;
+    t->fp = fopen(path, "rb");
+    if (t->fp == NULL || fread(hdr, sizeof(*hdr), 1, t->fp) != 1 ||
+        memcmp(hdr->Magic, "GBNTRC", sizeof(hdr->Magic)) != 0 ||
+        hdr->Version != TRACE_VERSION) {
+        if (t->fp) fclose(t->fp);
+        free(t->buf);
+        free(t);
+        return NULL;
+    }
+    t->lastNs = hdr->StartNs;
+    return t;
+}
+
+static int get_varint(struct arq_trace *t, unsigned long long *v)
+{
+    int c, shift = 0;
+
+    *v = 0;
+    do {
+        if ((c = getc(t->fp)) == EOF || shift > 63) return -1;
+        *v |= (unsigned long long)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return 0;
+}
+
+int traceRead(struct arq_trace *t, struct trace_rec *rec)
+{
+    unsigned long long dt, id, len, stored;
+    int kind;
+
+    for (;;) {
+        if ((kind = getc(t->fp)) == EOF) return 0;
+        if (get_varint(t, &dt) < 0) return -1;
+        t->lastNs += dt;
+        if (kind != TRACE_PEER) break;
+
+        /* Adresse der nächsten Gegenstelle */
+        struct sockaddr_storage a;
+        int al = getc(t->fp);
+        if (al == EOF || (size_t)al > sizeof(a) ||
+            fread(&a, 1, (size_t)al, t->fp) != (size_t)al ||
+            peer_add(t, &a, (socklen_t)al) < 0)
+            return -1;
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    rec->kind = kind;
+    rec->ns = t->lastNs;
+    if (kind == TRACE_TICK) return 1;
+    if ((kind != TRACE_RX && kind != TRACE_TX) ||
+        get_varint(t, &id) < 0 || get_varint(t, &len) < 0 ||
+        get_varint(t, &stored) < 0 ||
+        id > t->nPeers || len > TRACE_REC_MAX || stored > len ||
+        fread(t->buf, 1, stored, t->fp) != stored)
+        return -1;
+    memset(t->buf + stored, 0, len - stored);
+    if (id > 0) {
+        rec->peer = &t->peers[id - 1].addr;
+        rec->peerLen = t->peers[id - 1].len;
+    }
+    rec->len = (unsigned long)len;
+    rec->data = t->buf;
+    return 1;
+}
+
+int traceClose(struct arq_trace *t)
+{
+    int rc = 0;
+
+    if (t == NULL) return 0;
+    if (t->fp) {
+        fclose(t->fp);
+    } else {
+        traceFlush(t);
+        if (close(t->fd) != 0 || t->err) rc = -1;
+    }
+    free(t->peers);
+    free(t->slots);
+    free(t->buf);
+    free(t);
+    return rc;
+}
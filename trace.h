@@ -0,0 +1,86 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <sys/socket.h>
+
+/*
+ * Mitschnitt der Datagramme einer ARQ-Engine (Trace) zur Analyse und
+ * zur Wiedergabe (replay.c).
+ *
+ * Aufgezeichnet wird auf der SAP-Schicht: jedes empfangene und
+ * gesendete Datagramm so, wie es auf dem Draht liegt, mit der Zeit der
+ * Engine (io->now, ns) und der Gegenstelle; beim Server zusätzlich die
+ * Ticks des Timer Wheels, damit Timer bei der Wiedergabe zur selben
+ * Zeit feuern.
+ *
+ * Dateiformat (Byteordnung des Rechners): struct trace_hdr, danach
+ * Records aus Art (1 Byte) und Abstand zum vorigen Record (varint, ns):
+ *   TRACE_RX/TX : Gegenstelle (varint, 0 = Server des Clients),
+ *                 Länge (varint), gespeicherte Bytes (varint), Bytes;
+ *                 Nullbytes am Ende (Auffüllung von name[]) entfallen
+ *   TRACE_PEER  : Adresslänge (1 Byte), sockaddr; erhält die nächste
+ *                 Nummer ab 1 (nur intern, traceRead() löst sie auf)
+ *   TRACE_TICK  : keine Daten
+ */
+
+#define TRACE_RX    1   /* Datagramm empfangen        */
+#define TRACE_TX    2   /* Datagramm gesendet         */
+#define TRACE_TICK  3   /* Tick des Timer Wheels      */
+
+#define TRACE_VERSION  1
+
+struct trace_hdr {
+    char               Magic[6];    /* "GBNTRC", von traceCreate() gesetzt */
+    unsigned char      Version;
+    unsigned char      Side;        /* 'S' Server, 'C' Client              */
+    unsigned long long StartNs;     /* Bezug für den ersten Abstand        */
+    union {                         /* Einstellungen für die Wiedergabe    */
+        struct {
+            double        lossReq, lossAck;
+            unsigned long delAckMs, idleMs;
+            int           cookies;
+            unsigned char cookieKey[32];   /* nur im Trace, gilt nur für diesen Lauf */
+        } srv;
+        struct {
+            unsigned long      pace;
+            unsigned long long rtoNs, coalDelayNs;
+            unsigned long      lifetimeMs;
+            unsigned int       maxRetx;
+        } cli;
+    } Conf;
+};
+
+struct trace_rec {
+    int                            kind;    /* TRACE_*                     */
+    unsigned long long             ns;
+    const struct sockaddr_storage *peer;    /* NULL: keine Adresse         */
+    socklen_t                      peerLen;
+    unsigned long                  len;
+    const unsigned char           *data;    /* gültig bis zum nächsten traceRead() */
+};
+
+struct arq_trace;
+
+/* Datei anlegen (0600) und Kopf schreiben (Side, StartNs und Conf
+ * vom Aufrufer). Rückgabewert: Trace oder NULL. */
+struct arq_trace *traceCreate(const char *path, const struct trace_hdr *hdr);
+
+/* Ein Record anhängen (gepuffert); peer == NULL: keine Adresse. */
+void traceRecord(struct arq_trace *t, int kind, unsigned long long ns,
+                 const struct sockaddr_storage *peer, socklen_t peerLen,
+                 const void *buf, unsigned long len);
+
+/* Gepufferte Records schreiben. */
+void traceFlush(struct arq_trace *t);
+
+/* Zum Lesen öffnen, Kopf nach *hdr. Rückgabewert: Trace oder NULL. */
+struct arq_trace *traceOpen(const char *path, struct trace_hdr *hdr);
+
+/* Nächster Record. Rückgabewert: 1, 0 am Ende, <0 bei defekter Datei. */
+int  traceRead(struct arq_trace *t, struct trace_rec *rec);
+
+/* Schließen (beim Schreiben vorher leeren).
+ * Rückgabewert: 0, <0 bei Schreibfehler. */
+int  traceClose(struct arq_trace *t);
+
+#endif /* TRACE_H_INCLUDED */
@@ -0,0 +1,234 @@
+/* uring.c - io_uring über rohe Systemaufrufe, siehe uring.h */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+static int sys_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                     unsigned flags, void *arg, size_t argSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int sys_register(int fd, unsigned op, void *arg, unsigned nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+int uringInit(struct uring *u, unsigned entries)
+{
+    struct io_uring_params p;
+    char *sq;
+    size_t sqSize, cqSize;
+
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+
+    /* Nur ein Thread reicht ein: Kernel spart Synchronisation und IPIs */
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    u->fd = sys_setup(entries, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        u->fd = sys_setup(entries, &p);
+    }
+    if (u->fd < 0) return -1;
+
+    /* SQ- und CQ-Ring in einer Abbildung (IORING_FEAT_SINGLE_MMAP) */
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(u->fd);
+        u->fd = -1;
+        errno = ENOSYS;
+        return -1;
+    }
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ringSize = (sqSize > cqSize) ? sqSize : cqSize;
+    u->ringMem = mmap(NULL, u->ringSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->ringMem == MAP_FAILED) {
+        u->ringMem = NULL;
+        uringExit(u);
+        return -1;
+    }
+    u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        uringExit(u);
+        return -1;
+    }
+
+    sq = u->ringMem;
+    u->sqHead    = (unsigned *)(sq + p.sq_off.head);
+    u->sqTail    = (unsigned *)(sq + p.sq_off.tail);
+    u->sqMask    = (unsigned *)(sq + p.sq_off.ring_mask);
+    u->sqArray   = (unsigned *)(sq + p.sq_off.array);
+    u->sqEntries = p.sq_entries;
+    u->cqHead    = (unsigned *)(sq + p.cq_off.head);
+    u->cqTail    = (unsigned *)(sq + p.cq_off.tail);
+    u->cqMask    = (unsigned *)(sq + p.cq_off.ring_mask);
+    u->cqes      = (struct io_uring_cqe *)(sq + p.cq_off.cqes);
+
+    u->sqLocalTail = u->sqSubmitted = *u->sqTail;
+    return 0;
+}
+
+void uringExit(struct uring *u)
+{
+    if (u->br) {
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = u->bgid;
+        (void)sys_register(u->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(u->br, u->brSize);
+        u->br = NULL;
+    }
+    free(u->bufs);
+    u->bufs = NULL;
+    if (u->sqes) munmap(u->sqes, u->sqesSize);
+    if (u->ringMem) munmap(u->ringMem, u->ringSize);
+    u->sqes = NULL;
+    u->ringMem = NULL;
+    if (u->fd >= 0) close(u->fd);
+    u->fd = -1;
+}
+
+struct io_uring_sqe *uringSqe(struct uring *u)
+{
+    struct io_uring_sqe *sqe;
+    unsigned idx;
+
+    while (u->sqLocalTail - __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE) >= u->sqEntries) {
+        if (uringEnter(u, 0, -1) < 0) return NULL;
+    }
+    idx = u->sqLocalTail & *u->sqMask;
+    sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[idx] = idx;
+    u->sqLocalTail++;
+    return sqe;
+}
+
+int uringEnter(struct uring *u, unsigned waitNr, long long timeoutNs)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned toSubmit = u->sqLocalTail - u->sqSubmitted;
+    unsigned flags = 0;
+    void *argp = NULL;
+    size_t argSize = 0;
+    int n;
+
+    if (toSubmit == 0 && waitNr == 0) return 0;
+
+    __atomic_store_n(u->sqTail, u->sqLocalTail, __ATOMIC_RELEASE);
+    if (waitNr > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutNs >= 0) {
+            ts.tv_sec  = timeoutNs / 1000000000LL;
+            ts.tv_nsec = timeoutNs % 1000000000LL;
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (unsigned long long)(unsigned long)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argSize = sizeof(arg);
+        }
+    }
+
+    n = sys_enter(u->fd, toSubmit, waitNr, flags, argp, argSize);
+    if (n < 0) {
+        if (errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY)
+            return 0;
+        return -1;
+    }
+    u->sqSubmitted += (unsigned)n;
+    return 0;
+}
+
+struct io_uring_cqe *uringPeek(struct uring *u)
+{
+    unsigned head = *u->cqHead;
+
+    if (head == __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &u->cqes[head & *u->cqMask];
+}
+
+void uringSeen(struct uring *u)
+{
+    __atomic_store_n(u->cqHead, *u->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+unsigned uringReady(const struct uring *u)
+{
+    return __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE) - *u->cqHead;
+}
+
+int uringBufRing(struct uring *u, unsigned short bgid, unsigned entries, unsigned size)
+{
+    struct io_uring_buf_reg reg;
+
+    u->brSize = entries * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->brSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        return -1;
+    }
+    u->bufs = malloc((size_t)entries * size);
+    if (u->bufs == NULL) {
+        munmap(u->br, u->brSize);
+        u->br = NULL;
+        return -1;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (unsigned long)u->br;
+    reg.ring_entries = entries;
+    reg.bgid         = bgid;
+    if (sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(u->br, u->brSize);
+        free(u->bufs);
+        u->br = NULL;
+        u->bufs = NULL;
+        return -1;
+    }
+
+    u->brEntries = entries;
+    u->brTail    = 0;
+    u->bgid      = bgid;
+    u->bufSize   = size;
+    for (unsigned i = 0; i < entries; i++)
+        uringBufPut(u, (unsigned short)i);
+    return 0;
+}
+
+void *uringBuf(struct uring *u, unsigned short bid)
+{
+    return u->bufs + (size_t)bid * u->bufSize;
+}
+
+void uringBufPut(struct uring *u, unsigned short bid)
+{
+    struct io_uring_buf *b = &u->br->bufs[u->brTail & (u->brEntries - 1)];
+
+    b->addr = (unsigned long)uringBuf(u, bid);
+    b->len  = u->bufSize;
+    b->bid  = bid;
+    u->brTail++;
+    __atomic_store_n(&u->br->tail, u->brTail, __ATOMIC_RELEASE);
+}
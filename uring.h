@@ -0,0 +1,75 @@
+#ifndef URING_H_INCLUDED
+#define URING_H_INCLUDED
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/*
+ * Minimaler io_uring-Zugang über die rohen Systemaufrufe (ohne liburing).
+ *
+ * Submission- und Completion-Queue liegen gemeinsam im Speicher des
+ * Prozesses: SQEs werden nur eingetragen und erst mit uringEnter() in
+ * einem Aufruf übergeben; CQEs werden ohne Systemaufruf abgeholt
+ * (uringPeek/uringSeen). Optional ein Buffer-Ring für Multishot-Empfang
+ * (der Kernel wählt je Datagramm einen freien Puffer).
+ *
+ * Nicht thread-sicher; ein Ring gehört einem Thread.
+ */
+
+struct uring {
+    int                  fd;
+
+    /* Submission Queue */
+    unsigned            *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned             sqEntries;
+    unsigned             sqLocalTail;   /* eingetragen, noch nicht veröffentlicht */
+    unsigned             sqSubmitted;   /* bereits an den Kernel übergeben        */
+    struct io_uring_sqe *sqes;
+
+    /* Completion Queue */
+    unsigned            *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+
+    void                *ringMem;
+    size_t               ringSize;
+    size_t               sqesSize;
+
+    /* Buffer-Ring (uringBufRing), sonst br == NULL */
+    struct io_uring_buf_ring *br;
+    size_t               brSize;
+    unsigned             brEntries;
+    unsigned short       brTail;
+    unsigned short       bgid;
+    char                *bufs;
+    unsigned             bufSize;
+};
+
+/* Ring mit entries SQEs anlegen. Rückgabewert: 0, <0 wenn io_uring
+ * nicht verfügbar ist (alter Kernel, seccomp) -> Aufrufer fällt zurück. */
+int  uringInit(struct uring *u, unsigned entries);
+void uringExit(struct uring *u);
+
+/* Freie, genullte SQE; bei voller SQ werden die eingetragenen zuerst
+ * übergeben. user_data und Opcode setzt der Aufrufer. */
+struct io_uring_sqe *uringSqe(struct uring *u);
+
+/* Eingetragene SQEs übergeben und auf mindestens waitNr CQEs warten,
+ * höchstens timeoutNs (<0: unbegrenzt). Ohne SQEs und waitNr == 0 kein
+ * Systemaufruf. Rückgabewert: 0 (auch bei Timeout/EINTR), <0 bei Fehler. */
+int  uringEnter(struct uring *u, unsigned waitNr, long long timeoutNs);
+
+/* Nächste CQE oder NULL; nach der Auswertung uringSeen() aufrufen. */
+struct io_uring_cqe *uringPeek(struct uring *u);
+void uringSeen(struct uring *u);
+
+/* Anzahl abholbereiter CQEs */
+unsigned uringReady(const struct uring *u);
+
+/* Buffer-Ring mit entries (Zweierpotenz) Puffern à size Bytes als
+ * Gruppe bgid registrieren. Rückgabewert: 0, <0 bei Fehler. */
+int   uringBufRing(struct uring *u, unsigned short bgid, unsigned entries, unsigned size);
+void *uringBuf(struct uring *u, unsigned short bid);
+/* Puffer bid nach der Auswertung an den Kernel zurückgeben. */
+void  uringBufPut(struct uring *u, unsigned short bid);
+
+#endif /* URING_H_INCLUDED */